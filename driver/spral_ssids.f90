@@ -124,9 +124,14 @@ program run_prob
   smanal = (stop_t - start_t)/real(rate_t)
   print "(a,es10.2)", "Predict nfact = ", real(inform%num_factor)
   print "(a,es10.2)", "Predict nflop = ", real(inform%num_flops)
+  print "(a,es10.2)", "Predict maxcontrib = ", real(inform%maxcontrib)
   print "(a6, i10)", "nparts", inform%nparts
   print "(a6, es10.2)", "cpu_flops", real(inform%cpu_flops)
   print "(a6, es10.2)", "gpu_flops", real(inform%gpu_flops)
+  print "(a,7es10.2)", "Analyse times (order etree counts snodes rows map &
+       &subtrees) = ", inform%time_order, inform%time_etree, &
+       inform%time_col_counts, inform%time_supernodes, inform%time_row_lists, &
+       inform%time_map, inform%time_subtrees
   smaflop = real(inform%num_flops)
   smafact = real(inform%num_factor)
 
@@ -154,6 +159,9 @@ program run_prob
   end if
   write (*, "(a)") "ok"
   print *, "Factor took ", (stop_t - start_t)/real(rate_t)
+  if (inform%part_node_cost .ge. 0) &
+       print "(a,2es10.2)", "Fitted part_node_cost, part_entry_cost = ", &
+       inform%part_node_cost, inform%part_entry_cost
   smfact = (stop_t - start_t)/real(rate_t)
 
   ! Solve
@@ -248,6 +256,15 @@ contains
           options%ordering = 2 ! Matching-based ordering
           options%scaling = 3 ! Scaling from matching ordering
           print *, "Using matching-based ordering (scaling overwritten)"
+       case("--ordering=nd")
+          options%ordering = 3 ! Native nested dissection
+          print *, "Using native nested dissection ordering"
+       case("--ordering=amd")
+          options%ordering = 4 ! Approximate minimum degree
+          print *, "Using approximate minimum degree ordering"
+       case("--ordering=auto")
+          options%ordering = 5 ! Choose between AMD and METIS
+          print *, "Using automatic choice of ordering"
        case("--force-posdef")
           force_psdef = .true.
           print *, "Forcing matrix to be positive definite"
@@ -271,6 +288,13 @@ contains
           argnum = argnum + 1
           read (argval, *) options%nemin
           print *, 'Supernode amalgamation nemin = ', options%nemin
+       case("--amalg-cost")
+          options%amalgamation = 2 ! Cost model amalgamation
+          print *, 'Using cost model for supernode amalgamation'
+       case("--analyse-cache")
+          call get_command_argument(argnum, options%analyse_cache)
+          argnum = argnum + 1
+          print *, 'Caching analyse results in ', trim(options%analyse_cache)
        case("--u")
           call get_command_argument(argnum, argval)
           argnum = argnum + 1
@@ -318,6 +342,16 @@ contains
           read (argval, *) options%gpu_perf_coeff
           print *, 'GPU Performance coefficient = ', &
                options%gpu_perf_coeff
+       case("--part-node-cost")
+          call get_command_argument(argnum, argval)
+          argnum = argnum + 1
+          read (argval, *) options%part_node_cost
+          print *, 'Subtree splitting node cost = ', options%part_node_cost
+       case("--part-entry-cost")
+          call get_command_argument(argnum, argval)
+          argnum = argnum + 1
+          read (argval, *) options%part_entry_cost
+          print *, 'Subtree splitting entry cost = ', options%part_entry_cost
        case("--small-subtree-threshold")
           call get_command_argument(argnum, argval)
           argnum = argnum + 1
@@ -329,9 +363,27 @@ contains
           argnum = argnum + 1
           read (argval, *) options%cpu_block_size
           print *, 'CPU block size = ', options%cpu_block_size
+       case("--cpu-inner-block-size")
+          call get_command_argument(argnum, argval)
+          argnum = argnum + 1
+          read (argval, *) options%cpu_inner_block_size
+          print *, 'CPU inner block size = ', options%cpu_inner_block_size
+       case("--cholesky-schedule")
+          call get_command_argument(argnum, argval)
+          argnum = argnum + 1
+          read (argval, *) options%cholesky_schedule
+          print *, 'Cholesky schedule = ', options%cholesky_schedule
+       case("--tree-schedule")
+          call get_command_argument(argnum, argval)
+          argnum = argnum + 1
+          read (argval, *) options%tree_schedule
+          print *, 'Tree schedule = ', options%tree_schedule
        case("--no-ignore-numa")
           options%ignore_numa = .false.
           print *, 'Using separate NUMA regions'
+       case("--no-ignore-cache")
+          options%ignore_cache = .false.
+          print *, 'Using separate L3 cache groups'
        case default
           if (seen_fname) then
              print *, "Unrecognised command line argument: ", argval
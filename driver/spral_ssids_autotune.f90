@@ -0,0 +1,531 @@
+! Sweeps the main performance tuning options of SSIDS over a set of
+! representative problems and writes the best values found to a profile
+! that can be loaded with ssids_options%read_profile() (or in C by setting
+! the environment variable SPRAL_SSIDS_PROFILE before calling
+! spral_ssids_default_options()).
+program ssids_autotune
+  use spral_random
+  use spral_random_matrix, only : random_matrix_generate
+  use spral_rutherford_boeing
+  use spral_ssids
+  use spral_matrix_util, only : SPRAL_MATRIX_REAL_SYM_INDEF
+  implicit none
+
+  integer, parameter :: wp = kind(0d0)
+  integer, parameter :: long = selected_int_kind(18)
+
+  ! Parameter values to sweep
+  integer, dimension(*), parameter :: nemin_vals = (/ 8, 16, 32, 64 /)
+  integer(long), dimension(*), parameter :: threshold_vals = &
+       (/ 1000000_long, 4000000_long, 16000000_long /)
+  integer, dimension(*), parameter :: block_size_vals = (/ 128, 256, 512 /)
+  integer, dimension(*), parameter :: amalg_vals = (/ 1, 2 /) ! nemin, cost
+  integer, dimension(*), parameter :: inner_block_size_vals = (/ 16, 32, 64 /)
+
+  ! Problem description
+  type problem_type
+     character(len=:), allocatable :: name
+     integer :: n
+     integer, dimension(:), allocatable :: ptr, row
+     real(wp), dimension(:), allocatable :: val
+     real(wp), dimension(:), allocatable :: rhs
+  end type problem_type
+
+  type(problem_type), dimension(:), allocatable :: probs
+  type(ssids_options) :: options, best_options
+  character(len=:), allocatable :: output
+  logical :: posdef
+  integer :: nrep
+
+  integer :: i, j, k, l, p, flag
+  real(wp) :: tanal, tfact, tsolve, ttotal, best
+  character(len=200) :: hostname
+
+  call proc_args(probs, output, posdef, nrep, options)
+  if (size(probs) .eq. 0) then
+     print *, "No problems specified. Usage:"
+     print *, "   spral_ssids_autotune [--posdef] [--nrep k] ", &
+          "[--output file] [--random n nnz] [matrix.rb ...]"
+     stop
+  end if
+
+  ! Calibrate amalgamation cost model for this machine
+  call calibrate_amalg(options, nrep)
+  print "(a,es10.3)", "Calibrated amalg_node_cost    = ", &
+       options%amalg_node_cost
+  print "(a,f10.3)", "Calibrated amalg_half_width   = ", &
+       options%amalg_half_width
+
+  ! Sweep parameter space
+  best = huge(best)
+  best_options = options
+  write (*, "(a8,a12,a8,a6,3a10)") &
+       "nemin", "threshold", "blksz", "amalg", "analyse", "factor", "solve"
+  do i = 1, size(nemin_vals)
+     do j = 1, size(threshold_vals)
+        do k = 1, size(block_size_vals)
+           do l = 1, size(amalg_vals)
+              options%nemin = nemin_vals(i)
+              options%small_subtree_threshold = threshold_vals(j)
+              options%cpu_block_size = block_size_vals(k)
+              options%amalgamation = amalg_vals(l)
+              tanal = 0; tfact = 0; tsolve = 0
+              do p = 1, size(probs)
+                 call time_problem(probs(p), options, posdef, nrep, tanal, &
+                      tfact, tsolve, flag)
+                 if (flag .lt. 0) exit
+              end do
+              if (flag .lt. 0) then
+                 write (*, "(i8,i12,i8,i6,a,i0)") options%nemin, &
+                      options%small_subtree_threshold, &
+                      options%cpu_block_size, options%amalgamation, &
+                      "   failed with flag ", flag
+                 cycle
+              end if
+              write (*, "(i8,i12,i8,i6,3f10.4)") options%nemin, &
+                   options%small_subtree_threshold, options%cpu_block_size, &
+                   options%amalgamation, tanal, tfact, tsolve
+              ttotal = tanal + tfact + tsolve
+              if (ttotal .lt. best) then
+                 best = ttotal
+                 best_options = options
+              end if
+           end do
+        end do
+     end do
+  end do
+
+  if (best .eq. huge(best)) then
+     print *, "All parameter choices failed, no profile written"
+     stop
+  end if
+
+  ! Write results
+  print *
+  print "(a,i0)", "Best nemin                   = ", best_options%nemin
+  print "(a,i0)", "Best small_subtree_threshold = ", &
+       best_options%small_subtree_threshold
+  print "(a,i0)", "Best cpu_block_size          = ", &
+       best_options%cpu_block_size
+  print "(a,i0)", "Best amalgamation            = ", &
+       best_options%amalgamation
+
+  ! Choose inner block size by factorization time with the best options
+  ! (the default is a fixed size, so that factors are reproducible)
+  options = best_options
+  best = huge(best)
+  do k = 1, size(inner_block_size_vals)
+     options%cpu_inner_block_size = inner_block_size_vals(k)
+     tanal = 0; tfact = 0; tsolve = 0
+     do p = 1, size(probs)
+        call time_problem(probs(p), options, posdef, nrep, tanal, tfact, &
+             tsolve, flag)
+        if (flag .lt. 0) exit
+     end do
+     if (flag .lt. 0) cycle
+     if (tfact .lt. best) then
+        best = tfact
+        best_options%cpu_inner_block_size = options%cpu_inner_block_size
+     end if
+  end do
+  print "(a,i0)", "Best cpu_inner_block_size    = ", &
+       best_options%cpu_inner_block_size
+
+  ! Calibrate subtree splitting cost model with best options
+  call calibrate_part(probs, best_options, posdef)
+  print "(a,es10.3)", "Calibrated part_node_cost    = ", &
+       best_options%part_node_cost
+  print "(a,es10.3)", "Calibrated part_entry_cost   = ", &
+       best_options%part_entry_cost
+  call get_environment_variable("HOSTNAME", hostname)
+  if (len_trim(hostname) .eq. 0) hostname = "unknown"
+  call best_options%write_profile(output, flag, &
+       comment="Generated by spral_ssids_autotune on host " // &
+       trim(hostname))
+  if (flag .ne. 0) then
+     print *, "Failed to write profile ", output, ", iostat = ", flag
+     stop
+  end if
+  print *, "Profile written to ", output
+
+contains
+
+  !> @brief Time analyse, factor and solve for a single problem, adding
+  !>        times (in seconds, best of nrep runs) to those supplied.
+  subroutine time_problem(prob, options, posdef, nrep, tanal, tfact, tsolve, &
+       flag)
+    implicit none
+    type(problem_type), intent(in) :: prob
+    type(ssids_options), intent(in) :: options
+    logical, intent(in) :: posdef
+    integer, intent(in) :: nrep
+    real(wp), intent(inout) :: tanal
+    real(wp), intent(inout) :: tfact
+    real(wp), intent(inout) :: tsolve
+    integer, intent(out) :: flag
+
+    type(ssids_akeep) :: akeep
+    type(ssids_fkeep) :: fkeep
+    type(ssids_inform) :: inform
+    real(wp), dimension(:), allocatable :: x
+    integer(long) :: start_t, stop_t, rate_t
+    real(wp) :: ta, tf, ts
+    integer :: rep, cuda_error
+
+    flag = 0
+    ta = huge(ta); tf = huge(tf); ts = huge(ts)
+    allocate(x(prob%n))
+    do rep = 1, nrep
+       call system_clock(start_t, rate_t)
+       call ssids_analyse(.false., prob%n, prob%ptr, prob%row, akeep, &
+            options, inform, val=prob%val)
+       call system_clock(stop_t)
+       flag = inform%flag
+       if (flag .lt. 0) exit
+       ta = min(ta, real(stop_t-start_t,wp)/real(rate_t,wp))
+
+       call system_clock(start_t, rate_t)
+       call ssids_factor(posdef, prob%val, akeep, fkeep, options, inform, &
+            ptr=prob%ptr, row=prob%row)
+       call system_clock(stop_t)
+       flag = inform%flag
+       if (flag .lt. 0) exit
+       tf = min(tf, real(stop_t-start_t,wp)/real(rate_t,wp))
+
+       x(:) = prob%rhs(:)
+       call system_clock(start_t, rate_t)
+       call ssids_solve(x, akeep, fkeep, options, inform)
+       call system_clock(stop_t)
+       flag = inform%flag
+       if (flag .lt. 0) exit
+       ts = min(ts, real(stop_t-start_t,wp)/real(rate_t,wp))
+
+       call ssids_free(akeep, fkeep, cuda_error)
+    end do
+    call ssids_free(akeep, fkeep, cuda_error)
+    if (flag .lt. 0) return
+
+    tanal = tanal + ta
+    tfact = tfact + tf
+    tsolve = tsolve + ts
+  end subroutine time_problem
+
+  !> @brief Calibrate the amalgamation cost model by timing factorization of
+  !>        block diagonal matrices with dense blocks of various widths.
+  !>
+  !> The time per block of width p is modelled as
+  !>    t(p) = c + f(p) (1+h/p) / R = c + f(p) x + (f(p)/p) y,
+  !> with f(p) the flops to factorize it, c the overhead of a node and R the
+  !> peak flop rate. This is linear in c, x=1/R and y=h/R, which are found by
+  !> a least squares fit to the timings (relative to their size). The node
+  !> cost is c expressed in flops at rate R. Values are left unchanged if the
+  !> timings are not consistent with the model.
+  subroutine calibrate_amalg(options, nrep)
+    implicit none
+    type(ssids_options), intent(inout) :: options
+    integer, intent(in) :: nrep
+
+    integer, dimension(*), parameter :: width = (/ 8, 16, 32, 64, 256 /)
+    integer, dimension(*), parameter :: nblk = (/ 5000, 4000, 2000, 500, 40 /)
+    real(wp), dimension(size(width),3) :: a
+    real(wp), dimension(3,3) :: ata
+    real(wp), dimension(3) :: atb
+    real(wp) :: t, f, d, c, x, y
+    integer :: i, flag
+
+    do i = 1, size(width)
+       call time_block_diag(width(i), nblk(i), options, nrep, t, flag)
+       if (flag .lt. 0) then
+          print *, "Calibration failed with flag ", flag
+          return
+       end if
+       f = width(i) * (width(i)+1.0_wp) * (2*width(i)+1.0_wp) / 6
+       ! Scale row by 1/t so that relative error is minimised
+       a(i,:) = (/ 1.0_wp, f, f/width(i) /) / t
+    end do
+
+    ! Solve normal equations (a^T a) (c, x, y)^T = a^T 1 by Cramer's rule
+    ata = matmul(transpose(a), a)
+    atb = sum(a, dim=1)
+    d = det3(ata)
+    if (d .eq. 0) return
+    c = det3(reshape((/ atb, ata(:,2), ata(:,3) /), (/ 3, 3 /))) / d
+    x = det3(reshape((/ ata(:,1), atb, ata(:,3) /), (/ 3, 3 /))) / d
+    y = det3(reshape((/ ata(:,1), ata(:,2), atb /), (/ 3, 3 /))) / d
+    if ((x .le. 0) .or. (y .lt. 0) .or. (c .lt. 0)) then
+       print *, "Timings inconsistent with amalgamation model, not calibrated"
+       return
+    end if
+    options%amalg_half_width = real(y / x)
+    options%amalg_node_cost = real(c / x)
+  end subroutine calibrate_amalg
+
+  !> @brief Calibrate the subtree splitting cost model from the task times of
+  !>        a factorization of each problem.
+  !>
+  !> Each factorization returns the costs fitted to its own tasks (see
+  !> ssids_inform%part_node_cost). Their geometric mean over the problems is
+  !> taken, so that no single problem dominates. Values are left unchanged if
+  !> no fit succeeds.
+  subroutine calibrate_part(probs, options, posdef)
+    implicit none
+    type(problem_type), dimension(:), intent(in) :: probs
+    type(ssids_options), intent(inout) :: options
+    logical, intent(in) :: posdef
+
+    type(ssids_akeep) :: akeep
+    type(ssids_fkeep) :: fkeep
+    type(ssids_inform) :: inform
+    real(wp) :: node_sum, entry_sum
+    integer :: p, nfit, cuda_error
+
+    node_sum = 0; entry_sum = 0; nfit = 0
+    do p = 1, size(probs)
+       call ssids_analyse(.false., probs(p)%n, probs(p)%ptr, probs(p)%row, &
+            akeep, options, inform, val=probs(p)%val)
+       if (inform%flag .ge. 0) &
+            call ssids_factor(posdef, probs(p)%val, akeep, fkeep, options, &
+            inform, ptr=probs(p)%ptr, row=probs(p)%row)
+       call ssids_free(akeep, fkeep, cuda_error)
+       if (inform%flag .lt. 0) cycle
+       if (inform%part_node_cost .lt. 0) cycle ! No fit
+       ! NB: +1 as either cost may be fitted as zero
+       node_sum = node_sum + log(inform%part_node_cost + 1)
+       entry_sum = entry_sum + log(inform%part_entry_cost + 1)
+       nfit = nfit + 1
+    end do
+    if (nfit .eq. 0) then
+       print *, "No task times fitted, subtree costs not calibrated"
+       return
+    end if
+    options%part_node_cost = real(exp(node_sum / nfit) - 1)
+    options%part_entry_cost = real(exp(entry_sum / nfit) - 1)
+  end subroutine calibrate_part
+
+  !> @brief Determinant of a 3x3 matrix.
+  real(wp) function det3(a)
+    implicit none
+    real(wp), dimension(3,3), intent(in) :: a
+
+    det3 = a(1,1) * (a(2,2)*a(3,3) - a(2,3)*a(3,2)) &
+         - a(1,2) * (a(2,1)*a(3,3) - a(2,3)*a(3,1)) &
+         + a(1,3) * (a(2,1)*a(3,2) - a(2,2)*a(3,1))
+  end function det3
+
+  !> @brief Return in t the time (best of nrep runs) per block to factorize a
+  !>        positive-definite block diagonal matrix of nblk dense blocks of
+  !>        width p.
+  subroutine time_block_diag(p, nblk, options, nrep, t, flag)
+    implicit none
+    integer, intent(in) :: p
+    integer, intent(in) :: nblk
+    type(ssids_options), intent(in) :: options
+    integer, intent(in) :: nrep
+    real(wp), intent(out) :: t
+    integer, intent(out) :: flag
+
+    type(ssids_akeep) :: akeep
+    type(ssids_fkeep) :: fkeep
+    type(ssids_inform) :: inform
+    integer, dimension(:), allocatable :: ptr, row
+    real(wp), dimension(:), allocatable :: val
+    integer :: n, blk, i, j, k, rep, cuda_error
+    integer(long) :: start_t, stop_t, rate_t
+
+    ! Lower triangle of each block stored by columns, diagonal first
+    n = p * nblk
+    allocate(ptr(n+1), row(nblk*(p*(p+1))/2), val(nblk*(p*(p+1))/2))
+    k = 1
+    do blk = 0, nblk-1
+       do j = 1, p
+          ptr(blk*p + j) = k
+          do i = j, p
+             row(k) = blk*p + i
+             val(k) = merge(real(p, wp), 1.0_wp/p, i .eq. j)
+             k = k + 1
+          end do
+       end do
+    end do
+    ptr(n+1) = k
+
+    t = huge(t)
+    call ssids_analyse(.true., n, ptr, row, akeep, options, inform)
+    flag = inform%flag
+    if (flag .ge. 0) then
+       do rep = 1, nrep
+          call system_clock(start_t, rate_t)
+          call ssids_factor(.true., val, akeep, fkeep, options, inform)
+          call system_clock(stop_t)
+          flag = inform%flag
+          if (flag .lt. 0) exit
+          t = min(t, real(stop_t-start_t,wp)/real(rate_t,wp))
+       end do
+    end if
+    call ssids_free(akeep, fkeep, cuda_error)
+    t = t / nblk
+  end subroutine time_block_diag
+
+  !> @brief Form rhs corresponding to solution of all ones.
+  subroutine set_rhs(prob)
+    implicit none
+    type(problem_type), intent(inout) :: prob
+
+    integer :: i, j, k
+
+    allocate(prob%rhs(prob%n))
+    prob%rhs(:) = 0
+    do i = 1, prob%n
+       do j = prob%ptr(i), prob%ptr(i+1)-1
+          k = prob%row(j)
+          prob%rhs(k) = prob%rhs(k) + prob%val(j)
+          if (i .eq. k) cycle
+          prob%rhs(i) = prob%rhs(i) + prob%val(j)
+       end do
+    end do
+  end subroutine set_rhs
+
+  !> @brief Generate a random problem, made diagonally dominant if posdef.
+  subroutine make_random(prob, n, nnz, posdef, state)
+    implicit none
+    type(problem_type), intent(out) :: prob
+    integer, intent(in) :: n
+    integer, intent(in) :: nnz
+    logical, intent(in) :: posdef
+    type(random_state), intent(inout) :: state
+
+    integer :: i, j, flag
+    character(len=40) :: name
+
+    write (name, "(a,i0,a,i0,a)") "random(", n, ",", nnz, ")"
+    prob%name = trim(name)
+    prob%n = n
+    allocate(prob%ptr(n+1), prob%row(nnz), prob%val(nnz))
+    call random_matrix_generate(state, SPRAL_MATRIX_REAL_SYM_INDEF, n, n, &
+         nnz, prob%ptr, prob%row, flag, val=prob%val, nonsingular=.true., &
+         sort=.true.)
+    if (flag .lt. 0) then
+       print *, "random_matrix_generate failed with flag ", flag
+       stop
+    end if
+    if (posdef) then
+       ! Make diagonally dominant (diagonal entry is first in each column)
+       do i = 1, n
+          prob%val(prob%ptr(i)) = abs(prob%val(prob%ptr(i))) + 1.0
+          do j = prob%ptr(i)+1, prob%ptr(i+1)-1
+             prob%val(prob%ptr(i)) = prob%val(prob%ptr(i)) + abs(prob%val(j))
+             prob%val(prob%ptr(prob%row(j))) = &
+                  prob%val(prob%ptr(prob%row(j))) + abs(prob%val(j))
+          end do
+       end do
+    end if
+    call set_rhs(prob)
+  end subroutine make_random
+
+  !> @brief Read a problem from a Rutherford-Boeing file.
+  subroutine read_problem(prob, filename, posdef)
+    implicit none
+    type(problem_type), intent(out) :: prob
+    character(len=*), intent(in) :: filename
+    logical, intent(in) :: posdef
+
+    type(rb_read_options) :: rb_options
+    integer :: m, flag
+
+    prob%name = filename
+    rb_options%values = 2 ! make up values if necessary
+    if (posdef) rb_options%values = -3 ! Force diagonal dominance
+    call rb_read(filename, m, prob%n, prob%ptr, prob%row, prob%val, &
+         rb_options, flag)
+    if (flag .ne. 0) then
+       print *, "Rutherford-Boeing read of ", filename, " failed with error ", &
+            flag
+       stop
+    end if
+    call set_rhs(prob)
+  end subroutine read_problem
+
+  !> @brief Append problem to list.
+  subroutine add_problem(probs, prob)
+    implicit none
+    type(problem_type), dimension(:), allocatable, intent(inout) :: probs
+    type(problem_type), intent(in) :: prob
+
+    type(problem_type), dimension(:), allocatable :: temp
+
+    allocate(temp(size(probs)+1))
+    temp(1:size(probs)) = probs(:)
+    temp(size(probs)+1) = prob
+    call move_alloc(temp, probs)
+    print *, "Added problem ", probs(size(probs))%name
+  end subroutine add_problem
+
+  subroutine proc_args(probs, output, posdef, nrep, options)
+    implicit none
+    type(problem_type), dimension(:), allocatable, intent(out) :: probs
+    character(len=:), allocatable :: output
+    logical, intent(out) :: posdef
+    integer, intent(out) :: nrep
+    type(ssids_options), intent(inout) :: options
+
+    integer :: argnum, narg, pass
+    integer :: n, nnz
+    character(len=200) :: argval
+    type(problem_type) :: prob
+    type(random_state) :: state
+
+    ! Defaults
+    allocate(probs(0))
+    posdef = .false.
+    nrep = 3
+    call get_environment_variable("HOSTNAME", argval)
+    if (len_trim(argval) .gt. 0) then
+       output = "spral_ssids_" // trim(argval) // ".profile"
+    else
+       output = "spral_ssids.profile"
+    end if
+    options%print_level = -1 ! Quiet
+
+    ! Process args. Options are handled on the first pass and problems are
+    ! built on the second, so that options apply wherever they appear.
+    narg = command_argument_count()
+    do pass = 1, 2
+       argnum = 1
+       do while (argnum .le. narg)
+          call get_command_argument(argnum, argval)
+          argnum = argnum + 1
+          select case (argval)
+          case("--posdef")
+             if (pass .eq. 2) cycle
+             posdef = .true.
+             print *, 'Matrices assumed positive definite'
+          case("--nrep")
+             call get_command_argument(argnum, argval)
+             argnum = argnum + 1
+             if (pass .eq. 2) cycle
+             read (argval, *) nrep
+             nrep = max(1, nrep)
+          case("--output")
+             call get_command_argument(argnum, argval)
+             argnum = argnum + 1
+             if (pass .eq. 2) cycle
+             output = trim(argval)
+          case("--random")
+             call get_command_argument(argnum, argval)
+             argnum = argnum + 1
+             read (argval, *) n
+             call get_command_argument(argnum, argval)
+             argnum = argnum + 1
+             read (argval, *) nnz
+             if (pass .eq. 1) cycle
+             call make_random(prob, n, nnz, posdef, state)
+             call add_problem(probs, prob)
+          case default
+             if (pass .eq. 1) cycle
+             call read_problem(prob, trim(argval), posdef)
+             call add_problem(probs, prob)
+          end select
+       end do
+    end do
+  end subroutine proc_args
+
+end program ssids_autotune
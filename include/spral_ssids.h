@@ -31,7 +31,17 @@ struct spral_ssids_options {
    int pivot_method;
    double small;
    double u;
-   char unused[80]; // Allow for future expansion
+   int cpu_inner_block_size;
+   int cholesky_schedule;
+   int tree_schedule;
+   bool ignore_cache;
+   const char *analyse_cache;
+   int amalgamation;
+   float amalg_node_cost;
+   float amalg_half_width;
+   float part_node_cost;
+   float part_entry_cost;
+   char unused[36]; // Allow for future expansion
 };
 
 struct spral_ssids_inform {
@@ -51,7 +61,12 @@ struct spral_ssids_inform {
    int stat;
    int cuda_error;
    int cublas_error;
-   char unused[80]; // Allow for future expansion
+   long maxcontrib;
+   double part_node_cost;
+   double part_entry_cost;
+   double cpu_busy_time;
+   double cpu_idle_time;
+   char unused[40]; // Allow for future expansion
 };
 
 /************************************
@@ -83,6 +98,10 @@ void spral_ssids_factor_ptr32(bool posdef, const int *ptr, const int *row,
       const double *val, double *scale, void *akeep, void **fkeep,
       const struct spral_ssids_options *options,
       struct spral_ssids_inform *inform);
+/* Perform numerical factorization of matrix with changed values only */
+void spral_ssids_refactor(const double *val, void *akeep, void *fkeep,
+      const struct spral_ssids_options *options,
+      struct spral_ssids_inform *inform);
 /* Perform triangular solve(s) for single rhs */
 void spral_ssids_solve1(int job, double *x1, void *akeep, void *fkeep,
       const struct spral_ssids_options *options,
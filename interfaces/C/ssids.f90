@@ -23,7 +23,17 @@ module spral_ssids_ciface
      integer(C_INT) :: pivot_method
      real(C_DOUBLE) :: small
      real(C_DOUBLE) :: u
-     character(C_CHAR) :: unused(80)
+     integer(C_INT) :: cpu_inner_block_size
+     integer(C_INT) :: cholesky_schedule
+     integer(C_INT) :: tree_schedule
+     logical(C_BOOL) :: ignore_cache
+     type(C_PTR) :: analyse_cache
+     integer(C_INT) :: amalgamation
+     real(C_FLOAT) :: amalg_node_cost
+     real(C_FLOAT) :: amalg_half_width
+     real(C_FLOAT) :: part_node_cost
+     real(C_FLOAT) :: part_entry_cost
+     character(C_CHAR) :: unused(36)
   end type spral_ssids_options
 
   type, bind(C) :: spral_ssids_inform
@@ -43,9 +53,21 @@ module spral_ssids_ciface
      integer(C_INT) :: stat
      integer(C_INT) :: cuda_error
      integer(C_INT) :: cublas_error
-     character(C_CHAR) :: unused(80)
+     integer(C_LONG) :: maxcontrib
+     real(C_DOUBLE) :: part_node_cost
+     real(C_DOUBLE) :: part_entry_cost
+     real(C_DOUBLE) :: cpu_busy_time
+     real(C_DOUBLE) :: cpu_idle_time
+     character(C_CHAR) :: unused(40)
   end type spral_ssids_inform
 
+  interface
+     integer(C_SIZE_T) pure function strlen(string) bind(C)
+       use :: iso_c_binding
+       type(C_PTR), value, intent(in) :: string
+     end function strlen
+  end interface
+
 contains
   subroutine copy_options_in(coptions, foptions, cindexed)
     implicit none
@@ -53,6 +75,9 @@ contains
     type(ssids_options), intent(inout) :: foptions ! inherit some defaults!
     logical, intent(out) :: cindexed
 
+    integer :: i
+    character(C_CHAR), dimension(:), pointer :: cstr
+
     cindexed                   = (coptions%array_base .eq. 0)
     foptions%print_level       = coptions%print_level
     foptions%unit_diagnostics  = coptions%unit_diagnostics
@@ -60,14 +85,31 @@ contains
     foptions%unit_warning      = coptions%unit_warning
     foptions%ordering          = coptions%ordering
     foptions%nemin             = coptions%nemin
+    foptions%amalgamation      = coptions%amalgamation
+    foptions%amalg_node_cost   = coptions%amalg_node_cost
+    foptions%amalg_half_width  = coptions%amalg_half_width
+    foptions%analyse_cache     = ''
+    if (C_ASSOCIATED(coptions%analyse_cache)) then
+       call c_f_pointer(coptions%analyse_cache, cstr, &
+            shape = (/ strlen(coptions%analyse_cache) /))
+       do i = 1, min(size(cstr), len(foptions%analyse_cache))
+          foptions%analyse_cache(i:i) = cstr(i)
+       end do
+    end if
     foptions%ignore_numa       = coptions%ignore_numa
+    foptions%ignore_cache      = coptions%ignore_cache
     foptions%use_gpu           = coptions%use_gpu
     foptions%min_gpu_work      = coptions%min_gpu_work
     foptions%max_load_inbalance= coptions%max_load_inbalance
     foptions%gpu_perf_coeff    = coptions%gpu_perf_coeff
+    foptions%part_node_cost    = coptions%part_node_cost
+    foptions%part_entry_cost   = coptions%part_entry_cost
     foptions%scaling           = coptions%scaling
     foptions%small_subtree_threshold = coptions%small_subtree_threshold
     foptions%cpu_block_size    = coptions%cpu_block_size
+    foptions%cpu_inner_block_size = coptions%cpu_inner_block_size
+    foptions%cholesky_schedule = coptions%cholesky_schedule
+    foptions%tree_schedule     = coptions%tree_schedule
     foptions%action            = coptions%action
     foptions%pivot_method      = coptions%pivot_method
     foptions%small             = coptions%small
@@ -89,6 +131,11 @@ contains
     cinform%num_delay             = finform%num_delay
     cinform%num_factor            = finform%num_factor
     cinform%num_flops             = finform%num_flops
+    cinform%maxcontrib            = finform%maxcontrib
+    cinform%part_node_cost        = finform%part_node_cost
+    cinform%part_entry_cost       = finform%part_entry_cost
+    cinform%cpu_busy_time         = finform%cpu_busy_time
+    cinform%cpu_idle_time         = finform%cpu_idle_time
     cinform%num_neg               = finform%num_neg
     cinform%num_sup               = finform%num_sup
     cinform%num_two               = finform%num_two
@@ -105,6 +152,16 @@ subroutine spral_ssids_default_options(coptions) bind(C)
   type(spral_ssids_options), intent(out) :: coptions
 
   type(ssids_options) :: default_options
+  character(len=:), allocatable :: profile
+  integer :: len, st
+
+  ! Override defaults with tuned values from profile, if one is specified
+  call get_environment_variable("SPRAL_SSIDS_PROFILE", length=len, status=st)
+  if ((st .eq. 0) .and. (len .gt. 0)) then
+     allocate(character(len=len) :: profile)
+     call get_environment_variable("SPRAL_SSIDS_PROFILE", value=profile)
+     call default_options%read_profile(profile, st) ! Errors ignored
+  end if
 
   coptions%array_base        = 0 ! C
   coptions%print_level       = default_options%print_level
@@ -113,14 +170,24 @@ subroutine spral_ssids_default_options(coptions) bind(C)
   coptions%unit_warning      = default_options%unit_warning
   coptions%ordering          = default_options%ordering
   coptions%nemin             = default_options%nemin
+  coptions%amalgamation      = default_options%amalgamation
+  coptions%amalg_node_cost   = default_options%amalg_node_cost
+  coptions%amalg_half_width  = default_options%amalg_half_width
+  coptions%analyse_cache     = C_NULL_PTR ! No cache by default
   coptions%ignore_numa       = default_options%ignore_numa
+  coptions%ignore_cache      = default_options%ignore_cache
   coptions%use_gpu           = default_options%use_gpu
   coptions%min_gpu_work      = default_options%min_gpu_work
   coptions%max_load_inbalance= default_options%max_load_inbalance
   coptions%gpu_perf_coeff    = default_options%gpu_perf_coeff
+  coptions%part_node_cost    = default_options%part_node_cost
+  coptions%part_entry_cost   = default_options%part_entry_cost
   coptions%scaling           = default_options%scaling
   coptions%small_subtree_threshold = default_options%small_subtree_threshold
   coptions%cpu_block_size    = default_options%cpu_block_size
+  coptions%cpu_inner_block_size = default_options%cpu_inner_block_size
+  coptions%cholesky_schedule = default_options%cholesky_schedule
+  coptions%tree_schedule     = default_options%tree_schedule
   coptions%action            = default_options%action
   coptions%pivot_method      = default_options%pivot_method
   coptions%small             = default_options%small
@@ -584,6 +651,45 @@ subroutine spral_ssids_factor_ptr32(cposdef, cptr, crow, val, cscale, cakeep, &
   call copy_inform_out(finform, cinform)
 end subroutine spral_ssids_factor_ptr32
 
+subroutine spral_ssids_refactor(val, cakeep, cfkeep, coptions, cinform) bind(C)
+  use spral_ssids_ciface
+  use spral_ssids_datatypes, only : SSIDS_ERROR_CALL_SEQUENCE
+  implicit none
+
+  real(C_DOUBLE), dimension(*), intent(in) :: val
+  type(C_PTR), value :: cakeep
+  type(C_PTR), value :: cfkeep
+  type(spral_ssids_options), intent(in) :: coptions
+  type(spral_ssids_inform), intent(out) :: cinform
+
+  type(ssids_akeep), pointer :: fakeep
+  type(ssids_fkeep), pointer :: ffkeep
+  type(ssids_options) :: foptions
+  type(ssids_inform) :: finform
+
+  logical :: cindexed
+
+  ! Copy options in first to find out whether we use Fortran or C indexing
+  call copy_options_in(coptions, foptions, cindexed)
+
+  ! Check factorize has been called
+  if ((.not. C_ASSOCIATED(cakeep)) .or. (.not. C_ASSOCIATED(cfkeep))) then
+     finform%flag = SSIDS_ERROR_CALL_SEQUENCE
+     call copy_inform_out(finform, cinform)
+     return
+  end if
+
+  ! Translate arguments
+  call C_F_POINTER(cakeep, fakeep)
+  call C_F_POINTER(cfkeep, ffkeep)
+
+  ! Call Fortran routine
+  call ssids_refactor(val, fakeep, ffkeep, foptions, finform)
+
+  ! Copy arguments out
+  call copy_inform_out(finform, cinform)
+end subroutine spral_ssids_refactor
+
 subroutine spral_ssids_solve1(job, cx1, cakeep, cfkeep, coptions, cinform) &
      bind(C)
   use spral_ssids_ciface
@@ -0,0 +1,731 @@
+!> \file
+!> \copyright 2026 The Science and Technology Facilities Council (STFC)
+!> \licence   BSD licence, see LICENCE file for details
+!> \brief Approximate minimum degree ordering
+!>
+!> This file is a Fortran port of the AMD_2 routine of the AMD package, to
+!> which the following notice applies:
+!>
+!> AMD, Copyright (c) Timothy A. Davis, Patrick R. Amestoy, and Iain S. Duff.
+!> All Rights Reserved.
+!>
+!> Redistribution and use in source and binary forms, with or without
+!> modification, are permitted provided that the following conditions are
+!> met:
+!>  * Redistributions of source code must retain the above copyright notice,
+!>    this list of conditions and the following disclaimer.
+!>  * Redistributions in binary form must reproduce the above copyright
+!>    notice, this list of conditions and the following disclaimer in the
+!>    documentation and/or other materials provided with the distribution.
+!>  * Neither the name of the organizations to which the authors are
+!>    affiliated, nor the names of its contributors may be used to endorse
+!>    or promote products derived from this software without specific prior
+!>    written permission.
+!>
+!> THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+!> IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+!> THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+!> PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+!> CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+!> EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+!> PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+!> PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+!> LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+!> NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+!> SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+!
+!> \brief Provides an approximate minimum degree (AMD) ordering of a
+!>        symmetric sparse matrix.
+!>
+!> The algorithm is that of Amestoy, Davis and Duff [ACM TOMS 22(4), 1996],
+!> ported from AMD_2 of the AMD package: elimination is simulated on a
+!> quotient graph in which eliminated variables are represented by elements
+!> (the cliques they form), elements are absorbed into the new element of any
+!> pivot adjacent to them (including aggressive absorption of elements whose
+!> variables are a subset of the new element), indistinguishable variables are
+!> merged into supervariables, and the external degree of each variable is
+!> approximated by an upper bound. Rows with more than max(16,10*sqrt(n))
+!> entries are treated as dense and ordered last. The resulting assembly tree
+!> is postordered with the largest child of each node last.
+module spral_amd_order
+  implicit none
+
+  private
+  public :: amd_order ! Compute AMD order of symmetric matrix
+
+  integer, parameter :: long = selected_int_kind(18)
+
+  ! Return codes
+  integer, parameter :: ERROR_ALLOC = -1
+  integer, parameter :: ERROR_N_OOR = -2
+
+  !> Marks an empty list. With the encoding flip(i)=-i, an object index i>0
+  !> may be stored as flip(i) to mark it, and flip(EMPTY)=EMPTY.
+  integer, parameter :: EMPTY = 0
+
+contains
+
+!> \brief Compute an approximate minimum degree ordering of a symmetric
+!>        matrix.
+!>
+!> \param n Order of matrix.
+!> \param ptr Column pointers for pattern of both lower and upper triangles.
+!> \param row Row indices. Diagonal entries are ignored, there must be no
+!>        duplicates or out-of-range entries.
+!> \param perm On exit, perm(i) is the position of variable i in the
+!>        elimination order.
+!> \param invp On exit, invp(k) is the variable in position k of the
+!>        elimination order.
+!> \param flag Return code: 0 on success, negative on error.
+!> \param stat Fortran stat parameter on allocation failure.
+!> \param lnz If present, on exit holds the number of entries in the strict
+!>        lower triangle of \f$L\f$ predicted for this order.
+subroutine amd_order(n, ptr, row, perm, invp, flag, stat, lnz)
+  implicit none
+  integer, intent(in) :: n
+  integer(long), dimension(n+1), intent(in) :: ptr
+  integer, dimension(ptr(n+1)-1), intent(in) :: row
+  integer, dimension(n), intent(out) :: perm
+  integer, dimension(n), intent(out) :: invp
+  integer, intent(out) :: flag
+  integer, intent(out) :: stat
+  integer(long), optional, intent(out) :: lnz
+
+  integer(long), dimension(:), allocatable :: pe
+  integer, dimension(:), allocatable :: iw, len, nv, next, last, head, &
+       elen, degree, w
+  integer(long) :: iwlen, pfree, j, nz, my_lnz
+  integer :: i
+
+  flag = 0
+  stat = 0
+  if (present(lnz)) lnz = 0
+
+  if (n .lt. 1) then
+     flag = ERROR_N_OOR
+     return
+  end if
+
+  ! Copy pattern, dropping diagonal entries, with elbow room for elements
+  nz = 0
+  do i = 1, n
+     do j = ptr(i), ptr(i+1)-1
+        if (row(j) .ne. i) nz = nz + 1
+     end do
+  end do
+  iwlen = nz + nz/5 + 2*n
+  allocate(pe(n), iw(iwlen), len(n), nv(n), next(n), last(n), head(0:n-1), &
+       elen(n), degree(n), w(n), stat=stat)
+  if (stat .ne. 0) then
+     flag = ERROR_ALLOC
+     return
+  end if
+  pfree = 1
+  do i = 1, n
+     pe(i) = pfree
+     do j = ptr(i), ptr(i+1)-1
+        if (row(j) .eq. i) cycle
+        iw(pfree) = row(j)
+        pfree = pfree + 1
+     end do
+     len(i) = int(pfree - pe(i))
+  end do
+
+  call amd_main(n, pe, iw, iwlen, pfree, len, nv, next, last, head, elen, &
+       degree, w, my_lnz)
+  if (present(lnz)) lnz = my_lnz
+
+  ! amd_main() returns the position of variable i in next(i)
+  do i = 1, n
+     perm(i) = next(i)
+     invp(next(i)) = i
+  end do
+end subroutine amd_order
+
+!> \brief Core AMD algorithm on a quotient graph.
+!>
+!> On entry, the adjacency list of variable i is iw(pe(i):pe(i)+len(i)-1),
+!> and iw(pfree:iwlen) is free space. On exit, next(i) is the position of
+!> variable i in the elimination order. All other arrays are destroyed.
+!>
+!> Objects (variables and elements) are stored as follows during the
+!> elimination. For a variable i, iw(pe(i):pe(i)+len(i)-1) lists first the
+!> elen(i) elements adjacent to it, then the variables adjacent to it; nv(i)
+!> is the number of variables in its supervariable (or 0 if it has been
+!> merged into another, negative while it is in the current element), and
+!> degree(i) its approximate external degree. For an element e, the list
+!> holds its variables, elen(e) is flip(its front size), degree(e) is its
+!> external degree, and w(e) is a work value that is 0 once e is absorbed.
+!> For absorbed elements and merged variables, pe holds flip(parent).
+subroutine amd_main(n, pe, iw, iwlen, pfree, len, nv, next, last, head, &
+     elen, degree, w, lnz)
+  implicit none
+  integer, intent(in) :: n
+  integer(long), dimension(n), intent(inout) :: pe
+  integer(long), intent(in) :: iwlen
+  integer, dimension(iwlen), intent(inout) :: iw
+  integer(long), intent(inout) :: pfree
+  integer, dimension(n), intent(inout) :: len
+  integer, dimension(n), intent(out) :: nv
+  integer, dimension(n), intent(out) :: next
+  integer, dimension(n), intent(out) :: last
+  integer, dimension(0:n-1), intent(out) :: head
+  integer, dimension(n), intent(out) :: elen
+  integer, dimension(n), intent(out) :: degree
+  integer, dimension(n), intent(out) :: w
+  integer(long), intent(out) :: lnz
+
+  integer :: dense, ndense, nel, mindeg, lemax, wflg, wbig
+  integer :: me, elenme, nvpiv, degme, nvi, nvj, e, i, j, k, ilast, inext, &
+       knt1, knt2, knt3, ln, eln, slenme, lenj, deg, dext, we, wnvi, nleft, &
+       jlast, jnext
+  integer(long) :: p, pj, pme, pme1, pme2, p1, p2, p3, p4, pn, psrc, pdst, &
+       pend, hash, f, r
+  logical :: ok
+
+  ! Rows with more than dense entries are treated as dense and ordered last
+  dense = int(10*sqrt(real(n)))
+  dense = min(n, max(16, dense))
+
+  ! Initialise
+  wbig = huge(wbig) - n
+  lemax = 0
+  mindeg = 0
+  nel = 0
+  ndense = 0
+  lnz = 0
+  do i = 1, n
+     last(i) = EMPTY
+     next(i) = EMPTY
+     nv(i) = 1
+     w(i) = 1
+     elen(i) = 0
+     degree(i) = len(i)
+  end do
+  head(:) = EMPTY
+  wflg = clear_flag(0, wbig, w, n)
+
+  ! Build degree lists, eliminating empty rows and flagging dense ones
+  do i = 1, n
+     deg = degree(i)
+     if (deg .eq. 0) then
+        ! Empty row: eliminate immediately as an element with no variables
+        elen(i) = flip(1)
+        nel = nel + 1
+        pe(i) = EMPTY
+        w(i) = 0
+     else if (deg .gt. dense) then
+        ! Dense row: ordered last, ignored until then
+        ndense = ndense + 1
+        nv(i) = 0
+        elen(i) = EMPTY
+        nel = nel + 1
+        pe(i) = EMPTY
+     else
+        inext = head(deg)
+        if (inext .ne. EMPTY) last(inext) = i
+        next(i) = inext
+        head(deg) = i
+     end if
+  end do
+
+  do while (nel .lt. n)
+     !
+     ! Select pivot me of minimum approximate degree (one always exists
+     ! while nel < n)
+     !
+     me = EMPTY
+     do deg = mindeg, n-1
+        me = head(deg)
+        if (me .gt. EMPTY) exit
+     end do
+     mindeg = deg
+     inext = next(me)
+     if (inext .ne. EMPTY) last(inext) = EMPTY
+     head(deg) = inext
+
+     elenme = elen(me)
+     nvpiv = nv(me)
+     nel = nel + nvpiv
+
+     !
+     ! Construct new element me, the union of its adjacent variables and of
+     ! the variables of its adjacent elements (which are absorbed)
+     !
+     nv(me) = -nvpiv
+     degme = 0
+     if (elenme .eq. 0) then
+        ! No adjacent elements: construct new element in place
+        pme1 = pe(me)
+        pme2 = pme1 - 1
+        do p = pme1, pme1 + len(me) - 1
+           i = iw(p)
+           nvi = nv(i)
+           if (nvi .le. 0) cycle
+           degme = degme + nvi
+           nv(i) = -nvi
+           pme2 = pme2 + 1
+           iw(pme2) = i
+           ! Remove i from degree list
+           ilast = last(i)
+           inext = next(i)
+           if (inext .ne. EMPTY) last(inext) = ilast
+           if (ilast .ne. EMPTY) then
+              next(ilast) = inext
+           else
+              head(degree(i)) = inext
+           end if
+        end do
+     else
+        ! Construct new element in free space at end of iw
+        p = pe(me)
+        pme1 = pfree
+        slenme = len(me) - elenme
+        do knt1 = 1, elenme + 1
+           if (knt1 .gt. elenme) then
+              ! Search the variables adjacent to me
+              e = me
+              pj = p
+              ln = slenme
+           else
+              ! Search the variables of an element adjacent to me
+              e = iw(p)
+              p = p + 1
+              pj = pe(e)
+              ln = len(e)
+           end if
+           do knt2 = 1, ln
+              i = iw(pj)
+              pj = pj + 1
+              nvi = nv(i)
+              if (nvi .le. 0) cycle
+              if (pfree .gt. iwlen) then
+                 ! Out of space: compress iw
+                 pe(me) = p
+                 len(me) = len(me) - knt1
+                 if (len(me) .eq. 0) pe(me) = EMPTY
+                 pe(e) = pj
+                 len(e) = ln - knt2
+                 if (len(e) .eq. 0) pe(e) = EMPTY
+                 ! Store first entry of each object in pe, and mark its start
+                 do j = 1, n
+                    pn = pe(j)
+                    if (pn .gt. 0) then
+                       pe(j) = iw(pn)
+                       iw(pn) = flip(int(j))
+                    end if
+                 end do
+                 psrc = 1
+                 pdst = 1
+                 pend = pme1 - 1
+                 do while (psrc .le. pend)
+                    k = flip(iw(psrc))
+                    psrc = psrc + 1
+                    if (k .gt. 0) then
+                       iw(pdst) = int(pe(k))
+                       pe(k) = pdst
+                       pdst = pdst + 1
+                       lenj = len(k)
+                       do knt3 = 0, lenj-2
+                          iw(pdst) = iw(psrc)
+                          pdst = pdst + 1
+                          psrc = psrc + 1
+                       end do
+                    end if
+                 end do
+                 ! Move partially constructed new element
+                 p1 = pdst
+                 do psrc = pme1, pfree-1
+                    iw(pdst) = iw(psrc)
+                    pdst = pdst + 1
+                 end do
+                 pme1 = p1
+                 pfree = pdst
+                 pj = pe(e)
+                 p = pe(me)
+              end if
+              ! i is a principal variable not yet in the new element
+              degme = degme + nvi
+              nv(i) = -nvi
+              iw(pfree) = i
+              pfree = pfree + 1
+              ! Remove i from degree list
+              ilast = last(i)
+              inext = next(i)
+              if (inext .ne. EMPTY) last(inext) = ilast
+              if (ilast .ne. EMPTY) then
+                 next(ilast) = inext
+              else
+                 head(degree(i)) = inext
+              end if
+           end do
+           if (e .ne. me) then
+              ! Absorb element e into me
+              pe(e) = flip(me)
+              w(e) = 0
+           end if
+        end do
+        pme2 = pfree - 1
+     end if
+     degree(me) = degme
+     pe(me) = pme1
+     len(me) = int(pme2 - pme1 + 1)
+     elen(me) = flip(nvpiv + degme)
+     wflg = clear_flag(wflg, wbig, w, n)
+
+     !
+     ! Compute |Le \ Lme| for each element e adjacent to a variable of me
+     !
+     do pme = pme1, pme2
+        i = iw(pme)
+        eln = elen(i)
+        if (eln .le. 0) cycle
+        nvi = -nv(i)
+        wnvi = wflg - nvi
+        do p = pe(i), pe(i) + eln - 1
+           e = iw(p)
+           we = w(e)
+           if (we .ge. wflg) then
+              we = we - nvi
+           else if (we .ne. 0) then
+              we = degree(e) + wnvi
+           end if
+           w(e) = we
+        end do
+     end do
+
+     !
+     ! Update approximate degrees, absorb elements and detect mass elimination
+     !
+     do pme = pme1, pme2
+        i = iw(pme)
+        p1 = pe(i)
+        p2 = p1 + elen(i) - 1
+        pn = p1
+        hash = 0
+        deg = 0
+        ! Scan elements of i, absorbing those that are subsets of me
+        do p = p1, p2
+           e = iw(p)
+           we = w(e)
+           if (we .eq. 0) cycle
+           dext = we - wflg
+           if (dext .gt. 0) then
+              deg = deg + dext
+              iw(pn) = e
+              pn = pn + 1
+              hash = hash + e
+           else
+              ! Aggressive absorption: Le is a subset of Lme
+              pe(e) = flip(me)
+              w(e) = 0
+           end if
+        end do
+        elen(i) = int(pn - p1 + 1) ! Including me
+        ! Scan variables of i, dropping those in me
+        p3 = pn
+        p4 = p1 + len(i)
+        do p = p2 + 1, p4 - 1
+           j = iw(p)
+           nvj = nv(j)
+           if (nvj .le. 0) cycle
+           deg = deg + nvj
+           iw(pn) = int(j)
+           pn = pn + 1
+           hash = hash + j
+        end do
+        if ((elen(i) .eq. 1) .and. (p3 .eq. pn)) then
+           ! Mass elimination: i is adjacent only to me
+           pe(i) = flip(me)
+           nvi = -nv(i)
+           degme = degme - nvi
+           nvpiv = nvpiv + nvi
+           nel = nel + nvi
+           nv(i) = 0
+           elen(i) = EMPTY
+        else
+           degree(i) = min(degree(i), deg)
+           ! Add me to front of element list of i
+           iw(pn) = iw(p3)
+           iw(p3) = iw(p1)
+           iw(p1) = me
+           len(i) = int(pn - p1 + 1)
+           ! Place i in hash bucket, kept in degree list head or its last()
+           hash = mod(hash, int(n, long))
+           k = head(hash)
+           if (k .le. EMPTY) then
+              next(i) = flip(k)
+              head(hash) = flip(i)
+           else
+              next(i) = last(k)
+              last(k) = i
+           end if
+           last(i) = int(hash)
+        end if
+     end do
+     degree(me) = degme
+     lemax = max(lemax, degme)
+     wflg = wflg + lemax
+     wflg = clear_flag(wflg, wbig, w, n)
+
+     !
+     ! Supervariable detection: merge variables with identical lists
+     !
+     do pme = pme1, pme2
+        i = iw(pme)
+        if (nv(i) .ge. 0) cycle
+        ! i is a principal variable in me: take its hash bucket
+        hash = last(i)
+        k = head(hash)
+        if (k .eq. EMPTY) then
+           i = EMPTY
+        else if (k .lt. EMPTY) then
+           i = flip(k)
+           head(hash) = EMPTY
+        else
+           i = last(k)
+           last(k) = EMPTY
+        end if
+        do while (i .ne. EMPTY)
+           if (next(i) .eq. EMPTY) exit
+           ln = len(i)
+           eln = elen(i)
+           ! Mark entries of i (the first is me, common to all)
+           do p = pe(i) + 1, pe(i) + ln - 1
+              w(iw(p)) = wflg
+           end do
+           jlast = i
+           k = next(i)
+           do while (k .ne. EMPTY)
+              ok = (len(k) .eq. ln) .and. (elen(k) .eq. eln)
+              p = pe(k) + 1
+              do while (ok .and. (p .le. pe(k) + ln - 1))
+                 if (w(iw(p)) .ne. wflg) ok = .false.
+                 p = p + 1
+              end do
+              if (ok) then
+                 ! Merge k into i
+                 pe(k) = flip(i)
+                 nv(i) = nv(i) + nv(k)
+                 nv(k) = 0
+                 elen(k) = EMPTY
+                 k = next(k)
+                 next(jlast) = k
+              else
+                 jlast = k
+                 k = next(k)
+              end if
+           end do
+           wflg = wflg + 1
+           i = next(i)
+        end do
+     end do
+
+     !
+     ! Restore degree lists, and remove nonprincipal variables from me
+     !
+     p = pme1
+     nleft = n - nel
+     do pme = pme1, pme2
+        i = iw(pme)
+        nvi = -nv(i)
+        if (nvi .le. 0) cycle
+        nv(i) = nvi
+        deg = degree(i) + degme - nvi
+        deg = min(deg, nleft - nvi)
+        inext = head(deg)
+        if (inext .ne. EMPTY) last(inext) = i
+        next(i) = inext
+        last(i) = EMPTY
+        head(deg) = i
+        mindeg = min(mindeg, deg)
+        degree(i) = deg
+        iw(p) = i
+        p = p + 1
+     end do
+     nv(me) = nvpiv
+     len(me) = int(p - pme1)
+     if (len(me) .eq. 0) then
+        pe(me) = EMPTY
+        w(me) = 0
+     end if
+     if (elenme .ne. 0) pfree = p ! Element was not constructed in place
+
+     ! Count entries of L in this front (excluding diagonal)
+     f = nvpiv
+     r = degme + ndense
+     lnz = lnz + f*r + (f-1)*f/2
+  end do
+  f = ndense
+  lnz = lnz + (f-1)*f/2
+
+  !
+  ! Compute assembly tree: pe(i) is parent of i, and elen(e) is front size
+  !
+  do i = 1, n
+     pe(i) = flip(int(pe(i)))
+     elen(i) = flip(elen(i))
+  end do
+  ! Point each nonprincipal variable at its principal element
+  do i = 1, n
+     if (nv(i) .ne. 0) cycle
+     k = int(pe(i))
+     if (k .eq. EMPTY) cycle ! Dense row
+     do while (nv(k) .eq. 0)
+        k = int(pe(k))
+     end do
+     e = k
+     k = i
+     do while (nv(k) .eq. 0)
+        jnext = int(pe(k))
+        pe(k) = e
+        k = jnext
+     end do
+  end do
+
+  ! Postorder elements, using head() as child and last() as sibling lists
+  call postorder(n, pe, nv, elen, head, last, w, degree)
+
+  ! Number variables: those of each element in postorder, then dense rows
+  k = 1
+  do j = 1, n
+     e = w(j)
+     if (e .eq. EMPTY) exit
+     next(e) = k
+     k = k + nv(e)
+  end do
+  do i = 1, n
+     if (nv(i) .ne. 0) cycle
+     e = int(pe(i))
+     if (e .ne. EMPTY) then
+        next(i) = next(e)
+        next(e) = next(e) + 1
+     else
+        next(i) = k
+        k = k + 1
+     end if
+  end do
+end subroutine amd_main
+
+!> \brief Postorder the assembly tree, with largest child of each node last.
+!>
+!> \param n Number of nodes.
+!> \param parent Parent of each node, EMPTY for roots.
+!> \param nv Node i is in the tree if nv(i)>0.
+!> \param fsize Front size of each node.
+!> \param child Workspace.
+!> \param sibling Workspace.
+!> \param post On exit, post(1:nnode) lists nodes in postorder, and
+!>        post(nnode+1) is EMPTY if nnode<n.
+!> \param stack Workspace.
+subroutine postorder(n, parent, nv, fsize, child, sibling, post, stack)
+  implicit none
+  integer, intent(in) :: n
+  integer(long), dimension(n), intent(in) :: parent
+  integer, dimension(n), intent(in) :: nv
+  integer, dimension(n), intent(in) :: fsize
+  integer, dimension(n), intent(out) :: child
+  integer, dimension(n), intent(out) :: sibling
+  integer, dimension(n), intent(out) :: post
+  integer, dimension(n), intent(out) :: stack
+
+  integer :: i, j, f, fprev, bigf, bigfprev, maxfrsize, fnext, k, top, h
+
+  child(:) = EMPTY
+  sibling(:) = EMPTY
+  do j = n, 1, -1
+     if (nv(j) .le. 0) cycle
+     if (parent(j) .eq. EMPTY) cycle
+     sibling(j) = child(parent(j))
+     child(parent(j)) = j
+  end do
+
+  ! Move largest child of each node to end of its child list
+  do i = 1, n
+     if ((nv(i) .le. 0) .or. (child(i) .eq. EMPTY)) cycle
+     fprev = EMPTY
+     maxfrsize = -1
+     bigfprev = EMPTY
+     bigf = EMPTY
+     f = child(i)
+     do while (f .ne. EMPTY)
+        if (fsize(f) .ge. maxfrsize) then
+           maxfrsize = fsize(f)
+           bigfprev = fprev
+           bigf = f
+        end if
+        fprev = f
+        f = sibling(f)
+     end do
+     fnext = sibling(bigf)
+     if (fnext .ne. EMPTY) then
+        if (bigfprev .eq. EMPTY) then
+           child(i) = fnext
+        else
+           sibling(bigfprev) = fnext
+        end if
+        sibling(bigf) = EMPTY
+        sibling(fprev) = bigf
+     end if
+  end do
+
+  ! Depth first search from each root
+  post(:) = EMPTY
+  k = 0
+  do i = 1, n
+     if ((parent(i) .ne. EMPTY) .or. (nv(i) .le. 0)) cycle
+     top = 1
+     stack(1) = i
+     do while (top .gt. 0)
+        j = stack(top)
+        if (child(j) .ne. EMPTY) then
+           ! Push children so that the first is popped first
+           f = child(j)
+           do while (f .ne. EMPTY)
+              top = top + 1
+              f = sibling(f)
+           end do
+           h = top
+           f = child(j)
+           do while (f .ne. EMPTY)
+              stack(h) = f
+              h = h - 1
+              f = sibling(f)
+           end do
+           child(j) = EMPTY
+        else
+           top = top - 1
+           k = k + 1
+           post(k) = j
+        end if
+     end do
+  end do
+end subroutine postorder
+
+!> \brief Ensure wflg is in range, resetting nonzero entries of w if not.
+integer function clear_flag(wflg, wbig, w, n)
+  implicit none
+  integer, intent(in) :: wflg
+  integer, intent(in) :: wbig
+  integer, dimension(n), intent(inout) :: w
+  integer, intent(in) :: n
+
+  integer :: x
+
+  clear_flag = wflg
+  if ((wflg .ge. 2) .and. (wflg .lt. wbig)) return
+  do x = 1, n
+     if (w(x) .ne. 0) w(x) = 1
+  end do
+  clear_flag = 2
+end function clear_flag
+
+!> \brief Mark (or unmark) an object index: flip(flip(i)) = i.
+elemental integer function flip(i)
+  implicit none
+  integer, intent(in) :: i
+
+  flip = -i
+end function flip
+
+end module spral_amd_order
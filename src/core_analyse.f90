@@ -8,20 +8,38 @@
 !
 ! Routines originally based on HSL_MC78 v1.2.0
 module spral_core_analyse
+!$ use omp_lib
   implicit none
 
   private
   public :: basic_analyse ! Perform a full analysis for a given matrix ordering
 
+  integer, parameter :: wp = kind(0d0)
   integer, parameter :: long = selected_int_kind(18)
   integer, parameter :: ptr_kind = long ! integer kind used for user's
     ! column pointers (rptr is always long) - integer or long
 
   integer, parameter :: minsz_ms = 16 ! minimum size to use merge sort
+  integer, parameter :: par_min_subtree = 32 ! minimum number of nodes in a
+    ! subtree processed as an independent task in parallel analysis
+  integer, parameter :: par_tasks_per_thread = 4 ! target number of subtree
+    ! tasks per thread in parallel analysis
+  real(wp), parameter :: amalg_entry_cost = 8.0 ! cost, in flops, of assembling
+    ! one entry of a contribution block into its parent (amalgamation model)
+  real(wp), parameter :: amalg_max_fill = 0.5 ! amalgamation model never
+    ! merges two nodes if this increases their entries in L by a larger factor
 
   integer, parameter :: ERROR_ALLOCATION = -1
   integer, parameter :: WARNING_SINGULAR = 1
 
+  ! Effect of a subtree on last_p and last_nbr of its ancestors, found in
+  ! parallel by find_col_counts and applied in serial afterwards
+  type col_count_summary
+     integer, dimension(:), allocatable :: u ! ancestors seen in subtree
+     integer, dimension(:), allocatable :: last_p ! last_p(u(i)) in subtree
+     integer, dimension(:), allocatable :: last_nbr ! last_nbr(u(i)) in subtree
+  end type col_count_summary
+
 contains
 
 !!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!
@@ -34,9 +52,22 @@ contains
 !
 ! Performance might be improved by:
 ! * Improving the sort algorithm used in find_row_idx
+!
+! If more than one OpenMP thread is available, column counts and row lists are
+! found in parallel over independent subtrees of the elimination and assembly
+! trees. The results are identical to those found in serial.
+!
+! If node_cost and half_width are present, nodes not amalgamated by the nemin
+! rule are also merged if a cost model predicts this is faster (see
+! cost_merge()).
+!
+! The children of each supernode are ordered to minimise the peak memory
+! required by contribution blocks in a serial traversal of the assembly tree
+! (see reorder_children()).
 !
   subroutine basic_analyse(n, ptr, row, perm, nnodes, sptr, &
-       sparent, rptr, rlist, nemin, info, stat, nfact, nflops)
+       sparent, rptr, rlist, nemin, info, stat, nfact, nflops, times, &
+       node_cost, half_width, maxcontrib)
     implicit none
     integer, intent(in) :: n ! Dimension of system
     integer(ptr_kind), dimension(n+1), intent(in) :: ptr ! Column pointers
@@ -55,18 +86,32 @@ contains
     integer, intent(out) :: stat
     integer(long), intent(out) :: nfact
     integer(long), intent(out) :: nflops
+    real(wp), dimension(4), optional, intent(out) :: times ! Wall clock time
+      ! in seconds spent finding: (1) elimination tree and postorder,
+      ! (2) column counts, (3) supernodes, (4) sorted row lists
+    real(wp), optional, intent(in) :: node_cost ! Cost model: fixed cost of a
+      ! node, in flops
+    real(wp), optional, intent(in) :: half_width ! Cost model: number of
+      ! eliminated columns at which a node runs at half peak flop rate
+    integer(long), optional, intent(out) :: maxcontrib ! Predicted peak number
+      ! of entries in contribution blocks (without pivoting)
 
     integer :: i
+    integer :: nth ! number of threads available
+    integer(long) :: t_start, t_stop, t_rate ! system_clock values
     integer, dimension(:), allocatable :: invp ! inverse permutation of perm
     integer :: j
     integer :: realn ! number of variables with an actual entry present
     integer :: st ! stat argument in allocate calls
+    integer(long) :: r_maxcontrib
 
     integer, dimension(:), allocatable :: scc
     integer, dimension(:), allocatable :: cc ! number of entries in each column
     integer, dimension(:), allocatable :: parent ! parent of each node in etree
     integer, dimension(:), allocatable :: tperm ! temporary permutation vector
 
+    if (present(times)) times(:) = 0
+
     ! Quick exit for n < 0.
     ! ERROR_ALLOCATION will be signalled, but since allocation status cannot be
     ! negative, in this way info about the invalid argument (n < 0) is conveyed.
@@ -95,6 +140,9 @@ contains
     end do
 
     realn = n ! Assume full rank
+    nth = 1
+!$  nth = omp_get_max_threads()
+    call system_clock(t_start, t_rate)
 
     ! Build elimination tree
     allocate(parent(n), stat=st)
@@ -107,36 +155,51 @@ contains
     if (st .ne. 0) goto 490
 
     if (n .ne. realn) info = WARNING_SINGULAR
+    call record_time(1)
 
     ! Determine column counts
     allocate(cc(n+1), stat=st)
     if (st .ne. 0) goto 490
-    call find_col_counts(n, ptr, row, perm, invp, parent, cc, st)
+    call find_col_counts(n, ptr, row, perm, invp, parent, nth, cc, st)
     if (st .ne. 0) goto 490
+    call record_time(2)
 
     ! Identify supernodes
     allocate(tperm(n), sptr(n+1), sparent(n), scc(n), stat=st)
     if (st .ne. 0) goto 490
     call find_supernodes(n, realn, parent, cc, tperm, nnodes, sptr, sparent, &
-         scc, nemin, info, st)
+         scc, nemin, info, st, node_cost=node_cost, half_width=half_width)
     if (info .lt. 0) return
 
     ! Apply permutation to obtain final elimination order
     call apply_perm(n, tperm, perm, invp, cc)
 
+    ! Reorder children to minimise peak contribution block memory
+    call reorder_children(n, nnodes, sptr, sparent, scc, tperm, r_maxcontrib, &
+         st)
+    if (st .ne. 0) goto 490
+    call apply_perm(n, tperm, perm, invp, cc)
+    if (present(maxcontrib)) maxcontrib = r_maxcontrib
+    call record_time(3)
+
     ! Determine column patterns - keep%nodes(:)%index
     allocate(rptr(nnodes+1), rlist(sum(scc(1:nnodes))), stat=st)
     if (st .ne. 0) goto 490
     call find_row_lists(n, ptr, row, perm, invp, nnodes, sptr, &
-         sparent, scc, rptr, rlist, info, st)
+         sparent, scc, nth, rptr, rlist, info, st)
     if (st .ne. 0) goto 490
 
     ! Calculate info%num_factor and info%num_flops
     call calc_stats(nnodes, sptr, scc, nfact=nfact, nflops=nflops)
 
     ! Sort entries of row lists
-    call dbl_tr_sort(n, nnodes, rptr, rlist, st)
+    if (nth .gt. 1) then
+       call par_sort_row_lists(n, nnodes, sptr, rptr, rlist, st)
+    else
+       call dbl_tr_sort(n, nnodes, rptr, rlist, st)
+    end if
     if (st .ne. 0) goto 490
+    call record_time(4)
 
     return
 
@@ -148,6 +211,18 @@ contains
     info = ERROR_ALLOCATION
     stat = st
     return
+
+  contains
+
+    ! Record time since last call (or start) as times(phase)
+    subroutine record_time(phase)
+      implicit none
+      integer, intent(in) :: phase
+
+      call system_clock(t_stop)
+      if (present(times)) times(phase) = real(t_stop-t_start, wp) / t_rate
+      t_start = t_stop
+    end subroutine record_time
   end subroutine basic_analyse
 
 !!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!
@@ -384,7 +459,16 @@ contains
 !
 ! [2] Tim Davis's book "Direct Methods for Sparse Linear Systems", SIAM 2006.
 !
-  subroutine find_col_counts(n, ptr, row, perm, invp, parent, cc, st)
+! If nth > 1, the pivots of independent subtrees of the elimination tree are
+! first processed in parallel by subtree_col_counts(). Within a subtree, last_p
+! and last_nbr for indices of the subtree are only touched by pivots of that
+! subtree, whilst those of its ancestors are tracked locally and summarised.
+! The remaining pivots are then processed in serial, applying each subtree's
+! summary in place of its pivots. As the net weight passed up the tree is only
+! accumulated once all weights are known, the result is identical to the
+! serial algorithm.
+!
+  subroutine find_col_counts(n, ptr, row, perm, invp, parent, nth, cc, st)
     implicit none
     integer, intent(in) :: n ! dimension of system
     integer(ptr_kind), dimension(n+1), intent(in) :: ptr ! column pointers of A
@@ -394,6 +478,7 @@ contains
     integer, dimension(n), intent(in) :: invp ! inverse of perm
     integer, dimension(n), intent(in) :: parent ! parent(i) is the
       ! parent of pivot i in the elimination tree
+    integer, intent(in) :: nth ! number of threads to use
     integer, dimension(n+1), intent(out) :: cc ! On exit, cc(i) is the
       ! number of entries in the lower triangular part of L (includes diagonal)
       ! for the column containing pivot i. For most of the routine however, it
@@ -403,15 +488,24 @@ contains
     integer, intent(out) :: st ! stat parmeter for allocate calls
    
     integer :: col ! column of matrix associated with piv
+    integer, dimension(:), allocatable :: depth ! depth(i) is depth of node
+      ! i in elimination tree (roots have depth 1)
     integer, dimension(:), allocatable :: first ! first descendants
     integer :: i
     integer(ptr_kind) :: ii
+    integer :: k
     integer, dimension(:), allocatable :: last_nbr ! previous neighbour
     integer, dimension(:), allocatable :: last_p ! previous p?
+    integer :: next_first ! first pivot of next subtree to be summarised
+    integer :: nroots ! number of subtrees processed in parallel
     integer :: par ! parent node of piv
     integer :: piv ! current pivot
     integer :: pp ! last pivot where u was encountered
     integer :: lca ! least common ancestor of piv and pp
+    integer, dimension(:), allocatable :: roots ! roots of subtrees
+    integer :: sub ! next subtree to be summarised
+    type(col_count_summary), dimension(:), allocatable :: summary ! summaries
+      ! of effects of subtrees on their ancestors
     integer :: u ! current entry in column col
     integer :: uwt ! weight of u
     integer, dimension(:), allocatable :: vforest ! virtual forest
@@ -454,10 +548,53 @@ contains
     last_nbr(:) = 0
 
     !
-    ! Determine cc(i), the number of net new entries to pass up tree from
-    ! node i.
+    ! Find weights of independent subtrees in parallel
     !
-    do piv = 1, n
+    call find_par_subtrees(n, parent, first, nth, nroots, roots, st)
+    if (st .ne. 0) return
+    next_first = n+1
+    if (nroots .gt. 0) then
+       allocate(depth(n+1), summary(nroots), stat=st)
+       if (st .ne. 0) return
+       depth(n+1) = 0
+       do i = n, 1, -1
+          depth(i) = depth(parent(i)) + 1
+       end do
+       call subtree_col_counts(n, ptr, row, perm, invp, parent, first, depth, &
+            nroots, roots, cc, vforest, last_p, last_nbr, summary, st)
+       if (st .ne. 0) return
+       next_first = first(roots(1))
+    end if
+    sub = 1
+
+    !
+    ! Determine cc(i), the number of net new entries appearing at node i.
+    !
+    piv = 1
+    do while (piv .le. n)
+       if (piv .eq. next_first) then
+          ! Pivots of subtree have been processed already: apply its effect on
+          ! ancestors as if its pivots had been processed here.
+          do k = 1, size(summary(sub)%u)
+             u = summary(sub)%u(k)
+             pp = last_p(u)
+             if (pp .ne. 0) then
+                ! First time u is seen in subtree is not first time seen
+                lca = FIND(vforest, pp)
+                cc(lca) = cc(lca) - 1
+             end if
+             last_p(u) = summary(sub)%last_p(k)
+             last_nbr(u) = summary(sub)%last_nbr(k)
+          end do
+          piv = roots(sub)
+          vforest(piv) = parent(piv)
+          piv = piv + 1
+          sub = sub + 1
+          next_first = n+1
+          if (sub .le. nroots) next_first = first(roots(sub))
+          cycle
+       end if
+
        ! Loop over entries in column below the diagonal
        col = invp(piv)
        do ii = ptr(col), ptr(col+1)-1
@@ -491,12 +628,18 @@ contains
           ! seen in this subtree before
           last_nbr(u) = piv
        end do
-       ! Pass uneliminated variables up to parent
-       par = parent(piv)
-       cc(par) = cc(par) + cc(piv) - 1
 
        ! place the parent of piv into the same partial elimination tree as piv
-       vforest(piv) = par ! operation "UNION" from [1]
+       vforest(piv) = parent(piv) ! operation "UNION" from [1]
+       piv = piv + 1
+    end do
+
+    !
+    ! Pass uneliminated variables up to parent
+    !
+    do piv = 1, n
+       par = parent(piv)
+       cc(par) = cc(par) + cc(piv) - 1
     end do
   end subroutine find_col_counts
 
@@ -520,6 +663,194 @@ contains
     FIND = current
   end function FIND
 
+!
+! This subroutine processes the pivots of independent subtrees of the
+! elimination tree in parallel for find_col_counts(). Each subtree is processed
+! exactly as in serial, except that last_p and last_nbr for ancestors of the
+! subtree are held in thread local arrays indexed by depth, and vforest of the
+! subtree's root is left unset. On exit, summary(s) holds the ancestors seen by
+! subtree s and their local values of last_p and last_nbr.
+!
+  subroutine subtree_col_counts(n, ptr, row, perm, invp, parent, first, depth, &
+       nroots, roots, cc, vforest, last_p, last_nbr, summary, st)
+    implicit none
+    integer, intent(in) :: n ! dimension of system
+    integer(ptr_kind), dimension(n+1), intent(in) :: ptr ! column pointers of A
+    integer, dimension(ptr(n+1)-1), intent(in) :: row ! row indices of A
+    integer, dimension(n), intent(in) :: perm ! perm(i) is the pivot
+      ! position of column i
+    integer, dimension(n), intent(in) :: invp ! inverse of perm
+    integer, dimension(n), intent(in) :: parent ! parent(i) is the
+      ! parent of pivot i in the elimination tree
+    integer, dimension(n+1), intent(in) :: first ! first descendants
+    integer, dimension(n+1), intent(in) :: depth ! depth in elimination tree
+    integer, intent(in) :: nroots ! number of subtrees
+    integer, dimension(nroots), intent(in) :: roots ! roots of subtrees
+    integer, dimension(n+1), intent(inout) :: cc ! net new entries at node i
+    integer, dimension(n+1), intent(inout) :: vforest ! virtual forest
+    integer, dimension(n+1), intent(inout) :: last_p ! previous pivot
+    integer, dimension(n+1), intent(inout) :: last_nbr ! previous neighbour
+    type(col_count_summary), dimension(nroots), intent(out) :: summary
+    integer, intent(out) :: st ! stat parmeter for allocate calls
+
+    integer :: col ! column of matrix associated with piv
+    integer :: d ! depth of ancestor u
+    integer(ptr_kind) :: ii
+    integer :: k
+    integer :: lca ! least common ancestor of piv and pp
+    integer, dimension(:), allocatable :: loc_nbr ! last_nbr of ancestors
+    integer, dimension(:), allocatable :: loc_p ! last_p of ancestors
+    integer :: maxd ! maximum depth of any subtree root
+    integer :: nseen ! number of ancestors seen by current subtree
+    integer :: piv ! current pivot
+    integer :: pp ! last pivot where u was encountered
+    integer :: r ! root of current subtree
+    integer :: s ! current subtree
+    integer, dimension(:), allocatable :: seen ! ancestors seen by subtree
+    integer :: u ! current entry in column col
+
+    maxd = 1
+    do s = 1, nroots
+       maxd = max(maxd, depth(roots(s)))
+    end do
+
+    st = 0
+!$omp parallel default(none) &
+!$omp    shared(n, ptr, row, perm, invp, parent, first, depth, nroots, roots, &
+!$omp       cc, vforest, last_p, last_nbr, summary, maxd) &
+!$omp    private(col, d, ii, k, lca, loc_nbr, loc_p, nseen, piv, pp, r, s, &
+!$omp       seen, u) &
+!$omp    reduction(max:st)
+    allocate(loc_p(maxd), loc_nbr(maxd), seen(maxd), stat=st)
+    if (st .eq. 0) then
+       loc_p(:) = 0
+       loc_nbr(:) = 0
+    end if
+!$omp do schedule(dynamic)
+    do s = 1, nroots
+       if (st .ne. 0) cycle
+       r = roots(s)
+       nseen = 0
+       do piv = first(r), r
+          col = invp(piv)
+          do ii = ptr(col), ptr(col+1)-1
+             u = perm(row(ii))
+             if (u .le. piv) cycle ! not in lower triangular part
+             if (u .le. r) then
+                ! u is in subtree, so owned by it: as in find_col_counts()
+                if (first(piv) .gt. last_nbr(u)) then
+                   cc(piv) = cc(piv) + 1
+                   pp = last_p(u)
+                   if (pp .ne. 0) then
+                      lca = FIND(vforest, pp)
+                      cc(lca) = cc(lca) - 1
+                   end if
+                   last_p(u) = piv
+                end if
+                last_nbr(u) = piv
+             else
+                ! u is an ancestor of r: use local values
+                d = depth(u)
+                if (loc_nbr(d) .eq. 0) then
+                   nseen = nseen + 1
+                   seen(nseen) = u
+                end if
+                if (first(piv) .gt. loc_nbr(d)) then
+                   cc(piv) = cc(piv) + 1
+                   pp = loc_p(d)
+                   if (pp .ne. 0) then
+                      lca = FIND(vforest, pp)
+                      cc(lca) = cc(lca) - 1
+                   end if
+                   loc_p(d) = piv
+                end if
+                loc_nbr(d) = piv
+             end if
+          end do
+          ! Root of subtree is left as top of its tree for serial pass
+          if (piv .ne. r) vforest(piv) = parent(piv)
+       end do
+
+       ! Record summary and reset local values
+       allocate(summary(s)%u(nseen), summary(s)%last_p(nseen), &
+            summary(s)%last_nbr(nseen), stat=st)
+       if (st .ne. 0) cycle
+       do k = 1, nseen
+          u = seen(k)
+          d = depth(u)
+          summary(s)%u(k) = u
+          summary(s)%last_p(k) = loc_p(d)
+          summary(s)%last_nbr(k) = loc_nbr(d)
+          loc_p(d) = 0
+          loc_nbr(d) = 0
+       end do
+    end do
+!$omp end do
+!$omp end parallel
+  end subroutine subtree_col_counts
+
+!
+! This subroutine finds independent subtrees of a postordered tree of m nodes
+! to be processed in parallel by nth threads. Subtrees are maximal subject to
+! having at most max(par_min_subtree, m/(par_tasks_per_thread*nth)) nodes, and
+! those with fewer than par_min_subtree nodes are discarded. On exit roots
+! holds the roots of subtrees in increasing order, and nroots is zero if there
+! is no benefit in parallel processing.
+!
+  subroutine find_par_subtrees(m, parent, first, nth, nroots, roots, st)
+    implicit none
+    integer, intent(in) :: m ! number of nodes in tree
+    integer, dimension(m), intent(in) :: parent ! parent(i) is parent of node
+      ! i, or m+1 if i is a root
+    integer, dimension(m+1), intent(in) :: first ! first descendant of node
+    integer, intent(in) :: nth ! number of threads
+    integer, intent(out) :: nroots ! number of subtrees found
+    integer, dimension(:), allocatable, intent(out) :: roots ! subtree roots
+    integer, intent(out) :: st ! stat parmeter for allocate calls
+
+    integer :: i
+    integer :: maxsz ! maximum size of a subtree
+
+    st = 0
+    nroots = 0
+    if (nth .le. 1) return
+
+    maxsz = max(par_min_subtree, m / (par_tasks_per_thread*nth))
+    do i = 1, m
+       if (is_par_root(i)) nroots = nroots + 1
+    end do
+    if (nroots .lt. 2) then
+       ! No independent work, serial is fastest
+       nroots = 0
+       return
+    end if
+
+    allocate(roots(nroots), stat=st)
+    if (st .ne. 0) return
+    nroots = 0
+    do i = 1, m
+       if (.not. is_par_root(i)) cycle
+       nroots = nroots + 1
+       roots(nroots) = i
+    end do
+
+  contains
+
+    ! Return true if node i is the root of a subtree to be used
+    logical function is_par_root(i)
+      implicit none
+      integer, intent(in) :: i
+
+      is_par_root = .false.
+      if ((i-first(i)+1) .lt. par_min_subtree) return
+      if ((i-first(i)+1) .gt. maxsz) return
+      if (parent(i) .le. m) then
+         if ((parent(i)-first(parent(i))+1) .le. maxsz) return
+      end if
+      is_par_root = .true.
+    end function is_par_root
+  end subroutine find_par_subtrees
+
 !!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!
 ! Supernode amalgamation routines
 !!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!
@@ -531,10 +862,12 @@ contains
 ! A node, u, and its parent, v, are merged if:
 ! (a) No new fill-in is introduced i.e. cc(v) = cc(u)-1
 ! (b) The number of columns in both u and v is less than nemin
+! (c) node_cost and half_width are present and cost_merge() predicts merging
+!     u and v is faster
 !
 ! Note: assembly tree must be POSTORDERED on output
   subroutine find_supernodes(n, realn, parent, cc, sperm, nnodes, sptr, sparent, &
-       scc, nemin, info, st)
+       scc, nemin, info, st, node_cost, half_width)
     integer, intent(in) :: n
     integer, intent(in) :: realn
     integer, dimension(n), intent(in) :: parent ! parent(i) is the
@@ -550,6 +883,8 @@ contains
     integer, intent(in) :: nemin
     integer, intent(inout) :: info
     integer, intent(out) :: st ! stat paremter from allocate calls
+    real(wp), optional, intent(in) :: node_cost
+    real(wp), optional, intent(in) :: half_width
 
     integer :: i, j, k
     integer, dimension(:), allocatable :: height ! used to track height of tree
@@ -629,7 +964,8 @@ contains
 
        do j = 1, nchild
           node = child(j)
-          if (do_merge(node, par, nelim, cc, ezero, nemin)) then
+          if (do_merge(node, par, nelim, cc, ezero, nemin, node_cost, &
+                half_width)) then
              ! Merge contents of node into par. Delete node.
              call merge_nodes(node, par, nelim, nvert, vhead, vnext, height, &
                   ezero, cc)
@@ -706,6 +1042,199 @@ contains
     return
   end subroutine find_supernodes
 
+!
+! This subroutine reorders the children of each supernode so that a serial
+! traversal of the assembly tree needs as little memory for contribution
+! blocks as possible (Liu, 1986).
+!
+! The contribution block of node i has cb(i) = m(i)**2 entries, where
+! m(i) = scc(i) - nelim(i), and is allocated before those of its children are
+! freed. If the children of i are processed in the order c_1, ..., c_k, the
+! peak memory of the subtree rooted at i is thus
+!    peak(i) = max( max_j ( cb(c_1) + ... + cb(c_{j-1}) + peak(c_j) ),
+!                   cb(c_1) + ... + cb(c_k) + cb(i) ),
+! which is minimised by processing children in decreasing order of
+! peak(c) - cb(c). Ties are left in their existing order.
+!
+! On exit, sptr, sparent and scc describe the renumbered (still postordered)
+! supernodes, sperm maps the old pivot order to the new one, and maxcontrib
+! is the peak over the whole tree.
+!
+  subroutine reorder_children(n, nnodes, sptr, sparent, scc, sperm, &
+       maxcontrib, st)
+    implicit none
+    integer, intent(in) :: n
+    integer, intent(in) :: nnodes
+    integer, dimension(nnodes+1), intent(inout) :: sptr
+    integer, dimension(nnodes), intent(inout) :: sparent
+    integer, dimension(nnodes), intent(inout) :: scc
+    integer, dimension(n), intent(out) :: sperm ! permutation from old pivot
+      ! order to new pivot order
+    integer(long), intent(out) :: maxcontrib
+    integer, intent(out) :: st
+
+    integer :: i, j, k
+    integer :: node
+    integer :: par
+    integer :: s
+    integer(long) :: m
+    integer(long) :: sumcb ! sum of cb() over children processed so far
+    integer, dimension(:), allocatable :: cptr ! children of node i are
+      ! clist(cptr(i):cptr(i+1)-1)
+    integer, dimension(:), allocatable :: clist
+    integer, dimension(:), allocatable :: map ! map(i) is new index of node i
+    integer, dimension(:), allocatable :: nnode ! number of nodes in subtree
+    integer, dimension(:), allocatable :: old_sptr
+    integer, dimension(:), allocatable :: old_scc
+    integer(long), dimension(:), allocatable :: cb ! contribution block size
+    integer(long), dimension(:), allocatable :: peak ! peak memory of subtree
+    integer(long), dimension(:), allocatable :: key ! peak(i) - cb(i)
+
+    allocate(cptr(nnodes+2), clist(nnodes), map(nnodes+1), nnode(nnodes+1), &
+         cb(nnodes+1), peak(nnodes+1), key(nnodes+1), stat=st)
+    if (st .ne. 0) return
+
+    ! Build lists of children, initially in ascending order
+    cptr(:) = 0
+    do node = 1, nnodes
+       par = sparent(node)
+       cptr(par+1) = cptr(par+1) + 1
+    end do
+    cptr(1) = 1
+    do node = 1, nnodes+1
+       cptr(node+1) = cptr(node) + cptr(node+1)
+    end do
+    map(1:nnodes+1) = cptr(1:nnodes+1) ! insertion position
+    do node = 1, nnodes
+       par = sparent(node)
+       clist(map(par)) = node
+       map(par) = map(par) + 1
+    end do
+
+    ! Order children and find peak of each subtree. Children precede their
+    ! parent, so can do in order.
+    cb(nnodes+1) = 0 ! virtual root
+    do node = 1, nnodes+1
+       if (node .le. nnodes) then
+          m = scc(node) - (sptr(node+1) - sptr(node))
+          cb(node) = m*m
+       end if
+       i = cptr(node)
+       j = cptr(node+1) - 1
+       call sort_by_long_val(j-i+1, clist(i:j), key)
+       peak(node) = 0
+       sumcb = 0
+       do k = i, j
+          peak(node) = max(peak(node), sumcb + peak(clist(k)))
+          sumcb = sumcb + cb(clist(k))
+       end do
+       peak(node) = max(peak(node), sumcb + cb(node))
+       key(node) = peak(node) - cb(node)
+    end do
+    maxcontrib = peak(nnodes+1)
+
+    ! Find new postorder. The subtree of each node occupies a contiguous range
+    ! of indices, with the node itself last. Parents follow their children, so
+    ! work backwards, laying out the ranges of children of each node in turn.
+    nnode(:) = 1
+    do node = 1, nnodes
+       par = sparent(node)
+       nnode(par) = nnode(par) + nnode(node)
+    end do
+    map(nnodes+1) = 1 ! start of range
+    do node = nnodes+1, 1, -1
+       s = map(node)
+       do k = cptr(node), cptr(node+1)-1
+          map(clist(k)) = s
+          s = s + nnode(clist(k))
+       end do
+       map(node) = map(node) + nnode(node) - 1
+    end do
+
+    ! Renumber supernodes and their variables
+    deallocate(cptr, clist, cb, peak, key, stat=st)
+    allocate(old_sptr(nnodes+1), old_scc(nnodes), stat=st)
+    if (st .ne. 0) return
+    old_sptr(:) = sptr(:)
+    old_scc(:) = scc(:)
+    do node = 1, nnodes
+       nnode(map(node)) = old_sptr(node+1) - old_sptr(node)
+    end do
+    do node = 1, nnodes
+       sptr(node+1) = sptr(node) + nnode(node)
+    end do
+    do node = 1, nnodes
+       i = map(node)
+       scc(i) = old_scc(node)
+       nnode(i) = map(sparent(node))
+       do j = old_sptr(node), old_sptr(node+1)-1
+          sperm(j) = sptr(i) + (j - old_sptr(node))
+       end do
+    end do
+    sparent(:) = nnode(1:nnodes)
+    do j = sptr(nnodes+1), n
+       sperm(j) = j ! empty columns
+    end do
+  end subroutine reorder_children
+
+!
+! Sort n items labelled by idx into decreasing order of val(idx(i)), breaking
+! ties by increasing idx(i). Uses heapsort, as val is integer(long).
+!
+  subroutine sort_by_long_val(n, idx, val)
+    implicit none
+    integer, intent(in) :: n
+    integer, dimension(n), intent(inout) :: idx
+    integer(long), dimension(:), intent(in) :: val
+
+    integer :: i
+    integer :: k
+
+    do i = n/2, 1, -1
+       call sift_down(i, n)
+    end do
+    do k = n, 2, -1
+       i = idx(1)
+       idx(1) = idx(k)
+       idx(k) = i
+       call sift_down(1, k-1)
+    end do
+
+  contains
+    ! Return true if item a is to be placed after item b
+    logical function after(a, b)
+      implicit none
+      integer, intent(in) :: a
+      integer, intent(in) :: b
+
+      after = (val(a) .lt. val(b)) .or. &
+           ((val(a) .eq. val(b)) .and. (a .gt. b))
+    end function after
+
+    ! Restore heap property of idx(root:last), given it holds below root
+    subroutine sift_down(root, last)
+      implicit none
+      integer, intent(in) :: root
+      integer, intent(in) :: last
+
+      integer :: c, i, t
+
+      i = root
+      t = idx(i)
+      do
+         c = 2*i
+         if (c .gt. last) exit
+         if (c .lt. last) then
+            if (after(idx(c+1), idx(c))) c = c + 1
+         end if
+         if (.not. after(idx(c), t)) exit
+         idx(i) = idx(c)
+         i = c
+      end do
+      idx(i) = t
+    end subroutine sift_down
+  end subroutine sort_by_long_val
+
 !
 ! Sort n items labelled by idx into decreasing order of val(idx(i))
 !
@@ -803,7 +1332,8 @@ contains
 !
 ! Return .true. if we should merge node and par, .false. if we should not
 !
-  logical function do_merge(node, par, nelim, cc, ezero, nemin)
+  logical function do_merge(node, par, nelim, cc, ezero, nemin, node_cost, &
+       half_width)
     implicit none
     integer, intent(in) :: node ! node to merge and delete
     integer, intent(in) :: par ! parent to merge into
@@ -811,6 +1341,8 @@ contains
     integer, dimension(:), intent(in) :: cc
     integer(long), dimension(:), intent(in) :: ezero
     integer, intent(in) :: nemin
+    real(wp), optional, intent(in) :: node_cost
+    real(wp), optional, intent(in) :: half_width
 
     if (ezero(par) .eq. huge(ezero)) then
        do_merge = .false.
@@ -819,8 +1351,78 @@ contains
 
     do_merge = ((cc(par) .eq. (cc(node)-1)) .and. (nelim(par) .eq. 1)) .or. &
          ((nelim(par) .lt. nemin) .and. (nelim(node) .lt. nemin))
+    if (do_merge) return
+
+    if (present(node_cost) .and. present(half_width)) &
+         do_merge = cost_merge(nelim(node), cc(node)-1, nelim(par), cc(par)-1, &
+            node_cost, half_width)
   end function do_merge
 
+!
+! Return .true. if a cost model predicts that factorizing node and par as a
+! single node is faster than factorizing them separately.
+!
+! A node with p eliminated columns and r further rows is modelled as taking
+!    node_cost + flops(p,r) * (1 + half_width/p) + amalg_entry_cost * r(r+1)/2
+! flops-equivalent time: a fixed overhead, the factorization flops at a rate
+! that approaches peak as the node becomes wider, and the assembly of its
+! contribution block into its parent. Merging saves one overhead and one
+! assembly and runs at a wider block size, but factorizes explicit zeros. As
+! the gain in rate vanishes for wide nodes, merges happen mostly near the
+! leaves, leaving the (parallel) upper levels of the tree intact. Merges that
+! would increase the entries in L by more than a factor amalg_max_fill are
+! rejected to bound memory use.
+!
+  logical function cost_merge(pnode, rnode, ppar, rpar, node_cost, half_width)
+    implicit none
+    integer, intent(in) :: pnode ! number of columns eliminated at node
+    integer, intent(in) :: rnode ! rows of node not eliminated at it
+    integer, intent(in) :: ppar ! number of columns eliminated at par
+    integer, intent(in) :: rpar ! rows of par not eliminated at it
+    real(wp), intent(in) :: node_cost
+    real(wp), intent(in) :: half_width
+
+    real(wp) :: before, after, fill
+
+    ! Merged node has pnode+ppar columns and the same rows below them as par
+    fill = node_entries(pnode+ppar, rpar) - node_entries(pnode, rnode) - &
+         node_entries(ppar, rpar)
+    if (fill .gt. amalg_max_fill * &
+         (node_entries(pnode, rnode) + node_entries(ppar, rpar))) then
+       cost_merge = .false.
+       return
+    end if
+
+    before = node_time(pnode, rnode) + node_time(ppar, rpar)
+    after = node_time(pnode+ppar, rpar)
+    cost_merge = (after .lt. before)
+
+  contains
+
+    ! Entries of L in node with p columns and r rows below them
+    real(wp) function node_entries(p, r)
+      implicit none
+      integer, intent(in) :: p
+      integer, intent(in) :: r
+
+      node_entries = 0.5_wp*p*(p+1) + real(p,wp)*r
+    end function node_entries
+
+    ! Modelled time for node with p columns and r rows below them
+    real(wp) function node_time(p, r)
+      implicit none
+      integer, intent(in) :: p
+      integer, intent(in) :: r
+
+      real(wp) :: flops
+
+      ! sum_{j=1}^p (r+j)**2, as in calc_stats()
+      flops = real(p,wp)*r*r + real(r,wp)*p*(p+1) + real(p,wp)*(p+1)*(2*p+1)/6
+      node_time = node_cost + flops * (1 + half_width/p) + &
+           amalg_entry_cost * 0.5_wp*r*(r+1)
+    end function node_time
+  end function cost_merge
+
 !
 ! This subroutine merges node with its parent, deleting node in the process.
 !
@@ -907,9 +1509,15 @@ contains
 
 !
 ! This subroutine determines the row indices for each supernode
+!
+! If nth > 1, independent subtrees of the assembly tree are processed in
+! parallel, followed by the remaining nodes in serial. The row indices of a
+! subtree either belong to the subtree itself, or are columns of its ancestors.
+! A tag recording when the latter were last seen is held in a thread local
+! array indexed by the position of the column on the path to the root.
 !
   subroutine find_row_lists(n, ptr, row, perm, invp, nnodes, &
-       sptr, sparent, scc, rptr, rlist, info, st)
+       sptr, sparent, scc, nth, rptr, rlist, info, st)
     implicit none
     integer, intent(in) :: n
     integer(ptr_kind), dimension(n+1), intent(in) :: ptr
@@ -920,83 +1528,201 @@ contains
     integer, dimension(nnodes+1), intent(in) :: sptr
     integer, dimension(nnodes), intent(in) :: sparent
     integer, dimension(nnodes), intent(in) :: scc
+    integer, intent(in) :: nth ! number of threads to use
     integer(long), dimension(nnodes+1), intent(out) :: rptr
     integer, dimension(sum(scc(1:nnodes))), intent(out) :: rlist
     integer, intent(inout) :: info
     integer, intent(out) :: st
 
-    integer :: child ! current child of node
-    integer :: col ! current column of matrix corresponding to piv
-    integer(long) :: i
-    integer(long) :: idx ! current insert position into nodes(node)%index
+    integer :: base ! position of column on path to root
+    integer, dimension(:), allocatable :: cpos ! cpos(j) is the position of
+      ! column j on the path from it to the root (root's last column is 1)
+    integer :: i
     integer :: j
+    integer :: maxpos ! maximum position of a subtree root's first column
     integer :: node ! current node of assembly tree
-    integer :: piv ! current pivot position
+    integer :: nroots ! number of subtrees processed in parallel
+    integer :: par ! parent of node
+    integer, dimension(:), allocatable :: roots ! roots of subtrees
+    integer :: s ! current subtree
     integer, dimension(:), allocatable :: seen ! tag last time index was seen
     integer, dimension(:), allocatable :: chead ! head of child linked lists
     integer, dimension(:), allocatable :: cnext ! pointer to next child
+    integer, dimension(:), allocatable :: sfirst ! first descendant of node
+    integer, dimension(:), allocatable :: tag ! thread local version of seen
+      ! for ancestor columns, indexed by cpos
 
     ! Allocate and initialise memory
-    allocate(seen(n), chead(nnodes+1), cnext(nnodes+1), stat=st)
-    if (st .ne. 0) then
-       info = ERROR_ALLOCATION
-       return
-    end if
+    allocate(seen(n), chead(nnodes+1), cnext(nnodes+1), sfirst(nnodes+1), &
+         stat=st)
+    if (st .ne. 0) goto 490
     seen(:) = 0
     chead(:) = -1
 
     ! Build child linked lists (backwards so pop off in good order)
+    ! and find first descendants
+    do node = 1, nnodes+1
+       sfirst(node) = node
+    end do
     do node = nnodes, 1, -1
        i = sparent(node)
        cnext(node) = chead(i)
        chead(i) = node
     end do
+    do node = 1, nnodes
+       par = sparent(node)
+       sfirst(par) = min(sfirst(par), sfirst(node))
+    end do
 
-    ! Loop over nodes from bottom up building row lists.
+    ! Allocate space for row indices
     rptr(1) = 1
     do node = 1, nnodes
-
-       ! Allocate space for row indices
        rptr(node+1) = rptr(node) + scc(node)
-       idx = rptr(node) ! insert position
-
-       ! Add entries eliminated at this node
-       do piv = sptr(node), sptr(node+1)-1
-          seen(piv) = node
-          rlist(idx) = piv
-          idx = idx + 1
-       end do
+    end do
 
-       ! Find indices inherited from children
-       child = chead(node)
-       do while (child .ne. -1)
-          do i = rptr(child), rptr(child+1)-1
-             j = rlist(i)
-             if (j .lt. sptr(node)) cycle ! eliminated
-             if (seen(j) .eq. node) cycle ! already seen
-             seen(j) = node
-             rlist(idx) = j
-             idx = idx + 1
+    ! Process independent subtrees in parallel
+    call find_par_subtrees(nnodes, sparent, sfirst, nth, nroots, roots, st)
+    if (st .ne. 0) goto 490
+    if (nroots .gt. 0) then
+       allocate(cpos(n), stat=st)
+       if (st .ne. 0) goto 490
+       cpos(:) = 0
+       do node = nnodes, 1, -1
+          base = 0
+          if (sparent(node) .le. nnodes) base = cpos(sptr(sparent(node)))
+          do j = sptr(node+1)-1, sptr(node), -1
+             base = base + 1
+             cpos(j) = base
           end do
-          child = cnext(child)
        end do
-
-       ! Find new indices from A
-       do piv = sptr(node), sptr(node+1)-1
-          col = invp(piv)
-          do i = ptr(col), ptr(col+1)-1
-             j = perm(row(i))
-             if (j .lt. piv) cycle ! in upper triangle
-             if (seen(j) .eq. node) cycle ! already seen in this snode
-             ! Otherwise, this is a new entry
-             seen(j) = node
-             rlist(idx) = j
-             idx = idx + 1
+       maxpos = 1
+       do s = 1, nroots
+          maxpos = max(maxpos, cpos(sptr(roots(s))))
+       end do
+!$omp parallel default(shared) private(node, s, tag) reduction(max:st)
+       allocate(tag(maxpos), stat=st)
+       if (st .eq. 0) tag(:) = 0
+!$omp do schedule(dynamic)
+       do s = 1, nroots
+          if (st .ne. 0) cycle
+          do node = sfirst(roots(s)), roots(s)
+             call node_row_list(n, ptr, row, perm, invp, nnodes, sptr, &
+                  chead, cnext, rptr, rlist, node, seen, &
+                  sptr(roots(s)+1), tag, cpos)
           end do
        end do
+!$omp end do
+!$omp end parallel
+       if (st .ne. 0) goto 490
+    end if
+
+    ! Loop over remaining nodes from bottom up building row lists.
+    s = 1
+    node = 1
+    do while (node .le. nnodes)
+       if (s .le. nroots) then
+          if (node .eq. sfirst(roots(s))) then
+             ! Subtree already done
+             node = roots(s) + 1
+             s = s + 1
+             cycle
+          end if
+       end if
+       call node_row_list(n, ptr, row, perm, invp, nnodes, sptr, chead, &
+            cnext, rptr, rlist, node, seen, n+1)
+       node = node + 1
     end do
+    return
+
+490 continue
+    info = ERROR_ALLOCATION
+    return
   end subroutine find_row_lists
 
+!
+! This subroutine determines the row indices of a single supernode, given
+! those of its children. Indices j >= lim are tagged in tag(cpos(j)) rather
+! than seen(j).
+!
+  subroutine node_row_list(n, ptr, row, perm, invp, nnodes, sptr, chead, &
+       cnext, rptr, rlist, node, seen, lim, tag, cpos)
+    implicit none
+    integer, intent(in) :: n
+    integer(ptr_kind), dimension(n+1), intent(in) :: ptr
+    integer, dimension(ptr(n+1)-1), intent(in) :: row
+    integer, dimension(n), intent(in) :: perm
+    integer, dimension(n), intent(in) :: invp
+    integer, intent(in) :: nnodes
+    integer, dimension(nnodes+1), intent(in) :: sptr
+    integer, dimension(nnodes+1), intent(in) :: chead
+    integer, dimension(nnodes+1), intent(in) :: cnext
+    integer(long), dimension(nnodes+1), intent(in) :: rptr
+    integer, dimension(rptr(nnodes+1)-1), intent(inout) :: rlist
+    integer, intent(in) :: node ! current node of assembly tree
+    integer, dimension(n), intent(inout) :: seen
+    integer, intent(in) :: lim
+    integer, dimension(:), optional, intent(inout) :: tag
+    integer, dimension(n), optional, intent(in) :: cpos
+
+    integer :: child ! current child of node
+    integer :: col ! current column of matrix corresponding to piv
+    integer(long) :: i
+    integer(long) :: idx ! current insert position into nodes(node)%index
+    integer :: j
+    integer :: piv ! current pivot position
+
+    idx = rptr(node) ! insert position
+
+    ! Add entries eliminated at this node
+    do piv = sptr(node), sptr(node+1)-1
+       seen(piv) = node
+       rlist(idx) = piv
+       idx = idx + 1
+    end do
+
+    ! Find indices inherited from children
+    child = chead(node)
+    do while (child .ne. -1)
+       do i = rptr(child), rptr(child+1)-1
+          j = rlist(i)
+          if (j .lt. sptr(node)) cycle ! eliminated
+          if (.not. first_seen(j)) cycle ! already seen
+          rlist(idx) = j
+          idx = idx + 1
+       end do
+       child = cnext(child)
+    end do
+
+    ! Find new indices from A
+    do piv = sptr(node), sptr(node+1)-1
+       col = invp(piv)
+       do i = ptr(col), ptr(col+1)-1
+          j = perm(row(i))
+          if (j .lt. piv) cycle ! in upper triangle
+          if (.not. first_seen(j)) cycle ! already seen in this snode
+          ! Otherwise, this is a new entry
+          rlist(idx) = j
+          idx = idx + 1
+       end do
+    end do
+
+  contains
+
+    ! Tag index j as seen at node, returning true if not seen before
+    logical function first_seen(j)
+      implicit none
+      integer, intent(in) :: j
+
+      if (j .lt. lim) then
+         first_seen = (seen(j) .ne. node)
+         seen(j) = node
+      else
+         first_seen = (tag(cpos(j)) .ne. node)
+         tag(cpos(j)) = node
+      end if
+    end function first_seen
+  end subroutine node_row_list
+
 !!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!
 ! Assorted auxilary routines
 !!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!
@@ -1063,6 +1789,46 @@ contains
     end do
   end subroutine dbl_tr_sort
 
+!
+! This subroutine sorts the row indices of each supernode in parallel. It
+! produces the same result as dbl_tr_sort(), but without its serial transpose.
+! The indices eliminated at each node are already first and in order, so only
+! the remaining indices are sorted.
+!
+  subroutine par_sort_row_lists(n, nnodes, sptr, rptr, rlist, st)
+    implicit none
+    integer, intent(in) :: n
+    integer, intent(in) :: nnodes
+    integer, dimension(nnodes+1), intent(in) :: sptr
+    integer(long), dimension(nnodes+1), intent(in) :: rptr
+    integer, dimension(rptr(nnodes+1)-1), intent(inout) :: rlist
+    integer, intent(out) :: st
+
+    integer :: i
+    integer(long) :: ii
+    integer :: node
+    integer, dimension(:), allocatable :: rev ! rev(i) = n+1-i, as sort_by_val
+      ! sorts into decreasing order
+
+    allocate(rev(n), stat=st)
+    if (st .ne. 0) return
+    do i = 1, n
+       rev(i) = n+1-i
+    end do
+
+!$omp parallel default(shared) private(ii) reduction(max:st)
+    st = 0
+!$omp do schedule(dynamic,64)
+    do node = 1, nnodes
+       if (st .ne. 0) cycle
+       ii = rptr(node) + sptr(node+1) - sptr(node)
+       call sort_by_val(int(rptr(node+1)-ii), rlist(ii:rptr(node+1)-1), rev, &
+            st)
+    end do
+!$omp end do
+!$omp end parallel
+  end subroutine par_sort_row_lists
+
 !
 ! This subroutine applies the permutation perm to order, invp and cc
 !
@@ -45,6 +45,13 @@ void spral_hw_topology_guess(int* nregions, NumaRegion** regions) {
       region.gpus = (region.ngpu > 0) ? new int[region.ngpu] : nullptr;
       for(int i=0; i<region.ngpu; ++i)
          region.gpus[i] = gpus[i];
+      auto caches = topology.get_l3_caches(numa_nodes[i]);
+      region.ngroup = caches.size();
+      region.group_nproc =
+         (region.ngroup > 0) ? new int[region.ngroup] : nullptr;
+      for(int j=0; j<region.ngroup; ++j)
+         region.group_nproc[j] = topology.count_cores(caches[j]);
+      region.socket = topology.get_socket(numa_nodes[i]);
    }
 #else /* HAVE_HWLOC */
    // Compiled without hwloc support, just put everything in one region
@@ -65,6 +72,9 @@ void spral_hw_topology_guess(int* nregions, NumaRegion** regions) {
    region.ngpu = 0;
    region.gpus = nullptr;
 #endif /* HAVE_NVCC */
+   region.ngroup = 0; // Unknown without hwloc
+   region.group_nproc = nullptr;
+   region.socket = 0;
 #endif /* HAVE_HWLOC */
 }
 
@@ -78,6 +88,8 @@ void spral_hw_topology_free(int nregions, NumaRegion* regions) {
    for(int i=0; i<nregions; ++i) {
       if(regions[i].gpus)
          delete[] regions[i].gpus;
+      if(regions[i].group_nproc)
+         delete[] regions[i].group_nproc;
    }
    delete[] regions;
 }
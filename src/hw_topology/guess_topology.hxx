@@ -12,10 +12,16 @@ namespace spral {
 /** \brief Hardware topology module */
 namespace hw_topology {
 
+/** \brief Describes a NUMA region.
+ *
+ * Interoperates with Fortran type spral_hw_topology::c_numa_region. */
 struct NumaRegion {
-   int nproc;
-   int ngpu;
-   int *gpus;
+   int nproc; ///< Number of processors (cores) in region
+   int ngpu; ///< Number of attached GPUs
+   int *gpus; ///< List of attached GPUs
+   int ngroup; ///< Number of groups of cores sharing an L3 cache (or 0)
+   int *group_nproc; ///< Number of processors in each L3 group
+   int socket; ///< Socket (package) containing region, numbered from 0
 };
 
 extern "C"
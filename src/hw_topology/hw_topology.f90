@@ -20,12 +20,21 @@ module spral_hw_topology
      integer(C_INT) :: nproc
      integer(C_INT) :: ngpu
      type(C_PTR) :: gpus
+     integer(C_INT) :: ngroup
+     type(C_PTR) :: group_nproc
+     integer(C_INT) :: socket
   end type c_numa_region
 
   !> Represents a NUMA region
   type :: numa_region
      integer :: nproc !< Number of processors in region
      integer, dimension(:), allocatable :: gpus !< List of attached GPUs
+     !> Number of processors in each group sharing an L3 cache. Unallocated
+     !> or of size 0 if unknown.
+     integer, dimension(:), allocatable :: cache_groups
+     !> Socket (package) containing region, numbered from 0. Regions with
+     !> the same socket are grouped together for hierarchical execution.
+     integer :: socket = 0
   end type numa_region
 
   interface
@@ -63,6 +72,7 @@ contains
     type(C_PTR) :: c_regions
     type(c_numa_region), dimension(:), pointer, contiguous :: f_regions
     integer(C_INT), dimension(:), pointer, contiguous :: f_gpus
+    integer(C_INT), dimension(:), pointer, contiguous :: f_groups
 
     ! Get regions from C
     call spral_hw_topology_guess(nregions, c_regions)
@@ -81,6 +91,14 @@ contains
                   shape=(/ f_regions(i)%ngpu /))
              regions(i)%gpus = f_gpus(:)
           end if
+          allocate(regions(i)%cache_groups(f_regions(i)%ngroup), stat=st)
+          if (st .ne. 0) return
+          if (f_regions(i)%ngroup .gt. 0) then
+             call c_f_pointer(f_regions(i)%group_nproc, f_groups, &
+                  shape=(/ f_regions(i)%ngroup /))
+             regions(i)%cache_groups = f_groups(:)
+          end if
+          regions(i)%socket = f_regions(i)%socket
        end do
     end if
 
@@ -69,9 +69,43 @@ public:
       }
    }
 
-   /** \brief Return number of cores associated to object. */
+   /** \brief Return number of cores associated to object.
+    *
+    * NB: Counted by cpuset rather than by descending the tree, as from hwloc
+    * 2.0 NUMA nodes are memory children with no children of their own. */
    int count_cores(hwloc_obj_t const& obj) const {
-      return count_type(obj, HWLOC_OBJ_CORE);
+      return hwloc_get_nbobjs_inside_cpuset_by_type(topology_, obj->cpuset,
+            HWLOC_OBJ_CORE);
+   }
+
+   /** \brief Return vector of L3 caches within object.
+    *
+    * Empty if there is no single level of L3 cache (or if an L3 cache spans
+    * more than obj). */
+   std::vector<hwloc_obj_t> get_l3_caches(hwloc_obj_t const& obj) const {
+      std::vector<hwloc_obj_t> caches;
+      int depth = hwloc_get_cache_type_depth(topology_, 3,
+            HWLOC_OBJ_CACHE_UNIFIED);
+      if(depth < 0) return caches; // Not present, or at multiple depths
+      int ncache =
+         hwloc_get_nbobjs_inside_cpuset_by_depth(topology_, obj->cpuset, depth);
+      caches.reserve(ncache);
+      for(int i=0; i<ncache; ++i)
+         caches.push_back(
+               hwloc_get_obj_inside_cpuset_by_depth(topology_, obj->cpuset,
+                  depth, i)
+               );
+      return caches;
+   }
+
+   /** \brief Return index of socket (package) containing object.
+    *
+    * Returns 0 if there is no such socket, for example if obj spans more
+    * than one. */
+   int get_socket(hwloc_obj_t const& obj) const {
+      hwloc_obj_t package =
+         hwloc_get_ancestor_obj_by_type(topology_, HWLOC_OBJ_PACKAGE, obj);
+      return (package) ? static_cast<int>(package->logical_index) : 0;
    }
 
    /** \brief Return list of gpu indices associated to object. */
@@ -99,15 +133,64 @@ public:
       return gpus; // will be empty ifndef HAVE_NVCC
    }
 
-private:
-   int count_type(hwloc_obj_t const& obj, hwloc_obj_type_t type) const {
-      if(obj->type == type) return 1;
-      int count = 0;
-      for(unsigned int i=0; i<obj->arity; ++i)
-         count += count_type(obj->children[i], type);
-      return count;
+   /** \brief Return true if memory can be allocated bound to NUMA nodes. */
+   bool supports_membind() const {
+      struct hwloc_topology_support const* support =
+         hwloc_topology_get_support(topology_);
+      return support->membind->alloc_membind &&
+         support->membind->bind_membind &&
+         support->membind->interleave_membind;
+   }
+
+   /** \brief Convert set of OS processor indices to NUMA nodes that hold
+    *         them. */
+   void cpuset_to_nodeset(hwloc_const_cpuset_t cpuset,
+         hwloc_nodeset_t nodeset) const {
+#if HWLOC_API_VERSION >= 0x20000
+      hwloc_cpuset_to_nodeset(topology_, cpuset, nodeset);
+#else /* HWLOC_API_VERSION */
+      hwloc_cpuset_to_nodeset_strict(topology_, cpuset, nodeset);
+#endif /* HWLOC_API_VERSION */
+   }
+
+   /** \brief Allocate memory bound to (or if interleave is true, interleaved
+    *         across) the given NUMA nodes.
+    *
+    * Binding is best effort: if it fails, memory is still returned. Returns
+    * nullptr only if no memory could be allocated. Memory must be released
+    * through free_membind(). */
+   void* alloc_membind(size_t sz, hwloc_const_nodeset_t nodeset,
+         bool interleave) const {
+      hwloc_membind_policy_t policy =
+         (interleave) ? HWLOC_MEMBIND_INTERLEAVE : HWLOC_MEMBIND_BIND;
+#if HWLOC_API_VERSION >= 0x20000
+      return hwloc_alloc_membind(topology_, sz, nodeset, policy,
+            HWLOC_MEMBIND_BYNODESET);
+#else /* HWLOC_API_VERSION */
+      return hwloc_alloc_membind_nodeset(topology_, sz, nodeset, policy, 0);
+#endif /* HWLOC_API_VERSION */
+   }
+
+   /** \brief Free memory allocated by alloc_membind(). */
+   void free_membind(void* ptr, size_t sz) const {
+      hwloc_free(topology_, ptr, sz);
    }
 
+   /** \brief Find NUMA node(s) physically holding the page(s) of given memory
+    *         area.
+    *
+    * \return true on success, false if not supported. */
+   bool get_memory_location(void const* ptr, size_t sz,
+         hwloc_nodeset_t nodeset) const {
+#if HWLOC_API_VERSION >= 0x20000
+      return (hwloc_get_area_memlocation(topology_, ptr, sz, nodeset,
+               HWLOC_MEMBIND_BYNODESET) == 0) && !hwloc_bitmap_iszero(nodeset);
+#else /* HWLOC_API_VERSION */
+      return false; // Not available before hwloc 2.0
+#endif /* HWLOC_API_VERSION */
+   }
+
+private:
    hwloc_topology_t topology_; ///< Underlying topology object
 };
 
@@ -0,0 +1,509 @@
+!> \file
+!> \copyright 2026 The Science and Technology Facilities Council (STFC)
+!> \licence   BSD licence, see LICENCE file for details
+!> \brief Native nested dissection ordering
+!
+!> \brief Provides a nested dissection ordering of a symmetric sparse matrix
+!>        that is computed in parallel over the separator tree.
+!>
+!> The graph of the matrix is recursively bisected by vertex separators, and
+!> the vertices of each part are ordered before those of its separator. The
+!> two parts of each bisection are independent, so are dissected as separate
+!> OpenMP tasks. Each separator hence becomes a chain of nodes in the assembly
+!> tree whose two subtrees are the parts, so the top levels of the separator
+!> tree give the balanced independent subtrees that the analyse phase assigns
+!> to NUMA regions.
+!>
+!> Separators are found from level structures rooted at pseudo-peripheral
+!> vertices, and are then thinned. Subgraphs of at most nd_leaf_size vertices
+!> are ordered by minimum degree. The ordering found does not depend on the
+!> number of threads.
+module spral_nd_order
+  implicit none
+
+  private
+  public :: nd_order ! Compute nested dissection order of symmetric matrix
+
+  integer, parameter :: long = selected_int_kind(18)
+
+  ! Return codes
+  integer, parameter :: ERROR_ALLOC = -1
+  integer, parameter :: ERROR_N_OOR = -2
+
+  !> Subgraphs with at most this many vertices are ordered by minimum degree
+  integer, parameter :: nd_leaf_size = 64
+  !> Subgraphs with at least this many vertices are dissected in a new task
+  integer, parameter :: nd_task_size = 2000
+  !> Each part of a bisection should hold at least this fraction of vertices
+  real, parameter :: nd_min_balance = 0.2
+  !> Maximum number of level structures tried to find a peripheral vertex
+  integer, parameter :: nd_max_sweeps = 8
+
+  !> \brief Graph of a subproblem with full adjacency lists (no self loops)
+  type nd_graph
+     integer :: n = 0 !< Number of vertices
+     integer(long), dimension(:), allocatable :: ptr !< Adjacency list of
+        !< vertex i is adj(ptr(i):ptr(i+1)-1)
+     integer, dimension(:), allocatable :: adj !< Adjacent vertices
+     integer, dimension(:), allocatable :: vmap !< Vertex i of this graph is
+        !< variable vmap(i) of the original matrix
+  end type nd_graph
+
+contains
+
+!> \brief Compute a nested dissection ordering of a symmetric matrix.
+!>
+!> \param n Order of matrix.
+!> \param ptr Column pointers for pattern of both lower and upper triangles.
+!> \param row Row indices. Diagonal entries are ignored, there must be no
+!>        duplicates or out-of-range entries.
+!> \param perm On exit, perm(i) is the position of variable i in the
+!>        elimination order.
+!> \param invp On exit, invp(k) is the variable in position k of the
+!>        elimination order.
+!> \param flag Return code: 0 on success, negative on error.
+!> \param stat Fortran stat parameter on allocation failure.
+subroutine nd_order(n, ptr, row, perm, invp, flag, stat)
+  implicit none
+  integer, intent(in) :: n
+  integer(long), dimension(n+1), intent(in) :: ptr
+  integer, dimension(ptr(n+1)-1), intent(in) :: row
+  integer, dimension(n), intent(out) :: perm
+  integer, dimension(n), intent(out) :: invp
+  integer, intent(out) :: flag
+  integer, intent(out) :: stat
+
+  type(nd_graph) :: g
+  integer :: i, k
+  integer(long) :: j, ne
+
+  flag = 0
+  stat = 0
+
+  if (n .lt. 1) then
+     flag = ERROR_N_OOR
+     return
+  end if
+
+  ! Copy graph, dropping diagonal entries
+  ne = 0
+  do i = 1, n
+     do j = ptr(i), ptr(i+1)-1
+        if (row(j) .ne. i) ne = ne + 1
+     end do
+  end do
+  g%n = n
+  allocate(g%ptr(n+1), g%adj(ne), g%vmap(n), stat=stat)
+  if (stat .ne. 0) then
+     flag = ERROR_ALLOC
+     return
+  end if
+  ne = 0
+  do i = 1, n
+     g%ptr(i) = ne + 1
+     do j = ptr(i), ptr(i+1)-1
+        if (row(j) .eq. i) cycle
+        ne = ne + 1
+        g%adj(ne) = row(j)
+     end do
+     g%vmap(i) = i
+  end do
+  g%ptr(n+1) = ne + 1
+
+  ! Dissect, with independent subgraphs handled by different tasks
+!$omp parallel default(shared)
+!$omp single
+  call dissect(g, 1, invp, stat)
+!$omp end single
+!$omp end parallel
+  if (stat .ne. 0) then
+     flag = ERROR_ALLOC
+     return
+  end if
+
+  do k = 1, n
+     perm(invp(k)) = k
+  end do
+end subroutine nd_order
+
+!> \brief Order the vertices of a graph by nested dissection.
+!>
+!> The vertices of g are placed in positions base:base+g%n-1 of invp. The
+!> arrays of g are deallocated before its parts are dissected, so that the
+!> memory in use is bounded by a small multiple of the size of the original
+!> graph.
+!>
+!> \param g Graph to order.
+!> \param base First position in invp to use.
+!> \param invp Inverse of elimination order (shared by all tasks).
+!> \param stat Set to nonzero stat parameter on allocation failure.
+recursive subroutine dissect(g, base, invp, stat)
+  implicit none
+  type(nd_graph), intent(inout) :: g
+  integer, intent(in) :: base
+  integer, dimension(*), intent(inout) :: invp
+  integer, intent(inout) :: stat
+
+  type(nd_graph) :: ga, gb
+  integer, dimension(:), allocatable :: part, lmap
+  integer :: i, k, na, nb, st
+
+  if (g%n .le. nd_leaf_size) then
+     call leaf_order(g, base, invp, st)
+     if (st .ne. 0) goto 100
+     return
+  end if
+
+  ! Split vertices into parts A and B, and separator S
+  allocate(part(g%n), lmap(g%n), stat=st)
+  if (st .ne. 0) goto 100
+  call bisect(g, part, st)
+  if (st .ne. 0) goto 100
+
+  ! Number the vertices of each part, and order separator last
+  na = 0
+  nb = 0
+  k = base + g%n
+  do i = 1, g%n
+     select case(part(i))
+     case(1)
+        na = na + 1
+        lmap(i) = na
+     case(2)
+        nb = nb + 1
+        lmap(i) = nb
+     end select
+  end do
+  do i = g%n, 1, -1
+     if (part(i) .ne. 0) cycle
+     k = k - 1
+     invp(k) = g%vmap(i)
+  end do
+
+  ! Extract parts and free the current graph before recursing
+  call extract_part(g, part, lmap, 1, na, ga, st)
+  if (st .ne. 0) goto 100
+  call extract_part(g, part, lmap, 2, nb, gb, st)
+  if (st .ne. 0) goto 100
+  deallocate(part, lmap, g%ptr, g%adj, g%vmap)
+
+  if (na .gt. 0) then
+!$omp task default(shared) if(na .ge. nd_task_size)
+     call dissect(ga, base, invp, stat)
+!$omp end task
+  end if
+  if (nb .gt. 0) call dissect(gb, base+na, invp, stat)
+!$omp taskwait
+  return
+
+100 continue
+!$omp atomic write
+  stat = st
+end subroutine dissect
+
+!> \brief Find a vertex separator of a graph.
+!>
+!> If the graph is disconnected, its components are divided between the two
+!> parts and the separator is empty. Otherwise, a level of the level
+!> structure rooted at a pseudo-peripheral vertex is chosen as separator,
+!> minimising its size relative to the product of the sizes of the parts,
+!> subject to a minimum balance. Separator vertices adjacent to only one part
+!> are then moved into that part. A complete graph cannot be split, and all
+!> its vertices are returned in the separator.
+!>
+!> \param g Graph to split.
+!> \param part On exit, part(i) is 1 or 2 if vertex i is in part A or B
+!>        respectively, or 0 if it is in the separator.
+!> \param st Stat parameter from allocation.
+subroutine bisect(g, part, st)
+  implicit none
+  type(nd_graph), intent(in) :: g
+  integer, dimension(g%n), intent(out) :: part
+  integer, intent(out) :: st
+
+  integer, dimension(:), allocatable :: level, queue, level2, cnt
+  integer :: m, i, k, v, root, nv, nlev, nlev2, sweep, sep, na, nb
+  integer :: ncomp, start, csize
+  integer(long) :: j
+  logical :: has_a, has_b
+  real :: cost, best_cost
+
+  m = g%n
+  allocate(level(m), queue(m), level2(m), stat=st)
+  if (st .ne. 0) return
+
+  ! Find connected components, listed one after another in queue
+  level(:) = -1
+  nv = 0
+  ncomp = 0
+  do v = 1, m
+     if (level(v) .ge. 0) cycle
+     ncomp = ncomp + 1
+     call bfs(g, v, level, queue(nv+1:), k)
+     nv = nv + k
+  end do
+  if (ncomp .gt. 1) then
+     ! Give complete components to A until it holds about half the vertices
+     part(:) = 2
+     na = 0
+     start = 1
+     do while (start .le. m)
+        csize = 1
+        do while (start+csize .le. m)
+           if (level(queue(start+csize)) .eq. 0) exit ! Next component root
+           csize = csize + 1
+        end do
+        if ((na .gt. 0) .and. (na+csize .gt. m/2)) exit
+        part(queue(start:start+csize-1)) = 1
+        na = na + csize
+        start = start + csize
+     end do
+     return
+  end if
+
+  ! Find pseudo-peripheral root, starting from a vertex of minimum degree
+  root = 1
+  do v = 2, m
+     if (g%ptr(v+1)-g%ptr(v) .lt. g%ptr(root+1)-g%ptr(root)) root = v
+  end do
+  level(:) = -1
+  call bfs(g, root, level, queue, nv)
+  nlev = level(queue(nv)) + 1
+  do sweep = 1, nd_max_sweeps
+     ! Try vertex of minimum degree in last level
+     root = queue(nv)
+     do k = nv-1, 1, -1
+        v = queue(k)
+        if (level(v) .ne. nlev-1) exit
+        if (g%ptr(v+1)-g%ptr(v) .lt. g%ptr(root+1)-g%ptr(root)) root = v
+     end do
+     level2(:) = -1
+     call bfs(g, root, level2, queue, nv)
+     nlev2 = level2(queue(nv)) + 1
+     if (nlev2 .le. nlev) exit ! No improvement (queue is no longer needed)
+     level(:) = level2(:)
+     nlev = nlev2
+  end do
+
+  if (nlev .lt. 3) then
+     ! Root is adjacent to all others, and has minimum degree: graph complete
+     part(:) = 0
+     return
+  end if
+
+  ! Choose separator level
+  allocate(cnt(0:nlev-1), stat=st)
+  if (st .ne. 0) return
+  cnt(:) = 0
+  do v = 1, m
+     cnt(level(v)) = cnt(level(v)) + 1
+  end do
+  sep = 0
+  best_cost = huge(best_cost)
+  na = cnt(0)
+  do i = 1, nlev-2
+     nb = m - na - cnt(i)
+     if (min(na, nb) .ge. nd_min_balance*m) then
+        cost = real(cnt(i)) / (real(na)*real(nb))
+        if (cost .lt. best_cost) then
+           sep = i
+           best_cost = cost
+        end if
+     end if
+     na = na + cnt(i)
+  end do
+  if (sep .eq. 0) then
+     ! No balanced level, use the level containing the median vertex
+     na = cnt(0)
+     do sep = 1, nlev-2
+        if (na + cnt(sep) .ge. m/2) exit
+        na = na + cnt(sep)
+     end do
+     sep = min(sep, nlev-2)
+  end if
+  do v = 1, m
+     if (level(v) .lt. sep) then
+        part(v) = 1
+     else if (level(v) .gt. sep) then
+        part(v) = 2
+     else
+        part(v) = 0
+     end if
+  end do
+
+  ! Thin separator: move vertices with no neighbours in B to A, then those
+  ! with no neighbours in A to B
+  do v = 1, m
+     if (part(v) .ne. 0) cycle
+     has_b = .false.
+     do j = g%ptr(v), g%ptr(v+1)-1
+        if (part(g%adj(j)) .eq. 2) then
+           has_b = .true.
+           exit
+        end if
+     end do
+     if (.not. has_b) part(v) = 1
+  end do
+  do v = 1, m
+     if (part(v) .ne. 0) cycle
+     has_a = .false.
+     do j = g%ptr(v), g%ptr(v+1)-1
+        if (part(g%adj(j)) .eq. 1) then
+           has_a = .true.
+           exit
+        end if
+     end do
+     if (.not. has_a) part(v) = 2
+  end do
+end subroutine bisect
+
+!> \brief Breadth first search.
+!>
+!> \param g Graph.
+!> \param root Vertex to start from.
+!> \param level On entry, level(i)<0 if vertex i is to be visited. On exit,
+!>        level(i) is the distance of visited vertex i from root.
+!> \param queue On exit, queue(1:nv) lists visited vertices in order of
+!>        increasing level.
+!> \param nv Number of vertices visited.
+subroutine bfs(g, root, level, queue, nv)
+  implicit none
+  type(nd_graph), intent(in) :: g
+  integer, intent(in) :: root
+  integer, dimension(g%n), intent(inout) :: level
+  integer, dimension(*), intent(out) :: queue
+  integer, intent(out) :: nv
+
+  integer :: head, u, v
+  integer(long) :: j
+
+  level(root) = 0
+  queue(1) = root
+  nv = 1
+  head = 1
+  do while (head .le. nv)
+     v = queue(head)
+     head = head + 1
+     do j = g%ptr(v), g%ptr(v+1)-1
+        u = g%adj(j)
+        if (level(u) .ge. 0) cycle
+        level(u) = level(v) + 1
+        nv = nv + 1
+        queue(nv) = u
+     end do
+  end do
+end subroutine bfs
+
+!> \brief Extract the subgraph induced by one part of a bisection.
+!>
+!> \param g Graph.
+!> \param part Part of each vertex of g.
+!> \param lmap Index of each vertex within its part.
+!> \param p Part to extract.
+!> \param np Number of vertices in part p.
+!> \param gp On exit, the subgraph.
+!> \param st Stat parameter from allocation.
+subroutine extract_part(g, part, lmap, p, np, gp, st)
+  implicit none
+  type(nd_graph), intent(in) :: g
+  integer, dimension(g%n), intent(in) :: part
+  integer, dimension(g%n), intent(in) :: lmap
+  integer, intent(in) :: p
+  integer, intent(in) :: np
+  type(nd_graph), intent(out) :: gp
+  integer, intent(out) :: st
+
+  integer :: u, v
+  integer(long) :: j, ne
+
+  st = 0
+  gp%n = np
+  if (np .eq. 0) return
+
+  ne = 0
+  do v = 1, g%n
+     if (part(v) .ne. p) cycle
+     do j = g%ptr(v), g%ptr(v+1)-1
+        if (part(g%adj(j)) .eq. p) ne = ne + 1
+     end do
+  end do
+  allocate(gp%ptr(np+1), gp%adj(ne), gp%vmap(np), stat=st)
+  if (st .ne. 0) return
+  ne = 0
+  do v = 1, g%n
+     if (part(v) .ne. p) cycle
+     gp%ptr(lmap(v)) = ne + 1
+     gp%vmap(lmap(v)) = g%vmap(v)
+     do j = g%ptr(v), g%ptr(v+1)-1
+        u = g%adj(j)
+        if (part(u) .ne. p) cycle
+        ne = ne + 1
+        gp%adj(ne) = lmap(u)
+     end do
+  end do
+  gp%ptr(np+1) = ne + 1
+end subroutine extract_part
+
+!> \brief Order the vertices of a small graph by minimum degree.
+!>
+!> Elimination is simulated exactly using a dense adjacency matrix, with ties
+!> broken by lowest index.
+!>
+!> \param g Graph to order, with at most nd_leaf_size vertices.
+!> \param base First position in invp to use.
+!> \param invp Inverse of elimination order.
+!> \param st Stat parameter from allocation.
+subroutine leaf_order(g, base, invp, st)
+  implicit none
+  type(nd_graph), intent(in) :: g
+  integer, intent(in) :: base
+  integer, dimension(*), intent(inout) :: invp
+  integer, intent(out) :: st
+
+  logical, dimension(:,:), allocatable :: adjm
+  logical, dimension(:), allocatable :: done
+  integer, dimension(:), allocatable :: deg, nbr
+  integer :: m, i, k, l, p, a, b, nn
+  integer(long) :: j
+
+  m = g%n
+  allocate(adjm(m,m), done(m), deg(m), nbr(m), stat=st)
+  if (st .ne. 0) return
+
+  adjm(:,:) = .false.
+  do i = 1, m
+     do j = g%ptr(i), g%ptr(i+1)-1
+        adjm(g%adj(j), i) = .true.
+     end do
+  end do
+  do i = 1, m
+     deg(i) = count(adjm(:,i))
+  end do
+  done(:) = .false.
+
+  do k = 1, m
+     p = minloc(deg, dim=1, mask=.not.done)
+     done(p) = .true.
+     invp(base+k-1) = g%vmap(p)
+
+     ! Eliminate p: its remaining neighbours become a clique
+     nn = 0
+     do i = 1, m
+        if (done(i) .or. .not.adjm(i,p)) cycle
+        nn = nn + 1
+        nbr(nn) = i
+     end do
+     do i = 1, nn
+        a = nbr(i)
+        deg(a) = deg(a) - 1 ! Loses p
+        do l = 1, nn
+           b = nbr(l)
+           if ((b .eq. a) .or. adjm(b,a)) cycle
+           adjm(b,a) = .true.
+           deg(a) = deg(a) + 1
+        end do
+     end do
+  end do
+end subroutine leaf_order
+
+end module spral_nd_order
@@ -72,6 +72,13 @@ module spral_ssids_akeep
 
       ! Machine topology
       type(numa_region), dimension(:), allocatable :: topology
+      ! Teams of regions for hierarchical execution. Team t is made up of
+      ! regions team_first(t):team_last(t) of topology and is nested within
+      ! team team_parent(t). Team 1 is made up of all regions (and has
+      ! team_parent(1)=0), and each team is numbered after its parent.
+      integer, dimension(:), allocatable :: team_first
+      integer, dimension(:), allocatable :: team_last
+      integer, dimension(:), allocatable :: team_parent
 
       ! Inform at end of analyse phase
       type(ssids_inform) :: inform
@@ -115,6 +122,9 @@ subroutine free_akeep(akeep, flag)
    deallocate(akeep%map, stat=st)
    deallocate(akeep%scaling, stat=st)
    deallocate(akeep%topology, stat=st)
+   deallocate(akeep%team_first, stat=st)
+   deallocate(akeep%team_last, stat=st)
+   deallocate(akeep%team_parent, stat=st)
 end subroutine free_akeep
 
 end module spral_ssids_akeep
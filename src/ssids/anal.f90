@@ -18,9 +18,32 @@ module spral_ssids_anal
 
   private
   public :: analyse_phase,   & ! Calls core analyse and builds data strucutres
+            analyse_cache_file, & ! Name of file caching results of analyse
+            load_analyse_cache, & ! Load results of analyse from cache
             check_order,     & ! Check order is a valid permutation
             expand_pattern,  & ! Specialised half->full matrix conversion
-            expand_matrix      ! Specialised half->full matrix conversion
+            expand_matrix,   & ! Specialised half->full matrix conversion
+            is_clean_lower     ! Check lower triangle needs no cleaning
+
+  ! Cache of analyse phase results
+  character(len=8), parameter :: CACHE_MAGIC = 'SSIDSAK1'
+  integer, parameter :: CACHE_VERSION = 2 ! Change if format or algorithms
+    ! affecting the results of analyse change
+  integer(long), parameter :: hash_mask = 4294967295_long ! 2**32-1
+  integer(long), parameter :: cache_hash_seed = 2166136261_long ! FNV offset
+  integer(long), dimension(2), parameter :: hash_prime = &
+       (/ 16777619_long, 16777259_long /) ! Primes below 2**24
+
+  ! Minimum entries in lower triangle for expand_pattern() and expand_matrix()
+  ! to expand in parallel
+  integer(long), parameter :: par_expand_min_nz = 100000_long
+
+  interface write_cache_array
+     module procedure write_cache_array_int, write_cache_array_long
+  end interface write_cache_array
+  interface read_cache_array
+     module procedure read_cache_array_int, read_cache_array_long
+  end interface read_cache_array
 
 contains
 
@@ -34,7 +57,12 @@ contains
 ! need an extra copy of the lower triangle into the full structure before
 ! calling half_to_full
 !
-  subroutine expand_pattern(n,nz,ptr,row,aptr,arow)
+! If the lower triangle is clean (see is_clean_lower()), large matrices are
+! expanded in parallel by par_expand(), with the same result. The optional
+! argument clean may be used to state whether it is known to be clean, for
+! example as it was output by clean_cscl_oop(). Otherwise it is checked.
+!
+  subroutine expand_pattern(n,nz,ptr,row,aptr,arow,clean)
     implicit none
     integer, intent(in) :: n ! order of system
     integer(long), intent(in) :: nz
@@ -42,10 +70,16 @@ contains
     integer, intent(in) :: row(nz)
     integer(long), intent(out) :: aptr(n+1)
     integer, intent(out) :: arow(2*nz)
+    logical, optional, intent(in) :: clean
 
-    integer :: i,j
+    integer :: i,j,st
     integer(long) :: kk
 
+    if (expand_in_parallel(n, nz, ptr, row, clean)) then
+       call par_expand(n, nz, ptr, row, aptr, arow, st)
+       if (st .eq. 0) return
+    end if
+
     ! Set aptr(j) to hold no. nonzeros in column j
     aptr(:) = 0
     do j = 1, n
@@ -84,7 +118,7 @@ contains
 ! Given lower triangular part of A held in row, val and ptr, expand to
 ! upper and lower triangular parts.
 
-  subroutine expand_matrix(n,nz,ptr,row,val,aptr,arow,aval)
+  subroutine expand_matrix(n,nz,ptr,row,val,aptr,arow,aval,clean)
     implicit none
     integer, intent(in)   :: n ! order of system
     integer(long), intent(in)   :: nz
@@ -94,11 +128,17 @@ contains
     integer(long), intent(out)  :: aptr(n+1)
     integer, intent(out)  :: arow(2*nz)
     real(wp), intent(out) :: aval(2*nz)
+    logical, optional, intent(in) :: clean ! as for expand_pattern()
 
-    integer :: i,j
+    integer :: i,j,st
     integer(long) :: kk, ipos, jpos
     real(wp) :: atemp
 
+    if (expand_in_parallel(n, nz, ptr, row, clean)) then
+       call par_expand(n, nz, ptr, row, aptr, arow, st, val=val, aval=aval)
+       if (st .eq. 0) return
+    end if
+
     ! Set aptr(j) to hold no. nonzeros in column j
     aptr(:) = 0
     do j = 1, n
@@ -137,6 +177,230 @@ contains
     end do
   end subroutine expand_matrix
 
+!****************************************************************************
+!
+! Return .true. if the lower triangle of A held in ptr and row is clean, that
+! is as output by clean_cscl_oop(): ptr is valid and the row indices of each
+! column are in range and strictly increasing (so there are no duplicates).
+! On exit, ndiag holds the number of diagonal entries.
+!
+  logical function is_clean_lower(n, ptr, row, ndiag)
+    implicit none
+    integer, intent(in) :: n ! order of system
+    integer(long), dimension(n+1), intent(in) :: ptr
+    integer, dimension(*), intent(in) :: row
+    integer, intent(out) :: ndiag
+
+    integer :: j, last
+    integer(long) :: kk
+    logical :: clean
+
+    ndiag = 0
+    is_clean_lower = (ptr(1) .eq. 1)
+    do j = 1, n
+       is_clean_lower = is_clean_lower .and. (ptr(j+1) .ge. ptr(j))
+    end do
+    if (.not. is_clean_lower) return
+
+    clean = .true.
+!$omp parallel do default(shared) private(kk, last) schedule(dynamic, 256) &
+!$omp    reduction(.and.:clean) reduction(+:ndiag) &
+!$omp    if(ptr(n+1) .gt. par_expand_min_nz)
+    do j = 1, n
+       last = j-1
+       do kk = ptr(j), ptr(j+1)-1
+          clean = clean .and. (row(kk) .gt. last)
+          last = row(kk)
+       end do
+       clean = clean .and. (last .le. n)
+       if (ptr(j+1) .gt. ptr(j)) then
+          if (row(ptr(j)) .eq. j) ndiag = ndiag + 1
+       end if
+    end do
+!$omp end parallel do
+    is_clean_lower = clean
+  end function is_clean_lower
+
+!****************************************************************************
+!
+! Return .true. if expand_pattern() or expand_matrix() should use
+! par_expand(): the matrix is large, more than one thread is available, and
+! the lower triangle is clean (unless clean is present, in which case it
+! states whether it is).
+!
+  logical function expand_in_parallel(n, nz, ptr, row, clean)
+    implicit none
+    integer, intent(in) :: n ! order of system
+    integer(long), intent(in) :: nz
+    integer(long), dimension(n+1), intent(in) :: ptr
+    integer, dimension(nz), intent(in) :: row
+    logical, optional, intent(in) :: clean
+
+    integer :: ndiag
+
+    expand_in_parallel = .false.
+    if (nz .lt. par_expand_min_nz) return
+!$  expand_in_parallel = (omp_get_max_threads() .gt. 1)
+    if (.not. expand_in_parallel) return
+    if (present(clean)) then
+       expand_in_parallel = clean
+    else
+       expand_in_parallel = is_clean_lower(n, ptr, row, ndiag)
+    end if
+  end function expand_in_parallel
+
+!****************************************************************************
+!
+! Expand clean lower triangular part of A (see is_clean_lower()) held in row,
+! ptr and optionally val to upper and lower triangular parts, in parallel.
+!
+! The result is identical to that of the serial loops in expand_pattern() and
+! expand_matrix(): each column j holds its own (lower triangle) entries, then
+! the transpose of row j of the lower triangle, all in decreasing order of
+! row index. The first pass counts the entries of each column, with the
+! transposed entries counted atomically. The second copies the lower triangle
+! entries in reverse and scatters the transposed ones, each to the next free
+! position of its column (taken atomically). Finally the transposed entries of
+! each column are sorted, and their values found by bisection in the sorted
+! column of the lower triangle they came from.
+!
+! On exit st is nonzero if workspace could not be allocated, in which case
+! the caller should expand serially instead.
+!
+  subroutine par_expand(n, nz, ptr, row, aptr, arow, st, val, aval)
+    implicit none
+    integer, intent(in) :: n ! order of system
+    integer(long), intent(in) :: nz
+    integer(long), dimension(n+1), intent(in) :: ptr
+    integer, dimension(nz), intent(in) :: row
+    integer(long), dimension(n+1), intent(out) :: aptr
+    integer, dimension(2*nz), intent(out) :: arow
+    integer, intent(out) :: st
+    real(wp), dimension(nz), optional, intent(in) :: val
+    real(wp), dimension(2*nz), optional, intent(out) :: aval
+
+    integer :: i, j
+    integer(long) :: kk, pos, lo, hi, mid
+    integer(long), dimension(:), allocatable :: next ! next(i) is next free
+      ! position for transposed entries of column i
+
+    allocate(next(n), stat=st)
+    if (st .ne. 0) return
+
+    ! First pass: count transposed entries of each column
+    next(:) = 0
+!$omp parallel default(shared) private(i, j, kk, pos, lo, hi, mid)
+!$omp do schedule(dynamic, 256)
+    do j = 1, n
+       do kk = ptr(j), ptr(j+1)-1
+          i = row(kk)
+          if (i .eq. j) cycle
+!$omp atomic update
+          next(i) = next(i) + 1
+!$omp end atomic
+       end do
+    end do
+!$omp end do
+
+    ! Columns start after the entries of earlier columns, and their
+    ! transposed entries after their lower triangle entries
+!$omp single
+    aptr(1) = 1
+    do j = 1, n
+       aptr(j+1) = aptr(j) + (ptr(j+1)-ptr(j)) + next(j)
+       next(j) = aptr(j) + (ptr(j+1)-ptr(j))
+    end do
+!$omp end single
+
+    ! Second pass: copy lower triangle entries and scatter transposed ones
+!$omp do schedule(dynamic, 256)
+    do j = 1, n
+       do kk = ptr(j), ptr(j+1)-1
+          i = row(kk)
+          pos = aptr(j) + (ptr(j+1)-1-kk)
+          arow(pos) = i
+          if (present(val)) aval(pos) = val(kk)
+          if (i .eq. j) cycle
+!$omp atomic capture
+          pos = next(i)
+          next(i) = next(i) + 1
+!$omp end atomic
+          arow(pos) = j
+       end do
+    end do
+!$omp end do
+
+    ! Order transposed entries and find their values
+!$omp do schedule(dynamic, 256)
+    do i = 1, n
+       pos = aptr(i) + (ptr(i+1)-ptr(i))
+       call sort_decreasing(int(aptr(i+1)-pos), arow(pos:aptr(i+1)-1))
+       if (.not. present(val)) cycle
+       do kk = pos, aptr(i+1)-1
+          j = arow(kk)
+          lo = ptr(j)
+          hi = ptr(j+1)-1
+          do while (lo .lt. hi)
+             mid = (lo+hi)/2
+             if (row(mid) .lt. i) then
+                lo = mid + 1
+             else
+                hi = mid
+             end if
+          end do
+          aval(kk) = val(lo)
+       end do
+    end do
+!$omp end do
+!$omp end parallel
+  end subroutine par_expand
+
+!****************************************************************************
+!
+! Sort the n distinct values in a into decreasing order (heapsort).
+!
+  subroutine sort_decreasing(n, a)
+    implicit none
+    integer, intent(in) :: n
+    integer, dimension(n), intent(inout) :: a
+
+    integer :: i, last, temp
+
+    ! Build a heap with the smallest value at its root
+    do i = n/2, 1, -1
+       call sift_down(i, n)
+    end do
+    ! Repeatedly move root to end of heap
+    do last = n, 2, -1
+       temp = a(1)
+       a(1) = a(last)
+       a(last) = temp
+       call sift_down(1, last-1)
+    end do
+
+  contains
+    subroutine sift_down(first, m)
+      integer, intent(in) :: first
+      integer, intent(in) :: m
+
+      integer :: parent, child, val
+
+      parent = first
+      val = a(parent)
+      do
+         child = 2*parent
+         if (child .gt. m) exit
+         if (child .lt. m) then
+            if (a(child+1) .lt. a(child)) child = child + 1
+         end if
+         if (a(child) .ge. val) exit
+         a(parent) = a(child)
+         parent = child
+      end do
+      a(parent) = val
+    end subroutine sift_down
+  end subroutine sort_decreasing
+
 !****************************************************************************
 !
 ! This routine requires the LOWER triangular part of A
@@ -203,16 +467,24 @@ contains
 !>        and GPUs.
 !>
 !> Start with a single tree, and proceed top down splitting the largest subtree
-!> (in terms of total flops)  until we have a sufficient number of independent
+!> (in terms of total cost)  until we have a sufficient number of independent
 !> subtrees. A sufficient number is such that subtrees can be assigned to NUMA
 !> regions and GPUs with a load balance no worse than max_load_inbalance.
 !> Load balance is calculated as the maximum value over all regions/GPUs of:
 !> \f[ \frac{ n x_i / \alpha_i } { \sum_j (x_j/\alpha_j) } \f]
 !> Where \f$ \alpha_i \f$ is the performance coefficient of region/GPU i,
-!> \f$ x_i \f$ is the number of flops assigned to region/GPU i and \f$ n \f$ is
-!> the total number of regions. \f$ \alpha_i \f$ should be proportional to the
-!> speed of the region/GPU (i.e. if GPU is twice as fast as CPU, set alpha for
-!> CPU to 1.0 and alpha for GPU to 2.0).
+!> \f$ x_i \f$ is the cost assigned to region/GPU i and \f$ n \f$ is
+!> the total number of regions.
+!>
+!> The cost of a node is modelled in flop-equivalents as its flops, plus
+!> options%part_entry_cost for each entry of its contribution block (which
+!> must be zeroed, assembled into and assembled from, all at memory speed),
+!> plus options%part_node_cost for the fixed overheads of a node. Small nodes
+!> are thus not treated as free, so that regions finish at the same time.
+!> See fit_part_costs() for calibration of these values.
+!> \f$ \alpha_i \f$ should be proportional to the speed of the region/GPU
+!> (i.e. if GPU is twice as fast as CPU, set alpha for CPU to 1.0 and alpha
+!> for GPU to 2.0).
 !>
 !> If the original number of flops is greater than min_gpu_work and the
 !> performance coefficient of a GPU is greater than the combined coefficients
@@ -225,6 +497,12 @@ contains
 !> GPUs may only handle leaf subtrees, so the top nodes are assigned to the
 !> full set of CPUs.
 !>
+!> If there are no GPUs and the regions are grouped into teams at more than
+!> one level (see akeep%team_first), the tree is instead partitioned
+!> recursively by partition_teams(), so that the top nodes are assigned to
+!> progressively larger teams rather than directly to all CPUs. Such parts
+!> have exec_loc = -team (so -1 continues to denote all regions).
+!>
 !> Parts are returned as contigous ranges of nodes. Part i consists of nodes
 !> part(i):part(i+1)-1
 !>
@@ -234,6 +512,9 @@ contains
 !> @param sparent Supernode parent array. Supernode i has parent sparent(i).
 !> @param rptr Row pointers. Supernode i has rows rlist(rptr(i):rptr(i+1)-1).
 !> @param topology Machine topology to partition for.
+!> @param team_first First region of each team, see akeep%team_first.
+!> @param team_last Last region of each team.
+!> @param team_parent Parent of each team.
 !> @param min_gpu_work Minimum flops for a GPU execution to be worthwhile.
 !> @param max_load_inbalance Number greater than 1.0 representing maximum
 !>        permissible load inbalance.
@@ -247,7 +528,8 @@ contains
 !>        It should be run on the CPUs if
 !>        exec_loc(i) <= size(topology),
 !>        otherwise it should be run on GPU number
-!>        (exec_loc(i) - 1)/size(topology).
+!>        (exec_loc(i) - 1)/size(topology). If exec_loc(i) < 0, it should be
+!>        run by team -exec_loc(i).
 !> @param contrib_ptr Contribution pointer. Part i has contribution from
 !>        subtrees contrib_idx(contrib_ptr(i):contrib_ptr(i+1)-1).
 !> @param contrib_idx List of contributing subtrees, see contrib_ptr.
@@ -256,8 +538,8 @@ contains
 !> @param st Allocation status parameter. If non-zero an allocation error
 !>        occurred.
   subroutine find_subtree_partition(nnodes, sptr, sparent, rptr, options, &
-       topology, nparts, part, exec_loc, contrib_ptr, contrib_idx, &
-       contrib_dest, inform, st)
+       topology, team_first, team_last, team_parent, nparts, part, exec_loc, &
+       contrib_ptr, contrib_idx, contrib_dest, inform, st)
     implicit none
     integer, intent(in) :: nnodes
     integer, dimension(nnodes+1), intent(in) :: sptr
@@ -265,6 +547,9 @@ contains
     integer(long), dimension(nnodes+1), intent(in) :: rptr
     type(ssids_options), intent(in) :: options
     type(numa_region), dimension(:), intent(in) :: topology
+    integer, dimension(:), intent(in) :: team_first
+    integer, dimension(:), intent(in) :: team_last
+    integer, dimension(:), intent(in) :: team_parent
     integer, intent(out) :: nparts
     integer, dimension(:), allocatable, intent(inout) :: part
     integer, dimension(:), allocatable, intent(out) :: exec_loc
@@ -277,47 +562,34 @@ contains
     integer :: i, j, k
     integer(long) :: jj
     integer :: m, n, node
-    integer(long), dimension(:), allocatable :: flops
-    integer, dimension(:), allocatable :: size_order
+    integer(long), dimension(:), allocatable :: flops, cost
+    integer, dimension(:), allocatable :: size_order, node_team
     logical, dimension(:), allocatable :: is_child
     real :: load_balance, best_load_balance
-    integer :: nregion, ngpu
+    integer :: nregion, ngpu, t
     logical :: has_parent
 
-    ! Count flops below each node
-    allocate(flops(nnodes+1), stat=st)
+    ! Count flops and cost below each node
+    allocate(flops(nnodes+1), cost(nnodes+1), stat=st)
     if (st .ne. 0) return
     flops(:) = 0
+    cost(:) = 0
     do node = 1, nnodes
        m = int(rptr(node+1)-rptr(node))
        n = sptr(node+1)-sptr(node)
        do jj = m-n+1, m
           flops(node) = flops(node) + jj**2
        end do
+       cost(node) = cost(node) + flops(node) + &
+            nint(options%part_entry_cost * real(m-n)**2, long) + &
+            nint(options%part_node_cost, long)
        j = sparent(node)
        flops(j) = flops(j) + flops(node)
+       cost(j) = cost(j) + cost(node)
        !print *, "Node ", node, "parent", j, " flops ", flops(node)
     end do
     !print *, "Total flops ", flops(nnodes+1)
 
-    ! Initialize partition to be all children of virtual root
-    allocate(part(nnodes+1), size_order(nnodes), exec_loc(nnodes), &
-         is_child(nnodes), stat=st)
-    if (st .ne. 0) return
-    nparts = 0
-    part(1) = 1
-    do i = 1, nnodes
-       if (sparent(i) .gt. nnodes) then
-          nparts = nparts + 1
-          part(nparts+1) = i+1
-          is_child(nparts) = .true. ! All subtrees are intially child subtrees
-       end if
-    end do
-    call create_size_order(nparts, part, flops, size_order)
-    !print *, "Initial partition has ", nparts, " parts"
-    !print *, "part = ", part(1:nparts+1)
-    !print *, "size_order = ", size_order(1:nparts)
-
     ! Calculate number of regions/gpus
     nregion = size(topology)
     ngpu = 0
@@ -326,44 +598,93 @@ contains
     end do
     !print *, "running on ", nregion, " regions and ", ngpu, " gpus"
 
-    ! Keep splitting until we meet balance criterion
-    best_load_balance = huge(best_load_balance)
-    do i = 1, 2*(nregion+ngpu)
-       ! Check load balance criterion
-       load_balance = calc_exec_alloc(nparts, part, size_order, is_child,  &
-            flops, topology, options%min_gpu_work, options%gpu_perf_coeff, &
-            exec_loc, st)
+    allocate(part(nnodes+1), size_order(nnodes), exec_loc(nnodes), &
+         is_child(nnodes), stat=st)
+    if (st .ne. 0) return
+
+    if ((ngpu .eq. 0) .and. (size(team_first) .gt. nregion+1)) then
+       ! Hierarchy of teams: assign each node to a team, and take parts to be
+       ! runs of nodes of the same team, ending at each node whose parent
+       ! belongs to a different team
+       allocate(node_team(nnodes), stat=st)
        if (st .ne. 0) return
-       best_load_balance = min(load_balance, best_load_balance)
-       if (load_balance .lt. options%max_load_inbalance) exit ! allocation is good
-       ! Split tree further
-       call split_tree(nparts, part, size_order, is_child, sparent, flops, &
-            ngpu, options%min_gpu_work, st)
+       call partition_teams(nnodes, sparent, cost, topology, team_first, &
+            team_last, team_parent, options%max_load_inbalance, node_team, st)
        if (st .ne. 0) return
-    end do
+       nparts = 0
+       part(1) = 1
+       do node = 1, nnodes
+          t = node_team(node)
+          if (node .lt. nnodes) then
+             j = sparent(node)
+             if (j .le. nnodes) then
+                if ((node_team(j) .eq. t) .and. (node_team(node+1) .eq. t)) &
+                     cycle
+             end if
+          end if
+          nparts = nparts + 1
+          part(nparts+1) = node+1
+          if (any(team_parent(:) .eq. t)) then
+             exec_loc(nparts) = -t
+          else
+             exec_loc(nparts) = team_first(t)
+          end if
+       end do
+    else
+       ! Initialize partition to be all children of virtual root
+       nparts = 0
+       part(1) = 1
+       do i = 1, nnodes
+          if (sparent(i) .gt. nnodes) then
+             nparts = nparts + 1
+             part(nparts+1) = i+1
+             is_child(nparts) = .true. ! All subtrees are intially child subtrees
+          end if
+       end do
+       call create_size_order(nparts, part, cost, size_order)
+       !print *, "Initial partition has ", nparts, " parts"
+       !print *, "part = ", part(1:nparts+1)
+       !print *, "size_order = ", size_order(1:nparts)
+
+       ! Keep splitting until we meet balance criterion
+       best_load_balance = huge(best_load_balance)
+       do i = 1, 2*(nregion+ngpu)
+          ! Check load balance criterion
+          load_balance = calc_exec_alloc(nparts, part, size_order, is_child,  &
+               flops, cost, topology, options%min_gpu_work, &
+               options%gpu_perf_coeff, exec_loc, st)
+          if (st .ne. 0) return
+          best_load_balance = min(load_balance, best_load_balance)
+          if (load_balance .lt. options%max_load_inbalance) exit ! allocation is good
+          ! Split tree further
+          call split_tree(nparts, part, size_order, is_child, sparent, flops, &
+               cost, ngpu, options%min_gpu_work, st)
+          if (st .ne. 0) return
+       end do
 
-    ! Consolidate adjacent non-children nodes into same part and regen exec_alloc
-    !print *
-    !print *, "pre merge", part(1:nparts+1)
-    !print *, "exec_loc ", exec_loc(1:nparts)
-    j = 1
-    do i = 2, nparts
-       part(j+1) = part(i)
-       if (is_child(i) .or. is_child(j)) then
-          ! We can't merge j and i
-          j = j + 1
-          is_child(j) = is_child(i)
-       end if
-    end do
-    part(j+1) = part(nparts+1)
-    nparts = j
-    !print *, "post merge", part(1:nparts+1)
-    call create_size_order(nparts, part, flops, size_order)
-    load_balance = calc_exec_alloc(nparts, part, size_order, is_child,  &
-         flops, topology, options%min_gpu_work, options%gpu_perf_coeff, &
-         exec_loc, st)
-    if (st .ne. 0) return
-    !print *, "exec_loc ", exec_loc(1:nparts)
+       ! Consolidate adjacent non-children nodes into same part and regen exec_alloc
+       !print *
+       !print *, "pre merge", part(1:nparts+1)
+       !print *, "exec_loc ", exec_loc(1:nparts)
+       j = 1
+       do i = 2, nparts
+          part(j+1) = part(i)
+          if (is_child(i) .or. is_child(j)) then
+             ! We can't merge j and i
+             j = j + 1
+             is_child(j) = is_child(i)
+          end if
+       end do
+       part(j+1) = part(nparts+1)
+       nparts = j
+       !print *, "post merge", part(1:nparts+1)
+       call create_size_order(nparts, part, cost, size_order)
+       load_balance = calc_exec_alloc(nparts, part, size_order, is_child,  &
+            flops, cost, topology, options%min_gpu_work, &
+            options%gpu_perf_coeff, exec_loc, st)
+       if (st .ne. 0) return
+       !print *, "exec_loc ", exec_loc(1:nparts)
+    end if
 
     ! Merge adjacent subtrees that are executing on the same node so long as
     ! there is no more than one contribution to a parent subtree
@@ -440,7 +761,7 @@ contains
 !> as
 !> \f[ \frac{\max_i( n x_i / \alpha_i )} { \sum_j (x_j/\alpha_j) } \f]
 !> Where \f$ \alpha_i \f$ is the performance coefficient of region/GPU i,
-!> \f$ x_i \f$ is the number of flops assigned to region/GPU i and \f$ n \f$ is
+!> \f$ x_i \f$ is the cost assigned to region/GPU i and \f$ n \f$ is
 !> the total number of regions. \f$ \alpha_i \f$ should be proportional to the
 !> speed of the region/GPU (i.e. if GPU is twice as fast as CPU, set alpha for
 !> CPU to 1.0 and alpha for GPU to 2.0).
@@ -453,11 +774,13 @@ contains
 !> @param nparts Number of parts.
 !> @param parts List of part ranges. Part i consists of supernodes
 !>        part(i):part(i+1)-1.
-!> @param size_order Lists parts in decreasing order of flops.
+!> @param size_order Lists parts in decreasing order of cost.
 !>        i.e. size_order(1) is the largest part.
 !> @param is_child True if subtree is a child subtree (has no contributions
 !>        from other subtrees).
 !> @param flops Number of floating points in subtree rooted at each node.
+!> @param cost Cost of subtree rooted at each node, see
+!>        find_subtree_partition().
 !> @param topology Machine topology to allocate execution for.
 !> @param min_gpu_work Minimum work before allocation to GPU is useful.
 !> @param gpu_perf_coeff The value of \f$ \alpha_i \f$ used for all GPUs,
@@ -475,13 +798,14 @@ contains
 ! FIXME: Consider case when gpu_perf_coeff > 2.0 ???
 !        (Round robin may not be correct thing)
   real function calc_exec_alloc(nparts, part, size_order, is_child, flops, &
-       topology, min_gpu_work, gpu_perf_coeff, exec_loc, st)
+       cost, topology, min_gpu_work, gpu_perf_coeff, exec_loc, st)
     implicit none
     integer, intent(in) :: nparts
     integer, dimension(nparts+1), intent(in) :: part
     integer, dimension(nparts), intent(in) :: size_order
     logical, dimension(nparts), intent(in) :: is_child
     integer(long), dimension(*), intent(in) :: flops
+    integer(long), dimension(*), intent(in) :: cost
     type(numa_region), dimension(:), intent(in) :: topology
     integer(long), intent(in) :: min_gpu_work
     real, intent(in) :: gpu_perf_coeff
@@ -489,7 +813,7 @@ contains
     integer, intent(out) :: st
 
     integer :: i, p, nregion, ngpu, max_gpu, next
-    integer(long) :: pflops
+    integer(long) :: pflops, pcost
     integer, dimension(:), allocatable :: map ! List resources in order of
       ! decreasing power
     real, dimension(:), allocatable :: load_balance
@@ -573,16 +897,16 @@ contains
     ! Sum total 
     do p = 1, nparts
        if (exec_loc(p) .eq. -1) cycle ! not a child subtree
-       pflops = flops(part(p+1)-1)
+       pcost = cost(part(p+1)-1)
        if (exec_loc(p) .gt. nregion) then
           ! GPU
           load_balance(exec_loc(p)) = load_balance(exec_loc(p)) + &
-               real(pflops) / gpu_perf_coeff
-          total_balance = total_balance + real(pflops) / gpu_perf_coeff
+               real(pcost) / gpu_perf_coeff
+          total_balance = total_balance + real(pcost) / gpu_perf_coeff
        else
           ! CPU
-          load_balance(exec_loc(p)) = load_balance(exec_loc(p)) + real(pflops)
-          total_balance = total_balance + real(pflops)
+          load_balance(exec_loc(p)) = load_balance(exec_loc(p)) + real(pcost)
+          total_balance = total_balance + real(pcost)
        end if
     end do
     ! Calculate n * max(x_i/a_i) / sum(x_j/a_j)
@@ -600,19 +924,21 @@ contains
 !>
 !> @param nparts Number of parts: normally increased by one on return.
 !> @param part Part i consists of nodes part(i):part(i+1).
-!> @param size_order Lists parts in decreasing order of flops.
+!> @param size_order Lists parts in decreasing order of cost.
 !>        i.e. size_order(1) is the largest part.
 !> @param is_child True if subtree is a child subtree (has no contributions
 !>        from other subtrees).
 !> @param sparent Supernode parent array. Supernode i has parent sparent(i).
 !> @param flops Number of floating points in subtree rooted at each node.
+!> @param cost Cost of subtree rooted at each node, see
+!>        find_subtree_partition().
 !> @param ngpu Number of gpus.
 !> @param min_gpu_work Minimum worthwhile work to give to GPU.
 !> @param st Allocation status parameter. If non-zero an allocation error
 !>        occurred.
 !> @sa find_subtree_partition()
   subroutine split_tree(nparts, part, size_order, is_child, sparent, flops, &
-       ngpu, min_gpu_work, st)
+       cost, ngpu, min_gpu_work, st)
     implicit none
     integer, intent(inout) :: nparts
     integer, dimension(*), intent(inout) :: part
@@ -620,6 +946,7 @@ contains
     logical, dimension(*), intent(inout) :: is_child
     integer, dimension(*), intent(in) :: sparent
     integer(long), dimension(*), intent(in) :: flops
+    integer(long), dimension(*), intent(in) :: cost
     integer, intent(in) :: ngpu
     integer(long), intent(in) :: min_gpu_work
     integer, intent(out) :: st
@@ -687,7 +1014,7 @@ contains
     nparts = old_nparts + nchild
 
     ! Finally, recreate size_order array
-    call create_size_order(nparts, part, flops, size_order)
+    call create_size_order(nparts, part, cost, size_order)
   end subroutine split_tree
 
 !!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!
@@ -697,30 +1024,188 @@ contains
 !>
 !> @param nparts Number of parts: normally increased by one on return.
 !> @param part Part i consists of nodes part(i):part(i+1).
-!> @param flops Number of floating points in subtree rooted at each node.
-!> @param size_order Lists parts in decreasing order of flops.
+!> @param cost Cost of subtree rooted at each node.
+!> @param size_order Lists parts in decreasing order of cost.
 !>        i.e. size_order(1) is the largest part.
-  subroutine create_size_order(nparts, part, flops, size_order)
+  subroutine create_size_order(nparts, part, cost, size_order)
     implicit none
     integer, intent(in) :: nparts
     integer, dimension(nparts+1), intent(in) :: part
-    integer(long), dimension(*), intent(in) :: flops
+    integer(long), dimension(*), intent(in) :: cost
     integer, dimension(nparts), intent(out) :: size_order
 
     integer :: i, j
-    integer(long) :: iflops
+    integer(long) :: icost
 
     do i = 1, nparts
        ! We assume parts 1:i-1 are in order and aim to insert part i
-       iflops = flops(part(i+1)-1)
+       icost = cost(part(i+1)-1)
        do j = 1, i-1
-          if (iflops .gt. flops(part(j+1)-1)) exit ! node i belongs in posn j
+          if (icost .gt. cost(part(j+1)-1)) exit ! node i belongs in posn j
        end do
        size_order(j+1:i) = size_order(j:i-1)
        size_order(j) = i
     end do
   end subroutine create_size_order
 
+!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!
+!> @brief Assign the nodes of an assembly tree to a hierarchy of teams of
+!>        regions (see akeep%team_first).
+!>
+!> The roots of the tree belong to team 1. Working down the hierarchy, the
+!> subtrees belonging to each team are allocated greedily, largest first, to
+!> its child teams in proportion to their number of processors. Whilst the
+!> resulting load balance (as for calc_exec_alloc()) is not better than
+!> max_load_inbalance, the largest subtree is split: its root is assigned to
+!> the team itself and its children replace it. As in
+!> find_subtree_partition(), at most 2 * (number of child teams) splits are
+!> made. Subtrees belonging to a team with no children are assigned to it
+!> whole.
+!>
+!> Thus the top of the tree is factorized by progressively larger teams,
+!> rather than jumping from a single region to all regions.
+!>
+!> @param nnodes Total number of nodes
+!> @param sparent Supernode parent array. Supernode i has parent sparent(i).
+!> @param cost Cost of subtree rooted at each node, see
+!>        find_subtree_partition().
+!> @param topology Machine topology.
+!> @param team_first First region of each team.
+!> @param team_last Last region of each team.
+!> @param team_parent Parent of each team.
+!> @param max_load_inbalance Number greater than 1.0 representing maximum
+!>        permissible load inbalance.
+!> @param node_team On exit, team to which each node is assigned.
+!> @param st Allocation status parameter. If non-zero an allocation error
+!>        occurred.
+  subroutine partition_teams(nnodes, sparent, cost, topology, team_first, &
+       team_last, team_parent, max_load_inbalance, node_team, st)
+    implicit none
+    integer, intent(in) :: nnodes
+    integer, dimension(nnodes), intent(in) :: sparent
+    integer(long), dimension(nnodes+1), intent(in) :: cost
+    type(numa_region), dimension(:), intent(in) :: topology
+    integer, dimension(:), intent(in) :: team_first
+    integer, dimension(:), intent(in) :: team_last
+    integer, dimension(:), intent(in) :: team_parent
+    real, intent(in) :: max_load_inbalance
+    integer, dimension(nnodes), intent(out) :: node_team
+    integer, intent(out) :: st
+
+    integer :: i, j, k, node, nchild, nroot, nsplit, t
+    integer(long) :: icost
+    integer, dimension(:), allocatable :: cptr, clist, root, owner, head, &
+         next, child
+    real(wp), dimension(:), allocatable :: weight, load
+
+    allocate(cptr(nnodes+2), clist(nnodes), root(nnodes), owner(nnodes), &
+         head(size(team_first)), next(nnodes), child(size(team_first)), &
+         weight(size(team_first)), load(size(team_first)), stat=st)
+    if (st .ne. 0) return
+
+    ! Build lists of children: node i has children clist(cptr(i):cptr(i+1)-1),
+    ! with i = nnodes+1 for the virtual root
+    cptr(:) = 0
+    do node = 1, nnodes
+       j = sparent(node)
+       cptr(j+1) = cptr(j+1) + 1
+    end do
+    cptr(1) = 1
+    do i = 1, nnodes+1
+       cptr(i+1) = cptr(i) + cptr(i+1)
+    end do
+    do node = 1, nnodes
+       j = sparent(node)
+       clist(cptr(j)) = node
+       cptr(j) = cptr(j) + 1
+    end do
+    do i = nnodes+1, 2, -1
+       cptr(i) = cptr(i-1)
+    end do
+    cptr(1) = 1
+
+    ! Subtrees belonging to team t are linked from head(t) through next(:)
+    head(:) = 0
+    do i = cptr(nnodes+1), cptr(nnodes+2)-1
+       next(clist(i)) = head(1)
+       head(1) = clist(i)
+    end do
+
+    node_team(:) = 0
+    do t = 1, size(team_first) ! NB: teams are numbered after their parents
+       nroot = 0
+       node = head(t)
+       do while (node .ne. 0)
+          nroot = nroot + 1
+          root(nroot) = node
+          node = next(node)
+       end do
+       nchild = 0
+       do k = t+1, size(team_first)
+          if (team_parent(k) .ne. t) cycle
+          nchild = nchild + 1
+          child(nchild) = k
+          weight(nchild) = real(max(1, &
+               sum(topology(team_first(k):team_last(k))%nproc)), wp)
+       end do
+       if (nchild .eq. 0) then
+          node_team(root(1:nroot)) = t
+          cycle
+       end if
+
+       do nsplit = 0, 2*nchild
+          ! Sort subtrees in order of decreasing cost
+          do i = 2, nroot
+             node = root(i)
+             icost = cost(node)
+             do j = i-1, 1, -1
+                if (cost(root(j)) .ge. icost) exit
+                root(j+1) = root(j)
+             end do
+             root(j+1) = node
+          end do
+          ! Allocate each to child team that leaves least load per processor
+          load(1:nchild) = 0
+          do i = 1, nroot
+             k = minloc((load(1:nchild) + real(cost(root(i)), wp)) / &
+                  weight(1:nchild), 1)
+             owner(i) = k
+             load(k) = load(k) + real(cost(root(i)), wp)
+          end do
+          if (sum(load(1:nchild)) .le. 0) exit
+          if (maxval(load(1:nchild) / weight(1:nchild)) * &
+               sum(weight(1:nchild)) / sum(load(1:nchild)) .lt. &
+               max_load_inbalance) exit ! allocation is good
+          if (nsplit .eq. 2*nchild) exit
+          ! Split largest subtree that has children
+          do i = 1, nroot
+             if (cptr(root(i)+1) .gt. cptr(root(i))) exit
+          end do
+          if (i .gt. nroot) exit ! Nothing left to split
+          node = root(i)
+          node_team(node) = t
+          root(i:nroot-1) = root(i+1:nroot)
+          nroot = nroot - 1
+          do j = cptr(node), cptr(node+1)-1
+             nroot = nroot + 1
+             root(nroot) = clist(j)
+          end do
+       end do
+
+       ! Pass subtrees on to their child teams
+       do i = 1, nroot
+          k = child(owner(i))
+          next(root(i)) = head(k)
+          head(k) = root(i)
+       end do
+    end do
+
+    ! Remaining nodes belong to the same team as their parent
+    do node = nnodes, 1, -1
+       if (node_team(node) .eq. 0) node_team(node) = node_team(sparent(node))
+    end do
+  end subroutine partition_teams
+
 !****************************************************************************
 
 !
@@ -732,7 +1217,7 @@ contains
 ! input to factorization.
 !
   subroutine analyse_phase(n, ptr, row, ptr2, row2, order, invp, &
-       akeep, options, inform)
+       akeep, options, inform, cache_file, cache_order)
     implicit none
     integer, intent(in) :: n ! order of system
     integer(long), intent(in) :: ptr(n+1) ! col pointers (lower triangle) 
@@ -747,18 +1232,21 @@ contains
     type(ssids_akeep), intent(inout) :: akeep
     type(ssids_options), intent(in) :: options
     type(ssids_inform), intent(inout) :: inform
+    character(len=*), optional, intent(in) :: cache_file ! If present, file in
+      ! which to store results for load_analyse_cache()
+    integer, dimension(:), optional, intent(in) :: cache_order ! User
+      ! supplied order to be stored with results if options%ordering=0
 
     character(50)  :: context ! Procedure name (used when printing).
-    integer, dimension(:), allocatable :: contrib_dest, exec_loc, level
+    integer, dimension(:), allocatable :: contrib_dest, exec_loc
 
-    integer :: to_launch
-    integer :: numa_region, device, thread_num
     integer :: nemin, flag
-    integer :: blkm, blkn
     integer :: i, j
     integer :: nout, nout1 ! streams for errors and warnings
     integer(long) :: nz ! ptr(n+1)-1
     integer :: st
+    integer(long) :: t_start, t_stop, t_rate ! system_clock values
+    real(wp) :: times(4) ! times of phases of basic_analyse()
 
     context = 'ssids_analyse'
     nout = options%unit_error
@@ -772,9 +1260,23 @@ contains
     if (nemin .lt. 1) nemin = nemin_default
 
     ! Perform basic analysis so we can figure out subtrees we want to construct
-    call basic_analyse(n, ptr2, row2, order, akeep%nnodes, akeep%sptr, &
-         akeep%sparent, akeep%rptr,akeep%rlist,                        &
-         nemin, flag, inform%stat, inform%num_factor, inform%num_flops)
+    if (options%amalgamation .eq. AMALGAMATION_COST) then
+       call basic_analyse(n, ptr2, row2, order, akeep%nnodes, akeep%sptr, &
+            akeep%sparent, akeep%rptr, akeep%rlist, nemin, flag, inform%stat, &
+            inform%num_factor, inform%num_flops, times=times, &
+            node_cost=real(max(0.0, options%amalg_node_cost), wp), &
+            half_width=real(max(0.0, options%amalg_half_width), wp), &
+            maxcontrib=inform%maxcontrib)
+    else
+       call basic_analyse(n, ptr2, row2, order, akeep%nnodes, akeep%sptr, &
+            akeep%sparent, akeep%rptr,akeep%rlist,                        &
+            nemin, flag, inform%stat, inform%num_factor, inform%num_flops, &
+            times=times, maxcontrib=inform%maxcontrib)
+    end if
+    inform%time_etree = times(1)
+    inform%time_col_counts = times(2)
+    inform%time_supernodes = times(3)
+    inform%time_row_lists = times(4)
     select case(flag)
     case(0)
        ! Do nothing
@@ -801,12 +1303,16 @@ contains
     end do
 
     ! Build map from A to L in nptr, nlist
+    call system_clock(t_start, t_rate)
     nz = ptr(n+1) - 1
     allocate(akeep%nptr(n+1), akeep%nlist(2,nz), stat=st)
     if (st .ne. 0) go to 100
     call build_map(n, ptr, row, order, invp, akeep%nnodes, akeep%sptr, &
          akeep%rptr, akeep%rlist, akeep%nptr, akeep%nlist, st)
     if (st .ne. 0) go to 100
+    call system_clock(t_stop)
+    inform%time_map = real(t_stop-t_start, wp) / t_rate
+    t_start = t_stop
 
     ! Sort out subtrees
     !print *, "Input topology"
@@ -816,8 +1322,9 @@ contains
     !      print *, "---> gpus ", akeep%topology(i)%gpus
     !end do
     call find_subtree_partition(akeep%nnodes, akeep%sptr, akeep%sparent,           &
-         akeep%rptr, options, akeep%topology, akeep%nparts, akeep%part,            &
-         exec_loc, akeep%contrib_ptr, akeep%contrib_idx, contrib_dest, inform, st)
+         akeep%rptr, options, akeep%topology, akeep%team_first, akeep%team_last,   &
+         akeep%team_parent, akeep%nparts, akeep%part, exec_loc, akeep%contrib_ptr, &
+         akeep%contrib_idx, contrib_dest, inform, st)
     if (st .ne. 0) go to 100
     !print *, "invp = ", akeep%invp
     !print *, "sptr = ", akeep%sptr(1:akeep%nnodes+1)
@@ -831,6 +1338,54 @@ contains
     !print *, "contrib_dest = ", &
     !   contrib_dest(1:akeep%contrib_ptr(akeep%nparts+1)-1)
 
+    ! Store results for reuse (errors are ignored, as this is only an
+    ! optimisation)
+    if (present(cache_file)) &
+         call save_analyse_cache(cache_file, n, ptr, row, order, invp, &
+         (flag .eq. 1), akeep, exec_loc, contrib_dest, options, inform, &
+         user_order=cache_order)
+
+    call setup_subtrees(akeep, exec_loc, contrib_dest, options, inform, st)
+    if (st .ne. 0) go to 100
+    call system_clock(t_stop)
+    inform%time_subtrees = real(t_stop-t_start, wp) / t_rate
+
+    ! Store copy of inform data in akeep
+    akeep%inform = inform
+
+    return
+
+100 continue
+    inform%stat = st
+    if (inform%stat .ne. 0) then
+       inform%flag = SSIDS_ERROR_ALLOCATION
+    end if
+    return
+  end subroutine analyse_phase
+
+!****************************************************************************
+!
+! Construct the symbolic subtrees of akeep, given their execution locations
+! and the destinations of their contributions from find_subtree_partition(),
+! and determine the remaining analyse phase statistics.
+!
+  subroutine setup_subtrees(akeep, exec_loc, contrib_dest, options, inform, st)
+    implicit none
+    type(ssids_akeep), intent(inout) :: akeep
+    integer, dimension(:), intent(in) :: exec_loc
+    integer, dimension(:), intent(in) :: contrib_dest
+    type(ssids_options), intent(in) :: options
+    type(ssids_inform), intent(inout) :: inform
+    integer, intent(out) :: st
+
+    integer, dimension(:), allocatable :: level
+    integer :: to_launch
+    integer :: numa_region, device, thread_num
+    integer :: blkm, blkn
+    integer :: i
+
+    st = 0
+
     ! Construct symbolic subtrees
     allocate(akeep%subtree(akeep%nparts))
 
@@ -843,9 +1398,10 @@ contains
     numa_region = thread_num + 1
     do i = 1, akeep%nparts
        ! only initialize subtree if this is the correct region: note that
-       ! an "all region" subtree with location -1 is initialised by region 0
-       if (exec_loc(i) .eq. -1) then
-          if (numa_region .ne. 1) cycle
+       ! a subtree executed by team -exec_loc(i) (for example, the "all region"
+       ! team with location -1) is initialised by its first region
+       if (exec_loc(i) .lt. 0) then
+          if (numa_region .ne. akeep%team_first(-exec_loc(i))) cycle
           device = 0
        else if ((mod((exec_loc(i)-1), size(akeep%topology))+1) .ne. numa_region) then
           cycle
@@ -877,7 +1433,7 @@ contains
 
     ! Info
     allocate(level(akeep%nnodes+1), stat=st)
-    if (st .ne. 0) go to 100
+    if (st .ne. 0) return
     level(akeep%nnodes+1) = 0
     inform%maxfront = 0
     inform%maxdepth = 0
@@ -891,25 +1447,419 @@ contains
     deallocate(level, stat=st)
     inform%matrix_rank = akeep%sptr(akeep%nnodes+1)-1
     inform%num_sup = akeep%nnodes
+  end subroutine setup_subtrees
 
-    ! Store copy of inform data in akeep
-    akeep%inform = inform
+!****************************************************************************
+!
+! Return the name of the file in which analyse_phase() stores its results for
+! the given matrix pattern, pivot order (if options%ordering=0), options,
+! topology and teams of its regions (see akeep%team_first). The name is blank
+! if results are not to be cached.
+!
+! The file name is derived from a hash of all the above. As the hash may not be
+! unique, the pattern and order are also stored in the file and compared on
+! load.
+!
+  function analyse_cache_file(check, n, ptr, row, options, topology, &
+       team_first, team_last, team_parent, order) result(file)
+    implicit none
+    logical, intent(in) :: check
+    integer, intent(in) :: n
+    integer(long), dimension(n+1), intent(in) :: ptr
+    integer, dimension(ptr(n+1)-1), intent(in) :: row
+    type(ssids_options), intent(in) :: options
+    type(numa_region), dimension(:), intent(in) :: topology
+    integer, dimension(:), intent(in) :: team_first
+    integer, dimension(:), intent(in) :: team_last
+    integer, dimension(:), intent(in) :: team_parent
+    integer, dimension(:), optional, intent(in) :: order
+    character(len=:), allocatable :: file
+
+    integer :: i
+    integer(long), dimension(2) :: h
+    character(len=16) :: key
+
+    file = ''
+    if (len_trim(options%analyse_cache) .eq. 0) return
+    select case(options%ordering)
+    case(0)
+       if (.not. present(order)) return
+       if (size(order) .lt. n) return
+    case(1,3:5)
+       ! Ordering depends only on the pattern
+    case default
+       ! Ordering depends on values, so results cannot be reused
+       return
+    end select
 
-    return
+    ! Options affecting the results of analyse
+    h(:) = cache_hash_seed
+    call hash_int(h, (/ CACHE_VERSION, merge(1, 0, check), options%ordering, &
+         options%nemin, merge(1, 0, options%ignore_numa), &
+         merge(1, 0, options%ignore_cache), merge(1, 0, options%use_gpu), &
+         transfer(options%max_load_inbalance, 0), &
+         transfer(options%gpu_perf_coeff, 0), options%amalgamation, &
+         transfer(options%amalg_node_cost, 0), &
+         transfer(options%amalg_half_width, 0), &
+         transfer(options%part_node_cost, 0), &
+         transfer(options%part_entry_cost, 0) /))
+    call hash_long(h, (/ options%min_gpu_work, &
+         options%small_subtree_threshold /))
+
+    ! Topology
+    call hash_int(h, (/ size(topology) /))
+    do i = 1, size(topology)
+       call hash_int(h, (/ topology(i)%nproc /))
+       if (allocated(topology(i)%gpus)) call hash_int(h, topology(i)%gpus)
+       call hash_int(h, (/ -1 /)) ! Separator
+       if (allocated(topology(i)%cache_groups)) &
+            call hash_int(h, topology(i)%cache_groups)
+       call hash_int(h, (/ -1, topology(i)%socket /))
+    end do
+    call hash_int(h, (/ size(team_first) /))
+    call hash_int(h, team_first)
+    call hash_int(h, team_last)
+    call hash_int(h, team_parent)
+
+    ! Pattern and order
+    call hash_int(h, (/ n /))
+    call hash_long(h, ptr)
+    call hash_int(h, row)
+    if (options%ordering .eq. 0) call hash_int(h, abs(order(1:n)))
+
+    write(key, '(2z8.8)') h(1), h(2)
+    file = trim(options%analyse_cache) // '/ssids_' // key // '.akeep'
+  end function analyse_cache_file
+
+!****************************************************************************
+!
+! Store the results of analyse_phase() in file, to be reused by
+! load_analyse_cache(). The file is written with stream access, and its magic
+! number is written last, so that a partially written file is never loaded.
+! Any error simply results in the file not being (fully) written.
+!
+  subroutine save_analyse_cache(file, n, ptr, row, order, invp, singular, &
+       akeep, exec_loc, contrib_dest, options, inform, user_order)
+    implicit none
+    character(len=*), intent(in) :: file
+    integer, intent(in) :: n
+    integer(long), dimension(n+1), intent(in) :: ptr
+    integer, dimension(ptr(n+1)-1), intent(in) :: row
+    integer, dimension(n), intent(in) :: order ! final order
+    integer, dimension(n), intent(in) :: invp
+    logical, intent(in) :: singular ! true if matrix structurally singular
+    type(ssids_akeep), intent(in) :: akeep
+    integer, dimension(:), intent(in) :: exec_loc
+    integer, dimension(:), intent(in) :: contrib_dest
+    type(ssids_options), intent(in) :: options
+    type(ssids_inform), intent(in) :: inform
+    integer, dimension(:), optional, intent(in) :: user_order ! Stored if
+      ! options%ordering=0
+
+    integer :: unit, ios
+
+    if (len(file) .eq. 0) return
+    if ((options%ordering .eq. 0) .and. (.not. present(user_order))) return
+    open(newunit=unit, file=file, access='stream', form='unformatted', &
+         status='replace', action='write', iostat=ios)
+    if (ios .ne. 0) return
+
+    ! Header, pattern and user order (if any) to check on load
+    write(unit, iostat=ios) '        ', n, ptr(n+1)-1, ptr, row
+    if (ios .ne. 0) goto 100
+    if (options%ordering .eq. 0) then
+       write(unit, iostat=ios) 1, abs(user_order(1:n))
+    else
+       write(unit, iostat=ios) 0
+    end if
+    if (ios .ne. 0) goto 100
+
+    ! Results
+    write(unit, iostat=ios) merge(1, 0, singular), order, invp, akeep%nnodes, &
+         inform%num_factor, inform%num_flops, inform%maxcontrib, &
+         inform%cpu_flops, inform%gpu_flops, akeep%nparts
+    if (ios .ne. 0) goto 100
+    call write_cache_array(unit, akeep%sptr, ios)
+    if (ios .ne. 0) goto 100
+    call write_cache_array(unit, akeep%sparent, ios)
+    if (ios .ne. 0) goto 100
+    call write_cache_array(unit, akeep%rptr, ios)
+    if (ios .ne. 0) goto 100
+    call write_cache_array(unit, akeep%rlist, ios)
+    if (ios .ne. 0) goto 100
+    call write_cache_array(unit, akeep%nptr, ios)
+    if (ios .ne. 0) goto 100
+    write(unit, iostat=ios) akeep%nlist ! Size is 2 x nz
+    if (ios .ne. 0) goto 100
+    call write_cache_array(unit, akeep%part, ios)
+    if (ios .ne. 0) goto 100
+    call write_cache_array(unit, exec_loc, ios)
+    if (ios .ne. 0) goto 100
+    call write_cache_array(unit, akeep%contrib_ptr, ios)
+    if (ios .ne. 0) goto 100
+    call write_cache_array(unit, akeep%contrib_idx, ios)
+    if (ios .ne. 0) goto 100
+    call write_cache_array(unit, contrib_dest, ios)
+    if (ios .ne. 0) goto 100
+
+    ! Mark file as complete
+    write(unit, pos=1, iostat=ios) CACHE_MAGIC
 
 100 continue
-    inform%stat = st
-    if (inform%stat .ne. 0) then
-       inform%flag = SSIDS_ERROR_ALLOCATION
+    close(unit, iostat=ios)
+  end subroutine save_analyse_cache
+
+!****************************************************************************
+!
+! Load results stored by save_analyse_cache() into akeep, and set up its
+! subtrees, as if analyse_phase() had been called. The topology of akeep must
+! already be set. On exit, hit is true if results were loaded. Otherwise,
+! akeep is unchanged. A nonzero st indicates an allocation failure while
+! setting up the subtrees.
+!
+! The file is read sequentially with stream access, and only accepted if the
+! matrix pattern and user supplied order (if options%ordering=0) stored in it
+! are identical to those given.
+!
+  subroutine load_analyse_cache(file, n, ptr, row, order, akeep, options, &
+       inform, hit, st, user_order)
+    implicit none
+    character(len=*), intent(in) :: file
+    integer, intent(in) :: n
+    integer(long), dimension(n+1), intent(in) :: ptr
+    integer, dimension(ptr(n+1)-1), intent(in) :: row
+    integer, dimension(n), intent(out) :: order ! final order
+    type(ssids_akeep), intent(inout) :: akeep
+    type(ssids_options), intent(in) :: options
+    type(ssids_inform), intent(inout) :: inform
+    logical, intent(out) :: hit
+    integer, intent(out) :: st
+    integer, dimension(:), optional, intent(in) :: user_order ! Checked if
+      ! options%ordering=0
+
+    character(len=len(CACHE_MAGIC)) :: magic
+    integer :: unit, ios
+    integer :: cn, has_order, singular, nnodes, nparts
+    integer(long) :: cnz, num_factor, num_flops, maxcontrib, cpu_flops, &
+         gpu_flops
+    integer(long), dimension(:), allocatable :: cptr, rptr, nptr
+    integer(long), dimension(:,:), allocatable :: nlist
+    integer, dimension(:), allocatable :: crow, invp, sptr, sparent, rlist, &
+         part, exec_loc, contrib_ptr, contrib_idx, contrib_dest
+
+    hit = .false.
+    st = 0
+    if (len(file) .eq. 0) return
+    if ((options%ordering .eq. 0) .and. (.not. present(user_order))) return
+    open(newunit=unit, file=file, access='stream', form='unformatted', &
+         status='old', action='read', iostat=ios)
+    if (ios .ne. 0) return
+
+    ! Check header, pattern and user order
+    read(unit, iostat=ios) magic, cn, cnz
+    if (ios .ne. 0) goto 100
+    if ((magic .ne. CACHE_MAGIC) .or. (cn .ne. n) .or. &
+         (cnz .ne. ptr(n+1)-1)) goto 100
+    allocate(cptr(n+1), crow(cnz), stat=st)
+    if (st .ne. 0) goto 100
+    read(unit, iostat=ios) cptr, crow
+    if (ios .ne. 0) goto 100
+    if (any(cptr(:) .ne. ptr(:))) goto 100
+    if (any(crow(:) .ne. row(:))) goto 100
+    deallocate(cptr, crow)
+    read(unit, iostat=ios) has_order
+    if (ios .ne. 0) goto 100
+    if (has_order .ne. merge(1, 0, options%ordering .eq. 0)) goto 100
+    if (has_order .eq. 1) then
+       allocate(crow(n), stat=st)
+       if (st .ne. 0) goto 100
+       read(unit, iostat=ios) crow
+       if (ios .ne. 0) goto 100
+       if (any(crow(:) .ne. abs(user_order(1:n)))) goto 100
+       deallocate(crow)
     end if
+
+    ! Results
+    allocate(invp(n), stat=st)
+    if (st .ne. 0) goto 100
+    read(unit, iostat=ios) singular, order, invp, nnodes, num_factor, &
+         num_flops, maxcontrib, cpu_flops, gpu_flops, nparts
+    if (ios .ne. 0) goto 100
+    call read_cache_array(unit, sptr, ios)
+    if (ios .ne. 0) goto 100
+    call read_cache_array(unit, sparent, ios)
+    if (ios .ne. 0) goto 100
+    call read_cache_array(unit, rptr, ios)
+    if (ios .ne. 0) goto 100
+    call read_cache_array(unit, rlist, ios)
+    if (ios .ne. 0) goto 100
+    call read_cache_array(unit, nptr, ios)
+    if (ios .ne. 0) goto 100
+    allocate(nlist(2,cnz), stat=st)
+    if (st .ne. 0) goto 100
+    read(unit, iostat=ios) nlist
+    if (ios .ne. 0) goto 100
+    call read_cache_array(unit, part, ios)
+    if (ios .ne. 0) goto 100
+    call read_cache_array(unit, exec_loc, ios)
+    if (ios .ne. 0) goto 100
+    call read_cache_array(unit, contrib_ptr, ios)
+    if (ios .ne. 0) goto 100
+    call read_cache_array(unit, contrib_idx, ios)
+    if (ios .ne. 0) goto 100
+    call read_cache_array(unit, contrib_dest, ios)
+    if (ios .ne. 0) goto 100
+    close(unit, iostat=ios)
+
+    ! Success: transfer results to akeep
+    hit = .true.
+    akeep%invp(1:n) = invp(:)
+    akeep%nnodes = nnodes
+    call move_alloc(sptr, akeep%sptr)
+    call move_alloc(sparent, akeep%sparent)
+    call move_alloc(rptr, akeep%rptr)
+    call move_alloc(rlist, akeep%rlist)
+    call move_alloc(nptr, akeep%nptr)
+    call move_alloc(nlist, akeep%nlist)
+    akeep%nparts = nparts
+    call move_alloc(part, akeep%part)
+    call move_alloc(contrib_ptr, akeep%contrib_ptr)
+    call move_alloc(contrib_idx, akeep%contrib_idx)
+    if (singular .ne. 0) inform%flag = SSIDS_WARNING_ANAL_SINGULAR
+    inform%num_factor = num_factor
+    inform%num_flops = num_flops
+    inform%maxcontrib = maxcontrib
+    inform%cpu_flops = cpu_flops
+    inform%gpu_flops = gpu_flops
+    inform%nparts = nparts
+    inform%analyse_cache_hit = .true.
+
+    call setup_subtrees(akeep, exec_loc, contrib_dest, options, inform, st)
     return
-  end subroutine analyse_phase
+
+100 continue
+    st = 0 ! Failures are not errors, just a cache miss
+    close(unit, iostat=ios)
+  end subroutine load_analyse_cache
+
+!****************************************************************************
+!
+! Write integer array preceded by its size to a stream
+!
+  subroutine write_cache_array_int(unit, array, ios)
+    implicit none
+    integer, intent(in) :: unit
+    integer, dimension(:), intent(in) :: array
+    integer, intent(out) :: ios
+
+    write(unit, iostat=ios) size(array, kind=long), array
+  end subroutine write_cache_array_int
+
+!****************************************************************************
+!
+! Write integer(long) array preceded by its size to a stream
+!
+  subroutine write_cache_array_long(unit, array, ios)
+    implicit none
+    integer, intent(in) :: unit
+    integer(long), dimension(:), intent(in) :: array
+    integer, intent(out) :: ios
+
+    write(unit, iostat=ios) size(array, kind=long), array
+  end subroutine write_cache_array_long
+
+!****************************************************************************
+!
+! Read and allocate integer array written by write_cache_array_int()
+!
+  subroutine read_cache_array_int(unit, array, ios)
+    implicit none
+    integer, intent(in) :: unit
+    integer, dimension(:), allocatable, intent(out) :: array
+    integer, intent(out) :: ios
+
+    integer(long) :: sz
+
+    read(unit, iostat=ios) sz
+    if (ios .ne. 0) return
+    if (sz .lt. 0) ios = -1
+    if (ios .ne. 0) return
+    allocate(array(sz), stat=ios)
+    if (ios .ne. 0) return
+    read(unit, iostat=ios) array
+  end subroutine read_cache_array_int
+
+!****************************************************************************
+!
+! Read and allocate integer(long) array written by write_cache_array_long()
+!
+  subroutine read_cache_array_long(unit, array, ios)
+    implicit none
+    integer, intent(in) :: unit
+    integer(long), dimension(:), allocatable, intent(out) :: array
+    integer, intent(out) :: ios
+
+    integer(long) :: sz
+
+    read(unit, iostat=ios) sz
+    if (ios .ne. 0) return
+    if (sz .lt. 0) ios = -1
+    if (ios .ne. 0) return
+    allocate(array(sz), stat=ios)
+    if (ios .ne. 0) return
+    read(unit, iostat=ios) array
+  end subroutine read_cache_array_long
+
+!****************************************************************************
+!
+! Update the pair of 32-bit FNV-1a style hashes h with the values of array.
+! Arithmetic is performed on 64-bit integers such that it never overflows.
+!
+  subroutine hash_int(h, array)
+    implicit none
+    integer(long), dimension(2), intent(inout) :: h
+    integer, dimension(:), intent(in) :: array
+
+    integer(long) :: i
+    integer(long) :: x
+
+    do i = 1, size(array, kind=long)
+       x = iand(int(array(i), long), hash_mask)
+       h(1) = iand(ieor(h(1), x) * hash_prime(1), hash_mask)
+       h(2) = iand(ieor(h(2), x) * hash_prime(2), hash_mask)
+    end do
+  end subroutine hash_int
+
+!****************************************************************************
+!
+! As hash_int(), but for integer(long) values, hashing each half separately.
+!
+  subroutine hash_long(h, array)
+    implicit none
+    integer(long), dimension(2), intent(inout) :: h
+    integer(long), dimension(:), intent(in) :: array
+
+    integer(long) :: i
+    integer(long) :: x
+
+    do i = 1, size(array, kind=long)
+       x = iand(array(i), hash_mask)
+       h(1) = iand(ieor(h(1), x) * hash_prime(1), hash_mask)
+       h(2) = iand(ieor(h(2), x) * hash_prime(2), hash_mask)
+       x = iand(ishft(array(i), -32), hash_mask)
+       h(1) = iand(ieor(h(1), x) * hash_prime(1), hash_mask)
+       h(2) = iand(ieor(h(2), x) * hash_prime(2), hash_mask)
+    end do
+  end subroutine hash_long
 
 !****************************************************************************
 !
 ! Build a map from A to nodes
 ! lcol( nlist(2,i) ) = val( nlist(1,i) )
 ! nptr defines start of each node in nlist
+!
+! Once the transpose of A is built, the entries of each node are counted and
+! then found in parallel, each thread using its own map of row indices.
 !
   subroutine build_map(n, ptr, row, perm, invp, nnodes, sptr, rptr, rlist, &
        nptr, nlist, st)
@@ -943,7 +1893,7 @@ contains
     integer(long), dimension(:), allocatable :: origin
     integer, dimension(:), allocatable :: map
 
-    allocate(map(n), ptr2(n+3), row2(ptr(n+1)-1), origin(ptr(n+1)-1), stat=st)
+    allocate(ptr2(n+3), row2(ptr(n+1)-1), origin(ptr(n+1)-1), stat=st)
     if (st .ne. 0) return
 
     !
@@ -975,13 +1925,41 @@ contains
        end do
     end do
 
+    !
+    ! Count entries of each node in nptr(node+1), then find starts
+    !
+!$omp parallel do default(shared) private(i, ii, j, col, pp) &
+!$omp    schedule(dynamic,64)
+    do node = 1, nnodes
+       pp = 0
+       do j = sptr(node), sptr(node+1)-1
+          col = invp(j)
+          do i = ptr2(col), ptr2(col+1)-1
+             if (abs(perm(row2(i))) .ge. j) pp = pp + 1
+          end do
+          do ii = ptr(col), ptr(col+1)-1
+             if (abs(perm(row(ii))) .ge. j) pp = pp + 1
+          end do
+       end do
+       nptr(node+1) = pp
+    end do
+!$omp end parallel do
+    nptr(1) = 1
+    do node = 1, nnodes
+       nptr(node+1) = nptr(node) + nptr(node+1)
+    end do
+
     !
     ! Build nptr, nlist map
     !
-    pp = 1
+!$omp parallel default(shared) private(i, ii, j, jj, k, pp, blkm, col, map) &
+!$omp    reduction(max:st)
+    allocate(map(n), stat=st)
+!$omp do schedule(dynamic,64)
     do node = 1, nnodes
+       if (st .ne. 0) cycle
        blkm = int(rptr(node+1) - rptr(node))
-       nptr(node) = pp
+       pp = nptr(node)
 
        ! Build map for node indices
        do jj = rptr(node), rptr(node+1)-1
@@ -1012,6 +1990,7 @@ contains
           end do
        end do
     end do
-    nptr(nnodes+1) = pp
+!$omp end do
+!$omp end parallel
   end subroutine build_map
 end module spral_ssids_anal
@@ -17,7 +17,6 @@ module spral_ssids_contrib
   ! but alas Fortran/C interop causes severe problems, so we just have the
   ! owner value instead and if statements to call the right thing).
   type :: contrib_type
-     logical :: ready = .false.
      integer :: n ! size of block
      real(C_DOUBLE), dimension(:), pointer :: val ! n x n lwr triangular matrix
      integer(C_INT) :: ldval
@@ -50,15 +49,13 @@ subroutine spral_ssids_contrib_get_data(ccontrib, n, val, ldval, rlist, &
   type(C_PTR), intent(out) :: delay_val
   integer(C_INT), intent(out) :: lddelay
 
-  type(contrib_type), pointer, volatile :: fcontrib
+  type(contrib_type), pointer :: fcontrib
 
   if (c_associated(ccontrib)) then
      call c_f_pointer(ccontrib, fcontrib)
 
-     do while (.not. fcontrib%ready)
-        ! FIXME: make below a taskyield? (was: flush)
-        !$omp taskyield
-     end do
+     ! NB: No need to wait for the block, as a subtree is only started once
+     ! all its inputs have been published (see factor_chain()).
 
      n = fcontrib%n
      val = c_loc(fcontrib%val)
@@ -10,14 +10,15 @@
 #include <memory>
 
 #include "compat.hxx" // for std::align if required
+#include "ssids/cpu/NumaAllocator.hxx"
 
 namespace spral { namespace ssids { namespace cpu {
 
 namespace append_alloc_internal {
 
 /** A single fixed size page of memory with allocate function.
- * We are required to guaruntee it is zero'd, so use calloc rather than anything
- * else for the allocation.
+ * We are required to guaruntee it is zero'd, so obtain memory from a
+ * NumaPlacement (which uses calloc or equivalent).
  * Deallocation is not supported.
  */
 class Page {
@@ -29,8 +30,9 @@ class Page {
   static const int align = 16; // 16 byte alignment
 #endif
 public:
-   Page(size_t sz, Page* next=nullptr)
-   : next(next), mem_(calloc(sz+align, 1)), ptr_(mem_), space_(sz+align)
+   Page(size_t sz, NumaPlacement& placement, Page* next=nullptr)
+   : next(next), placement_(placement), mem_(placement.allocate(sz+align)),
+     ptr_(mem_), space_(sz+align), size_(sz+align)
    {
       if(!mem_) throw std::bad_alloc();
    }
@@ -44,7 +46,7 @@ public:
       printf("AppendAlloc: Used      %16ld (%.2e GB)\n",
             used, 1e-9*double(used));
 #endif /* MEM_STATS */
-      free(mem_);
+      placement_.deallocate(mem_, size_);
    }
    void* allocate(size_t sz) {
       if(!std::align(align, sz, ptr_, space_)) return nullptr;
@@ -56,19 +58,25 @@ public:
 public:
    Page* const next;
 private:
+   NumaPlacement& placement_; // Placement memory was obtained from
    void *const mem_; // Pointer to memory so we can free it
    void *ptr_; // Next address to return
    size_t space_; // Amount of free memory
+   size_t const size_; // Total size of mem_
 };
 
 /** A memory allocation pool consisting of one or more pages.
+ * Pages are placed on the NUMA node(s) of the team that creates the pool.
  * Deallocation is not supported.
  */
 class Pool {
    const size_t PAGE_SIZE = 8*1024*1024; // 8MB
 public:
-   Pool(size_t initial_size)
-   : top_page_(new Page(std::max(PAGE_SIZE, initial_size)))
+   /* NB: The first page is not rounded up to PAGE_SIZE, as a factorization
+    * may be split into many small subtrees, each with its own pool */
+   Pool(size_t initial_size, std::shared_ptr<NumaPlacement> placement)
+   : placement_(placement),
+     top_page_(new Page(initial_size, *placement_))
    {}
    Pool(const Pool&) =delete; // Not copyable
    Pool& operator=(const Pool&) =delete; // Not copyable
@@ -86,13 +94,15 @@ public:
       {
          ptr = top_page_->allocate(sz);
          if(!ptr) { // Insufficient space on current top page, make a new one
-            top_page_ = new Page(std::max(PAGE_SIZE, sz), top_page_);
+            top_page_ =
+               new Page(std::max(PAGE_SIZE, sz), *placement_, top_page_);
             ptr = top_page_->allocate(sz);
          }
       }
       return ptr;
    }
 private:
+   std::shared_ptr<NumaPlacement> placement_; // Placement of pages
    Page* top_page_;
 };
 
@@ -107,8 +117,13 @@ class AppendAlloc {
 public :
    typedef T               value_type;
 
-   AppendAlloc(size_t initial_size)
-   : pool_(new append_alloc_internal::Pool(initial_size))
+   /** \param initial_size Size of first page.
+    *  \param placement NUMA placement of pages. Defaults to that of the
+    *         calling team. */
+   AppendAlloc(size_t initial_size,
+         std::shared_ptr<NumaPlacement> placement=
+            std::make_shared<NumaPlacement>())
+   : pool_(new append_alloc_internal::Pool(initial_size, placement))
    {}
 
    /** Rebind a type T to a type U AppendAlloc */
@@ -358,6 +358,12 @@ public:
       }
    }
 
+   /** \brief Return number of pages, including the initial one */
+   int get_num_pages() {
+      spral::omp::AcquiredLock scopeLock(lock_);
+      return pages_.size();
+   }
+
 private:
    CharAllocator alloc_; ///< Underlying allocator to be passed to new pages
    std::size_t max_sz_; ///< Size of last page allocated
@@ -401,6 +407,13 @@ public:
    {
       table_.get()->deallocate(ptr, n*sizeof(T));
    }
+
+   /** \brief Return number of pages added to the pool since construction, as
+    *         allocations did not fit in the initial size */
+   int get_pages_added() const
+   {
+      return table_.get()->get_num_pages() - 1;
+   }
 private:
    std::shared_ptr<buddy_alloc_internal::Table<CharAllocator>> table_;
    template<typename U, typename UAlloc>
@@ -0,0 +1,116 @@
+/** \file
+ *  \copyright 2026 The Science and Technology Facilities Council (STFC)
+ *  \licence   BSD licence, see LICENCE file for details
+ */
+#include "ssids/cpu/NumaAllocator.hxx"
+
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+#include "config.h"
+#include "omp.hxx"
+#include "hw_topology/hwloc_wrapper.hxx"
+
+#if defined(HAVE_HWLOC) && defined(_OPENMP)
+#define NUMA_PLACEMENT
+#endif
+
+namespace spral { namespace ssids { namespace cpu {
+
+#ifdef NUMA_PLACEMENT
+namespace {
+
+/** \brief Return topology shared by all placements, loaded on first use. */
+hw_topology::HwlocTopology const& get_topology() {
+   static hw_topology::HwlocTopology topology;
+   return topology;
+}
+
+} /* anon namespace */
+#endif /* NUMA_PLACEMENT */
+
+NumaPlacement::NumaPlacement()
+: bytes_(0)
+{
+#ifdef NUMA_PLACEMENT
+   int nplaces = omp_get_partition_num_places();
+   if(nplaces <= 0) return; // Threads not bound, leave it to first touch
+   auto const& topology = get_topology();
+   if(!topology.supports_membind()) return;
+
+   /* Find processors of our team's places, and hence their NUMA nodes */
+   std::vector<int> place_nums(nplaces);
+   omp_get_partition_place_nums(place_nums.data());
+   hwloc_cpuset_t cpuset = hwloc_bitmap_alloc();
+   std::vector<int> procs;
+   for(int place : place_nums) {
+      procs.resize(omp_get_place_num_procs(place));
+      omp_get_place_proc_ids(place, procs.data());
+      for(int proc : procs)
+         hwloc_bitmap_set(cpuset, proc);
+   }
+   hwloc_nodeset_t nodeset = hwloc_bitmap_alloc();
+   topology.cpuset_to_nodeset(cpuset, nodeset);
+   hwloc_bitmap_free(cpuset);
+   int nnodes = hwloc_bitmap_weight(nodeset);
+   if(nnodes <= 0) {
+      hwloc_bitmap_free(nodeset);
+      return;
+   }
+   nodeset_ = nodeset;
+   interleave_ = (nnodes > 1);
+#endif /* NUMA_PLACEMENT */
+}
+
+NumaPlacement::~NumaPlacement() {
+#ifdef NUMA_PLACEMENT
+   if(nodeset_) hwloc_bitmap_free(static_cast<hwloc_nodeset_t>(nodeset_));
+#endif /* NUMA_PLACEMENT */
+}
+
+void* NumaPlacement::allocate(size_t sz) {
+#ifdef NUMA_PLACEMENT
+   if(nodeset_) {
+      void* ptr = get_topology().alloc_membind(sz,
+            static_cast<hwloc_nodeset_t>(nodeset_), interleave_);
+      if(!ptr) return nullptr;
+#ifndef __linux__
+      // On Linux hwloc uses mmap(), which already provides zeroed pages
+      memset(ptr, 0, sz);
+#endif /* __linux__ */
+      bytes_ += sz;
+      return ptr;
+   }
+#endif /* NUMA_PLACEMENT */
+   void* ptr = calloc(sz, 1);
+   if(ptr) bytes_ += sz;
+   return ptr;
+}
+
+void NumaPlacement::deallocate(void* ptr, size_t sz) {
+#ifdef NUMA_PLACEMENT
+   if(nodeset_) {
+      get_topology().free_membind(ptr, sz);
+      bytes_ -= sz;
+      return;
+   }
+#endif /* NUMA_PLACEMENT */
+   bytes_ -= sz;
+   free(ptr);
+}
+
+int NumaPlacement::is_local(void const* ptr) const {
+   int local = -1;
+#ifdef NUMA_PLACEMENT
+   if(!nodeset_ || !ptr) return local;
+   hwloc_nodeset_t where = hwloc_bitmap_alloc();
+   if(get_topology().get_memory_location(ptr, 1, where))
+      local = hwloc_bitmap_isincluded(where,
+            static_cast<hwloc_nodeset_t>(nodeset_)) ? 1 : 0;
+   hwloc_bitmap_free(where);
+#endif /* NUMA_PLACEMENT */
+   return local;
+}
+
+}}} /* namespaces spral::ssids::cpu */
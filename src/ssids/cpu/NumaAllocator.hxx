@@ -0,0 +1,108 @@
+/** \file
+ *  \copyright 2026 The Science and Technology Facilities Council (STFC)
+ *  \licence   BSD licence, see LICENCE file for details
+ *
+ *  \brief
+ *  Allocation of memory on the NUMA node(s) of an OpenMP team.
+ */
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <new>
+
+namespace spral { namespace ssids { namespace cpu {
+
+/**
+ * \brief Placement of memory on the NUMA node(s) used by an OpenMP team.
+ *
+ * On construction, determines the NUMA nodes holding the place partition of
+ * the calling thread's team. inner_factor_cpu() creates one team per NUMA
+ * region, each bound to the places of that region, and then a team spanning
+ * all regions. Memory is then bound to the node of a single region team, or
+ * interleaved across all nodes of a team that spans several. If threads are
+ * not bound to places (e.g. OMP_PROC_BIND is not set), or hwloc is not
+ * available, memory is left to the operating system's first touch policy.
+ *
+ * Memory returned by allocate() is always zero.
+ */
+class NumaPlacement {
+public:
+   // \{
+   NumaPlacement(NumaPlacement const&) =delete;
+   NumaPlacement& operator=(NumaPlacement const&) =delete;
+   // \}
+   /** \brief Constructor: determine NUMA nodes of calling team. */
+   NumaPlacement();
+   ~NumaPlacement();
+
+   /** \brief Return zeroed memory of given size placed on our node(s).
+    *  \return Pointer to memory, or nullptr on failure. */
+   void* allocate(size_t sz);
+   /** \brief Release memory obtained from allocate(). */
+   void deallocate(void* ptr, size_t sz);
+
+   /** \brief Return true if memory is explicitly placed on our node(s). */
+   bool is_bound() const { return nodeset_ != nullptr; }
+   /** \brief Return true if memory is interleaved across several nodes. */
+   bool is_interleaved() const { return interleave_; }
+   /** \brief Return number of bytes currently allocated (whether or not they
+    *         are explicitly placed). */
+   size_t get_bytes() const { return bytes_; }
+   /** \brief Determine whether the memory at ptr (sampled at its first
+    *         page) is on one of our node(s).
+    *  \return 1 if it is, 0 if it is on some other node, or -1 if unknown. */
+   int is_local(void const* ptr) const;
+
+private:
+   void* nodeset_ = nullptr; ///< hwloc_nodeset_t of our node(s) if bound
+   bool interleave_ = false; ///< true if nodeset_ has more than one node
+   std::atomic<size_t> bytes_; ///< Bytes allocated by allocate()
+};
+
+/**
+ * \brief Allocator placing memory according to a NumaPlacement.
+ *
+ * Memory is always zeroed. Intended as the base allocator for allocators
+ * that manage large pages of memory, such as BuddyAllocator and AppendAlloc:
+ * each allocation may consume whole pages of memory.
+ */
+template <typename T>
+class NumaAllocator {
+public:
+   typedef T value_type;
+
+   /** \brief Constructor.
+    *  \param placement Placement to use. Shared with all copies. */
+   NumaAllocator(std::shared_ptr<NumaPlacement> const& placement)
+   : placement_(placement)
+   {}
+   /** \brief Rebind a type U NumaAllocator to type T */
+   template <typename U>
+   NumaAllocator(NumaAllocator<U> const& other)
+   : placement_(other.placement_)
+   {}
+
+   T* allocate(std::size_t n) {
+      void* ptr = placement_->allocate(n*sizeof(T));
+      if(!ptr) throw std::bad_alloc();
+      return static_cast<T*>(ptr);
+   }
+   void deallocate(T* ptr, std::size_t n) {
+      placement_->deallocate(ptr, n*sizeof(T));
+   }
+   template<class U>
+   bool operator==(NumaAllocator<U> const& rhs) const {
+      return placement_ == rhs.placement_;
+   }
+   template<class U>
+   bool operator!=(NumaAllocator<U> const& rhs) const {
+      return !(*this==rhs);
+   }
+private:
+   std::shared_ptr<NumaPlacement> placement_;
+   template <typename U> friend class NumaAllocator;
+};
+
+}}} /* namespaces spral::ssids::cpu */
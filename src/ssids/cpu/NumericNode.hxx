@@ -70,6 +70,8 @@ public:
    T *lcol; // Pointer to start of factor data
    int *perm; // Pointer to permutation
    T *contrib; // Pointer to contribution block
+   int nchild_remain; // Number of child tasks yet to complete (if we are
+                      // the root of a task and using TreeSchedule::ready)
 private:
    PoolAllocator pool_alloc_; // Our own version of pool allocator for freeing
                               // contrib
@@ -58,6 +58,33 @@ void* spral_ssids_cpu_create_num_subtree_dbl(
    }
 }
 
+extern "C"
+void spral_ssids_cpu_refactor_num_subtree_dbl(
+      bool posdef,
+      void* subtree_ptr, // pointer to relevant type of NumericSubtree
+      const double *const aval, // Values of A
+      void** child_contrib, // Contributions from child subtrees
+      struct cpu_factor_options const* options, // Options in
+      ThreadStats* stats // Info out
+      ) {
+   // Perform factorization
+   if(posdef) {
+      auto &subtree = *static_cast<NumericSubtreePosdef*>(subtree_ptr);
+      subtree.refactor(aval, child_contrib, *options, *stats);
+      if(options->print_level > 9999) {
+         printf("Final factors:\n");
+         subtree.print();
+      }
+   } else { /* indef */
+      auto &subtree = *static_cast<NumericSubtreeIndef*>(subtree_ptr);
+      subtree.refactor(aval, child_contrib, *options, *stats);
+      if(options->print_level > 9999) {
+         printf("Final factors:\n");
+         subtree.print();
+      }
+   }
+}
+
 extern "C"
 void spral_ssids_cpu_destroy_num_subtree_dbl(bool posdef, void* target) {
    if(!target) return;
@@ -5,10 +5,15 @@
  */
 #pragma once
 
+#include <chrono>
+#include <cstdio>
+
+#include "compat.hxx"
 #include "ssids/profile.hxx"
 #include "ssids/cpu/cpu_iface.hxx"
 #include "ssids/cpu/factor.hxx"
 #include "ssids/cpu/BuddyAllocator.hxx"
+#include "ssids/cpu/NumaAllocator.hxx"
 #include "ssids/cpu/NumericNode.hxx"
 #include "ssids/cpu/SymbolicSubtree.hxx"
 #include "ssids/cpu/SmallLeafNumericSubtree.hxx"
@@ -23,7 +28,11 @@ namespace spral { namespace ssids { namespace cpu {
  * \tparam T underlying numerical type e.g. double
  * \tparam PAGE_SIZE initial size to be used for thread Workspace
  * \tparam FactorAllocator allocator to be used for factor storage. It must
- *         zero memory upon allocation (eg through calloc or memset).
+ *         zero memory upon allocation (eg through calloc or memset), and be
+ *         constructible from a size and a std::shared_ptr<NumaPlacement>.
+ *
+ * Factor and pool memory is placed on the NUMA node(s) of the team that
+ * constructs the subtree, see NumaPlacement.
  * */
 template <bool posdef, //< true for Cholesky factoriztion, false for indefinte
           typename T,
@@ -31,7 +40,7 @@ template <bool posdef, //< true for Cholesky factoriztion, false for indefinte
           typename FactorAllocator
           >
 class NumericSubtree {
-   typedef BuddyAllocator<T,std::allocator<T>> PoolAllocator;
+   typedef BuddyAllocator<T,NumaAllocator<T>> PoolAllocator;
    //typedef SimpleAlignedAllocator<T> PoolAllocator;
    typedef SmallLeafNumericSubtree<posdef, T, FactorAllocator, PoolAllocator> SLNS;
 public:
@@ -58,9 +67,14 @@ public:
          struct cpu_factor_options const& options,
          ThreadStats& stats)
    : symb_(symbolic_subtree),
-     factor_alloc_(symbolic_subtree.get_factor_mem_est(options.multiplier)),
-     pool_alloc_(symbolic_subtree.get_pool_size<T>()),
-     small_leafs_(static_cast<SLNS*>(::operator new[](symb_.small_leafs_.size()*sizeof(SLNS))))
+     placement_(std::make_shared<NumaPlacement>()),
+     factor_alloc_(symbolic_subtree.get_factor_mem_est(options.multiplier),
+           placement_),
+     pool_alloc_(symbolic_subtree.get_pool_size<T>(posdef,
+              omp_get_num_threads()),
+           NumaAllocator<T>(placement_)),
+     small_leafs_(static_cast<SLNS*>(::operator new[](symb_.small_leafs_.size()*sizeof(SLNS)))),
+     afac_(scaling ? new T[symb_.get_num_a()] : nullptr)
    {
       /* Associate symbolic nodes to numeric ones; copy tree structure */
       nodes_.reserve(symbolic_subtree.nnodes_+1);
@@ -72,208 +86,36 @@ public:
          nodes_[ni].next_child = nc ? &nodes_[nc->idx] :  nullptr;
       }
 
-      /* Allocate workspaces */
-      int num_threads = omp_get_num_threads();
-      std::vector<ThreadStats> thread_stats(num_threads);
-      std::vector<Workspace> work;
-      work.reserve(num_threads);
-      for(int i=0; i<num_threads; ++i)
-         work.emplace_back(PAGE_SIZE);
-
-      // Each node is depend(inout) on itself and depend(in) on its parent.
-      // Whilst this isn't really what's happening it does ensure our
-      // ordering is correct: each node cannot be scheduled until all its
-      // children are done, but its children to run in any order.
-      bool abort;
-      #pragma omp atomic write
-      abort = false; // Set to true to abort remaining tasks
-      #pragma omp taskgroup
-      {
-         /* Loop over small leaf subtrees */
-         for(unsigned int si=0; si<symb_.small_leafs_.size(); ++si) {
-            auto* parent_lcol = &nodes_[symb_.small_leafs_[si].get_parent()];
-            #pragma omp task default(none) \
-               firstprivate(si) \
-               shared(aval, abort, options, scaling, thread_stats, work) \
-               depend(in: parent_lcol[0:1])
-            {
-              bool my_abort;
-              #pragma omp atomic read
-              my_abort = abort;
-              if (!my_abort) {
-               #pragma omp cancellation point taskgroup
-               try {
-                  int this_thread = omp_get_thread_num();
-#ifdef PROFILE
-                  Profile::Task task_subtree("TA_SUBTREE");
-#endif
-                  auto const& leaf = symb_.small_leafs_[si];
-                  new (&small_leafs_[si]) SLNS(leaf, nodes_, aval, scaling,
-                        factor_alloc_, pool_alloc_, work,
-                        options, thread_stats[this_thread]);
-                  if(thread_stats[this_thread].flag<Flag::SUCCESS) {
-#ifdef _OPENMP
-                     #pragma omp atomic write
-                     abort = true;
-                     #pragma omp cancel taskgroup
-#else
-                     stats += thread_stats[this_thread];
-                     return;
-#endif /* _OPENMP */
-                  }
-#ifdef PROFILE
-                  task_subtree.done();
-#endif
-               } catch (std::bad_alloc const&) {
-                  thread_stats[omp_get_thread_num()].flag =
-                     Flag::ERROR_ALLOCATION;
-#ifdef _OPENMP
-                  #pragma omp atomic write
-                  abort = true;
-                  #pragma omp cancel taskgroup
-#else
-                  stats += thread_stats[0];
-                  return;
-#endif /* _OPENMP */
-               } catch (SingularError const&) {
-                  thread_stats[omp_get_thread_num()].flag =
-                     Flag::ERROR_SINGULAR;
-#ifdef _OPENMP
-                  #pragma omp atomic write
-                  abort = true;
-                  #pragma omp cancel taskgroup
-#else
-                  stats += thread_stats[0];
-                  return;
-#endif /* _OPENMP */
-               }
-            } } // task/abort
-         }
-
-         /* Loop over singleton nodes in order */
-         for(int ni=0; ni<symb_.nnodes_; ++ni) {
-            if(symb_[ni].insmallleaf) continue; // already handled
-            auto* this_lcol = &nodes_[ni]; // for depend
-            auto* parent_lcol = &nodes_[symb_[ni].parent]; // for depend
-            #pragma omp task default(none) \
-               firstprivate(ni) \
-               shared(aval, abort, child_contrib, options, scaling, \
-                      thread_stats, work) \
-               depend(inout: this_lcol[0:1]) \
-               depend(in: parent_lcol[0:1])
-            {
-              bool my_abort;
-              #pragma omp atomic read
-              my_abort = abort;
-              if (!my_abort) {
-               #pragma omp cancellation point taskgroup
-               try {
-                  /*printf("%d: Node %d parent %d (of %d) size %d x %d\n",
-                        omp_get_thread_num(), ni, symb_[ni].parent,
-                        symb_.nnodes_, symb_[ni].nrow, symb_[ni].ncol);*/
-                  int this_thread = omp_get_thread_num();
-                  // Assembly of node (not of contribution block)
-                  assemble_pre
-                     (posdef, symb_.n, symb_[ni], child_contrib, nodes_[ni],
-                      factor_alloc_, pool_alloc_, work, aval, scaling);
-                  // Update stats
-                  int nrow = symb_[ni].nrow + nodes_[ni].ndelay_in;
-                  thread_stats[this_thread].maxfront =
-                     std::max(thread_stats[this_thread].maxfront, nrow);
-
-                  // Factorization
-                  factor_node<posdef>
-                     (ni, symb_[ni], nodes_[ni], options,
-                      thread_stats[this_thread], work,
-                      pool_alloc_);
-                  if(thread_stats[this_thread].flag<Flag::SUCCESS) {
-#ifdef _OPENMP
-                     #pragma omp atomic write
-                     abort = true;
-                     #pragma omp cancel taskgroup
-#else
-                     stats += thread_stats[0];
-                     return;
-#endif /* _OPENMP */
-                  }
-
-                  // Assemble children into contribution block
-                  #pragma omp atomic read
-                  my_abort = abort;
-                  if (!my_abort)
-                     assemble_post(symb_.n, symb_[ni], child_contrib,
-                           nodes_[ni], pool_alloc_, work);
-               } catch (std::bad_alloc const&) {
-                  thread_stats[omp_get_thread_num()].flag =
-                     Flag::ERROR_ALLOCATION;
-#ifdef _OPENMP
-                  #pragma omp atomic write
-                  abort = true;
-                  #pragma omp cancel taskgroup
-#else
-                  stats += thread_stats[0];
-                  return;
-#endif /* _OPENMP */
-               } catch (SingularError const&) {
-                  thread_stats[omp_get_thread_num()].flag =
-                     Flag::ERROR_SINGULAR;
-#ifdef _OPENMP
-                  #pragma omp atomic write
-                  abort = true;
-                  #pragma omp cancel taskgroup
-#else
-                  stats += thread_stats[0];
-                  return;
-#endif /* _OPENMP */
-               }
-            } } // task/abort
-         }
-      } // taskgroup
-
-      // Reduce thread_stats
-      stats = ThreadStats(); // initialise
-      for(auto tstats : thread_stats)
-         stats += tstats;
-      if(stats.flag < 0) return;
-
-      // Count stats
-      // FIXME: Do this as we go along...
-      if(posdef) {
-         // all stats remain zero
-      } else { // indefinite
-         for(int ni=0; ni<symb_.nnodes_; ni++) {
-            int m = symb_[ni].nrow + nodes_[ni].ndelay_in;
-            int n = symb_[ni].ncol + nodes_[ni].ndelay_in;
-            int ldl = align_lda<T>(m);
-            T *d = nodes_[ni].lcol + n*ldl;
-            for(int i=0; i<nodes_[ni].nelim; ) {
-               T a11 = d[2*i];
-               T a21 = d[2*i+1];
-               if(i+1==nodes_[ni].nelim || std::isfinite(d[2*i+2])) {
-                  // 1x1 pivot (or zero)
-                  if(a11 == 0.0) {
-                     // NB: If we reach this stage, options.action must be true.
-                     stats.flag = Flag::WARNING_FACT_SINGULAR;
-                     stats.num_zero++;
-                  }
-                  if(a11 < 0.0) stats.num_neg++;
-                  i++;
-               } else {
-                  // 2x2 pivot
-                  T a22 = d[2*i+3];
-                  stats.num_two++;
-                  T det = a11*a22 - a21*a21; // product of evals
-                  T trace = a11 + a22; // sum of evals
-                  if(det < 0) stats.num_neg++;
-                  else if(trace < 0) stats.num_neg+=2;
-                  i+=2;
-               }
-            }
-         }
-      }
+      /* Perform factorization, recording scaling factors as we go */
+      factor(aval, scaling, child_contrib, options, stats);
    }
    ~NumericSubtree() {
       delete[] small_leafs_;
+      delete[] afac_;
+   }
+
+   /** \brief Refactorize a matrix with the same sparsity pattern.
+    *
+    * Reuses the tree structure and the scaling factors recorded by the
+    * constructor, so only the values of A are read. Factor storage is
+    * replaced by a fresh allocation, placed as for the constructor.
+    *
+    *  \param aval pointer to user's a value array (references entire matrix)
+    *  \param child_contrib array of pointers to contributions from child
+    *         subtrees, as for the constructor.
+    *  \param options user-supplied options controlling execution.
+    *  \param stats collection of statistics for return to user.
+    */
+   void refactor(
+         T const* aval,
+         void** child_contrib,
+         struct cpu_factor_options const& options,
+         ThreadStats& stats) {
+      for(auto& node : nodes_)
+         node.free_contrib();
+      factor_alloc_ = FactorAllocator(
+            symb_.get_factor_mem_est(options.multiplier), placement_);
+      factor(aval, nullptr, child_contrib, options, stats);
    }
 
    void solve_fwd(int nrhs, double* x, int ldx) const {
@@ -520,12 +362,471 @@ public:
    SymbolicSubtree const& get_symbolic_subtree() { return symb_; }
 
 private:
+   /** \brief Time a thread spends executing tasks of this subtree.
+    *
+    * Tasks may execute others whilst waiting on their own subtasks, so only
+    * the outermost is timed.
+    */
+   struct ThreadTime {
+      int depth = 0; //< Number of our tasks active on thread
+      std::chrono::steady_clock::time_point start; //< Start of outermost
+      bool nested = false; //< True if outermost has executed another
+      double busy = 0.0; //< Total time in our tasks (seconds)
+
+      void begin() {
+         if(depth++ == 0) {
+            start = std::chrono::steady_clock::now();
+            nested = false;
+         } else {
+            nested = true;
+         }
+      }
+      /** \brief Returns time of task if it is the outermost and executed no
+       *         others, or a negative value otherwise. */
+      double end() {
+         if(--depth > 0) return -1.0;
+         double t = std::chrono::duration<double>(
+               std::chrono::steady_clock::now() - start).count();
+         busy += t;
+         return (nested) ? -1.0 : t;
+      }
+   };
+
+   /** \brief State shared by the tasks of a factorization. */
+   struct TaskContext {
+      TaskContext(T const* aval, T const* scaling, void** child_contrib,
+            struct cpu_factor_options const& options, int num_threads)
+      : aval(aval), scaling(scaling), child_contrib(child_contrib),
+        options(options), thread_stats(num_threads), thread_time(num_threads)
+      {
+         work.reserve(num_threads);
+         for(int i=0; i<num_threads; ++i)
+            work.emplace_back(PAGE_SIZE);
+      }
+
+      T const* aval; //< User's values of A (references entire matrix)
+      T const* scaling; //< Scaling to apply and record (or null)
+      void** child_contrib; //< Contributions from child subtrees
+      struct cpu_factor_options const& options; //< User-supplied options
+      std::vector<ThreadStats> thread_stats; //< Statistics of each thread
+      std::vector<ThreadTime> thread_time; //< Time of each thread in tasks
+      std::vector<Workspace> work; //< Workspace of each thread
+      bool abort = false; //< Set to true to abort remaining tasks
+   };
+
+   /** \brief Perform factorization.
+    *
+    * \param scaling Scaling to apply, recording factors in afac_. If null
+    *        then factors already in afac_ (if any) are used.
+    * Other parameters are as for the constructor.
+    */
+   void factor(
+         T const* aval,
+         T const* scaling,
+         void** child_contrib,
+         struct cpu_factor_options const& options,
+         ThreadStats& stats) {
+      /* Allocate workspaces */
+      int num_threads = omp_get_num_threads();
+      TaskContext ctx(aval, scaling, child_contrib, options, num_threads);
+
+      /* Record whether contributions from child subtrees are held on our
+       * NUMA node(s). NB: they are all available, as we are only started
+       * once all our inputs are ready. */
+      long contrib_local = 0, contrib_remote = 0, contrib_bytes = 0;
+      for(int ni=0; ni<symb_.nnodes_; ++ni) {
+         for(int contrib_idx : symb_[ni].contrib) {
+            int cn, ldcontrib, ndelay, lddelay;
+            double const *cval, *delay_val;
+            int const *crlist, *delay_perm;
+            spral_ssids_contrib_get_data(
+                  child_contrib[contrib_idx], &cn, &cval, &ldcontrib, &crlist,
+                  &ndelay, &delay_perm, &delay_val, &lddelay
+                  );
+            long bytes = long(cn)*ldcontrib*sizeof(double);
+            contrib_bytes += bytes;
+            switch(placement_->is_local(cval)) {
+               case 1: contrib_local += bytes; break;
+               case 0: contrib_remote += bytes; break;
+               default: break; // location unknown
+            }
+         }
+      }
+
+      // Unless tree_schedule is ready, each node is depend(inout) on itself
+      // and depend(in) on its parent. Whilst this isn't really what's
+      // happening it does ensure our ordering is correct: each node cannot be
+      // scheduled until all its children are done, but its children to run in
+      // any order.
+      // Nodes that are part of a small subtree are represented by the root of
+      // that subtree for dependency purposes.
+      // Tasks are also given a priority based on the longest path through
+      // them, see task_priority().
+      auto start = std::chrono::steady_clock::now();
+      #pragma omp taskgroup
+      {
+         switch(options.tree_schedule) {
+         case TreeSchedule::ready:
+            /* Create tasks for leaves, longest chain first. Each continues
+             * with its parent if it is the last child to complete */
+            for(int ni=0; ni<symb_.nnodes_; ++ni)
+               nodes_[ni].nchild_remain = symb_[ni].nchild_task;
+            for(int ti : symb_.cp_order_)
+               if(symb_[symb_.get_task_root(ti)].nchild_task == 0)
+                  spawn_ready(ti, ctx);
+            break;
+         case TreeSchedule::critical_path:
+            /* Create tasks longest chain first */
+            for(int ti : symb_.cp_order_) {
+               if(ti >= symb_.nnodes_)
+                  spawn_small_subtree(ti - symb_.nnodes_, ctx);
+               else
+                  spawn_node(ti, ctx);
+            }
+            break;
+         default: /* TreeSchedule::postorder */
+            /* Loop over small leaf subtrees */
+            for(unsigned int si=0; si<symb_.small_leafs_.size(); ++si) {
+               if(symb_.small_leafs_[si].has_inputs()) continue; // below
+               spawn_small_subtree(si, ctx);
+            }
+
+            /* Loop over singleton nodes in order */
+            unsigned int next_si = 0; // next small subtree with inputs
+            for(int ni=0; ni<symb_.nnodes_; ++ni) {
+               if(symb_[ni].insmallleaf) {
+                  // Small subtrees with inputs must be spawned after any
+                  // nodes that contribute to them, so do so when we reach
+                  // their root.
+                  // NB: such subtrees are stored in order of their roots.
+                  while(next_si < symb_.small_leafs_.size() &&
+                        !symb_.small_leafs_[next_si].has_inputs())
+                     ++next_si;
+                  if(next_si < symb_.small_leafs_.size() &&
+                        symb_.small_leafs_[next_si].get_root() == ni)
+                     spawn_small_subtree(next_si++, ctx);
+                  continue; // otherwise already handled
+               }
+               spawn_node(ni, ctx);
+            }
+            break;
+         }
+      } // taskgroup
+
+      // Record time each thread was and was not executing our tasks. NB:
+      // the latter includes time spent on other subtrees running concurrently.
+      double wall = std::chrono::duration<double>(
+            std::chrono::steady_clock::now() - start).count();
+      for(int i=0; i<num_threads; ++i) {
+         double busy = ctx.thread_time[i].busy;
+         ctx.thread_stats[i].busy_time = busy;
+         ctx.thread_stats[i].idle_time = std::max(0.0, wall-busy);
+      }
+
+      // Reduce thread_stats
+      stats = ThreadStats(); // initialise
+      for(auto tstats : ctx.thread_stats)
+         stats += tstats;
+      // Memory of a team spanning several NUMA nodes is only local to some
+      // of its threads, so is counted separately
+      long const bytes = placement_->get_bytes();
+      stats.alloc_bytes += bytes;
+      stats.contrib_bytes += contrib_bytes;
+      if(placement_->is_interleaved())
+         stats.numa_interleaved_bytes += bytes + contrib_local;
+      else if(placement_->is_bound())
+         stats.numa_local_bytes += bytes + contrib_local;
+      stats.numa_remote_bytes += contrib_remote;
+      stats.pool_bytes +=
+         symb_.get_pool_size<T>(posdef, num_threads) * sizeof(T);
+      stats.pool_pages_added += pool_alloc_.get_pages_added();
+      if(stats.flag < 0) return;
+
+      // Count stats
+      // FIXME: Do this as we go along...
+      if(posdef) {
+         // all stats remain zero
+      } else { // indefinite
+         for(int ni=0; ni<symb_.nnodes_; ni++) {
+            int m = symb_[ni].nrow + nodes_[ni].ndelay_in;
+            int n = symb_[ni].ncol + nodes_[ni].ndelay_in;
+            int ldl = align_lda<T>(m);
+            T *d = nodes_[ni].lcol + n*ldl;
+            for(int i=0; i<nodes_[ni].nelim; ) {
+               T a11 = d[2*i];
+               T a21 = d[2*i+1];
+               if(i+1==nodes_[ni].nelim || std::isfinite(d[2*i+2])) {
+                  // 1x1 pivot (or zero)
+                  if(a11 == 0.0) {
+                     // NB: If we reach this stage, options.action must be true.
+                     stats.flag = Flag::WARNING_FACT_SINGULAR;
+                     stats.num_zero++;
+                  }
+                  if(a11 < 0.0) stats.num_neg++;
+                  i++;
+               } else {
+                  // 2x2 pivot
+                  T a22 = d[2*i+3];
+                  stats.num_two++;
+                  T det = a11*a22 - a21*a21; // product of evals
+                  T trace = a11 + a22; // sum of evals
+                  if(det < 0) stats.num_neg++;
+                  else if(trace < 0) stats.num_neg+=2;
+                  i+=2;
+               }
+            }
+         }
+      }
+   }
+
+   /** \brief Return node used to represent given node in task dependencies.
+    *
+    * This is the node itself, unless it is part of a small subtree in which
+    * case it is the root of that subtree. Out of subtree parents are
+    * represented by the virtual root nodes_[nnodes_].
+    */
+   int dep_node(int idx) const {
+      return symb_[std::min(idx, symb_.nnodes_)].small_root;
+   }
+
+   /** \brief Return OpenMP task priority for task rooted at node idx.
+    *
+    * Priority is proportional to the flops on the longest path through the
+    * node, relative to the longest path in the subtree. It only has an
+    * effect if OMP_MAX_TASK_PRIORITY is set.
+    */
+   int task_priority(int idx) const {
+      int max_priority = omp_get_max_task_priority();
+      long max_path = symb_.max_path_flops_;
+      if(max_priority <= 0 || max_path <= 0) return 0;
+      return static_cast<int>(
+            (static_cast<double>(max_priority) * symb_[idx].path_flops)
+            / max_path);
+   }
+
+   /** \brief Record time of a task consisting of nodes sa:en, for calibration
+    *         of the subtree splitting cost model.
+    *
+    * \param seconds Time of task, or negative if not to be recorded.
+    * \sa ThreadStats::add_task_time()
+    */
+   void record_task_time(int sa, int en, double seconds, ThreadStats& stats)
+   const {
+      if(seconds < 0.0) return;
+      double flops = 0.0, entries = 0.0;
+      for(int ni=sa; ni<=en; ++ni) {
+         double cb = symb_[ni].nrow - symb_[ni].ncol;
+         flops += symb_[ni].flops;
+         entries += cb*cb;
+      }
+      stats.add_task_time(flops, entries, en-sa+1, seconds);
+   }
+
+   /** \brief Factorize node ni (not part of a small subtree).
+    *
+    * \returns false on failure, in which case ctx.abort has been set and the
+    *          calling task should cancel the remaining tasks.
+    */
+   bool run_node(int ni, TaskContext& ctx) {
+      int this_thread = omp_get_thread_num();
+      ctx.thread_time[this_thread].begin();
+      bool ok = true;
+      try {
+         /*printf("%d: Node %d parent %d (of %d) size %d x %d\n",
+               this_thread, ni, symb_[ni].parent, symb_.nnodes_,
+               symb_[ni].nrow, symb_[ni].ncol);*/
+         // Assembly of node (not of contribution block)
+         assemble_pre
+            (posdef, symb_[ni], ctx.child_contrib, nodes_[ni],
+             factor_alloc_, ctx.aval, ctx.scaling, afac_);
+         // Update stats
+         int nrow = symb_[ni].nrow + nodes_[ni].ndelay_in;
+         ctx.thread_stats[this_thread].maxfront =
+            std::max(ctx.thread_stats[this_thread].maxfront, nrow);
+
+         // Factorization
+         factor_node<posdef>
+            (ni, symb_[ni], nodes_[ni], ctx.options,
+             ctx.thread_stats[this_thread], ctx.work,
+             pool_alloc_);
+         ok = (ctx.thread_stats[this_thread].flag >= Flag::SUCCESS);
+
+         // Assemble children into contribution block
+         bool my_abort;
+         #pragma omp atomic read
+         my_abort = ctx.abort;
+         if (ok && !my_abort)
+            assemble_post(symb_[ni], ctx.child_contrib, nodes_[ni]);
+      } catch (std::bad_alloc const&) {
+         ctx.thread_stats[this_thread].flag = Flag::ERROR_ALLOCATION;
+         ok = false;
+      } catch (SingularError const&) {
+         ctx.thread_stats[this_thread].flag = Flag::ERROR_SINGULAR;
+         ok = false;
+      }
+      if(!ok) {
+         // NB: without OpenMP, remaining tasks check abort and do nothing
+         #pragma omp atomic write
+         ctx.abort = true;
+      }
+      double seconds = ctx.thread_time[this_thread].end();
+      if(ok) record_task_time(ni, ni, seconds, ctx.thread_stats[this_thread]);
+      return ok;
+   }
+
+   /** \brief Factorize small subtree si.
+    *
+    * \returns false on failure, as for run_node().
+    */
+   bool run_small_subtree(int si, TaskContext& ctx) {
+      int this_thread = omp_get_thread_num();
+      ctx.thread_time[this_thread].begin();
+      bool ok = true;
+      try {
+#ifdef PROFILE
+         Profile::Task task_subtree("TA_SUBTREE");
+#endif
+         auto const& leaf = symb_.small_leafs_[si];
+         new (&small_leafs_[si]) SLNS(leaf, nodes_, ctx.aval, ctx.scaling,
+               afac_, ctx.child_contrib, factor_alloc_, pool_alloc_, ctx.work,
+               ctx.options, ctx.thread_stats[this_thread]);
+         ok = (ctx.thread_stats[this_thread].flag >= Flag::SUCCESS);
+#ifdef PROFILE
+         task_subtree.done();
+#endif
+      } catch (std::bad_alloc const&) {
+         ctx.thread_stats[this_thread].flag = Flag::ERROR_ALLOCATION;
+         ok = false;
+      } catch (SingularError const&) {
+         ctx.thread_stats[this_thread].flag = Flag::ERROR_SINGULAR;
+         ok = false;
+      }
+      if(!ok) {
+         #pragma omp atomic write
+         ctx.abort = true;
+      }
+      double seconds = ctx.thread_time[this_thread].end();
+      if(ok) {
+         auto const& leaf = symb_.small_leafs_[si];
+         record_task_time(leaf.get_first(), leaf.get_root(), seconds,
+               ctx.thread_stats[this_thread]);
+      }
+      return ok;
+   }
+
+   /** \brief Spawn task to factorize node ni (not part of a small subtree).
+    *
+    * The task is depend(inout) on the node and depend(in) on its parent, so
+    * must be spawned after all its children.
+    */
+   void spawn_node(int ni, TaskContext& ctx) {
+      auto* this_lcol = &nodes_[ni]; // for depend
+      auto* parent_lcol = &nodes_[dep_node(symb_[ni].parent)]; // for depend
+      int priority = task_priority(ni);
+      #pragma omp task default(none) \
+         firstprivate(ni) \
+         shared(ctx) \
+         depend(inout: this_lcol[0:1]) \
+         depend(in: parent_lcol[0:1]) \
+         priority(priority)
+      {
+        bool my_abort;
+        #pragma omp atomic read
+        my_abort = ctx.abort;
+        if (!my_abort) {
+         #pragma omp cancellation point taskgroup
+         if(!run_node(ni, ctx)) {
+            #pragma omp cancel taskgroup
+         }
+      } } // task/abort
+   }
+
+   /** \brief Spawn task to factorize small subtree si.
+    *
+    * The task is depend(inout) on the subtree's root and depend(in) on its
+    * parent, so it may only start once any children outside the subtree have
+    * completed, and must be spawned after them.
+    */
+   void spawn_small_subtree(int si, TaskContext& ctx) {
+      auto* root_lcol = &nodes_[symb_.small_leafs_[si].get_root()];
+      auto* parent_lcol =
+         &nodes_[dep_node(symb_.small_leafs_[si].get_parent())];
+      int priority = task_priority(symb_.small_leafs_[si].get_root());
+      #pragma omp task default(none) \
+         firstprivate(si) \
+         shared(ctx) \
+         depend(inout: root_lcol[0:1]) \
+         depend(in: parent_lcol[0:1]) \
+         priority(priority)
+      {
+        bool my_abort;
+        #pragma omp atomic read
+        my_abort = ctx.abort;
+        if (!my_abort) {
+         #pragma omp cancellation point taskgroup
+         if(!run_small_subtree(si, ctx)) {
+            #pragma omp cancel taskgroup
+         }
+      } } // task/abort
+   }
+
+   /** \brief Spawn task to factorize task ti, whose children have completed.
+    *
+    * Task ti is as for SymbolicNode::task. No task dependencies are used:
+    * instead each task's count of remaining children is decremented when a
+    * child completes. The last child to complete then continues with its
+    * parent, so only tasks for leaves of the tree are ever created.
+    */
+   void spawn_ready(int ti, TaskContext& ctx) {
+      int priority = task_priority(symb_.get_task_root(ti));
+      #pragma omp task default(none) \
+         firstprivate(ti) \
+         shared(ctx) \
+         priority(priority)
+      {
+        bool my_abort;
+        #pragma omp atomic read
+        my_abort = ctx.abort;
+        while (!my_abort && ti >= 0) {
+           #pragma omp cancellation point taskgroup
+           bool ok = (ti >= symb_.nnodes_) ?
+              run_small_subtree(ti - symb_.nnodes_, ctx) :
+              run_node(ti, ctx);
+           if(!ok) {
+              #pragma omp cancel taskgroup
+              break; // NB: only reached if cancellation is disabled
+           }
+           ti = complete_task(ti);
+           #pragma omp atomic read
+           my_abort = ctx.abort;
+        }
+      } // task
+   }
+
+   /** \brief Record completion of task ti for its parent (ready schedule).
+    *
+    * \returns task of parent if ti was the last of its children to complete,
+    *          or -1 otherwise (or if the parent is not in this subtree).
+    */
+   int complete_task(int ti) {
+      int parent = symb_[symb_.get_task_root(ti)].parent;
+      if(parent >= symb_.nnodes_) return -1; // Parent in another subtree
+      int proot = dep_node(parent);
+      int remain;
+      // NB: seq_cst flush ensures the parent sees all its children's results
+      #pragma omp atomic capture seq_cst
+      remain = --nodes_[proot].nchild_remain;
+      return (remain == 0) ? symb_[proot].task : -1;
+   }
+
    SymbolicSubtree const& symb_;
+   std::shared_ptr<NumaPlacement> placement_; // NUMA placement of our memory
    FactorAllocator factor_alloc_;
    PoolAllocator pool_alloc_;
    std::vector<NumericNode<T,PoolAllocator>> nodes_;
    SLNS *small_leafs_; // Apparently emplace_back isn't threadsafe, so
       // std::vector is out. So we use placement new instead.
+   T* afac_; // Scaling factor of each entry of A (null if no scaling)
 };
 
 }}} /* end of namespace spral::ssids::cpu */
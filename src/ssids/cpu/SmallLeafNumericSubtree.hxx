@@ -7,6 +7,7 @@
 
 #include <memory>
 
+#include "ssids/contrib.h"
 #include "ssids/cpu/cpu_iface.hxx"
 #include "ssids/cpu/factor.hxx"
 #include "ssids/cpu/NumericNode.hxx"
@@ -34,7 +35,7 @@ class SmallLeafNumericSubtree<true, T, FactorAllocator, PoolAllocator> {
    typedef typename std::allocator_traits<FactorAllocator>::template rebind_traits<int> FAIntTraits;
    typedef std::allocator_traits<PoolAllocator> PATraits;
 public:
-   SmallLeafNumericSubtree(SmallLeafSymbolicSubtree const& symb, std::vector<NumericNode<T,PoolAllocator>>& old_nodes, T const* aval, T const* scaling, FactorAllocator& factor_alloc, PoolAllocator& pool_alloc, std::vector<Workspace>& work_vec, struct cpu_factor_options const& options, ThreadStats& stats) 
+   SmallLeafNumericSubtree(SmallLeafSymbolicSubtree const& symb, std::vector<NumericNode<T,PoolAllocator>>& old_nodes, T const* aval, T const* scaling, T* afac, void** child_contrib, FactorAllocator& factor_alloc, PoolAllocator& pool_alloc, std::vector<Workspace>& work_vec, struct cpu_factor_options const& options, ThreadStats& stats) 
       : old_nodes_(old_nodes), symb_(symb), lcol_(FADoubleTraits::allocate(factor_alloc, symb.nfactor_))
    {
       Workspace& work = work_vec[omp_get_thread_num()];
@@ -43,19 +44,20 @@ public:
          old_nodes_[ni].ndelay_in = 0;
          old_nodes_[ni].lcol = lcol_ + symb_[ni-symb_.sa_].lcol_offset;
       }
-      memset(lcol_, 0, symb_.nfactor_*sizeof(T));
+      // NB: No need to zero lcol_ as FactorAllocator is required to do so,
+      // and leaving it untouched until add_a() means pages are first touched
+      // by the thread that factorizes them.
 
       /* Add aval entries */
       for(int ni=symb_.sa_; ni<=symb_.en_; ++ni)
-         add_a(ni-symb_.sa_, symb_.symb_[ni], aval, scaling);
+         add_a(ni-symb_.sa_, symb_.symb_[ni], aval, scaling, afac);
 
       /* Perform factorization */
       for(int ni=symb_.sa_; ni<=symb_.en_; ++ni) {
          // Assembly
-         int* map = work.get_ptr<int>(symb_.symb_.n+1);
          assemble
             (ni-symb_.sa_, symb_.symb_[ni], &old_nodes_[ni], factor_alloc,
-             pool_alloc, map, aval, scaling);
+             pool_alloc, work, aval, scaling, afac, child_contrib);
          // Update stats
          int nrow = symb_.symb_[ni].nrow;
          stats.maxfront = std::max(stats.maxfront, nrow);
@@ -71,33 +73,12 @@ void add_a(
       int si,
       SymbolicNode const& snode,
       T const* aval,
-      T const* scaling
+      T const* scaling,
+      T* afac
       ) {
    double *lcol = lcol_ + symb_[si].lcol_offset;
    size_t ldl = align_lda<double>(snode.nrow);
-   if(scaling) {
-      /* Scaling to apply */
-      for(int i=0; i<snode.num_a; i++) {
-         long src  = snode.amap[2*i+0] - 1; // amap contains 1-based values
-         long dest = snode.amap[2*i+1] - 1; // amap contains 1-based values
-         int c = dest / snode.nrow;
-         int r = dest % snode.nrow;
-         T rscale = scaling[ snode.rlist[r]-1 ];
-         T cscale = scaling[ snode.rlist[c]-1 ];
-         size_t k = c*ldl + r;
-         lcol[k] = rscale * aval[src] * cscale;
-      }
-   } else {
-      /* No scaling to apply */
-      for(int i=0; i<snode.num_a; i++) {
-         long src  = snode.amap[2*i+0] - 1; // amap contains 1-based values
-         long dest = snode.amap[2*i+1] - 1; // amap contains 1-based values
-         int c = dest / snode.nrow;
-         int r = dest % snode.nrow;
-         size_t k = c*ldl + r;
-         lcol[k] = aval[src];
-      }
-   }
+   add_a_block(0, snode.ncol, snode, 0, aval, scaling, afac, lcol, ldl);
 }
 
 void assemble(
@@ -106,9 +87,11 @@ void assemble(
       NumericNode<T,PoolAllocator>* node,
       FactorAllocator& factor_alloc,
       PoolAllocator& pool_alloc,
-      int* map,
+      Workspace& work,
       T const* aval,
-      T const* scaling
+      T const* scaling,
+      T* afac,
+      void** child_contrib
       ) {
    /* Rebind allocators */
    typename FAIntTraits::allocator_type factor_alloc_int(factor_alloc);
@@ -129,44 +112,74 @@ void assemble(
       node->perm[i] = snode.rlist[i];
 
    /* Add children */
-   if(node->first_child != NULL) {
-      /* Build lookup vector, allowing for insertion of delayed vars */
-      /* Note that while rlist[] is 1-indexed this is fine so long as lookup
-       * is also 1-indexed (which it is as it is another node's rlist[] */
-      for(int i=0; i<snode.nrow; i++)
-         map[ snode.rlist[i] ] = i;
+   if(node->first_child != NULL || snode.contrib.size() > 0) {
       /* Loop over children adding contributions */
       for(auto* child=node->first_child; child!=NULL; child=child->next_child) {
          SymbolicNode const& csnode = child->symb;
          /* Handle expected contributions (only if something there) */
          if(child->contrib) {
             int cm = csnode.nrow - csnode.ncol;
-            for(int i=0; i<cm; i++) {
-               int c = map[ csnode.rlist[csnode.ncol+i] ];
+            int* map = work.get_ptr<int>(cm);
+            map_child_rows(0, cm, csnode.rmap, snode.ncol, 0, map);
+            int i = 0;
+            for(; i<cm && map[i]<snode.ncol; i++) {
+               // Contribution added to lcol
                T *src = &child->contrib[i*cm];
-               if(c < snode.ncol) {
-                  // Contribution added to lcol
-                  int ldd = align_lda<double>(nrow);
-                  T *dest = &node->lcol[c*ldd];
-                  for(int j=i; j<cm; j++) {
-                     int r = map[ csnode.rlist[csnode.ncol+j] ];
-                     dest[r] += src[j];
-                  }
-               } else {
-                  // Contribution added to contrib
-                  // FIXME: Add after contribution block established?
-                  int ldd = snode.nrow - snode.ncol;
-                  T *dest = &node->contrib[(c-ncol)*ldd];
-                  for(int j=i; j<cm; j++) {
-                     int r = map[ csnode.rlist[csnode.ncol+j] ] - ncol;
-                     dest[r] += src[j];
-                  }
-               }
+               int ldd = align_lda<double>(nrow);
+               T *dest = &node->lcol[map[i]*ldd];
+               asm_col_runs(i, cm, csnode.nrun, csnode.rrun, map, src, dest);
+            }
+            // Remaining rows all lie in contrib as they are in node order
+            for(int j=i; j<cm; j++)
+               map[j] -= ncol;
+            for(; i<cm; i++) {
+               // Contribution added to contrib
+               // FIXME: Add after contribution block established?
+               T *src = &child->contrib[i*cm];
+               int ldd = snode.nrow - snode.ncol;
+               T *dest = &node->contrib[map[i]*ldd];
+               asm_col_runs(i, cm, csnode.nrun, csnode.rrun, map, src, dest);
             }
             /* Free memory from child contribution block */
             child->free_contrib();
          }
       }
+      /* Add any contribution block from other subtrees */
+      for(int contrib_idx : snode.contrib) {
+         int cn, ldcontrib, ndelay, lddelay;
+         double const *cval, *delay_val;
+         int const *crlist, *delay_perm;
+         spral_ssids_contrib_get_data(
+               child_contrib[contrib_idx], &cn, &cval, &ldcontrib, &crlist,
+               &ndelay, &delay_perm, &delay_val, &lddelay
+               );
+         if(!cval) continue; // child was all delays, nothing to do
+         int* map = work.get_ptr<int>(cn);
+         map_contrib_rows(cn, crlist, snode, 0, map);
+         for(int i=0; i<cn; i++) {
+            int c = map[i];
+            T const* src = &cval[i*ldcontrib];
+            if(c < snode.ncol) {
+               // Contribution added to lcol
+               int ldd = align_lda<double>(nrow);
+               T *dest = &node->lcol[c*ldd];
+               for(int j=i; j<cn; j++) {
+                  int r = map[j];
+                  dest[r] += src[j];
+               }
+            } else {
+               // Contribution added to contrib
+               int ldd = snode.nrow - snode.ncol;
+               T *dest = &node->contrib[(c-ncol)*ldd];
+               for(int j=i; j<cn; j++) {
+                  int r = map[j] - ncol;
+                  dest[r] += src[j];
+               }
+            }
+         }
+         /* Free memory from child contribution block */
+         spral_ssids_contrib_free_dbl(child_contrib[contrib_idx]);
+      }
    }
 }
 
@@ -186,7 +199,7 @@ class SmallLeafNumericSubtree<false, T, FactorAllocator, PoolAllocator> {
    typedef typename std::allocator_traits<FactorAllocator>::template rebind_traits<int> FAIntTraits;
    typedef std::allocator_traits<PoolAllocator> PATraits;
 public:
-   SmallLeafNumericSubtree(SmallLeafSymbolicSubtree const& symb, std::vector<NumericNode<T,PoolAllocator>>& old_nodes, T const* aval, T const* scaling, FactorAllocator& factor_alloc, PoolAllocator& pool_alloc, std::vector<Workspace>& work_vec, struct cpu_factor_options const& options, ThreadStats& stats) 
+   SmallLeafNumericSubtree(SmallLeafSymbolicSubtree const& symb, std::vector<NumericNode<T,PoolAllocator>>& old_nodes, T const* aval, T const* scaling, T* afac, void** child_contrib, FactorAllocator& factor_alloc, PoolAllocator& pool_alloc, std::vector<Workspace>& work_vec, struct cpu_factor_options const& options, ThreadStats& stats) 
    : old_nodes_(old_nodes), symb_(symb)
    {
       Workspace& work = work_vec[omp_get_thread_num()];
@@ -195,10 +208,9 @@ public:
                omp_get_thread_num(), ni, symb_[ni].parent, symb_.nnodes_,
                symb_[ni].nrow, symb_[ni].ncol);*/
          // Assembly of node (not of contribution block)
-         int* map = work.get_ptr<int>(symb_.symb_.n+1);
          assemble_pre
             (symb_.symb_[ni], old_nodes_[ni], factor_alloc,
-             pool_alloc, map, aval, scaling);
+             pool_alloc, work, aval, scaling, afac, child_contrib);
          // Update stats
          int nrow = symb_.symb_[ni].nrow + old_nodes_[ni].ndelay_in;
          stats.maxfront = std::max(stats.maxfront, nrow);
@@ -210,7 +222,8 @@ public:
          if(stats.flag<Flag::SUCCESS) return; // something is wrong
 
          // Assemble children into contribution block
-         assemble_post(symb_.symb_[ni], old_nodes_[ni], pool_alloc, map);
+         assemble_post(symb_.symb_[ni], old_nodes_[ni], pool_alloc, work,
+               child_contrib);
       }
    }
 
@@ -220,9 +233,11 @@ private:
          NumericNode<T,PoolAllocator>& node,
          FactorAllocator& factor_alloc,
          PoolAllocator& pool_alloc,
-         int* map,
+         Workspace& work,
          T const* aval,
-         T const* scaling
+         T const* scaling,
+         T* afac,
+         void** child_contrib
          ) {
       /* Rebind allocators */
       typename FADoubleTraits::allocator_type factor_alloc_double(factor_alloc);
@@ -233,6 +248,16 @@ private:
       for(auto* child=node.first_child; child!=NULL; child=child->next_child) {
          node.ndelay_in += child->ndelay_out;
       }
+      for(int contrib_idx : snode.contrib) {
+         int cn, ldcontrib, ndelay, lddelay;
+         double const *cval, *delay_val;
+         int const *crlist, *delay_perm;
+         spral_ssids_contrib_get_data(
+               child_contrib[contrib_idx], &cn, &cval, &ldcontrib, &crlist,
+               &ndelay, &delay_perm, &delay_val, &lddelay
+               );
+         node.ndelay_in += ndelay;
+      }
       int nrow = snode.nrow + node.ndelay_in;
       int ncol = snode.ncol + node.ndelay_in;
 
@@ -241,7 +266,8 @@ private:
       size_t ldl = align_lda<double>(nrow);
       size_t len = (ldl+2) * ncol; // +2 is for D
       node.lcol = FADoubleTraits::allocate(factor_alloc_double, len);
-      memset(node.lcol, 0, len*sizeof(T));
+      //memset(node.lcol, 0, len*sizeof(T)); NOT REQUIRED as FactorAllocator
+      // is required to ensure it is zero for us (i.e. uses calloc)
 
       /* Get space for contribution block + (explicitly do not zero it!) */
       long contrib_dimn = snode.nrow - snode.ncol;
@@ -254,45 +280,21 @@ private:
          node.perm[i] = snode.rlist[i];
 
       /* Add A */
-      if(scaling) {
-         /* Scaling to apply */
-         for(int i=0; i<snode.num_a; i++) {
-            long src  = snode.amap[2*i+0] - 1; // amap contains 1-based values
-            long dest = snode.amap[2*i+1] - 1; // amap contains 1-based values
-            int c = dest / snode.nrow;
-            int r = dest % snode.nrow;
-            long k = c*ldl + r;
-            if(r >= snode.ncol) k += node.ndelay_in;
-            T rscale = scaling[ snode.rlist[r]-1 ];
-            T cscale = scaling[ snode.rlist[c]-1 ];
-            node.lcol[k] = rscale * aval[src] * cscale;
-         }
-      } else {
-         /* No scaling to apply */
-         for(int i=0; i<snode.num_a; i++) {
-            long src  = snode.amap[2*i+0] - 1; // amap contains 1-based values
-            long dest = snode.amap[2*i+1] - 1; // amap contains 1-based values
-            int c = dest / snode.nrow;
-            int r = dest % snode.nrow;
-            long k = c*ldl + r;
-            if(r >= snode.ncol) k += node.ndelay_in;
-            node.lcol[k] = aval[src];
-         }
-      }
+      add_a_block(0, snode.ncol, snode, node.ndelay_in, aval, scaling, afac,
+            node.lcol, ldl);
 
       /* Add children */
-      if(node.first_child != NULL) {
-         /* Build lookup vector, allowing for insertion of delayed vars */
-         /* Note that while rlist[] is 1-indexed this is fine so long as lookup
-          * is also 1-indexed (which it is as it is another node's rlist[] */
-         for(int i=0; i<snode.ncol; i++)
-            map[ snode.rlist[i] ] = i;
-         for(int i=snode.ncol; i<snode.nrow; i++)
-            map[ snode.rlist[i] ] = i + node.ndelay_in;
+      if(node.first_child != NULL || snode.contrib.size() > 0) {
          /* Loop over children adding contributions */
          int delay_col = snode.ncol;
          for(auto* child=node.first_child; child!=NULL; child=child->next_child) {
             SymbolicNode const& csnode = child->symb;
+            /* Find rows of node corresponding to child's rows, allowing for
+             * insertion of delayed vars */
+            int cm = csnode.nrow - csnode.ncol;
+            int* map = work.get_ptr<int>(cm);
+            map_child_rows(0, cm, csnode.rmap, snode.ncol, node.ndelay_in,
+                  map);
             /* Handle delays - go to back of node
              * (i.e. become the last rows as in lower triangular format) */
             for(int i=0; i<child->ndelay_out; i++) {
@@ -308,7 +310,7 @@ private:
                dest = node.lcol;
                src = &child->lcol[child->nelim*lds + child->ndelay_in +i*lds];
                for(int j=csnode.ncol; j<csnode.nrow; j++) {
-                  int r = map[ csnode.rlist[j] ];
+                  int r = map[j-csnode.ncol];
                   if(r < ncol) dest[r*ldl+delay_col] = src[j];
                   else         dest[delay_col*ldl+r] = src[j];
                }
@@ -317,19 +319,64 @@ private:
 
             /* Handle expected contributions (only if something there) */
             if(child->contrib) {
-               int cm = csnode.nrow - csnode.ncol;
                for(int i=0; i<cm; i++) {
-                  int c = map[ csnode.rlist[csnode.ncol+i] ];
+                  int c = map[i];
                   T *src = &child->contrib[i*cm];
                   // NB: we handle contribution to contrib in assemble_post()
                   if(c < snode.ncol) {
                      // Contribution added to lcol
                      int ldd = align_lda<T>(nrow);
                      T *dest = &node.lcol[c*ldd];
-                     for(int j=i; j<cm; j++) {
-                        int r = map[ csnode.rlist[csnode.ncol+j] ];
-                        dest[r] += src[j];
-                     }
+                     asm_col_runs(i, cm, csnode.nrun, csnode.rrun, map, src,
+                           dest);
+                  }
+               }
+            }
+         }
+         /* Add any contribution block from other subtrees */
+         for(int contrib_idx : snode.contrib) {
+            int cn, ldcontrib, ndelay, lddelay;
+            double const *cval, *delay_val;
+            int const *crlist, *delay_perm;
+            spral_ssids_contrib_get_data(
+                  child_contrib[contrib_idx], &cn, &cval, &ldcontrib, &crlist,
+                  &ndelay, &delay_perm, &delay_val, &lddelay
+                  );
+            int* map = work.get_ptr<int>(cn);
+            map_contrib_rows(cn, crlist, snode, node.ndelay_in, map);
+            /* Handle delays - go to back of node
+             * (i.e. become the last rows as in lower triangular format) */
+            for(int i=0; i<ndelay; i++) {
+               // Add delayed rows (from delayed cols)
+               T *dest = &node.lcol[delay_col*(ldl+1)];
+               T const* src = &delay_val[i*(lddelay+1)];
+               node.perm[delay_col] = delay_perm[i];
+               for(int j=0; j<ndelay-i; j++) {
+                  dest[j] = src[j];
+               }
+               // Add child's non-fully summed rows (from delayed cols)
+               dest = node.lcol;
+               src = &delay_val[i*lddelay+ndelay];
+               for(int j=0; j<cn; j++) {
+                  int r = map[j];
+                  if(r < ncol) dest[r*ldl+delay_col] = src[j];
+                  else         dest[delay_col*ldl+r] = src[j];
+               }
+               delay_col++;
+            }
+            if(!cval) continue; // child was all delays, nothing more to do
+            /* Handle expected contribution */
+            for(int i=0; i<cn; i++) {
+               int c = map[i];
+               T const* src = &cval[i*ldcontrib];
+               // NB: we handle contribution to contrib in assemble_post()
+               if(c < snode.ncol) {
+                  // Contribution added to lcol
+                  int ldd = align_lda<T>(nrow);
+                  T *dest = &node.lcol[c*ldd];
+                  for(int j=i; j<cn; j++) {
+                     int r = map[j];
+                     dest[r] += src[j];
                   }
                }
             }
@@ -378,7 +425,7 @@ private:
       stats.num_delay += node->ndelay_out;
 
       /* Mark as no contribution if we make no contribution */
-      if(node->nelim==0 && !node->first_child) {
+      if(node->nelim==0 && !node->first_child && snode.contrib.size()==0) {
          // FIXME: Actually loop over children and check one exists with contrib
          //        rather than current approach of just looking for children.
          node->free_contrib();
@@ -393,41 +440,66 @@ private:
          SymbolicNode const& snode,
          NumericNode<T,PoolAllocator>& node,
          PoolAllocator& pool_alloc,
-         int* map
+         Workspace& work,
+         void** child_contrib
          ) {
       /* Initialise variables */
       int ncol = snode.ncol + node.ndelay_in;
 
       /* Add children */
-      if(node.first_child != NULL) {
-         /* Build lookup vector, allowing for insertion of delayed vars */
-         /* Note that while rlist[] is 1-indexed this is fine so long as lookup
-          * is also 1-indexed (which it is as it is another node's rlist[] */
-         for(int i=0; i<snode.ncol; i++)
-            map[ snode.rlist[i] ] = i;
-         for(int i=snode.ncol; i<snode.nrow; i++)
-            map[ snode.rlist[i] ] = i + node.ndelay_in;
+      if(node.first_child != NULL || snode.contrib.size() > 0) {
          /* Loop over children adding contributions */
          for(auto* child=node.first_child; child!=NULL; child=child->next_child) {
             SymbolicNode const& csnode = child->symb;
             if(!child->contrib) continue;
             int cm = csnode.nrow - csnode.ncol;
-            for(int i=0; i<cm; i++) {
-               int c = map[ csnode.rlist[csnode.ncol+i] ];
+            int* map = work.get_ptr<int>(cm);
+            map_child_rows(0, cm, csnode.rmap, snode.ncol, node.ndelay_in,
+                  map);
+            // NB: only interested in contribution to generated element, i.e.
+            // rows from the first that maps beyond ncol (rows are in order)
+            int i = 0;
+            for(; i<cm && map[i]<ncol; i++);
+            for(int j=i; j<cm; j++)
+               map[j] -= ncol;
+            for(; i<cm; i++) {
+               // Contribution added to contrib
                T *src = &child->contrib[i*cm];
+               int ldd = snode.nrow - snode.ncol;
+               T *dest = &node.contrib[map[i]*ldd];
+               asm_col_runs(i, cm, csnode.nrun, csnode.rrun, map, src, dest);
+            }
+            /* Free memory from child contribution block */
+            child->free_contrib();
+         }
+         /* Add any contribution block from other subtrees */
+         for(int contrib_idx : snode.contrib) {
+            int cn, ldcontrib, ndelay, lddelay;
+            double const *cval, *delay_val;
+            int const *crlist, *delay_perm;
+            spral_ssids_contrib_get_data(
+                  child_contrib[contrib_idx], &cn, &cval, &ldcontrib, &crlist,
+                  &ndelay, &delay_perm, &delay_val, &lddelay
+                  );
+            if(!cval) continue; // child was all delays, nothing to do
+            int* map = work.get_ptr<int>(cn);
+            map_contrib_rows(cn, crlist, snode, node.ndelay_in, map);
+            for(int i=0; i<cn; i++) {
+               int c = map[i];
+               T const* src = &cval[i*ldcontrib];
                // NB: only interested in contribution to generated element
                if(c >= snode.ncol) {
                   // Contribution added to contrib
                   int ldd = snode.nrow - snode.ncol;
                   T *dest = &node.contrib[(c-ncol)*ldd];
-                  for(int j=i; j<cm; j++) {
-                     int r = map[ csnode.rlist[csnode.ncol+j] ] - ncol;
+                  for(int j=i; j<cn; j++) {
+                     int r = map[j] - ncol;
                      dest[r] += src[j];
                   }
                }
             }
             /* Free memory from child contribution block */
-            child->free_contrib();
+            spral_ssids_contrib_free_dbl(child_contrib[contrib_idx]);
          }
       }
    }
@@ -5,7 +5,7 @@
  */
 #pragma once
 
-#include <memory>
+#include <vector>
 
 #include "ssids/cpu/cpu_iface.hxx"
 #include "ssids/cpu/SymbolicNode.hxx"
@@ -23,6 +23,11 @@ class SymbolicSubtree;
  *
  * It is expected that the subtree will fit within L2 cache exclusively owned
  * by the executing thread.
+ *
+ * The same machinery is also used for small subtrees in the middle of the
+ * tree. These receive contributions from children that are not part of the
+ * subtree and/or from other parttrees, and can only be started once those
+ * are available (see has_inputs()).
  */
 class SmallLeafSymbolicSubtree {
 private:
@@ -31,7 +36,6 @@ private:
       int nrow;
       int ncol;
       int sparent;
-      int* rlist;
       int lcol_offset;
    };
 
@@ -60,55 +64,44 @@ public:
     * \param rptr Row list pointers. Supernode i consists of rows
     *        row_list[rptr[i]-1:rptr[i+1]-1-1]. Note entries are numbered from 1
     *        not 0.
-    * \param rlist Row lists. Supernode i consists of rows
-    *        row_list[rptr[i]-1:rptr[i+1]-1-1]. Note entries are numbered from 1
-    *        not 0.
     * \param nptr Node pointers for map from \f$ A \f$ to \f$ L \f$. Node i
     *        has map entries nlist[2*(nptr[i]-1):2*(nptr[i+1]-1-1)+1].
     *        Note entries are numbered from 1 not 0.
     * \param nlist Mapping from \f$ A \f$ to \f$ L \f$. Each map entry is a
     *        pair such that entry nlist[2*i+0] of \f$ A \f$ maps to entry
     *        nlist[2*i+1] of the relevant supernode (as per nptr) of \f$ L \f$.
+    * \param has_inputs True if the subtree receives contributions from nodes
+    *        outside itself (i.e. it is not a leaf subtree), either from other
+    *        nodes of the parttree or from other parttrees.
     * \param symb Underlying SymbolicSubtree for containing parttree.
     */
-   SmallLeafSymbolicSubtree(int sa, int en, int part_offset, int const* sptr, int const* sparent, long const* rptr, int const* rlist, long const* nptr, long const* nlist, SymbolicSubtree const& symb)
+   SmallLeafSymbolicSubtree(int sa, int en, int part_offset, int const* sptr, int const* sparent, long const* rptr, long const* nptr, long const* nlist, bool has_inputs, SymbolicSubtree const& symb)
    : sa_(sa), en_(en), nnodes_(en-sa+1), parent_(sparent[part_offset+en]-1-part_offset),
-     nodes_(nnodes_),
-     rlist_(new int[rptr[part_offset+en+1]-rptr[part_offset+sa]], std::default_delete<int[]>()),
+     has_inputs_(has_inputs), nodes_(nnodes_),
      nptr_(nptr), nlist_(nlist), symb_(symb)
    {
       /* Setup basic node information */
       nfactor_ = 0;
-      int* newrlist = rlist_.get();
       for(int ni=sa; ni<=en; ++ni) {
          nodes_[ni-sa].nrow = rptr[part_offset+ni+1] - rptr[part_offset+ni];
          nodes_[ni-sa].ncol = sptr[part_offset+ni+1] - sptr[part_offset+ni];
          nodes_[ni-sa].sparent = sparent[part_offset+ni]-sa-1; // sparent is Fortran indexed
-         // FIXME: subtract ncol off rlist for elim'd vars
-         nodes_[ni-sa].rlist = &newrlist[rptr[part_offset+ni]-rptr[part_offset+sa]];
          nodes_[ni-sa].lcol_offset = nfactor_;
          size_t ldl = align_lda<double>(nodes_[ni-sa].nrow);
          nfactor_ += nodes_[ni-sa].ncol*ldl;
       }
-      /* Construct rlist_ being offsets into parent node */
-      for(int ni=sa; ni<=en; ++ni) {
-         if(nodes_[ni-sa].ncol == nodes_[ni-sa].nrow) continue; // is root
-         int const* ilist = &rlist[rptr[part_offset+ni]-1]; // rptr is Fortran indexed
-         ilist += nodes_[ni-sa].ncol; // Skip eliminated vars
-         int pnode = sparent[part_offset+ni]-1; //Fortran indexed
-         int const* jlist = &rlist[rptr[pnode]-1]; // rptr is Fortran indexed
-         int const* jstart = jlist;
-         int *outlist = nodes_[ni-sa].rlist;
-         for(int i=nodes_[ni-sa].ncol; i<nodes_[ni-sa].nrow; ++i) {
-            for(; *ilist != *jlist; ++jlist); // Finds match in jlist
-            *(outlist++) = jlist - jstart;
-            ++ilist;
-         }
-      }
+      /* NB: Offsets of each node's rows into its parent are held in
+       * SymbolicNode::rmap, set up by the containing SymbolicSubtree. */
    }
 
    /** \brief Return parent node of subtree in parttree indexing. */
    int get_parent() const { return parent_; }
+   /** \brief Return first node of subtree in parttree indexing. */
+   int get_first() const { return sa_; }
+   /** \brief Return root node of subtree in parttree indexing. */
+   int get_root() const { return en_; }
+   /** \brief Return true if subtree has inputs from outside itself. */
+   bool has_inputs() const { return has_inputs_; }
    /** \brief Return given node of this tree. */
    Node const& operator[](int idx) const { return nodes_[idx]; }
 protected:
@@ -117,8 +110,8 @@ protected:
    int nnodes_; //< Number of nodes in subtree.
    int nfactor_; //< Number of entries in factor for subtree.
    int parent_; //< Parent of subtree in parttree.
+   bool has_inputs_; //< True if subtree has external children/contributions.
    std::vector<Node> nodes_; //< Nodes of this subtree.
-   std::shared_ptr<int> rlist_; //< Row entries of this subtree.
    long const* nptr_; //< Node mapping into nlist_.
    long const* nlist_; //< Mapping from \f$ A \f$ to \f$ L \f$.
    SymbolicSubtree const& symb_; //< Underlying parttree
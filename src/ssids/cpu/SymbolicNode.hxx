@@ -11,15 +11,30 @@ namespace spral { namespace ssids { namespace cpu {
 
 /** Symbolic representation of a node */
 struct SymbolicNode {
-   bool insmallleaf;
+   bool insmallleaf; //< True if node is handled by a small subtree
    int idx; //< Index of node
+   int small_root; //< Root of containing small subtree (or idx if none)
    int nrow; //< Number of rows
    int ncol; //< Number of columns
    SymbolicNode* first_child; //< Pointer to first child in linked list
    SymbolicNode* next_child; //< Pointer to second child in linked list
    int const* rlist; //< Pointer to row lists
+   int const* rmap; //< Position of rows rlist[ncol:nrow-1] in parent's rlist
+                    //  (nullptr if parent is not in this subtree)
+   int nrun; //< Number of contiguous runs in rmap
+   int const* rrun; //< (start, length) of each contiguous run in rmap
    int num_a; //< Number of entries mapped from A to L
-   long const* amap; //< Pointer to map from A to L locations
+   int const* aptr; //< Entries aptr[c]:aptr[c+1]-1 of A map to column c
+   int const* asplit; //< Entries asplit[c]:aptr[c+1]-1 of column c map to
+                      //  rows beyond the fully summed ones (i.e. after delays)
+   int const* arow; //< Row within node of each entry of A (ignoring delays)
+   int const* ascale; //< Index into scaling of each entry's row variable
+   long const* asrc; //< Index into user's value array of each entry of A
+   size_t aoff; //< Offset of node's entries within subtree-wide A map
+   long flops; //< Flops to factorize node (ignoring delays)
+   long path_flops; //< Flops on longest leaf-to-root path through node
+   int task; //< Task containing node: idx, or nnodes+si if in small subtree si
+   int nchild_task; //< Number of child tasks (if node is root of a task)
    int parent; //< index of parent node
    std::vector<int> contrib; //< index of expected contribution(s)
 };
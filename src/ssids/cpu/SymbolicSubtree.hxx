@@ -5,11 +5,15 @@
  */
 #pragma once
 
+#include <algorithm>
 #include <cstddef>
+#include <tuple>
+#include <utility>
 #include <vector>
 
 #include "ssids/cpu/SmallLeafSymbolicSubtree.hxx"
 #include "ssids/cpu/SymbolicNode.hxx"
+#include "ssids/cpu/kernels/ldlt_app.hxx"
 
 namespace spral { namespace ssids { namespace cpu {
 
@@ -23,7 +27,6 @@ public:
       sa--;
       // FIXME: don't process nodes that are in small leaf subtrees
       /* Fill out basic details */
-      maxfront_ = 0;
       for(int ni=0; ni<nnodes_; ++ni) {
          nodes_[ni].idx = ni;
          nodes_[ni].nrow = static_cast<int>(rptr[sa+ni+1] - rptr[sa+ni]);
@@ -32,11 +35,72 @@ public:
          nodes_[ni].next_child = nullptr;
          nodes_[ni].rlist = &rlist[rptr[sa+ni]-1]; // rptr is Fortran indexed
          nodes_[ni].num_a = nptr[sa+ni+1] - nptr[sa+ni];
-         nodes_[ni].amap = &nlist[2*(nptr[sa+ni]-1)]; // nptr is Fortran indexed
          nodes_[ni].parent = sparent[sa+ni]-sa-1; // sparent is Fortran indexed
          nodes_[ni].insmallleaf = false; // default to not in small leaf subtree
-         maxfront_ = std::max(maxfront_, (size_t) nodes_[ni].nrow);
+         nodes_[ni].small_root = ni;
       }
+      nodes_[nnodes_].idx = nnodes_;
+      nodes_[nnodes_].small_root = nnodes_;
+      nodes_[nnodes_].rmap = nullptr;
+      nodes_[nnodes_].num_a = 0;
+      /* Sort map from A to L of each node by column, then row, and split
+       * each column at the end of the fully summed rows. Adding A is then a
+       * streaming loop without division or further indirection. */
+      setup_amap(sa, nptr, nlist);
+      /* Find position of each node's uneliminated rows within its parent's
+       * row list, so that numeric assembly is a direct gather/scatter. As
+       * with SmallLeafSymbolicSubtree, we rely on rows appearing in the same
+       * order in the parent as in the child. */
+      size_t rmap_len = 0;
+      for(int ni=0; ni<nnodes_; ++ni)
+         if(nodes_[ni].parent < nnodes_)
+            rmap_len += nodes_[ni].nrow - nodes_[ni].ncol;
+      rmap_.resize(rmap_len);
+      rmap_len = 0;
+      for(int ni=0; ni<nnodes_; ++ni) {
+         nodes_[ni].rmap = nullptr;
+         if(nodes_[ni].parent >= nnodes_) continue; // Parent in another subtree
+         int* outlist = rmap_.data() + rmap_len;
+         nodes_[ni].rmap = outlist;
+         rmap_len += nodes_[ni].nrow - nodes_[ni].ncol;
+         SymbolicNode const& pnode = nodes_[ nodes_[ni].parent ];
+         int const* jlist = pnode.rlist;
+         for(int i=nodes_[ni].ncol; i<nodes_[ni].nrow; ++i) {
+            for(; *jlist != nodes_[ni].rlist[i]; ++jlist); // Find match
+            *(outlist++) = jlist - pnode.rlist;
+         }
+      }
+      /* Record runs of rmap that are contiguous in the parent, so that they
+       * can be assembled using vector operations. Runs are split where they
+       * cross the parent's fully summed columns, as delays may be inserted
+       * there. Short runs are not worth the overhead and are left to be
+       * scattered entry by entry. */
+      int const min_run = 4;
+      std::vector<size_t> rrun_offset(nnodes_+1, 0);
+      nodes_[nnodes_].nrun = 0;
+      for(int ni=0; ni<nnodes_; ++ni) {
+         nodes_[ni].nrun = 0;
+         rrun_offset[ni] = rrun_.size();
+         if(!nodes_[ni].rmap) continue;
+         int const* rmap = nodes_[ni].rmap;
+         int pncol = nodes_[ nodes_[ni].parent ].ncol;
+         int cm = nodes_[ni].nrow - nodes_[ni].ncol;
+         for(int j=0; j<cm; ) {
+            int len = 1;
+            while(j+len < cm && rmap[j+len] == rmap[j]+len &&
+                  (rmap[j] >= pncol || rmap[j+len] < pncol))
+               ++len;
+            if(len >= min_run) {
+               rrun_.push_back(j);
+               rrun_.push_back(len);
+               ++nodes_[ni].nrun;
+            }
+            j += len;
+         }
+      }
+      for(int ni=0; ni<nnodes_; ++ni)
+         nodes_[ni].rrun = rrun_.data() + rrun_offset[ni];
+      nodes_[nnodes_].rrun = nullptr;
       nodes_[nnodes_].first_child = nullptr; // List of roots
       /* Build child linked lists */
       for(int ni=0; ni<nnodes_; ++ni) {
@@ -53,6 +117,31 @@ public:
       nfactor_ = 0;
       for(int ni=0; ni<nnodes_; ++ni)
          nfactor_ += static_cast<size_t>(nodes_[ni].nrow)*nodes_[ni].ncol;
+      /* Find flops on the longest leaf-to-root path through each node: the
+       * longest path from a leaf up to the node (children precede parents)
+       * plus the path from the node to the root (parents follow children).
+       * These give task priorities, so that chains on the critical path are
+       * started first. */
+      {
+         std::vector<long> node_flops(nnodes_), below(nnodes_+1, 0),
+            above(nnodes_+1, 0);
+         for(int ni=0; ni<nnodes_; ++ni) {
+            node_flops[ni] = 0;
+            for(long k=0; k<nodes_[ni].ncol; ++k)
+               node_flops[ni] += (nodes_[ni].nrow - k)*(nodes_[ni].nrow - k);
+            nodes_[ni].flops = node_flops[ni];
+            below[ni] += node_flops[ni];
+            int parent = std::min(nodes_[ni].parent, nnodes_);
+            below[parent] = std::max(below[parent], below[ni]);
+         }
+         for(int ni=nnodes_-1; ni>=0; --ni) {
+            int parent = std::min(nodes_[ni].parent, nnodes_);
+            above[ni] = node_flops[ni] + above[parent];
+            nodes_[ni].path_flops = below[ni] + above[ni] - node_flops[ni];
+         }
+         nodes_[nnodes_].path_flops = 0;
+         max_path_flops_ = below[nnodes_];
+      }
       /* Find small leaf subtrees */
       // Count flops below each node
       std::vector<long> flops(nnodes_+1, 0);
@@ -75,12 +164,54 @@ public:
          if(last==ni) { ++ni; continue; } // No point for a single node
          // Nodes ni:last are in subtree
          small_leafs_.emplace_back(
-               ni, last, sa, sptr, sparent, rptr, rlist, nptr, nlist, *this
+               ni, last, sa, sptr, sparent, rptr, nptr, nlist, false,
+               *this
                );
-         for(int i=ni; i<=last; ++i)
+         for(int i=ni; i<=last; ++i) {
             nodes_[i].insmallleaf = true;
+            nodes_[i].small_root = last;
+         }
          ni = last+1; // Skip to next node not in this subtree
       }
+      /* Find small subtrees in the middle of the tree. These receive inputs
+       * from children outside the subtree (large nodes or small leaf
+       * subtrees) and/or from other parttrees. As the tree is postordered,
+       * nodes ni:en form a subtree rooted at en iff every node ni:en-1 has its
+       * parent in ni:en. Any child of such a node with index below ni is
+       * external and will be finished before the subtree starts. */
+      for(int ni=0; ni<nnodes_; ) {
+         long cost = 0;
+         int maxparent = ni; // Largest parent of nodes ni:en-1
+         int last = ni;
+         for(int en=ni; en<nnodes_; ++en) {
+            if(nodes_[en].insmallleaf) break;
+            if(en>ni) maxparent = std::max(maxparent, nodes_[en-1].parent);
+            // Cost of node itself plus assembly of any external children
+            for(int k=0; k<nodes_[en].ncol; ++k)
+               cost += (nodes_[en].nrow - k)*(nodes_[en].nrow - k);
+            for(auto* child=nodes_[en].first_child; child;
+                  child=child->next_child) {
+               if(child->idx >= ni) continue; // internal to subtree
+               long cm = child->nrow - child->ncol;
+               cost += cm*cm;
+            }
+            if(cost >= options.small_subtree_threshold) break;
+            if(maxparent <= en) last = en; // ni:en is a subtree
+         }
+         if(last==ni) { ++ni; continue; } // No point for a single node
+         // Nodes ni:last are in subtree
+         small_leafs_.emplace_back(
+               ni, last, sa, sptr, sparent, rptr, nptr, nlist, true,
+               *this
+               );
+         for(int i=ni; i<=last; ++i) {
+            nodes_[i].insmallleaf = true;
+            nodes_[i].small_root = last;
+         }
+         ni = last+1; // Skip to next node not in this subtree
+      }
+      setup_tasks();
+      setup_pool_size(options);
    }
 
    SymbolicNode const& operator[](int idx) const {
@@ -90,18 +221,232 @@ public:
       size_t mem = n*sizeof(int) + (2*n+nfactor_)*sizeof(double);
       return std::max(mem, static_cast<size_t>(mem*multiplier));
    }
+   /** \brief Return initial size of pool for contribution blocks (and
+    *         backups of nodes being factorized), as a number of T.
+    *
+    * This is twice the predicted peak (see setup_pool_size()) to allow for
+    * fragmentation of the buddy allocator, so that no further pages are
+    * needed unless there are delayed pivots.
+    *  \param posdef True if matrix is positive definite.
+    *  \param nthreads Number of threads factorizing the subtree. */
    template <typename T>
-   size_t get_pool_size() const {
-      return maxfront_*align_lda<double>(maxfront_);
+   size_t get_pool_size(bool posdef, int nthreads) const {
+      int level = 0;
+      while(level < max_pool_level && (1<<level) < nthreads) ++level;
+      return std::max(2*pool_size_[posdef ? 0 : 1][level], size_t(1));
+   }
+   /** \brief Return root node of task ti, as for SymbolicNode::task. */
+   int get_task_root(int ti) const {
+      return (ti < nnodes_) ? ti : small_leafs_[ti-nnodes_].get_root();
+   }
+   /** \brief Return number of entries of A mapped into subtree's factors. */
+   size_t get_num_a() const {
+      return asrc_.size();
    }
 public:
    int const n; //< Maximum row index
 private:
+   /** \brief Set up SymbolicNode::aptr etc. from nlist.
+    *  \param sa First node of subtree (0-based) in global numbering.
+    *  \param nptr Node pointers into nlist (Fortran indexed).
+    *  \param nlist Pairs (src, dest) mapping entries of A to L (Fortran
+    *         indexed), where dest is relative to its node. */
+   void setup_amap(int sa, long const* nptr, long const* nlist) {
+      size_t ptr_len = 0, a_len = 0;
+      for(int ni=0; ni<nnodes_; ++ni) {
+         ptr_len += nodes_[ni].ncol+1;
+         a_len += nodes_[ni].num_a;
+      }
+      aptr_.resize(2*ptr_len);
+      arow_.resize(2*a_len);
+      asrc_.resize(a_len);
+      std::vector<std::tuple<int,int,long>> entries;
+      size_t ptr_off = 0, a_off = 0;
+      for(int ni=0; ni<nnodes_; ++ni) {
+         SymbolicNode& node = nodes_[ni];
+         long const* amap = &nlist[2*(nptr[sa+ni]-1)]; // nptr is Fortran indexed
+         entries.clear();
+         entries.reserve(node.num_a);
+         for(int i=0; i<node.num_a; ++i) {
+            long src  = amap[2*i+0] - 1; // amap contains 1-based values
+            long dest = amap[2*i+1] - 1; // amap contains 1-based values
+            entries.emplace_back(dest / node.nrow, dest % node.nrow, src);
+         }
+         std::sort(entries.begin(), entries.end());
+         int* ptr = aptr_.data() + ptr_off;
+         int* split = ptr + node.ncol+1;
+         int* row = arow_.data() + a_off;
+         int* scale = row + node.num_a;
+         long* src = asrc_.data() + a_off/2;
+         for(int c=0; c<=node.ncol; ++c) ptr[c] = 0;
+         for(int i=0; i<node.num_a; ++i) {
+            int c = std::get<0>(entries[i]);
+            int r = std::get<1>(entries[i]);
+            ++ptr[c+1];
+            row[i] = r;
+            scale[i] = node.rlist[r]-1;
+            src[i] = std::get<2>(entries[i]);
+         }
+         for(int c=0; c<node.ncol; ++c) ptr[c+1] += ptr[c];
+         for(int c=0; c<node.ncol; ++c) {
+            split[c] = ptr[c];
+            while(split[c] < ptr[c+1] && row[split[c]] < node.ncol) ++split[c];
+         }
+         node.aptr = ptr;
+         node.asplit = split;
+         node.arow = row;
+         node.ascale = scale;
+         node.asrc = src;
+         node.aoff = a_off/2;
+         ptr_off += 2*(node.ncol+1);
+         a_off += 2*node.num_a;
+      }
+   }
+
+   /** \brief Set up pool_size_, the predicted peak memory use of the pool
+    *         allocator, without delays, using 2^t threads.
+    *
+    * The pool holds the contribution block of each node from when the node
+    * is assembled until its parent is factorized, and (if indefinite) a
+    * backup of each node while it is factorized, together with the backups
+    * of its leading diagonal block made as ldlt_app recurses to smaller
+    * block sizes. Each allocation is rounded up to a power of two, as by
+    * the buddy allocator.
+    *
+    * With q threads, we assume the children of a node are processed in order
+    * with up to w=min(q, nchild) active at once, each with q/w threads, and
+    * take the peak over all windows of w consecutive children (Liu's serial
+    * peak when w=1). Small subtrees are processed by a single task, so their
+    * nodes take w=1.
+    *
+    * \param options User-supplied options, as used by ldlt_app.
+    */
+   void setup_pool_size(struct cpu_factor_options const& options) {
+      int const nlevel = max_pool_level+1;
+      auto buddy_size = [](size_t sz) {
+         size_t bsz = 1;
+         while(bsz < sz) bsz *= 2;
+         return (sz>0) ? bsz : 0;
+      };
+      std::vector<size_t> cb(nnodes_+1, 0);
+      std::vector<size_t> peak(2*nlevel*nnodes_);
+      auto node_peak = [&peak, nlevel](int ni, int indef, int level)
+         -> size_t& { return peak[(2*ni+indef)*nlevel+level]; };
+      std::vector<int> children;
+      for(int ni=0; ni<=nnodes_; ++ni) {
+         size_t backup = 0;
+         if(ni < nnodes_) {
+            size_t m = nodes_[ni].nrow - nodes_[ni].ncol;
+            cb[ni] = buddy_size(m*m);
+            for(size_t sz : ldlt_app_backup_sizes<double>(nodes_[ni].nrow,
+                     nodes_[ni].ncol, options))
+               backup += buddy_size(sz);
+         }
+         // Children in order of factorization
+         children.clear();
+         size_t sum_cb = 0;
+         for(auto* child=nodes_[ni].first_child; child;
+               child=child->next_child) {
+            children.push_back(child->idx);
+            sum_cb += cb[child->idx];
+         }
+         std::reverse(children.begin(), children.end());
+         int nchild = children.size();
+         for(int indef=0; indef<2; ++indef) {
+            for(int level=0; level<nlevel; ++level) {
+               int w = (nodes_[ni].insmallleaf) ? 1
+                                                : std::min(1<<level, nchild);
+               int clevel = level;
+               while(clevel > 0 && w*(1<<clevel) > (1<<level)) --clevel;
+               size_t done = 0, active = 0, best = 0;
+               for(int j=0; j<nchild; ++j) {
+                  active += node_peak(children[j], indef, clevel);
+                  if(j >= w) {
+                     active -= node_peak(children[j-w], indef, clevel);
+                     done += cb[children[j-w]];
+                  }
+                  best = std::max(best, done+active);
+               }
+               best = std::max(best, sum_cb + cb[ni] + (indef ? backup : 0));
+               // Peak of virtual root is that of the whole subtree
+               if(ni < nnodes_) node_peak(ni, indef, level) = best;
+               else pool_size_[indef][level] = best;
+            }
+         }
+      }
+   }
+
+   /** \brief Set up SymbolicNode::task and nchild_task, and cp_order_, a
+    *         task creation order preferring deep chains.
+    *
+    * Tasks are nodes outside small subtrees and the small subtrees
+    * themselves. Starting from tasks with no children, we repeatedly take
+    * the available task whose root has the longest critical path, releasing
+    * its parent once all the parent's children are taken. The result is a
+    * valid (children first) order for creating dependent tasks in which the
+    * leaves of the longest chains come first.
+    */
+   void setup_tasks() {
+      int nsmall = small_leafs_.size();
+      // Task representing each node: ni itself or nnodes_+si for subtree si
+      for(int ni=0; ni<nnodes_; ++ni) {
+         nodes_[ni].task = ni;
+         nodes_[ni].nchild_task = 0;
+      }
+      nodes_[nnodes_].task = -1; // virtual root
+      for(int si=0; si<nsmall; ++si)
+         nodes_[small_leafs_[si].get_root()].task = nnodes_+si;
+      for(int ni=nnodes_-1; ni>=0; --ni)
+         if(nodes_[ni].insmallleaf)
+            nodes_[ni].task = nodes_[nodes_[ni].small_root].task;
+      // Count children of each task that are other tasks
+      for(int ni=0; ni<nnodes_; ++ni) {
+         SymbolicNode& parent = nodes_[ std::min(nodes_[ni].parent, nnodes_) ];
+         if(parent.task >= 0 && parent.task != nodes_[ni].task)
+            ++nodes_[parent.small_root].nchild_task;
+      }
+      // List schedule by critical path
+      std::vector<int> nwait(nnodes_+nsmall, 0);
+      std::vector<std::pair<long,int>> ready; // (path_flops, -task) heap
+      for(int ti=0; ti<nnodes_+nsmall; ++ti) {
+         if(ti<nnodes_ && nodes_[ti].insmallleaf) continue; // not a task
+         SymbolicNode const& root = nodes_[get_task_root(ti)];
+         nwait[ti] = root.nchild_task;
+         if(nwait[ti]==0) ready.emplace_back(root.path_flops, -ti);
+      }
+      std::make_heap(ready.begin(), ready.end());
+      cp_order_.clear();
+      cp_order_.reserve(nnodes_+nsmall);
+      while(!ready.empty()) {
+         std::pop_heap(ready.begin(), ready.end());
+         int ti = -ready.back().second;
+         ready.pop_back();
+         cp_order_.push_back(ti);
+         int parent = std::min(nodes_[get_task_root(ti)].parent, nnodes_);
+         int pt = nodes_[parent].task;
+         if(pt >= 0 && --nwait[pt]==0) {
+            ready.emplace_back(nodes_[get_task_root(pt)].path_flops, -pt);
+            std::push_heap(ready.begin(), ready.end());
+         }
+      }
+   }
+
+   static int const max_pool_level = 10; //< Largest t in pool_size_
    int nnodes_;
    size_t nfactor_;
-   size_t maxfront_;
+   size_t pool_size_[2][max_pool_level+1]; //< Predicted pool size for posdef
+                                           //  (0) and indefinite (1) matrices
+                                           //  using 2^t threads
+   long max_path_flops_; //< Flops on longest leaf-to-root path
    std::vector<SymbolicNode> nodes_;
+   std::vector<int> rmap_; //< Storage for SymbolicNode::rmap
+   std::vector<int> rrun_; //< Storage for SymbolicNode::rrun
+   std::vector<int> aptr_; //< Storage for SymbolicNode::aptr and asplit
+   std::vector<int> arow_; //< Storage for SymbolicNode::arow and ascale
+   std::vector<long> asrc_; //< Storage for SymbolicNode::asrc
    std::vector<SmallLeafSymbolicSubtree> small_leafs_;
+   std::vector<int> cp_order_; //< Critical path task order: node ni, or small
+                               //  subtree si if ni>=nnodes_ (as si+nnodes_)
 
    template <bool posdef, typename T, size_t PAGE_SIZE, typename FactorAlloc>
    friend class NumericSubtree;
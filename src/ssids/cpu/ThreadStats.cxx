@@ -24,8 +24,43 @@ ThreadStats& ThreadStats::operator+=(ThreadStats const& other) {
    maxfront = std::max(maxfront, other.maxfront);
    not_first_pass += other.not_first_pass;
    not_second_pass += other.not_second_pass;
+   numa_local_bytes += other.numa_local_bytes;
+   numa_remote_bytes += other.numa_remote_bytes;
+   numa_interleaved_bytes += other.numa_interleaved_bytes;
+   alloc_bytes += other.alloc_bytes;
+   contrib_bytes += other.contrib_bytes;
+   pool_bytes += other.pool_bytes;
+   pool_pages_added += other.pool_pages_added;
+   for(int i=0; i<9; ++i)
+      cost_fit[i] += other.cost_fit[i];
+   busy_time += other.busy_time;
+   idle_time += other.idle_time;
 
    return *this;
 }
 
+/** \brief Record the time of a task for fitting a cost model.
+ *
+ * Adds the row (flops, entries, nodes)/seconds of a least squares fit against
+ * a right hand side of 1 to the normal equations in cost_fit: the upper
+ * triangle of the 3x3 matrix by rows, then the right hand side. The fit is
+ * performed by Fortran routine fit_part_costs().
+ *
+ * \param flops Flops of the task's nodes.
+ * \param entries Entries of the task's contribution blocks.
+ * \param nodes Number of nodes in task.
+ * \param seconds Time of task.
+ */
+void ThreadStats::add_task_time(double flops, double entries, double nodes,
+      double seconds) {
+   if(seconds <= 0.0) return;
+   double a[3] = { flops/seconds, entries/seconds, nodes/seconds };
+   int k = 0;
+   for(int i=0; i<3; ++i)
+   for(int j=i; j<3; ++j)
+      cost_fit[k++] += a[i]*a[j];
+   for(int i=0; i<3; ++i)
+      cost_fit[6+i] += a[i];
+}
+
 }}} /* namespace spral::ssids::cpu */
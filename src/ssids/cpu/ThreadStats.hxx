@@ -53,8 +53,22 @@ struct ThreadStats {
    int maxfront = 0;    ///< Maximum front size
    int not_first_pass = 0;    ///< Number of pivots not eliminated in APP
    int not_second_pass = 0;   ///< Number of pivots not eliminated in APP or TPP
+   long numa_local_bytes = 0; ///< Bytes of memory on NUMA node of team
+   long numa_remote_bytes = 0; ///< Bytes of memory on other NUMA node(s)
+   long numa_interleaved_bytes = 0; ///< Bytes of memory on NUMA nodes of a
+                                    ///  team spanning several of them
+   long alloc_bytes = 0; ///< Bytes of factor and workspace memory allocated
+   long contrib_bytes = 0; ///< Bytes of contributions from other subtrees
+   long pool_bytes = 0; ///< Initial size of contribution block pools
+   int pool_pages_added = 0; ///< Pages added to pools as they overflowed
+   double cost_fit[9] = {}; ///< Normal equations for fit of task times, see
+                            ///  add_task_time()
+   double busy_time = 0.0; ///< Time executing tasks of factorization (s)
+   double idle_time = 0.0; ///< Time not executing tasks of factorization (s)
 
    ThreadStats& operator+=(ThreadStats const& other);
+   void add_task_time(double flops, double entries, double nodes,
+         double seconds);
 };
 
 }}} /* namespaces spral::ssids::cpu */
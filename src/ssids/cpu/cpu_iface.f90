@@ -26,6 +26,9 @@ module spral_ssids_cpu_iface
       real(C_DOUBLE) :: multiplier
       integer(C_LONG) :: small_subtree_threshold
       integer(C_INT) :: cpu_block_size
+      integer(C_INT) :: cpu_inner_block_size
+      integer(C_INT) :: cholesky_schedule
+      integer(C_INT) :: tree_schedule
       integer(C_INT) :: pivot_method
       integer(C_INT) :: failed_pivot_method
    end type cpu_factor_options
@@ -45,6 +48,16 @@ module spral_ssids_cpu_iface
       integer(C_INT) :: maxfront
       integer(C_INT) :: not_first_pass
       integer(C_INT) :: not_second_pass
+      integer(C_LONG) :: numa_local_bytes
+      integer(C_LONG) :: numa_remote_bytes
+      integer(C_LONG) :: numa_interleaved_bytes
+      integer(C_LONG) :: alloc_bytes
+      integer(C_LONG) :: contrib_bytes
+      integer(C_LONG) :: pool_bytes
+      integer(C_INT) :: pool_pages_added
+      real(C_DOUBLE) :: cost_fit(9)
+      real(C_DOUBLE) :: busy_time
+      real(C_DOUBLE) :: idle_time
    end type cpu_factor_stats
 
 contains
@@ -62,6 +75,9 @@ subroutine cpu_copy_options_in(foptions, coptions)
    coptions%multiplier     = foptions%multiplier
    coptions%small_subtree_threshold = foptions%small_subtree_threshold
    coptions%cpu_block_size = foptions%cpu_block_size
+   coptions%cpu_inner_block_size = foptions%cpu_inner_block_size
+   coptions%cholesky_schedule = min(3, max(1, foptions%cholesky_schedule))
+   coptions%tree_schedule = min(3, max(1, foptions%tree_schedule))
    coptions%pivot_method   = min(3, max(1, foptions%pivot_method))
    coptions%failed_pivot_method = min(2, max(1, foptions%failed_pivot_method))
 end subroutine cpu_copy_options_in
@@ -84,6 +100,21 @@ subroutine cpu_copy_stats_out(cstats, finform)
    finform%maxfront     = max(finform%maxfront, cstats%maxfront)
    finform%not_first_pass = finform%not_first_pass + cstats%not_first_pass
    finform%not_second_pass = finform%not_second_pass + cstats%not_second_pass
+   finform%numa_local_bytes = finform%numa_local_bytes + &
+      cstats%numa_local_bytes
+   finform%numa_remote_bytes = finform%numa_remote_bytes + &
+      cstats%numa_remote_bytes
+   finform%numa_interleaved_bytes = finform%numa_interleaved_bytes + &
+      cstats%numa_interleaved_bytes
+   finform%cpu_alloc_bytes = finform%cpu_alloc_bytes + cstats%alloc_bytes
+   finform%cpu_contrib_bytes = finform%cpu_contrib_bytes + &
+      cstats%contrib_bytes
+   finform%cpu_pool_bytes = finform%cpu_pool_bytes + cstats%pool_bytes
+   finform%cpu_pool_pages_added = finform%cpu_pool_pages_added + &
+      cstats%pool_pages_added
+   finform%cost_fit(:) = finform%cost_fit(:) + cstats%cost_fit(:)
+   finform%cpu_busy_time = finform%cpu_busy_time + cstats%busy_time
+   finform%cpu_idle_time = finform%cpu_idle_time + cstats%idle_time
    finform%matrix_rank  = finform%matrix_rank - cstats%num_zero
 end subroutine cpu_copy_stats_out
 
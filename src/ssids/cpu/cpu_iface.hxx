@@ -20,6 +20,18 @@ enum struct FailedPivotMethod : int {
    pass           = 2
 };
 
+enum struct CholeskySchedule : int {
+   column         = 1,
+   row            = 2,
+   lookahead      = 3
+};
+
+enum struct TreeSchedule : int {
+   postorder      = 1,
+   critical_path  = 2,
+   ready          = 3
+};
+
 struct cpu_factor_options {
    int print_level;
    bool action;
@@ -28,6 +40,9 @@ struct cpu_factor_options {
    double multiplier;
    long small_subtree_threshold;
    int cpu_block_size;
+   int cpu_inner_block_size;
+   CholeskySchedule cholesky_schedule;
+   TreeSchedule tree_schedule;
    PivotMethod pivot_method;
    FailedPivotMethod failed_pivot_method;
 };
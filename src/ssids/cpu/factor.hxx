@@ -148,7 +148,8 @@ void factor_node_posdef(
    /* Perform factorization */
    int flag;
    cholesky_factor(
-         m, n, lcol, ldl, beta, contrib, m-n, options.cpu_block_size, &flag
+         m, n, lcol, ldl, beta, contrib, m-n, options.cpu_block_size, &flag,
+         options.cholesky_schedule
          );
    if(flag!=-1) {
       node.nelim = flag+1;
@@ -5,6 +5,7 @@
  */
 #pragma once
 
+#include<algorithm>
 #include<cstring>
 #include<memory>
 #include<vector>
@@ -14,6 +15,7 @@
 #include "ssids/cpu/NumericNode.hxx"
 #include "ssids/cpu/SymbolicNode.hxx"
 #include "ssids/cpu/Workspace.hxx"
+#include "ssids/cpu/kernels/SimdVec.hxx"
 
 namespace spral { namespace ssids { namespace cpu {
 
@@ -36,102 +38,254 @@ void asm_col(int n, int const* idx, T const* src, T* dest) {
       dest[ idx[j] ] += src[j];
 }
 
+/** Assemble a contiguous run.
+ *
+ * Performs the operation dest(:) += src(:) using vector instructions.
+ */
+template <typename T>
+inline
+void asm_run(int n, T const* src, T* dest) {
+   typedef SimdVec<T> SimdVecT;
+   int const vlen = SimdVecT::vector_length;
+   int n2 = vlen*(n/vlen);
+   for(int j=0; j<n2; j+=vlen) {
+      SimdVecT d = SimdVecT::load_unaligned(&dest[j]);
+      SimdVecT s = SimdVecT::load_unaligned(&src[j]);
+      SimdVecT sum = d + s;
+      sum.store_unaligned(&dest[j]);
+   }
+   for(int j=n2; j<n; j++)
+      dest[j] += src[j];
+}
+
+/** Assemble a column using precomputed contiguous runs.
+ *
+ * Performs the operation dest( idx(from:n-1) ) += src(from:n-1). Over each
+ * run (runs[2*k], runs[2*k+1]) = (start, length), idx is known to be
+ * contiguous and asm_run() is used. Remaining entries are scattered using
+ * asm_col(). Runs may extend beyond n.
+ */
+template <typename T>
+inline
+void asm_col_runs(int from, int n, int nrun, int const* runs, int const* idx,
+      T const* src, T* dest) {
+   if(from >= n) return; // Nothing to do
+   // Binary search for first run ending after from
+   int lo = 0, hi = nrun;
+   while(lo < hi) {
+      int mid = (lo + hi) / 2;
+      if(runs[2*mid] + runs[2*mid+1] <= from) lo = mid+1;
+      else                                    hi = mid;
+   }
+   int j = from;
+   for(int k=lo; k<nrun && runs[2*k]<n; ++k) {
+      int start = std::max(j, runs[2*k]);
+      int end = std::min(n, runs[2*k] + runs[2*k+1]);
+      asm_col(start-j, &idx[j], &src[j], dest);
+      asm_run(end-start, &src[start], &dest[ idx[start] ]);
+      j = end;
+   }
+   asm_col(n-j, &idx[j], &src[j], dest);
+}
+
+/**
+ * \brief Map a child's precomputed relative row indices to rows of node.
+ *
+ * Performs the operation out(from:to-1) = rmap(from:to-1), adjusted to allow
+ * for ndelay delayed variables inserted after the first ncol rows.
+ *
+ * \param from First entry to map.
+ * \param to One more than last entry to map.
+ * \param rmap Positions of child's rows in node's row list
+ *        (see SymbolicNode::rmap).
+ * \param ncol Number of expected eliminations at node.
+ * \param ndelay Number of delays into node.
+ * \param out Row of node for each entry of rmap.
+ */
+inline
+void map_child_rows(int from, int to, int const* rmap, int ncol, int ndelay,
+      int* out) {
+   for(int j=from; j<to; ++j) {
+      int r = rmap[j];
+      out[j] = (r < ncol) ? r : r + ndelay;
+   }
+}
+
+/**
+ * \brief Map row list of a contribution block from another subtree to rows of
+ *        node.
+ *
+ * As the rows of the contribution appear in the same order in the node's
+ * row list, this is a single merge pass that does not require a lookup vector
+ * over all variables.
+ *
+ * \param cn Number of rows in contribution block.
+ * \param crlist Row list of contribution block.
+ * \param snode Symbolic node to which contribution is made.
+ * \param ndelay Number of delays into node.
+ * \param out Row of node for each entry of crlist.
+ */
+inline
+void map_contrib_rows(int cn, int const* crlist, SymbolicNode const& snode,
+      int ndelay, int* out) {
+   int k = 0;
+   for(int j=0; j<cn; ++j) {
+      for(; snode.rlist[k] != crlist[j]; ++k); // Find match in rlist
+      out[j] = (k < snode.ncol) ? k : k + ndelay;
+   }
+}
+
 /**
-   * \brief Add \f$A\f$ to a given block column of a node.
-   *
-   * \param from First column of target block column.
-   * \param to One more than last column of target block column.
-   * \param node Supernode to add to.
-   * \param aval Values of \f$A\f$.
-   * \param ldl Leading dimension of node.
-   * \param scaling Scaling to apply (none if null).
-   */
-template <typename T, typename NumericNode>
-void add_a_block(int from, int to, NumericNode& node, T const* aval,
-      T const* scaling) {
-   SymbolicNode const& snode = node.symb;
-   size_t ldl = node.get_ldl();
+ * \brief Add \f$A\f$ to a given block column of a node.
+ *
+ * Entries are stored by column (see SymbolicNode::aptr), so this is a
+ * streaming loop with no integer division.
+ *
+ * If scaling is supplied, the product of the row and column scaling of each
+ * entry is stored in afac as it is used. If scaling is null but afac is not,
+ * the values stored by an earlier call are reused, so refactorization need
+ * not gather the scaling again. If both are null no scaling is applied.
+ *
+ * \param from First column of target block column.
+ * \param to One more than last column of target block column.
+ * \param snode Supernode to add to.
+ * \param ndelay Number of delays into node (inserted after fully summed rows).
+ * \param aval Values of \f$A\f$.
+ * \param scaling Scaling to apply (none if null).
+ * \param afac Scaling factor of each entry of the subtree-wide A map (none if
+ *        null), indexed from SymbolicNode::aoff.
+ * \param lcol Factor storage of node.
+ * \param ldl Leading dimension of node.
+ */
+template <typename T>
+void add_a_block(int from, int to, SymbolicNode const& snode, int ndelay,
+      T const* aval, T const* scaling, T* afac, T* lcol, size_t ldl) {
+   int const* arow = snode.arow;
+   long const* asrc = snode.asrc;
    if(scaling) {
-      /* Scaling to apply */
-      for(int i=from; i<to; ++i) {
-         long src  = snode.amap[2*i+0] - 1; // amap contains 1-based values
-         long dest = snode.amap[2*i+1] - 1; // amap contains 1-based values
-         int c = dest / snode.nrow;
-         int r = dest % snode.nrow;
-         long k = c*ldl + r;
-         if(r >= snode.ncol) k += node.ndelay_in;
-         T rscale = scaling[ snode.rlist[r]-1 ];
+      /* Calculate and record scaling factors as we go */
+      int const* ascale = snode.ascale;
+      T* fac = afac + snode.aoff;
+      for(int c=from; c<to; ++c) {
          T cscale = scaling[ snode.rlist[c]-1 ];
-         node.lcol[k] = rscale * aval[src] * cscale;
+         for(int i=snode.aptr[c]; i<snode.aptr[c+1]; ++i)
+            fac[i] = scaling[ ascale[i] ] * cscale;
       }
-   } else {
-      /* No scaling to apply */
-      for(int i=from; i<to; ++i) {
-         long src  = snode.amap[2*i+0] - 1; // amap contains 1-based values
-         long dest = snode.amap[2*i+1] - 1; // amap contains 1-based values
-         int c = dest / snode.nrow;
-         int r = dest % snode.nrow;
-         long k = c*ldl + r;
-         if(r >= snode.ncol) k += node.ndelay_in;
-         node.lcol[k] = aval[src];
+   }
+   for(int c=from; c<to; ++c) {
+      T* dest = &lcol[c*ldl];
+      T* dest_delay = dest + ndelay; // Rows after delays
+      int mid = snode.asplit[c];
+      if(afac) {
+         /* Scaling to apply */
+         T const* fac = afac + snode.aoff;
+         for(int i=snode.aptr[c]; i<mid; ++i)
+            dest[ arow[i] ] = fac[i] * aval[ asrc[i] ];
+         for(int i=mid; i<snode.aptr[c+1]; ++i)
+            dest_delay[ arow[i] ] = fac[i] * aval[ asrc[i] ];
+      } else {
+         /* No scaling to apply */
+         for(int i=snode.aptr[c]; i<mid; ++i)
+            dest[ arow[i] ] = aval[ asrc[i] ];
+         for(int i=mid; i<snode.aptr[c+1]; ++i)
+            dest_delay[ arow[i] ] = aval[ asrc[i] ];
       }
    }
 }
 
 /**
- * \brief Assemble expected entries (i.e. not delays) into block column of
- *        the factors \f$L\f$
- * \param from First column of block column.
- * \param to Last column of block column.
- * \param node Node to assemble into.
- * \param cnode Node to assemble from.
- * \param map Map of node's entries.
- * \param cache Length cm lookup vector.
+ * \brief A contribution block to be assembled by assemble_tiles().
+ *
+ * The block is lower triangular with dimension cm. Row (and column) i is
+ * assembled into row (column) idx[i] of the target, where idx is increasing.
+ */
+template <typename T>
+struct AssemblySource {
+   int cm; //< Dimension of contribution block
+   T const* val; //< Values of contribution block
+   int ldval; //< Leading dimension of val
+   int const* idx; //< Target row/column of each row/column
+   int nrun; //< Number of contiguous runs in idx
+   int const* rrun; //< (start, length) of each contiguous run in idx
+};
+
+/**
+ * \brief Assemble all contributions to a single tile of the target.
+ *
+ * Adds those entries of every source that map to rows rfrom:rto-1 and columns
+ * cfrom:cto-1 of the target. As every source only touches its own tile,
+ * different tiles may be assembled concurrently.
+ *
+ * \param rfrom First row of tile.
+ * \param rto One more than last row of tile.
+ * \param cfrom First column of tile.
+ * \param cto One more than last column of tile.
+ * \param sources Contribution blocks to assemble.
+ * \param dest Target matrix.
+ * \param lddest Leading dimension of dest.
  */
-template <typename T, typename PoolAlloc, typename MapVector>
-void assemble_expected(int from, int to, NumericNode<T,PoolAlloc>& node, NumericNode<T,PoolAlloc> const& cnode, MapVector const& map, int* cache) {
-   SymbolicNode const& csnode = cnode.symb;
-   int cm = csnode.nrow - csnode.ncol;
-   for(int j=from; j<cm; ++j)
-      cache[j] = map[ csnode.rlist[csnode.ncol+j] ];
-   for(int i=from; i<to; i++) {
-      int c = cache[i];
-      T *src = &cnode.contrib[i*cm];
-      // NB: we handle contribution to contrib in assemble_post()
-      if(c < node.symb.ncol) {
-         // Contribution added to lcol
-         int ldd = node.get_ldl();
-         T *dest = &node.lcol[c*ldd];
-         asm_col(cm-i, &cache[i], &src[i], dest);
+template <typename T>
+void assemble_tile(int rfrom, int rto, int cfrom, int cto,
+      std::vector<AssemblySource<T>> const& sources, T* dest, int lddest) {
+   for(auto const& s : sources) {
+      int const* begin = s.idx;
+      int const* end = s.idx + s.cm;
+      int ifrom = std::lower_bound(begin, end, cfrom) - begin;
+      int ito = std::lower_bound(begin+ifrom, end, cto) - begin;
+      if(ifrom == ito) continue; // No columns in tile
+      int jfrom = std::lower_bound(begin+ifrom, end, rfrom) - begin;
+      int jto = std::lower_bound(begin+jfrom, end, rto) - begin;
+      for(int i=ifrom; i<ito; ++i) {
+         asm_col_runs(std::max(i, jfrom), jto, s.nrun, s.rrun, s.idx,
+               &s.val[i*s.ldval], &dest[s.idx[i]*lddest]);
       }
    }
 }
 
 /**
- * \brief Assemble expected entries (i.e. not delays) into contribution block.
- * \param from First column of block column.
- * \param to Last column of block column.
- * \param node Node to assemble into.
- * \param cnode Node to assemble from.
- * \param map Map of node's entries.
- * \param cache Length cm lookup vector.
+ * \brief Assemble contribution blocks into columns cfrom:cto-1 of a lower
+ *        triangular target with nrow rows.
+ *
+ * The target is split into 2D tiles of size tile_size x tile_size. Each tile
+ * is a separate task that accumulates from all sources, so there are no
+ * write conflicts between tasks.
+ *
+ * \param cfrom First column to assemble into.
+ * \param cto One more than last column to assemble into.
+ * \param nrow Number of rows in target.
+ * \param sources Contribution blocks to assemble.
+ * \param dest Target matrix.
+ * \param lddest Leading dimension of dest.
+ * \param tile_size Dimension of tiles.
  */
-template <typename T, typename PoolAlloc, typename MapVector>
-void assemble_expected_contrib(int from, int to, NumericNode<T,PoolAlloc>& node, NumericNode<T,PoolAlloc> const& cnode, MapVector const& map, int* cache) {
-   SymbolicNode const& csnode = cnode.symb;
-   int cm = csnode.nrow - csnode.ncol;
-   int ncol = node.symb.ncol + node.ndelay_in;
-   for(int j=from; j<cm; ++j)
-      cache[j] = map[ csnode.rlist[csnode.ncol+j] ] - ncol;
-   for(int i=from; i<to; i++) {
-      int c = cache[i]+ncol;
-      T *src = &cnode.contrib[i*cm];
-      // NB: only interested in contribution to generated element
-      if(c >= node.symb.ncol) {
-         // Contribution added to contrib
-         int ldd = node.symb.nrow - node.symb.ncol;
-         T *dest = &node.contrib[(c-ncol)*ldd];
-         asm_col(cm-i, &cache[i], &src[i], dest);
+template <typename T>
+void assemble_tiles(int cfrom, int cto, int nrow,
+      std::vector<AssemblySource<T>> const& sources, T* dest, int lddest,
+      int tile_size) {
+   if(sources.size() == 0 || cfrom >= cto) return; // Nothing to do
+   if(cto-cfrom <= tile_size && nrow-cfrom <= tile_size) {
+      // Single tile
+      assemble_tile(cfrom, nrow, cfrom, cto, sources, dest, lddest);
+      return;
+   }
+   // Multiple tiles
+   #pragma omp taskgroup
+   for(int c0=cfrom; c0<cto; c0+=tile_size) {
+      int c1 = std::min(c0+tile_size, cto);
+      for(int r0=c0; r0<nrow; r0+=tile_size) {
+         int r1 = std::min(r0+tile_size, nrow);
+         #pragma omp task default(none) \
+            firstprivate(r0, r1, c0, c1) \
+            shared(sources, dest, lddest)
+         {
+#ifdef PROFILE
+            Profile::Task task_asm("TA_ASM_TILE");
+#endif
+            assemble_tile(r0, r1, c0, c1, sources, dest, lddest);
+#ifdef PROFILE
+            task_asm.done();
+#endif
+         } /* task */
       }
    }
 }
@@ -141,15 +295,13 @@ template <typename T,
           typename PoolAlloc>
 void assemble_pre(
       bool posdef,
-      int n,
       SymbolicNode const& snode,
       void** child_contrib,
       NumericNode<T,PoolAlloc>& node,
       FactorAlloc& factor_alloc,
-      PoolAlloc& pool_alloc,
-      std::vector<Workspace>& work,
       T const* aval,
-      T const* scaling
+      T const* scaling,
+      T* afac
       ) {
 #ifdef PROFILE
    Profile::Task task_asm_pre("TA_ASM_PRE");
@@ -159,7 +311,6 @@ void assemble_pre(
    typename FADoubleTraits::allocator_type factor_alloc_double(factor_alloc);
    typedef typename std::allocator_traits<FactorAlloc>::template rebind_traits<int> FAIntTraits;
    typename FAIntTraits::allocator_type factor_alloc_int(factor_alloc);
-   typedef typename std::allocator_traits<PoolAlloc>::template rebind_alloc<int> PoolAllocInt;
 
    /* Count incoming delays and determine size of node */
    node.ndelay_in = 0;
@@ -201,15 +352,22 @@ void assemble_pre(
    int const add_a_blk_sz = 256;
    if(snode.num_a < add_a_blk_sz) {
       // Single block
-      add_a_block(0, snode.num_a, node, aval, scaling);
+      add_a_block(0, snode.ncol, snode, node.ndelay_in, aval, scaling, afac,
+            node.lcol, ldl);
    } else {
-      // Multiple blocks
+      // Multiple blocks, each of whole columns with about add_a_blk_sz entries
       #pragma omp taskgroup
-      for(int iblk=0; iblk<snode.num_a; iblk+=add_a_blk_sz) {
+      for(int cfrom=0; cfrom<snode.ncol; ) {
+         int cto = cfrom+1;
+         while(cto < snode.ncol &&
+               snode.aptr[cto] - snode.aptr[cfrom] < add_a_blk_sz)
+            ++cto;
          #pragma omp task default(none) \
-            firstprivate(iblk) \
-            shared(snode, node, aval, scaling, ldl)
-         add_a_block(iblk, std::min(iblk+add_a_blk_sz,snode.num_a), node, aval, scaling);
+            firstprivate(cfrom, cto) \
+            shared(snode, node, aval, scaling, afac, ldl)
+         add_a_block(cfrom, cto, snode, node.ndelay_in, aval, scaling, afac,
+               node.lcol, ldl);
+         cfrom = cto;
       }
    }
 #ifdef PROFILE
@@ -223,24 +381,37 @@ void assemble_pre(
     * Add children
     */
    int delay_col = snode.ncol;
+   /* Find rows of node corresponding to each incoming contribution, allowing
+    * for insertion of delayed vars. These are held in a single vector for all
+    * sources as they are required until all tiles have been assembled. */
+   size_t nidx = 0;
+   for(auto* child=node.first_child; child!=NULL; child=child->next_child)
+      nidx += child->symb.nrow - child->symb.ncol;
+   for(int contrib_idx : snode.contrib) {
+      int cn, ldcontrib, ndelay, lddelay;
+      double const *cval, *delay_val;
+      int const *crlist, *delay_perm;
+      spral_ssids_contrib_get_data(
+            child_contrib[contrib_idx], &cn, &cval, &ldcontrib, &crlist,
+            &ndelay, &delay_perm, &delay_val, &lddelay
+            );
+      nidx += cn;
+   }
+   std::vector<int> asm_idx(nidx);
+   std::vector<AssemblySource<T>> sources;
+   nidx = 0;
 
-   /* Build lookup vector, allowing for insertion of delayed vars */
-   /* Note that while rlist[] is 1-indexed this is fine so long as lookup
-    * is also 1-indexed (which it is as it is another node's rlist[] */
-   std::vector<int, PoolAllocInt> map(n+1, PoolAllocInt(pool_alloc));
-   for(int i=0; i<snode.ncol; i++)
-      map[ snode.rlist[i] ] = i;
-   for(int i=snode.ncol; i<snode.nrow; i++)
-      map[ snode.rlist[i] ] = i + node.ndelay_in;
-   /* Loop over children adding contributions */
+   /* Loop over children handling delays and recording contributions */
 #ifdef PROFILE
    task_asm_pre.done();
+   Profile::Task task_asm_delay("TA_ASM_PRE");
 #endif
    for(auto* child=node.first_child; child!=NULL; child=child->next_child) {
-#ifdef PROFILE
-      Profile::Task task_asm_pre("TA_ASM_PRE");
-#endif
       SymbolicNode const& csnode = child->symb;
+      int cm = csnode.nrow - csnode.ncol;
+      int* idx = asm_idx.data() + nidx;
+      nidx += cm;
+      map_child_rows(0, cm, csnode.rmap, snode.ncol, node.ndelay_in, idx);
       /* Handle delays - go to back of node
        * (i.e. become the last rows as in lower triangular format) */
       for(int i=0; i<child->ndelay_out; i++) {
@@ -255,46 +426,17 @@ void assemble_pre(
          // Add child's non-fully summed rows (from delayed cols)
          dest = node.lcol;
          src = &child->lcol[child->nelim*lds + child->ndelay_in +i*lds];
-         for(int j=csnode.ncol; j<csnode.nrow; j++) {
-            int r = map[ csnode.rlist[j] ];
-            if(r < ncol) dest[r*ldl+delay_col] = src[j];
-            else         dest[delay_col*ldl+r] = src[j];
+         for(int j=0; j<cm; j++) {
+            int r = idx[j];
+            if(r < ncol) dest[r*ldl+delay_col] = src[csnode.ncol+j];
+            else         dest[delay_col*ldl+r] = src[csnode.ncol+j];
          }
          delay_col++;
       }
-#ifdef PROFILE
-      task_asm_pre.done();
-#endif
-
-      /* Handle expected contributions (only if something there) */
-      if(child->contrib) {
-         int cm = csnode.nrow - csnode.ncol;
-         int const block_size = 256; // FIXME: make configurable?
-         if(cm < block_size) {
-            // Single block
-            int* cache = work[omp_get_thread_num()].get_ptr<int>(cm);
-            assemble_expected(0, cm, node, *child, map, cache);
-         } else {
-            // Multiple blocks
-            #pragma omp taskgroup
-            for(int iblk=0; iblk<cm; iblk+=block_size) {
-               #pragma omp task default(none) \
-                  firstprivate(iblk) \
-                  shared(map, child, snode, node, csnode, cm, nrow, work)
-               {
-#ifdef PROFILE
-                  Profile::Task task_asm_pre("TA_ASM_PRE");
-#endif
-                  int* cache = work[omp_get_thread_num()].get_ptr<int>(cm);
-                  assemble_expected(iblk, std::min(iblk+block_size,cm), node,
-                        *child, map, cache);
-#ifdef PROFILE
-                  task_asm_pre.done();
-#endif
-               } /* task */
-            }
-         }
-      }
+      /* Record expected contributions (only if something there) */
+      if(child->contrib)
+         sources.push_back({ cm, child->contrib, cm, idx, csnode.nrun,
+               csnode.rrun });
    }
    /* Add any contribution block from other subtrees */
    for(int contrib_idx : snode.contrib) {
@@ -305,9 +447,9 @@ void assemble_pre(
             child_contrib[contrib_idx], &cn, &cval, &ldcontrib, &crlist,
             &ndelay, &delay_perm, &delay_val, &lddelay
             );
-      int* cache = work[omp_get_thread_num()].get_ptr<int>(cn);
-      for(int j=0; j<cn; ++j)
-         cache[j] = map[ crlist[j] ];
+      int* idx = asm_idx.data() + nidx;
+      nidx += cn;
+      map_contrib_rows(cn, crlist, snode, node.ndelay_in, idx);
       /* Handle delays - go to back of node
        * (i.e. become the last rows as in lower triangular format) */
       for(int i=0; i<ndelay; i++) {
@@ -322,91 +464,70 @@ void assemble_pre(
          dest = node.lcol;
          src = &delay_val[i*lddelay+ndelay];
          for(int j=0; j<cn; j++) {
-            int r = cache[j];
+            int r = idx[j];
             if(r < ncol) dest[r*ldl+delay_col] = src[j];
             else         dest[delay_col*ldl+r] = src[j];
          }
          delay_col++;
       }
-      if(!cval) continue; // child was all delays, nothing more to do
-      /* Handle expected contribution */
-      for(int i=0; i<cn; ++i) {
-         int c = cache[i];
-         T const* src = &cval[i*ldcontrib];
-         // NB: we handle contribution to contrib in assemble_post()
-         if(c < snode.ncol) {
-            // Contribution added to lcol
-            int ldd = align_lda<T>(nrow);
-            T *dest = &node.lcol[c*ldd];
-            asm_col(cn-i, &cache[i], &src[i], dest);
-         }
-      }
+      /* Record expected contribution */
+      if(cval)
+         sources.push_back({ cn, cval, ldcontrib, idx, 0, nullptr });
    }
+#ifdef PROFILE
+   task_asm_delay.done();
+#endif
+
+   /* Assemble expected contributions into fully summed columns. Entries of
+    * later columns are handled by assemble_post() once the contribution
+    * block has been formed. */
+   int const tile_size = 256;
+   assemble_tiles(0, snode.ncol, nrow, sources, node.lcol, ldl, tile_size);
 }
 
 template <typename T,
           typename PoolAlloc
           >
 void assemble_post(
-      int n,
       SymbolicNode const& snode,
       void** child_contrib,
-      NumericNode<T,PoolAlloc>& node,
-      PoolAlloc& pool_alloc,
-      std::vector<Workspace>& work
+      NumericNode<T,PoolAlloc>& node
       ) {
-   /* Rebind allocators */
-   typedef typename std::allocator_traits<PoolAlloc>::template rebind_traits<int> PAIntTraits;
-   typename PAIntTraits::allocator_type pool_alloc_int(pool_alloc);
-
    /* Initialise variables */
    int ncol = snode.ncol + node.ndelay_in;
+   int cm = snode.nrow - snode.ncol;
 
-   /* Add children */
-   int* map = nullptr;
-   if(node.first_child != NULL || snode.contrib.size() > 0) {
-      /* Build lookup vector, allowing for insertion of delayed vars */
-      /* Note that while rlist[] is 1-indexed this is fine so long as lookup
-       * is also 1-indexed (which it is as it is another node's rlist[] */
-      if(!map) map = PAIntTraits::allocate(pool_alloc_int, n+1);
-      // FIXME: probably don't need to worry about first ncol?
-      for(int i=0; i<snode.ncol; i++)
-         map[ snode.rlist[i] ] = i;
-      for(int i=snode.ncol; i<snode.nrow; i++)
-         map[ snode.rlist[i] ] = i + node.ndelay_in;
-      /* Loop over children adding contributions */
-      for(auto* child=node.first_child; child!=NULL; child=child->next_child) {
-         SymbolicNode const& csnode = child->symb;
-         if(!child->contrib) continue;
-         int cm = csnode.nrow - csnode.ncol;
-         int const block_size = 256;
-         if(cm < block_size) {
-            int* cache = work[omp_get_thread_num()].get_ptr<int>(cm);
-            assemble_expected_contrib(0, cm, node, *child, map, cache);
-         } else {
-            #pragma omp taskgroup
-            for(int iblk=0; iblk<cm; iblk+=block_size) {
-               #pragma omp task default(none) \
-                  firstprivate(iblk) \
-                  shared(map, child, node, cm, work)
-               {
-#ifdef PROFILE
-                  Profile::Task task_asm("TA_ASM_POST");
-#endif
-                  int* cache = work[omp_get_thread_num()].get_ptr<int>(cm);
-                  assemble_expected_contrib(iblk, std::min(iblk+block_size,cm),
-                        node, *child, map, cache);
-#ifdef PROFILE
-                  task_asm.done();
-#endif
-               } /* task */
-            }
-         }
-         /* Free memory from child contribution block */
-         child->free_contrib();
-      }
+   /* Find rows of contribution block corresponding to each incoming
+    * contribution. Rows in the fully summed columns become negative and are
+    * never touched by assemble_tiles(). */
+   size_t nidx = 0;
+   for(auto* child=node.first_child; child!=NULL; child=child->next_child)
+      if(child->contrib) nidx += child->symb.nrow - child->symb.ncol;
+   for(int contrib_idx : snode.contrib) {
+      int cn, ldcontrib, ndelay, lddelay;
+      double const *cval, *delay_val;
+      int const *crlist, *delay_perm;
+      spral_ssids_contrib_get_data(
+            child_contrib[contrib_idx], &cn, &cval, &ldcontrib, &crlist,
+            &ndelay, &delay_perm, &delay_val, &lddelay
+            );
+      if(cval) nidx += cn;
+   }
+   std::vector<int> asm_idx(nidx);
+   std::vector<AssemblySource<T>> sources;
+   nidx = 0;
+   for(auto* child=node.first_child; child!=NULL; child=child->next_child) {
+      SymbolicNode const& csnode = child->symb;
+      if(!child->contrib) continue;
+      int ccm = csnode.nrow - csnode.ncol;
+      int* idx = asm_idx.data() + nidx;
+      nidx += ccm;
+      map_child_rows(0, ccm, csnode.rmap, snode.ncol, node.ndelay_in, idx);
+      for(int j=0; j<ccm; ++j)
+         idx[j] -= ncol;
+      sources.push_back({ ccm, child->contrib, ccm, idx, csnode.nrun,
+            csnode.rrun });
    }
-   /* Add any contribution block from other subtrees */
    for(int contrib_idx : snode.contrib) {
       int cn, ldcontrib, ndelay, lddelay;
       double const *cval, *delay_val;
@@ -416,24 +537,23 @@ void assemble_post(
             &ndelay, &delay_perm, &delay_val, &lddelay
             );
       if(!cval) continue; // child was all delays, nothing to do
-      int* cache = work[omp_get_thread_num()].get_ptr<int>(cn);
+      int* idx = asm_idx.data() + nidx;
+      nidx += cn;
+      map_contrib_rows(cn, crlist, snode, node.ndelay_in, idx);
       for(int j=0; j<cn; ++j)
-         cache[j] = map[ crlist[j] ] - ncol;
-      for(int i=0; i<cn; ++i) {
-         int c = cache[i]+ncol;
-         T const* src = &cval[i*ldcontrib];
-         // NB: only interested in contribution to generated element
-         if(c >= snode.ncol) {
-            // Contribution added to contrib
-            int ldd = snode.nrow - snode.ncol;
-            T *dest = &node.contrib[(c-ncol)*ldd];
-            asm_col(cn-i, &cache[i], &src[i], dest);
-         }
-      }
-      /* Free memory from child contribution block */
-      spral_ssids_contrib_free_dbl(child_contrib[contrib_idx]);
+         idx[j] -= ncol;
+      sources.push_back({ cn, cval, ldcontrib, idx, 0, nullptr });
    }
-   if(map) PAIntTraits::deallocate(pool_alloc_int, map, n+1);
+
+   /* Assemble into contribution block by tiles */
+   int const tile_size = 256;
+   assemble_tiles(0, cm, cm, sources, node.contrib, cm, tile_size);
+
+   /* Free memory from child contribution blocks and row maps */
+   for(auto* child=node.first_child; child!=NULL; child=child->next_child)
+      child->free_contrib();
+   for(int contrib_idx : snode.contrib)
+      spral_ssids_contrib_free_dbl(child_contrib[contrib_idx]);
 }
 
 }}} /* namespaces spral::ssids::cpu */
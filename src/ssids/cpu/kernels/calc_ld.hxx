@@ -35,8 +35,9 @@ int offset_to_align(T* ptr) {
 
 /** Calculates LD from L and D.
  *
- * We assume that both l and ld are 32-bytes aligned, and ldl and ldld are
- * multiples of 32 bytes, so we can use AVX.
+ * Vector instructions are used for any column of l and ld that share the same
+ * alignment. This is always the case if both l and ld are 32-bytes aligned,
+ * and ldl and ldld are multiples of 32 bytes.
  */
 template <enum operation op, typename T>
 void calcLD(int m, int n, T const* l, int ldl, T const* d, T* ld, int ldld) {
@@ -50,8 +51,9 @@ void calcLD(int m, int n, T const* l, int ldl, T const* d, T* ld, int ldld) {
          if(op==OP_N) {
             int const vlen = SimdVecT::vector_length;
             int const unroll = 4;
-            int offset = offset_to_align(l);
-            if(offset_to_align(ld) != offset) offset = m; // give up on vectors
+            int offset = offset_to_align(&l[col*ldl]);
+            if(offset_to_align(&ld[col*ldld]) != offset)
+               offset = m; // give up on vectors
             int nvec = std::max(0, (m-offset) / vlen);
             for(int row=0; row<std::min(offset,m); ++row)
                ld[col*ldld+row] = d11 * l[col*ldl+row];
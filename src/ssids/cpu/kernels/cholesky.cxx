@@ -13,178 +13,278 @@
 
 namespace spral { namespace ssids { namespace cpu {
 
-/** Perform Cholesky factorization of lower triangular matrix a[] in place.
- * Optionally calculates the contribution block (beta*C) - LL^T.
- *
- * \param m the number of rows
- * \param n the number of columns
- * \param a the matrix to be factorized, only lower triangle is used, however
- *    upper triangle may get overwritten with rubbish
- * \param lda the leading dimension of a
- * \param beta the coefficient to multiply C by (normally 0.0 or 1.0)
- * \param upd the (m-n) x (m-n) contribution block C (may be null)
- * \param ldup the leading dimension of upd
- * \param blksz the block size to use for parallelization. Blocks are aimed to
- *    contain at most blksz**2 entries.
- * \param info is initialized to -1, and will be changed to the index of any
- *    column where a non-zero column is encountered.
- */
-void cholesky_factor(int m, int n, double* a, int lda, double beta, double* upd, int ldupd, int blksz, int *info) {
-   if(n < blksz) {
-      // Adjust so blocks have blksz**2 entries
-      blksz = int((long(blksz)*blksz) / n);
-   }
+namespace {
 
-   #pragma omp atomic write
-   *info = -1;
+/** Task priorities: tasks on the critical path are given higher priority.
+ *  NB: priorities are capped by the OMP_MAX_TASK_PRIORITY environment variable,
+ *  so have no effect unless it is set. */
+int const PRIORITY_DIAG = 2; ///< Priority of diagonal block factorization
+int const PRIORITY_TRSM = 1; ///< Priority of column solves (and lookahead)
+int const PRIORITY_UPDATE = 0; ///< Priority of other updates
 
-   /* FIXME: Would this be better row-wise to ensure critical path, rather than
-    * its current col-wise implementation ensuring maximum work available??? */
-   #pragma omp taskgroup
-   for(int j = 0; j < n; j += blksz) {
-     int blkn = std::min(blksz, n-j);
-     /* Diagonal Block Factorization Task */
-     #pragma omp task default(none)                      \
-        firstprivate(j, blkn)                            \
-        shared(m, a, lda, blksz, info, beta, upd, ldupd) \
-        depend(inout: a[j*(lda+1):1])
+/** Submit Diagonal Block Factorization Task for block column j */
+void diag_task(int j, int m, int n, double* a, int lda, double beta,
+      double* upd, int ldupd, int blksz, int* info) {
+   int blkn = std::min(blksz, n-j);
+   #pragma omp task default(none)                      \
+      firstprivate(j, blkn, m, a, lda, blksz, info)    \
+      firstprivate(beta, upd, ldupd)                   \
+      depend(inout: a[j*(lda+1):1])                    \
+      priority(PRIORITY_DIAG)
+   {
+     int my_info;
+     #pragma omp atomic read
+     my_info = *info;
+     if (my_info == -1) {
+#ifdef PROFILE
+       Profile::Task task("TA_CHOL_DIAG");
+#endif
+       int blkm = std::min(blksz, m-j);
+       int flag = lapack_potrf(FILL_MODE_LWR, blkn, &a[j*(lda+1)], lda);
+       if (flag > 0) {
+         // Matrix was not positive definite
+         #pragma omp atomic write
+         *info = flag-1; // flag uses Fortran indexing
+       } else if (blkm > blkn) {
+         // Diagonal block factored OK, handle some rectangular part of block
+         host_trsm(SIDE_RIGHT, FILL_MODE_LWR, OP_T, DIAG_NON_UNIT,
+                   blkm-blkn, blkn, 1.0, &a[j*(lda+1)], lda,
+                   &a[j*(lda+1)+blkn], lda);
+         if (upd) {
+           double rbeta = (j==0) ? beta : 1.0;
+           host_syrk(FILL_MODE_LWR, OP_N, blkm-blkn, blkn, -1.0,
+                     &a[j*(lda+1)+blkn], lda, rbeta, upd, ldupd);
+         }
+       }
+#ifdef PROFILE
+       task.done();
+#endif
+     }
+   }
+}
+
+/** Submit Column Solve Tasks for all blocks below diagonal in column j */
+void trsm_tasks(int j, int m, int n, double* a, int lda, double beta,
+      double* upd, int ldupd, int blksz, int* info) {
+   int blkn = std::min(blksz, n-j);
+   for (int i = j+blksz; i < m; i += blksz) {
+     int blkm = std::min(blksz, m-i);
+     #pragma omp task default(none)                        \
+       firstprivate(i, j, blkn, blkm, a, lda, info)        \
+       firstprivate(beta, upd, ldupd, blksz, n)            \
+       depend(in: a[j*(lda+1):1])                          \
+       depend(inout: a[j*lda + i:1])                       \
+       priority(PRIORITY_TRSM)
      {
        int my_info;
        #pragma omp atomic read
        my_info = *info;
        if (my_info == -1) {
 #ifdef PROFILE
-         Profile::Task task("TA_CHOL_DIAG");
+         Profile::Task task("TA_CHOL_TRSM");
 #endif
-         int blkm = std::min(blksz, m-j);
-         int flag = lapack_potrf(FILL_MODE_LWR, blkn, &a[j*(lda+1)], lda);
-         if (flag > 0) {
-           // Matrix was not positive definite
-           #pragma omp atomic write
-           *info = flag-1; // flag uses Fortran indexing
-         } else if (blkm > blkn) {
-           // Diagonal block factored OK, handle some rectangular part of block
-           host_trsm(SIDE_RIGHT, FILL_MODE_LWR, OP_T, DIAG_NON_UNIT,
-                     blkm-blkn, blkn, 1.0, &a[j*(lda+1)], lda,
-                     &a[j*(lda+1)+blkn], lda);
-           if (upd) {
-             double rbeta = (j==0) ? beta : 1.0;
-             host_syrk(FILL_MODE_LWR, OP_N, blkm-blkn, blkn, -1.0,
-                       &a[j*(lda+1)+blkn], lda, rbeta, upd, ldupd);
-           }
+         host_trsm(SIDE_RIGHT, FILL_MODE_LWR, OP_T, DIAG_NON_UNIT,
+                   blkm, blkn, 1.0, &a[j*(lda+1)], lda, &a[j*lda+i], lda);
+         if ((blkn < blksz) && upd) {
+           double rbeta = (j==0) ? beta : 1.0;
+           host_gemm(OP_N, OP_T, blkm, blksz-blkn, blkn, -1.0,
+                     &a[j*lda+i], lda, &a[j*(lda+1)+blkn], lda,
+                     rbeta, &upd[i-n], ldupd);
          }
 #ifdef PROFILE
          task.done();
 #endif
        }
      }
-     /* Column Solve Tasks */
-     for (int i = j+blksz; i < m; i += blksz) {
-       int blkm = std::min(blksz, m-i);
-       #pragma omp task default(none)                        \
-         firstprivate(i, j, blkn, blkm)                      \
-         shared(a, lda, info, beta, upd, ldupd, blksz, n)    \
-         depend(in: a[j*(lda+1):1])                          \
-         depend(inout: a[j*lda + i:1])
-       {
-         int my_info;
-         #pragma omp atomic read
-         my_info = *info;
-         if (my_info == -1) {
+   }
+}
+
+/** Submit Schur Update Tasks from block column j to block column k < n */
+void update_tasks(int j, int k, int m, int n, double* a, int lda, double beta,
+      double* upd, int ldupd, int blksz, int* info, int priority) {
+   int blkn = std::min(blksz, n-j);
+   int blkk = std::min(blksz, n-k);
+   for (int i = k; i < m; i += blksz) {
+     #pragma omp task default(none)                            \
+       firstprivate(i, j, k, blkn, blkk, m, a, lda, blksz)     \
+       firstprivate(info, beta, upd, ldupd, n)                 \
+       depend(in: a[j*lda+k:1])                                \
+       depend(in: a[j*lda+i:1])                                \
+       depend(inout: a[k*lda+i:1])                             \
+       priority(priority)
+     {
+       int my_info;
+       #pragma omp atomic read
+       my_info = *info;
+       if (my_info == -1) {
 #ifdef PROFILE
-           Profile::Task task("TA_CHOL_TRSM");
+         Profile::Task task("TA_CHOL_UPD");
 #endif
-           host_trsm(SIDE_RIGHT, FILL_MODE_LWR, OP_T, DIAG_NON_UNIT,
-                     blkm, blkn, 1.0, &a[j*(lda+1)], lda, &a[j*lda+i], lda);
-           if ((blkn < blksz) && upd) {
-             double rbeta = (j==0) ? beta : 1.0;
-             host_gemm(OP_N, OP_T, blkm, blksz-blkn, blkn, -1.0,
-                       &a[j*lda+i], lda, &a[j*(lda+1)+blkn], lda,
-                       rbeta, &upd[i-n], ldupd);
+         int blkm = std::min(blksz, m-i);
+         host_gemm(OP_N, OP_T, blkm, blkk, blkn, -1.0, &a[j*lda+i], lda,
+                   &a[j*lda+k], lda, 1.0, &a[k*lda+i], lda);
+         if ((blkk < blksz) && upd) {
+           double rbeta = (j==0) ? beta : 1.0;
+           int upd_width = (m<k+blksz) ? blkm - blkk : blksz - blkk;
+           if ((i-n) < 0) {
+             // Special case for first block of contrib
+             host_gemm(OP_N, OP_T, blkm+i-n, upd_width, blkn, -1.0,
+                       &a[j*lda+n], lda, &a[j*lda+k+blkk], lda, rbeta,
+                       upd, ldupd);
+           } else {
+             host_gemm(OP_N, OP_T, blkm, upd_width, blkn, -1.0,
+                       &a[j*lda+i], lda, &a[j*lda+k+blkk], lda, rbeta,
+                       &upd[i-n], ldupd);
            }
-#ifdef PROFILE
-           task.done();
-#endif
          }
-       }
-     }
-     /* Schur Update Tasks: mostly internal */
-     for (int k = j+blksz; k < n; k += blksz) {
-       int blkk = std::min(blksz, n-k);
-       for (int i = k; i < m; i += blksz) {
-         #pragma omp task default(none)                            \
-           firstprivate(i, j, k, blkn, blkk)                       \
-           shared(m, a, lda, blksz, info, beta, upd, ldupd, n)     \
-           depend(in: a[j*lda+k:1])                                \
-           depend(in: a[j*lda+i:1])                                \
-           depend(inout: a[k*lda+i:1])
-         {
-           int my_info;
-           #pragma omp atomic read
-           my_info = *info;
-           if (my_info == -1) {
 #ifdef PROFILE
-             Profile::Task task("TA_CHOL_UPD");
-#endif
-             int blkm = std::min(blksz, m-i);
-             host_gemm(OP_N, OP_T, blkm, blkk, blkn, -1.0, &a[j*lda+i], lda,
-                       &a[j*lda+k], lda, 1.0, &a[k*lda+i], lda);
-             if ((blkk < blksz) && upd) {
-               double rbeta = (j==0) ? beta : 1.0;
-               int upd_width = (m<k+blksz) ? blkm - blkk : blksz - blkk;
-               if ((i-n) < 0) {
-                 // Special case for first block of contrib
-                 host_gemm(OP_N, OP_T, blkm+i-n, upd_width, blkn, -1.0,
-                           &a[j*lda+n], lda, &a[j*lda+k+blkk], lda, rbeta,
-                           upd, ldupd);
-               } else {
-                 host_gemm(OP_N, OP_T, blkm, upd_width, blkn, -1.0,
-                           &a[j*lda+i], lda, &a[j*lda+k+blkk], lda, rbeta,
-                           &upd[i-n], ldupd);
-               }
-             }
-#ifdef PROFILE
-             task.done();
+         task.done();
 #endif
-           }
-         }
        }
      }
-     /* Contrib Schur complement update: external */
-     if (upd) {
-       for (int k = blksz*((n-1)/blksz+1); k < m; k += blksz) {
-         int blkk = std::min(blksz, m-k);
-         for (int i = k; i < m; i += blksz) {
-           #pragma omp task default(none)                        \
-             firstprivate(i, j, k, blkn, blkk)                   \
-             shared(m, n, a, lda, blksz, info, beta, upd, ldupd) \
-             depend(in: a[j*lda+k:1])                            \
-             depend(in: a[j*lda+i:1])                            \
-             depend(inout: upd[(k-n)*lda+(i-n):1])
-           {
-             int my_info;
-             #pragma omp atomic read
-             my_info = *info;
-             if (my_info == -1) {
+   }
+}
+
+/** Submit Contrib Schur complement update Tasks from block column j to
+ *  column k >= n of contribution block */
+void contrib_update_tasks(int j, int k, int m, int n, double* a, int lda,
+      double beta, double* upd, int ldupd, int blksz, int* info) {
+   int blkn = std::min(blksz, n-j);
+   int blkk = std::min(blksz, m-k);
+   for (int i = k; i < m; i += blksz) {
+     #pragma omp task default(none)                        \
+       firstprivate(i, j, k, blkn, blkk, m, n, a, lda)     \
+       firstprivate(blksz, info, beta, upd, ldupd)         \
+       depend(in: a[j*lda+k:1])                            \
+       depend(in: a[j*lda+i:1])                            \
+       depend(inout: upd[(k-n)*lda+(i-n):1])               \
+       priority(PRIORITY_UPDATE)
+     {
+       int my_info;
+       #pragma omp atomic read
+       my_info = *info;
+       if (my_info == -1) {
 #ifdef PROFILE
-               Profile::Task task("TA_CHOL_UPD");
+         Profile::Task task("TA_CHOL_UPD");
 #endif
-               int blkm = std::min(blksz, m-i);
-               double rbeta = (j==0) ? beta : 1.0;
-               host_gemm(OP_N, OP_T, blkm, blkk, blkn, -1.0,
-                         &a[j*lda+i], lda, &a[j*lda+k], lda,
-                         rbeta, &upd[(k-n)*ldupd+(i-n)], ldupd);
+         int blkm = std::min(blksz, m-i);
+         double rbeta = (j==0) ? beta : 1.0;
+         host_gemm(OP_N, OP_T, blkm, blkk, blkn, -1.0,
+                   &a[j*lda+i], lda, &a[j*lda+k], lda,
+                   rbeta, &upd[(k-n)*ldupd+(i-n)], ldupd);
 #ifdef PROFILE
-               task.done();
+         task.done();
 #endif
-             }
-           }
-         }
        }
      }
    }
 }
 
+} /* anon namespace */
+
+/** Perform Cholesky factorization of lower triangular matrix a[] in place.
+ * Optionally calculates the contribution block (beta*C) - LL^T.
+ *
+ * Tasks are submitted in an order determined by schedule; all orders give
+ * the same result, but differ in how soon the critical path of diagonal
+ * factorizations and column solves becomes available to run:
+ * - CholeskySchedule::column: right-looking, all tasks of block column j are
+ *   submitted before any of j+1. Maximises work available.
+ * - CholeskySchedule::row: left-looking, all updates to block column k are
+ *   submitted immediately before its factorization.
+ * - CholeskySchedule::lookahead: right-looking, but the updates to and
+ *   factorization of block column j+1 are submitted before the remaining
+ *   updates from block column j.
+ * In all cases the diagonal and column solve tasks are given a higher OpenMP
+ * task priority.
+ *
+ * \param m the number of rows
+ * \param n the number of columns
+ * \param a the matrix to be factorized, only lower triangle is used, however
+ *    upper triangle may get overwritten with rubbish
+ * \param lda the leading dimension of a
+ * \param beta the coefficient to multiply C by (normally 0.0 or 1.0)
+ * \param upd the (m-n) x (m-n) contribution block C (may be null)
+ * \param ldup the leading dimension of upd
+ * \param blksz the block size to use for parallelization. Blocks are aimed to
+ *    contain at most blksz**2 entries.
+ * \param info is initialized to -1, and will be changed to the index of any
+ *    column where a non-zero column is encountered.
+ * \param schedule the order in which tasks are submitted.
+ */
+void cholesky_factor(int m, int n, double* a, int lda, double beta, double* upd, int ldupd, int blksz, int *info, CholeskySchedule schedule) {
+   if(n < blksz) {
+      // Adjust so blocks have blksz**2 entries
+      blksz = int((long(blksz)*blksz) / n);
+   }
+
+   #pragma omp atomic write
+   *info = -1;
+
+   // First block column of contribution block
+   int const kcontrib = blksz*((n-1)/blksz+1);
+
+   #pragma omp taskgroup
+   {
+      switch(schedule) {
+      case CholeskySchedule::row:
+         for(int k = 0; k < n; k += blksz) {
+            for(int j = 0; j < k; j += blksz)
+               update_tasks(j, k, m, n, a, lda, beta, upd, ldupd, blksz, info,
+                     PRIORITY_UPDATE);
+            diag_task(k, m, n, a, lda, beta, upd, ldupd, blksz, info);
+            trsm_tasks(k, m, n, a, lda, beta, upd, ldupd, blksz, info);
+         }
+         if(upd) {
+            for(int k = kcontrib; k < m; k += blksz)
+            for(int j = 0; j < n; j += blksz)
+               contrib_update_tasks(j, k, m, n, a, lda, beta, upd, ldupd, blksz,
+                     info);
+         }
+         break;
+      case CholeskySchedule::lookahead:
+         if(n > 0) {
+            diag_task(0, m, n, a, lda, beta, upd, ldupd, blksz, info);
+            trsm_tasks(0, m, n, a, lda, beta, upd, ldupd, blksz, info);
+         }
+         for(int j = 0; j < n; j += blksz) {
+            // Updates to next block column and its factorization go first
+            int knext = j+blksz;
+            if(knext < n) {
+               update_tasks(j, knext, m, n, a, lda, beta, upd, ldupd, blksz, info,
+                     PRIORITY_TRSM);
+               diag_task(knext, m, n, a, lda, beta, upd, ldupd, blksz, info);
+               trsm_tasks(knext, m, n, a, lda, beta, upd, ldupd, blksz, info);
+            }
+            // Then remaining updates
+            for(int k = knext+blksz; k < n; k += blksz)
+               update_tasks(j, k, m, n, a, lda, beta, upd, ldupd, blksz, info,
+                     PRIORITY_UPDATE);
+            if(upd) {
+               for(int k = kcontrib; k < m; k += blksz)
+                  contrib_update_tasks(j, k, m, n, a, lda, beta, upd, ldupd,
+                        blksz, info);
+            }
+         }
+         break;
+      default: // CholeskySchedule::column
+         for(int j = 0; j < n; j += blksz) {
+            diag_task(j, m, n, a, lda, beta, upd, ldupd, blksz, info);
+            trsm_tasks(j, m, n, a, lda, beta, upd, ldupd, blksz, info);
+            for(int k = j+blksz; k < n; k += blksz)
+               update_tasks(j, k, m, n, a, lda, beta, upd, ldupd, blksz, info,
+                     PRIORITY_UPDATE);
+            if(upd) {
+               for(int k = kcontrib; k < m; k += blksz)
+                  contrib_update_tasks(j, k, m, n, a, lda, beta, upd, ldupd,
+                        blksz, info);
+            }
+         }
+         break;
+      }
+   } /* taskgroup */
+}
+
 /* Forwards solve corresponding to cholesky_factor() */
 void cholesky_solve_fwd(int m, int n, double const* a, int lda, int nrhs, double* x, int ldx) {
    if(nrhs==1) {
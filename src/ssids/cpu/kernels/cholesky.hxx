@@ -3,9 +3,11 @@
  *  \licence   BSD licence, see LICENCE file for details
  *  \author    Jonathan Hogg
  */
+#include "ssids/cpu/cpu_iface.hxx"
+
 namespace spral { namespace ssids { namespace cpu {
 
-void cholesky_factor(int m, int n, double* a, int lda, double beta, double* upd, int ldupd, int blksz, int *info);
+void cholesky_factor(int m, int n, double* a, int lda, double beta, double* upd, int ldupd, int blksz, int *info, CholeskySchedule schedule=CholeskySchedule::column);
 void cholesky_solve_fwd(int m, int n, double const* a, int lda, int nrhs, double* x, int ldx);
 void cholesky_solve_bwd(int m, int n, double const* a, int lda, int nrhs, double* x, int ldx);
 
@@ -25,6 +25,7 @@
 #include "ssids/profile.hxx"
 #include "ssids/cpu/BlockPool.hxx"
 #include "ssids/cpu/BuddyAllocator.hxx"
+#include "ssids/cpu/NumaAllocator.hxx"
 #include "ssids/cpu/cpu_iface.hxx"
 #include "ssids/cpu/Workspace.hxx"
 #include "ssids/cpu/kernels/block_ldlt.hxx"
@@ -37,13 +38,21 @@ namespace spral { namespace ssids { namespace cpu {
 
 namespace ldlt_app_internal {
 
-static const int INNER_BLOCK_SIZE = 32;
-
 /** \return number of blocks for given n */
 inline int calc_nblk(int n, int block_size) {
    return (n-1) / block_size + 1;
 }
 
+/** \return block size to use when recursing on a diagonal block of size
+ *          block_size. The block size is halved (rounded up to a multiple of
+ *          inner_block_size) at each level until inner_block_size is reached.
+ */
+inline int calc_recurse_blksz(int block_size, int inner_block_size) {
+   if(block_size <= 2*inner_block_size) return inner_block_size;
+   int half = (block_size-1) / 2 + 1;
+   return inner_block_size * calc_nblk(half, inner_block_size);
+}
+
 /** \return block size of block blk if maximum in dimension is n */
 inline int calc_blkn(int blk, int n, int block_size) {
    return std::min(block_size, n-blk*block_size);
@@ -939,7 +948,8 @@ public:
     *           \f[ A_{ii} = P L_{ii} D_i L_{ii}^T P^T. \f]
     *           The mechanism to do so varies:
     *           - If block_size != BLOCK_SIZE then recurse with a call to
-    *             LDLT::factor() using BLOCK_SIZE as the new block size.
+    *             LDLT::factor() using half the current block size (but no
+    *             less than BLOCK_SIZE) as the new block size.
     *           - Otherwise, if the block is a full block of size BLOCK_SIZE,
     *             call block_ldlt().
     *           - Otherwise, if the block is not full, call ldlt_tpp_factor().
@@ -969,9 +979,11 @@ public:
          lperm[i] = i;
       cdata_[i_].d = &d[2*next_elim];
       if(block_size_ != INNER_BLOCK_SIZE) {
-         // Recurse
+         // Recurse, halving block size until we reach INNER_BLOCK_SIZE
+         int const inner_block_size =
+            calc_recurse_blksz(block_size_, INNER_BLOCK_SIZE);
          CopyBackup<T, Allocator> inner_backup(
-               nrow(), ncol(), INNER_BLOCK_SIZE, alloc
+               nrow(), ncol(), inner_block_size, alloc
                );
          bool const use_tasks = false; // Don't run in parallel at lower level
          bool const debug = false; // Don't print debug info for inner call
@@ -981,7 +993,7 @@ public:
                 ::factor(
                       nrow(), ncol(), lperm, aval_, lda_,
                       cdata_[i_].d, inner_backup, options, options.pivot_method,
-                      INNER_BLOCK_SIZE, 0, nullptr, 0, work, alloc
+                      inner_block_size, 0, nullptr, 0, work, alloc
                       );
          if(cdata_[i_].nelim < 0) return cdata_[i_].nelim;
          int* temp = work[omp_get_thread_num()].get_ptr<int>(ncol());
@@ -2485,6 +2497,44 @@ public:
    }
 };
 
+/** \brief Factorize using LDLT with a given inner block size.
+ *  \details Wrapper allowing runtime selection of INNER_BLOCK_SIZE, see
+ *           ldlt_app_factor() for parameters. */
+template<typename T, int INNER_BLOCK_SIZE, typename Allocator>
+int ldlt_app_factor_inner(int m, int n, int* perm, T* a, int lda, T* d,
+      T beta, T* upd, int ldupd, struct cpu_factor_options const& options,
+      int outer_block_size, std::vector<Workspace>& work,
+      Allocator const& alloc) {
+   bool const debug = false;
+   //PoolBackup<T, Allocator> backup(m, n, outer_block_size, alloc);
+   CopyBackup<T, Allocator> backup(m, n, outer_block_size, alloc);
+
+   bool const use_tasks = true;
+   return LDLT
+      <T, INNER_BLOCK_SIZE, CopyBackup<T,Allocator>, use_tasks, debug,
+       Allocator>
+      ::factor(
+            m, n, perm, a, lda, d, backup, options, options.pivot_method,
+            outer_block_size, beta, upd, ldupd, work, alloc
+            );
+}
+
+/** \brief Return inner block size to use.
+ *  \details options.cpu_inner_block_size is rounded to the nearest supported
+ *           size (16, 32 or 64). If it is not positive, a fixed default of 32
+ *           is used so that factors are reproducible. The autotune driver
+ *           finds the fastest size for a machine and records it in its
+ *           profile.
+ *  \param options User-supplied options.
+ */
+inline int get_inner_block_size(struct cpu_factor_options const& options) {
+   int const requested = options.cpu_inner_block_size;
+   if(requested <= 0) return 32;
+   if(requested < 24) return 16;
+   if(requested < 48) return 32;
+   return 64;
+}
+
 } /* namespace spral::ssids:cpu::ldlt_app_internal */
 
 using namespace spral::ssids::cpu::ldlt_app_internal;
@@ -2516,22 +2566,42 @@ int ldlt_app_factor(int m, int n, int* perm, T* a, int lda, T* d, T beta, T* upd
    Profile::setState("TA_MISC1");
 #endif
 
-   // Template parameters and workspaces
-   bool const debug = false;
-   //PoolBackup<T, Allocator> backup(m, n, outer_block_size, alloc);
-   CopyBackup<T, Allocator> backup(m, n, outer_block_size, alloc);
-
-   // Actual call
-   bool const use_tasks = true;
-   return LDLT
-      <T, INNER_BLOCK_SIZE, CopyBackup<T,Allocator>, use_tasks, debug,
-       Allocator>
-      ::factor(
-            m, n, perm, a, lda, d, backup, options, options.pivot_method,
-            outer_block_size, beta, upd, ldupd, work, alloc
+   // Dispatch on inner block size
+   switch(get_inner_block_size(options)) {
+   case 16:
+      return ldlt_app_factor_inner<T, 16>(
+            m, n, perm, a, lda, d, beta, upd, ldupd, options, outer_block_size,
+            work, alloc
+            );
+   case 64:
+      return ldlt_app_factor_inner<T, 64>(
+            m, n, perm, a, lda, d, beta, upd, ldupd, options, outer_block_size,
+            work, alloc
             );
+   default:
+      return ldlt_app_factor_inner<T, 32>(
+            m, n, perm, a, lda, d, beta, upd, ldupd, options, outer_block_size,
+            work, alloc
+            );
+   }
+}
+template int ldlt_app_factor<double, BuddyAllocator<double,NumaAllocator<double>>>(int, int, int*, double*, int, double*, double, double*, int, struct cpu_factor_options const&, std::vector<Workspace>&, BuddyAllocator<double,NumaAllocator<double>> const& alloc);
+
+/** \brief Return sizes (as a number of T) of the backups that
+ *         ldlt_app_factor() allocates and holds at once for an m x n node:
+ *         first that of the node, then that of its leading diagonal block at
+ *         each level of recursion to the inner block size.
+ */
+template <typename T>
+std::vector<size_t> ldlt_app_backup_sizes(int m, int n, struct cpu_factor_options const& options) {
+   std::vector<size_t> sizes(1, align_lda<T>(m) * n);
+   int const inner_block_size = get_inner_block_size(options);
+   for(int bs=options.cpu_block_size; bs!=inner_block_size;
+         bs=calc_recurse_blksz(bs, inner_block_size))
+      sizes.push_back(align_lda<T>(std::min(bs, m)) * std::min(bs, n));
+   return sizes;
 }
-template int ldlt_app_factor<double, BuddyAllocator<double,std::allocator<double>>>(int, int, int*, double*, int, double*, double, double*, int, struct cpu_factor_options const&, std::vector<Workspace>&, BuddyAllocator<double,std::allocator<double>> const& alloc);
+template std::vector<size_t> ldlt_app_backup_sizes<double>(int, int, struct cpu_factor_options const&);
 
 template <typename T>
 void ldlt_app_solve_fwd(int m, int n, T const* l, int ldl, int nrhs, T* x, int ldx) {
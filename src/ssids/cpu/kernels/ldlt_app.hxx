@@ -5,6 +5,7 @@
  */
 #pragma once
 
+#include <cstddef>
 #include <vector>
 
 #include "ssids/cpu/Workspace.hxx"
@@ -14,6 +15,9 @@ namespace spral { namespace ssids { namespace cpu {
 template<typename T, typename Allocator>
 int ldlt_app_factor(int m, int n, int *perm, T *a, int lda, T *d, T beta, T* upd, int ldupd, struct cpu_factor_options const& options, std::vector<Workspace>& work, Allocator const& alloc);
 
+template <typename T>
+std::vector<size_t> ldlt_app_backup_sizes(int m, int n, struct cpu_factor_options const& options);
+
 template <typename T>
 void ldlt_app_solve_fwd(int m, int n, T const* l, int ldl, int nrhs, T* x, int ldx);
 
@@ -9,8 +9,15 @@
 #include <cmath>
 #include <limits>
 #include <utility>
+#include <vector>
 
+#ifdef _OPENMP
+#include <omp.h>
+#endif /* _OPENMP */
+
+#include "compat.hxx"
 #include "ssids/cpu/ThreadStats.hxx"
+#include "ssids/cpu/kernels/calc_ld.hxx"
 #include "ssids/cpu/kernels/wrappers.hxx"
 
 namespace spral { namespace ssids { namespace cpu {
@@ -27,8 +34,28 @@ bool check_col_small(int idx, int from, int to, double const* a, int lda, double
    return check;
 }
 
-/** Returns col index of largest entry in row starting at a */
-int find_row_abs_max(int from, int to, double const* a, int lda) {
+/** Number of columns brought into the active panel at a time. Updates to
+ *  columns outside the panel are deferred and applied as a single BLAS-3 call
+ *  when they are brought into it. */
+int const PANEL_SIZE = 32;
+/** Minimum work (flops, or entries searched) for a task in parallel loops */
+long const MIN_TASK_WORK = 4096;
+
+/** Returns number of rows/entries each task should handle to split a loop of
+ *  len iterations, each costing work, over the threads of the current team.
+ *  A return value of at least len means the loop should run serially, as
+ *  there are no other threads or too little work to share. */
+int calc_task_size(int len, long work) {
+   int const nthread = omp_get_num_threads();
+   if(nthread <= 1 || len <= 0) return len;
+   long const min_size = (MIN_TASK_WORK-1) / std::max(1L, work) + 1;
+   long const size = std::max(min_size, static_cast<long>((len-1)/nthread+1));
+   if(size >= len) return len;
+   return static_cast<int>(8 * ((size-1)/8 + 1)); // Whole cache lines
+}
+
+/** Returns col index of largest entry in row starting at a (serial) */
+int find_row_abs_max_serial(int from, int to, double const* a, int lda) {
    if(from>=to) return -1;
    int best_idx=from; double best_val=fabs(a[from*lda]);
    for(int idx=from+1; idx<to; ++idx)
@@ -39,6 +66,31 @@ int find_row_abs_max(int from, int to, double const* a, int lda) {
    return best_idx;
 }
 
+/** Returns col index of largest entry in row starting at a.
+ *  Long rows are split into chunks searched as separate tasks, one per
+ *  thread of the current team (see calc_task_size()). Ties are
+ *  resolved in favour of the lowest index, as for the serial search. */
+int find_row_abs_max(int from, int to, double const* a, int lda) {
+   int chunk = calc_task_size(to-from, 1);
+   if(chunk >= to-from) return find_row_abs_max_serial(from, to, a, lda);
+   int nchunk = (to-from-1) / chunk + 1;
+   std::vector<int> best(nchunk);
+   #pragma omp taskgroup
+   for(int i=0; i<nchunk; ++i) {
+      #pragma omp task default(none) \
+         firstprivate(i) \
+         shared(from, to, a, lda, chunk, best)
+      best[i] = find_row_abs_max_serial(
+            from+i*chunk, std::min(to, from+(i+1)*chunk), a, lda
+            );
+   }
+   int best_idx = best[0];
+   for(int i=1; i<nchunk; ++i)
+      if(fabs(a[best[i]*lda]) > fabs(a[best_idx*lda]))
+         best_idx = best[i];
+   return best_idx;
+}
+
 /** Performs symmetric swap of col1 and col2 in lower triangle */
 // FIXME: remove n only here for debug
 void swap_cols(int col1, int col2, int m, int n, int* perm, double* a, int lda, int nleft, double* aleft, int ldleft) {
@@ -71,20 +123,77 @@ void swap_cols(int col1, int col2, int m, int n, int* perm, double* a, int lda,
    std::swap( a[col1*lda+col1], a[col2*lda+col2] );
 }
 
-/** Returns abs value of largest unelim entry in row/col not in posn exclude or on diagonal */
+/** Returns abs value of largest entry in a[from:to-1] not in posn exclude */
+double find_col_abs_max_exclude(int from, int to, double const* a, int exclude) {
+   double best = 0.0;
+   for(int r=from; r<to; ++r) {
+      if(r==exclude) continue;
+      best = std::max(best, fabs(a[r]));
+   }
+   return best;
+}
+
+/** Returns abs value of largest unelim entry in row/col not in posn exclude or on diagonal.
+ *  The column part is split into chunks searched as separate tasks if long. */
 double find_rc_abs_max_exclude(int col, int nelim, int m, double const* a, int lda, int exclude) {
    double best = 0.0;
    for(int c=nelim; c<col; ++c) {
       if(c==exclude) continue;
       best = std::max(best, fabs(a[c*lda+col]));
    }
-   for(int r=col+1; r<m; ++r) {
-      if(r==exclude) continue;
-      best = std::max(best, fabs(a[col*lda+r]));
+   int chunk = calc_task_size(m-col-1, 1);
+   double const* acol = &a[col*lda];
+   if(chunk >= m-col-1)
+      return std::max(best, find_col_abs_max_exclude(col+1, m, acol, exclude));
+   int nchunk = (m-col-2) / chunk + 1;
+   std::vector<double> cbest(nchunk);
+   #pragma omp taskgroup
+   for(int i=0; i<nchunk; ++i) {
+      #pragma omp task default(none) \
+         firstprivate(i) \
+         shared(col, m, acol, exclude, chunk, cbest)
+      cbest[i] = find_col_abs_max_exclude(
+            col+1+i*chunk, std::min(m, col+1+(i+1)*chunk), acol, exclude
+            );
    }
+   for(int i=0; i<nchunk; ++i)
+      best = std::max(best, cbest[i]);
    return best;
 }
 
+/** Performs the update a -= l ld^T for an m x n block a with rank k.
+ *  If there is enough work the rows are split into blocks, one per thread of
+ *  the current team, updated as separate tasks. */
+void update_block(int m, int n, int k, double const* l, int ldl,
+      double const* ld, int ldld, double* a, int lda) {
+   if(m<=0 || n<=0 || k<=0) return; // Nothing to do
+   int blksz = calc_task_size(m, 2L*n*k);
+   if(blksz >= m) {
+      host_gemm(OP_N, OP_T, m, n, k, -1.0, l, ldl, ld, ldld, 1.0, a, lda);
+      return;
+   }
+   #pragma omp taskgroup
+   for(int r=0; r<m; r+=blksz) {
+      #pragma omp task default(none) \
+         firstprivate(r) \
+         shared(m, n, k, l, ldl, ld, ldld, a, lda, blksz)
+      host_gemm(OP_N, OP_T, std::min(blksz, m-r), n, k, -1.0, &l[r], ldl,
+            ld, ldld, 1.0, &a[r], lda);
+   }
+}
+
+/** Applies the deferred updates from pivots 0:nelim-1 to columns from:to-1.
+ *  \param work Workspace for the LD block, resized as required. */
+void apply_deferred(int from, int to, int nelim, int m, double const* d,
+      double* a, int lda, std::vector<double>& work) {
+   if(nelim<=0 || from>=to) return; // Nothing to do
+   int ldld = to - from;
+   if(work.size() < static_cast<size_t>(ldld)*nelim) work.resize(ldld*nelim);
+   calcLD<OP_N>(ldld, nelim, &a[from], lda, d, work.data(), ldld);
+   update_block(m-from, to-from, nelim, &a[from], lda, work.data(), ldld,
+         &a[from*lda+from], lda);
+}
+
 /** Return true if (t,p) is a good 2x2 pivot, false otherwise */
 bool test_2x2(int t, int p, double maxt, double maxp, double const* a, int lda, double u, double small, double* d) {
    // NB: We know t < p
@@ -161,14 +270,29 @@ void zero_col(int col, int m, double* a, int lda) {
 
 } /* anon namespace */
 
-/** Simple LDL^T with threshold partial pivoting.
- * Intended for finishing off small matrices, not for performance */
+/** LDL^T with threshold partial pivoting.
+ *
+ * Pivots are sought column by column as usual, but only the columns of an
+ * active panel are kept up to date. Updates to columns to the right of the
+ * panel are deferred until the pivot search reaches them, at which point they
+ * are applied left-looking with a single BLAS-3 call. As pivot candidates are
+ * only ever tested against entries in columns up to and including themselves,
+ * this gives identical pivot choices to an unblocked right-looking
+ * implementation. Large updates and searches are split into tasks. */
 int ldlt_tpp_factor(int m, int n, int* perm, double* a, int lda, double* d,
       double* ld, int ldld, bool action, double u, double small, int nleft,
       double* aleft, int ldleft) {
    //printf("=== ENTRY %d %d ===\n", m, n);
    int nelim = 0; // Number of eliminated variables
+   int pend = std::min(n, PANEL_SIZE); // End of active panel
+   std::vector<double> ldwork; // Workspace for deferred updates
    while(nelim<n) {
+      // Ensure we have at least a 2x2 pivot's worth of active columns
+      if(pend < n && pend-nelim < 2) {
+         int new_pend = std::min(n, nelim + PANEL_SIZE);
+         apply_deferred(pend, new_pend, nelim, m, d, a, lda, ldwork);
+         pend = new_pend;
+      }
       /*printf("nelim = %d\n", nelim);
       for(int r=0; r<m; ++r) {
          printf("%d: ", perm[r]);
@@ -190,6 +314,12 @@ int ldlt_tpp_factor(int m, int n, int* perm, double* a, int lda, double* d,
       int p; // Index of current candidate pivot [starts at col 2]
       for(p=nelim+1; p<n; ++p) {
          //printf("Consider p=%d\n", p);
+         if(p == pend) {
+            // Extend active panel to include p
+            int new_pend = std::min(n, pend + PANEL_SIZE);
+            apply_deferred(pend, new_pend, nelim, m, d, a, lda, ldwork);
+            pend = new_pend;
+         }
          // Check if column p is effectively zero
          if(check_col_small(p, nelim, m, a, lda, small)) {
             // Record zero pivot
@@ -214,9 +344,9 @@ int ldlt_tpp_factor(int m, int n, int* perm, double* a, int lda, double* d,
             swap_cols(t, nelim, m, n, perm, a, lda, nleft, aleft, ldleft);
             swap_cols(p, nelim+1, m, n, perm, a, lda, nleft, aleft, ldleft);
             apply_2x2(nelim, m, a, lda, ld, ldld, d);
-            host_gemm(OP_N, OP_T, m-nelim-2, n-nelim-2, 2, -1.0,
+            update_block(m-nelim-2, pend-nelim-2, 2,
                   &a[nelim*lda+nelim+2], lda, &ld[nelim+2], ldld,
-                  1.0, &a[(nelim+2)*lda+nelim+2], lda); // update trailing mat
+                  &a[(nelim+2)*lda+nelim+2], lda); // update active panel
             nelim += 2;
             break;
          }
@@ -229,9 +359,9 @@ int ldlt_tpp_factor(int m, int n, int* perm, double* a, int lda, double* d,
             d[2*nelim] = 1 / a[nelim*lda+nelim];
             d[2*nelim+1] = 0.0;
             apply_1x1(nelim, m, a, lda, ld, ldld, d);
-            host_gemm(OP_N, OP_T, m-nelim-1, n-nelim-1, 1, -1.0,
+            update_block(m-nelim-1, pend-nelim-1, 1,
                   &a[nelim*lda+nelim+1], lda, &ld[nelim+1], ldld,
-                  1.0, &a[(nelim+1)*lda+nelim+1], lda); // update trailing mat
+                  &a[(nelim+1)*lda+nelim+1], lda); // update active panel
             nelim += 1;
             break;
          }
@@ -248,9 +378,9 @@ int ldlt_tpp_factor(int m, int n, int* perm, double* a, int lda, double* d,
             d[2*nelim] = 1 / a[nelim*lda+nelim];
             d[2*nelim+1] = 0.0;
             apply_1x1(nelim, m, a, lda, ld, ldld, d);
-            host_gemm(OP_N, OP_T, m-nelim-1, n-nelim-1, 1, -1.0,
+            update_block(m-nelim-1, pend-nelim-1, 1,
                   &a[nelim*lda+nelim+1], lda, &ld[nelim+1], ldld,
-                  1.0, &a[(nelim+1)*lda+nelim+1], lda); // update trailing mat
+                  &a[(nelim+1)*lda+nelim+1], lda); // update active panel
             nelim += 1;
          } else {
             // That didn't work either. No more pivots to be found
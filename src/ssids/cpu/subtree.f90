@@ -28,6 +28,7 @@ module spral_ssids_cpu_subtree
      type(cpu_symbolic_subtree), pointer :: symbolic
      type(C_PTR) :: csubtree
    contains
+     procedure :: refactor
      procedure :: get_contrib
      procedure :: solve_fwd
      procedure :: solve_diag
@@ -82,6 +83,20 @@ module spral_ssids_cpu_subtree
        type(cpu_factor_stats), intent(out) :: stats
      end function c_create_numeric_subtree
 
+     subroutine c_refactor_numeric_subtree(posdef, subtree, aval, &
+          child_contrib, options, stats) &
+          bind(C, name="spral_ssids_cpu_refactor_num_subtree_dbl")
+       use, intrinsic :: iso_c_binding
+       import :: cpu_factor_options, cpu_factor_stats
+       implicit none
+       logical(C_BOOL), value :: posdef
+       type(C_PTR), value :: subtree
+       real(C_DOUBLE), dimension(*), intent(in) :: aval
+       type(C_PTR), dimension(*), intent(inout) :: child_contrib
+       type(cpu_factor_options), intent(in) :: options
+       type(cpu_factor_stats), intent(out) :: stats
+     end subroutine c_refactor_numeric_subtree
+
      subroutine c_destroy_numeric_subtree(posdef, subtree) &
           bind(C, name="spral_ssids_cpu_destroy_num_subtree_dbl")
        use, intrinsic :: iso_c_binding
@@ -278,6 +293,7 @@ contains
 
     ! Extract to Fortran data structures
     call cpu_copy_stats_out(cstats, inform)
+    call print_thread_times(cstats, options)
 
     ! Success, set result and return
     factor => cpu_factor
@@ -291,6 +307,64 @@ contains
     return
   end function factor
 
+  !> @brief Refactorize with new values of A, reusing the existing factor
+  !>        object and the scaling supplied when it was created.
+  !>
+  !> On error, inform%flag is set and the subtree must be cleaned up rather
+  !> than used.
+  subroutine refactor(this, aval, child_contrib, options, inform)
+    implicit none
+    class(cpu_numeric_subtree), intent(inout) :: this
+    real(wp), dimension(*), intent(in) :: aval
+    type(contrib_type), dimension(:), target, intent(inout) :: child_contrib
+    type(ssids_options), intent(in) :: options
+    type(ssids_inform), intent(inout) :: inform
+
+    type(cpu_factor_options) :: coptions
+    type(cpu_factor_stats) :: cstats
+    integer :: i
+    type(C_PTR), dimension(:), allocatable :: contrib_ptr
+    integer :: st
+
+    ! Convert child_contrib to contrib_ptr
+    allocate(contrib_ptr(size(child_contrib)), stat=st)
+    if (st .ne. 0) then
+       inform%flag = SSIDS_ERROR_ALLOCATION
+       inform%stat = st
+       return
+    end if
+    do i = 1, size(child_contrib)
+       contrib_ptr(i) = C_LOC(child_contrib(i))
+    end do
+
+    ! Call C++ refactor routine
+    call cpu_copy_options_in(options, coptions)
+    call c_refactor_numeric_subtree(this%posdef, this%csubtree, aval, &
+         contrib_ptr, coptions, cstats)
+    if (cstats%flag .lt. 0) then
+       inform%flag = cstats%flag
+       return
+    end if
+
+    ! Extract to Fortran data structures
+    call cpu_copy_stats_out(cstats, inform)
+    call print_thread_times(cstats, options)
+  end subroutine refactor
+
+  !> @brief Print time threads spent busy and idle during factorization of a
+  !>        subtree, if options%print_level is at least 2.
+  subroutine print_thread_times(cstats, options)
+    implicit none
+    type(cpu_factor_stats), intent(in) :: cstats
+    type(ssids_options), intent(in) :: options
+
+    if ((options%print_level .lt. 2) .or. (options%unit_diagnostics .lt. 0)) &
+         return
+    write (options%unit_diagnostics, '(a,2(es10.3,a))') &
+         ' Subtree factorized: threads busy ', cstats%busy_time, &
+         's, idle ', cstats%idle_time, 's'
+  end subroutine print_thread_times
+
   subroutine numeric_cleanup(this)
     implicit none
     class(cpu_numeric_subtree), intent(inout) :: this
@@ -39,6 +39,7 @@ module spral_ssids_datatypes
   integer, parameter, public :: SSIDS_ERROR_NOT_LLT           = -13
   integer, parameter, public :: SSIDS_ERROR_NOT_LDLT          = -14
   integer, parameter, public :: SSIDS_ERROR_NO_SAVED_SCALING  = -15
+  integer, parameter, public :: SSIDS_ERROR_AMALGAMATION      = -16
   integer, parameter, public :: SSIDS_ERROR_ALLOCATION        = -50
   integer, parameter, public :: SSIDS_ERROR_CUDA_UNKNOWN      = -51
   integer, parameter, public :: SSIDS_ERROR_CUBLAS_UNKNOWN    = -52
@@ -73,6 +74,19 @@ module spral_ssids_datatypes
   integer, parameter, public :: FAILED_PIVOT_METHOD_TPP    = 1
   integer, parameter, public :: FAILED_PIVOT_METHOD_PASS   = 2
 
+  ! NB: the below must match enum CholeskySchedule in cpu/cpu_iface.hxx
+  integer, parameter, public :: CHOLESKY_SCHEDULE_COLUMN    = 1
+  integer, parameter, public :: CHOLESKY_SCHEDULE_ROW       = 2
+  integer, parameter, public :: CHOLESKY_SCHEDULE_LOOKAHEAD = 3
+
+  ! NB: the below must match enum TreeSchedule in cpu/cpu_iface.hxx
+  integer, parameter, public :: TREE_SCHEDULE_POSTORDER     = 1
+  integer, parameter, public :: TREE_SCHEDULE_CRITICAL_PATH = 2
+  integer, parameter, public :: TREE_SCHEDULE_READY         = 3
+
+  integer, parameter, public :: AMALGAMATION_NEMIN          = 1
+  integer, parameter, public :: AMALGAMATION_COST           = 2
+
   !!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!
 
   ! Note: below smalloc etc. types can't be in spral_ssids_alloc module as
@@ -208,14 +222,32 @@ module spral_ssids_datatypes
        ! 0 Order must be supplied by user
        ! 1 METIS ordering with default settings is used.
        ! 2 Matching with METIS on compressed matrix.
+       ! 3 Native nested dissection, computed in parallel.
+       ! 4 Approximate minimum degree (AMD).
+       ! 5 Automatic choice of AMD or METIS from n and AMD's fill estimate.
      integer :: nemin = nemin_default ! Min. number of eliminations at a tree
        ! node for amalgamation not to be considered.
+     integer :: amalgamation = AMALGAMATION_NEMIN ! Supernode amalgamation:
+       ! 1 - Merge nodes on the basis of nemin only
+       ! 2 - As 1, and also merge nodes if a cost model predicts that fewer,
+       !     larger nodes will be faster to factorize
+     real :: amalg_node_cost = 5e4 ! Amalgamation cost model: fixed cost of
+       ! each node of the assembly tree, in flops
+     real :: amalg_half_width = 16.0 ! Amalgamation cost model: number of
+       ! eliminated columns at which a node is factorized at half peak rate
+     character(len=255) :: analyse_cache = '' ! If not blank, directory in
+       ! which ssids_analyse() stores its results keyed by the sparsity
+       ! pattern of A, so they may be reused by later calls (including from
+       ! other processes) with the same pattern. Not used if ordering is 2.
 
      !
      ! High level subtree splitting parameters
      !
      logical :: ignore_numa = .false. ! If true, treat entire machine as single
        ! NUMA region for purposes of subtree allocation.
+     logical :: ignore_cache = .true. ! If false (and ignore_numa is false),
+       ! split each NUMA region into groups of cores sharing an L3 cache for
+       ! purposes of subtree allocation.
      logical :: use_gpu = .true. ! Use GPUs if present
      logical :: gpu_only = .false. ! FIXME: not yet implemented.
      integer(long) :: min_gpu_work = 5*10**9_long ! Only assign subtree to GPU
@@ -224,6 +256,10 @@ module spral_ssids_datatypes
        ! when dividing tree into subtrees
      real :: gpu_perf_coeff = 1.0 ! How many times better is a GPU than a
        ! single NUMA region's worth of processors
+     real :: part_node_cost = 2e5 ! Subtree splitting cost model: fixed cost
+       ! of each node of the assembly tree, in flops
+     real :: part_entry_cost = 10.0 ! Subtree splitting cost model: cost of
+       ! each entry of a contribution block, in flops
 
      !
      ! Options used by ssids_factor() [both indef+posdef]
@@ -242,6 +278,21 @@ module spral_ssids_datatypes
        ! which we treat a subtree as small and use the single core kernel
      integer :: cpu_block_size = 256 ! block size to use for task
        ! generation on larger nodes
+     integer :: cpu_inner_block_size = 0 ! block size at which recursive
+       ! factorization of diagonal blocks stops (one of 16, 32 or 64).
+       ! If <=0, 32 is used. spral_ssids_autotune records the fastest
+       ! value for a machine in its profile.
+     integer :: cholesky_schedule = CHOLESKY_SCHEDULE_COLUMN ! Order in which
+       ! tasks are generated for positive-definite factorization of large
+       ! nodes:
+       ! 1 - Right-looking, by block column
+       ! 2 - Left-looking, by block row
+       ! 3 - Right-looking with lookahead of one block column
+     integer :: tree_schedule = TREE_SCHEDULE_POSTORDER ! Order in which
+       ! tasks are created for the nodes of the assembly tree:
+       ! 1 - Postorder
+       ! 2 - Longest chain (critical path) first
+       ! 3 - As 2, but only create tasks once their children are complete
 
      !
      ! Options used by ssids_factor() with posdef=.false.
@@ -279,6 +330,8 @@ module spral_ssids_datatypes
    contains
      procedure :: print_summary_analyse
      procedure :: print_summary_factor
+     procedure :: read_profile
+     procedure :: write_profile
   end type ssids_options
 
   !!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!
@@ -315,6 +368,20 @@ contains
     write (mp,'(a,i15)') ' options%unit_warning      =  ',this%unit_warning
     write (mp,'(a,i15)') ' options%nemin             =  ',this%nemin
     write (mp,'(a,i15)') ' options%ordering          =  ',this%ordering
+    write (mp,'(a,i15)') ' options%amalgamation      =  ',this%amalgamation
+    if (this%amalgamation .eq. AMALGAMATION_COST) then
+       write (mp,'(a,es15.4)') ' options%amalg_node_cost   =  ', &
+            this%amalg_node_cost
+       write (mp,'(a,es15.4)') ' options%amalg_half_width  =  ', &
+            this%amalg_half_width
+    end if
+    write (mp,'(a,es15.4)') ' options%part_node_cost    =  ', &
+         this%part_node_cost
+    write (mp,'(a,es15.4)') ' options%part_entry_cost   =  ', &
+         this%part_entry_cost
+    if (len_trim(this%analyse_cache) .gt. 0) &
+         write (mp,'(2a)') ' options%analyse_cache     =  ', &
+         trim(this%analyse_cache)
   end subroutine print_summary_analyse
 
 !!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!
@@ -369,4 +436,110 @@ contains
     end if
   end subroutine print_summary_factor
 
+!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!
+!> @brief Read tuned option values from a profile
+!> @details A profile is a text file, such as that written by
+!>          write_profile(), with lines of the form "name = value". Blank
+!>          lines, lines starting with '#', and unrecognised names are
+!>          ignored. Values read before any error are retained.
+!> @param this Instance to update
+!> @param filename Name of profile file
+!> @param stat Zero on success, otherwise the iostat value of the failed
+!>        open or read.
+  subroutine read_profile(this, filename, stat)
+    implicit none
+    class(ssids_options), intent(inout) :: this
+    character(len=*), intent(in) :: filename
+    integer, intent(out) :: stat
+
+    integer :: unit, eq, st
+    character(len=200) :: line, name
+
+    open(newunit=unit, file=filename, status='old', action='read', iostat=stat)
+    if (stat .ne. 0) return
+    do
+       read (unit, '(a)', iostat=st) line
+       if (st .ne. 0) exit ! End of file
+       line = adjustl(line)
+       if ((len_trim(line) .eq. 0) .or. (line(1:1) .eq. '#')) cycle
+       eq = index(line, '=')
+       if (eq .eq. 0) cycle
+       name = adjustl(line(1:eq-1))
+       select case(trim(name))
+       case('nemin')
+          read (line(eq+1:), *, iostat=stat) this%nemin
+       case('small_subtree_threshold')
+          read (line(eq+1:), *, iostat=stat) this%small_subtree_threshold
+       case('cpu_block_size')
+          read (line(eq+1:), *, iostat=stat) this%cpu_block_size
+       case('cpu_inner_block_size')
+          read (line(eq+1:), *, iostat=stat) this%cpu_inner_block_size
+       case('amalgamation')
+          read (line(eq+1:), *, iostat=stat) this%amalgamation
+       case('amalg_node_cost')
+          read (line(eq+1:), *, iostat=stat) this%amalg_node_cost
+       case('amalg_half_width')
+          read (line(eq+1:), *, iostat=stat) this%amalg_half_width
+       case('part_node_cost')
+          read (line(eq+1:), *, iostat=stat) this%part_node_cost
+       case('part_entry_cost')
+          read (line(eq+1:), *, iostat=stat) this%part_entry_cost
+       end select
+       if (stat .ne. 0) exit
+    end do
+    close(unit)
+  end subroutine read_profile
+
+!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!
+!> @brief Write tunable option values to a profile for later use with
+!>        read_profile()
+!> @param this Instance to write
+!> @param filename Name of profile file (overwritten if it exists)
+!> @param stat Zero on success, otherwise the iostat value of the failed
+!>        open or write.
+!> @param comment Optional comment written at head of file
+  subroutine write_profile(this, filename, stat, comment)
+    implicit none
+    class(ssids_options), intent(in) :: this
+    character(len=*), intent(in) :: filename
+    integer, intent(out) :: stat
+    character(len=*), optional, intent(in) :: comment
+
+    integer :: unit
+
+    open(newunit=unit, file=filename, status='replace', action='write', &
+         iostat=stat)
+    if (stat .ne. 0) return
+    write (unit, '(a)', iostat=stat) '# SSIDS options profile'
+    if (present(comment) .and. (stat .eq. 0)) &
+         write (unit, '(2a)', iostat=stat) '# ', comment
+    if (stat .eq. 0) &
+         write (unit, '(a,i0)', iostat=stat) 'nemin = ', this%nemin
+    if (stat .eq. 0) &
+         write (unit, '(a,i0)', iostat=stat) 'small_subtree_threshold = ', &
+            this%small_subtree_threshold
+    if (stat .eq. 0) &
+         write (unit, '(a,i0)', iostat=stat) 'cpu_block_size = ', &
+            this%cpu_block_size
+    if (stat .eq. 0) &
+         write (unit, '(a,i0)', iostat=stat) 'cpu_inner_block_size = ', &
+            this%cpu_inner_block_size
+    if (stat .eq. 0) &
+         write (unit, '(a,i0)', iostat=stat) 'amalgamation = ', &
+            this%amalgamation
+    if (stat .eq. 0) &
+         write (unit, '(a,es12.5)', iostat=stat) 'amalg_node_cost = ', &
+            this%amalg_node_cost
+    if (stat .eq. 0) &
+         write (unit, '(a,es12.5)', iostat=stat) 'amalg_half_width = ', &
+            this%amalg_half_width
+    if (stat .eq. 0) &
+         write (unit, '(a,es12.5)', iostat=stat) 'part_node_cost = ', &
+            this%part_node_cost
+    if (stat .eq. 0) &
+         write (unit, '(a,es12.5)', iostat=stat) 'part_entry_cost = ', &
+            this%part_entry_cost
+    close(unit)
+  end subroutine write_profile
+
 end module spral_ssids_datatypes
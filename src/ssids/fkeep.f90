@@ -17,7 +17,7 @@ module spral_ssids_fkeep
   implicit none
 
   private
-  public :: ssids_fkeep
+  public :: ssids_fkeep, fit_part_costs
 
 !!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!
 
@@ -50,8 +50,247 @@ module spral_ssids_fkeep
 
 contains
 
+  !> @brief Factorize subtree i.
+  !>
+  !> If fkeep%subtree(i) already holds a CPU factorization of the same
+  !> subtree, it is refactorized in place with the new values, reusing its
+  !> scaling factors. Otherwise a new factorization is created.
+  subroutine factor_subtree(fkeep, akeep, i, val, child_contrib, options, &
+       inform)
+    implicit none
+    class(ssids_fkeep), intent(inout) :: fkeep
+    type(ssids_akeep), intent(in) :: akeep
+    integer, intent(in) :: i
+    real(wp), dimension(*), target, intent(in) :: val
+    type(contrib_type), dimension(:), target, intent(inout) :: child_contrib
+    type(ssids_options), intent(in) :: options
+    type(ssids_inform), intent(inout) :: inform
+
+    if (associated(fkeep%subtree(i)%ptr)) then
+       select type(subtree => fkeep%subtree(i)%ptr)
+       type is (cpu_numeric_subtree)
+          call subtree%refactor(val, child_contrib, options, inform)
+          return
+       class default
+          ! No in place refactorization available, start afresh
+          call subtree%cleanup()
+          deallocate(fkeep%subtree(i)%ptr)
+       end select
+    end if
+
+    if (allocated(fkeep%scaling)) then
+       fkeep%subtree(i)%ptr => akeep%subtree(i)%ptr%factor( &
+            fkeep%pos_def, val, child_contrib, options, inform, &
+            scaling=fkeep%scaling)
+    else
+       fkeep%subtree(i)%ptr => akeep%subtree(i)%ptr%factor( &
+            fkeep%pos_def, val, child_contrib, options, inform)
+    end if
+  end subroutine factor_subtree
+
+  !> @brief Factorize part i and, whilst it supplied the last outstanding
+  !>        input of its consumer part, continue with that consumer.
+  !>
+  !> Each published contribution decrements pending(consumer) atomically, so
+  !> a part never has to wait for an input: the producer that takes the count
+  !> to zero either continues with the consumer itself, if the consumer may
+  !> execute in this team (see part_runs_in()) or is a part of an enclosing
+  !> team that may start here (see start_early()), or leaves it to be claimed
+  !> by the consumer's own team when that next looks for ready parts. If that
+  !> team has already finished its work by then, the consumer waits for an
+  !> enclosing team (see factor_team()).
+  !>
+  !> NB: A part only starts once all its inputs are published, rather than
+  !> starting the nodes of its root as each input arrives: the tasks of a
+  !> subtree cannot be handed to the team factorizing another, so this would
+  !> mean waiting for inputs within the subtree.
+  !>
+  !> @param team Calling team, see akeep%team_first.
+  !> @param inform Per-thread inform values, indexed by thread number.
+  !> @param active Number of child teams of each team still busy.
+  subroutine factor_chain(fkeep, akeep, i, val, options, inform, &
+       child_contrib, pending, consumer, active, team, abort)
+    implicit none
+    class(ssids_fkeep), intent(inout) :: fkeep
+    type(ssids_akeep), intent(in) :: akeep
+    integer, intent(in) :: i
+    real(wp), dimension(*), target, intent(in) :: val
+    type(ssids_options), intent(in) :: options
+    type(ssids_inform), dimension(*), intent(inout) :: inform
+    type(contrib_type), dimension(*), intent(inout) :: child_contrib
+    integer, dimension(*), intent(inout) :: pending
+    integer, dimension(*), intent(in) :: consumer
+    integer, dimension(*), intent(inout) :: active
+    integer, intent(in) :: team
+    logical, intent(inout) :: abort
+
+    integer :: part, next, remain, my_loc
+    logical :: my_abort
+
+    part = i
+    do
+!$omp atomic read
+       my_abort = abort
+!$omp end atomic
+       if (my_abort) return
+       my_loc = 0
+!$     my_loc = omp_get_thread_num()
+       my_loc = my_loc + 1
+       call factor_subtree(fkeep, akeep, part, val,                           &
+            child_contrib(akeep%contrib_ptr(part):akeep%contrib_ptr(part+1)-1), &
+            options, inform(my_loc))
+       if (inform(my_loc)%flag .lt. 0) then
+!$omp atomic write
+          abort = .true.
+!$omp end atomic
+          return
+       end if
+
+       ! Publish contribution to consumer (if any)
+       next = consumer(part)
+       if (next .gt. akeep%nparts) return ! part is a root
+       child_contrib(akeep%contrib_idx(part)) = &
+            fkeep%subtree(part)%ptr%get_contrib()
+       ! NB: seq_cst ensures consumer sees all data published by its producers
+!$omp atomic capture seq_cst
+       pending(next) = pending(next) - 1
+       remain = pending(next)
+!$omp end atomic
+       if (remain .gt. 0) return ! Other inputs still outstanding
+       if (.not. (part_runs_in(akeep, next, team) .or. &
+            start_early(akeep, active, next, team))) return
+       if (.not. claim_part(pending, next)) return ! Claimed by a rescan
+       part = next
+    end do
+  end subroutine factor_chain
+
+  !> @brief Return true if part i may execute in given team, that is if all
+  !>        the regions of the team assigned to it belong to this team.
+  !>
+  !> @param team Team, see akeep%team_first. Any part may execute in team 1
+  !>        (all regions).
+  logical function part_runs_in(akeep, i, team)
+    implicit none
+    type(ssids_akeep), intent(in) :: akeep
+    integer, intent(in) :: i
+    integer, intent(in) :: team
+
+    integer :: exec_loc, first, last
+
+    exec_loc = akeep%subtree(i)%exec_loc
+    if (exec_loc .lt. 0) then
+       first = akeep%team_first(-exec_loc)
+       last = akeep%team_last(-exec_loc)
+    else
+       first = mod((exec_loc-1), size(akeep%topology)) + 1
+       last = first
+    end if
+    part_runs_in = ((first .ge. akeep%team_first(team)) .and. &
+         (last .le. akeep%team_last(team)))
+  end function part_runs_in
+
+  !> @brief Return true if part i belongs to a team enclosing the given team,
+  !>        and should start in the given team as soon as it is ready.
+  !>
+  !> This is the case whilst another child team on the way up to the team of
+  !> the part is still busy, so that the part overlaps with its work rather
+  !> than waiting for it. Otherwise the part is left for its own team, which
+  !> is about to run it with all its threads.
+  !>
+  !> @param active Number of child teams of each team still busy.
+  !> @param team Team, see akeep%team_first.
+  logical function start_early(akeep, active, i, team)
+    implicit none
+    type(ssids_akeep), intent(in) :: akeep
+    integer, dimension(*), intent(inout) :: active
+    integer, intent(in) :: i
+    integer, intent(in) :: team
+
+    integer :: owner, t, nactive
+    logical :: busy
+
+    start_early = .false.
+    if (akeep%subtree(i)%exec_loc .ge. 0) return ! part of a single region
+    owner = -akeep%subtree(i)%exec_loc
+    busy = .false.
+    t = team
+    do while (t .gt. owner) ! NB: teams are numbered after their parents
+       t = akeep%team_parent(t)
+!$omp atomic read
+       nactive = active(t)
+!$omp end atomic
+       busy = busy .or. (nactive .gt. 1)
+    end do
+    start_early = busy .and. (t .eq. owner)
+  end function start_early
+
+  !> @brief Claim part i for execution, returning true if it has all its
+  !>        inputs and was not already claimed.
+  !>
+  !> Once the last input of a part is published, pending(i) is only changed
+  !> by claims, each of which decrements it, so exactly one succeeds.
+  logical function claim_part(pending, i)
+    implicit none
+    integer, dimension(*), intent(inout) :: pending
+    integer, intent(in) :: i
+
+    integer :: remain
+
+    claim_part = .false.
+!$omp atomic read
+    remain = pending(i)
+!$omp end atomic
+    if (remain .ne. 0) return ! Inputs outstanding, or already claimed
+!$omp atomic capture
+    pending(i) = pending(i) - 1
+    remain = pending(i)
+!$omp end atomic
+    claim_part = (remain .eq. -1)
+  end function claim_part
+
+  !> @brief Claim all parts that may execute in a team, or start early in it
+  !>        (see start_early()), and have all their inputs, returning them in
+  !>        ready(1:nready).
+  !>
+  !> @param team Team, see akeep%team_first.
+  !> @param active Number of child teams of each team still busy.
+  subroutine claim_ready_parts(akeep, team, pending, active, ready, nready)
+    implicit none
+    type(ssids_akeep), intent(in) :: akeep
+    integer, intent(in) :: team
+    integer, dimension(*), intent(inout) :: pending
+    integer, dimension(*), intent(inout) :: active
+    integer, dimension(*), intent(out) :: ready
+    integer, intent(out) :: nready
+
+    integer :: i
+
+    nready = 0
+    do i = 1, akeep%nparts
+       if (.not. (part_runs_in(akeep, i, team) .or. &
+            start_early(akeep, active, i, team))) cycle
+       if (.not. claim_part(pending, i)) cycle
+       nready = nready + 1
+       ready(nready) = i
+    end do
+  end subroutine claim_ready_parts
+
+  !> @brief Factorize the parts of a team with no child teams, which is made
+  !>        up of a single NUMA region.
+  !>
+  !> Parts of the region with all their inputs available are started here.
+  !> Others are started by their last producer if it executes in this region.
+  !> Once all parts started have completed, the region is rescanned for parts
+  !> whose last input has since been published by another region, and these
+  !> are started in turn, along with any parts of enclosing teams that may
+  !> start early in this region (see start_early()). Only a part whose inputs
+  !> are still outstanding when a rescan finds nothing is left to an
+  !> enclosing team.
+  !>
+  !> @param team Team, see akeep%team_first.
+  !> @param active Number of child teams of each team still busy.
   subroutine inner_factor_numa(fkeep, akeep, val, options, inform, &
-       child_contrib, all_region)
+       child_contrib, pending, consumer, active, team, abort)
     implicit none
     type(ssids_akeep), intent(in) :: akeep
     class(ssids_fkeep), intent(inout) :: fkeep
@@ -59,83 +298,159 @@ contains
     type(ssids_options), intent(in) :: options
     type(ssids_inform), dimension(*), intent(inout) :: inform
     type(contrib_type), dimension(*), intent(inout) :: child_contrib
-    logical, intent(inout) :: all_region
+    integer, dimension(*), intent(inout) :: pending
+    integer, dimension(*), intent(in) :: consumer
+    integer, dimension(*), intent(inout) :: active
+    integer, intent(in) :: team
+    logical, intent(inout) :: abort
 
-    integer :: i, to_launch, numa_region, exec_loc, my_loc
-    logical :: abort, my_abort
+    integer :: i, nready, to_launch, numa_region
+    integer, dimension(:), allocatable :: ready
+    logical :: my_abort
 
-    numa_region = 0
-!$  numa_region = omp_get_thread_num()
-    numa_region = numa_region + 1
+    numa_region = akeep%team_first(team)
 
     to_launch = akeep%topology(numa_region)%nproc
     if (to_launch .le. 0) return
 !$  call omp_set_num_threads(to_launch)
 
+    allocate(ready(akeep%nparts), stat=inform(1)%stat)
+    if (inform(1)%stat .ne. 0) then
+       inform(1)%flag = SSIDS_ERROR_ALLOCATION
 !$omp atomic write
-    abort = .false.
+       abort = .true.
+!$omp end atomic
+       return
+    end if
+    do
+!$omp atomic read
+       my_abort = abort
 !$omp end atomic
+       if (my_abort) return
+       call claim_ready_parts(akeep, team, pending, active, ready, nready)
+       if (nready .eq. 0) exit
 
-    ! Split into threads for this NUMA region
+       ! Split into threads for this NUMA region
 !$omp parallel proc_bind(close)                 &
 !$omp    default(shared)                        &
-!$omp    private(i, exec_loc, my_abort, my_loc) &
+!$omp    private(i)                             &
 !$omp    num_threads(to_launch)
 !$omp single
 !$omp taskgroup
-    do i = 1, akeep%nparts
-       exec_loc = akeep%subtree(i)%exec_loc
-       if (exec_loc .eq. -1) then
+       do i = 1, nready
+!$omp task default(shared) firstprivate(i)
+          call factor_chain(fkeep, akeep, ready(i), val, options, inform, &
+               child_contrib, pending, consumer, active, team, abort)
+!$omp end task
+       end do
+!$omp end taskgroup
+!$omp end single
+!$omp end parallel
+    end do
+  end subroutine inner_factor_numa
+
+  !> @brief Factorize the parts of a team and of the teams nested within it.
+  !>
+  !> Child teams factorize their own parts concurrently, each bound to its
+  !> share of the places of this team. Whilst a child team is still busy, a
+  !> part of this team whose inputs are ready is started by a child team that
+  !> is idle, or by the child team that produced its last input, using the
+  !> threads of that child team (see start_early()). The parts left over once
+  !> all child teams have finished are factorized using all the threads of
+  !> this team: these are the parts assigned to the team itself, and any whose
+  !> last producer executed in a different child team. Hence, with regions
+  !> grouped by socket, the top of the tree is factorized by a socket before
+  !> all sockets are involved, and starts whilst other sockets finish their
+  !> own parts.
+  !>
+  !> @param team Team, see akeep%team_first.
+  !> @param inform Per-thread inform values. Region r uses entries
+  !>        (r-1)*max_cpus_per_numa+1 onwards.
+  !> @param active Number of child teams of each team still busy. The entry
+  !>        of the parent of this team is decremented on exit.
+  recursive subroutine factor_team(fkeep, akeep, team, val, options, inform, &
+       child_contrib, pending, consumer, active, max_cpus_per_numa, abort)
+    implicit none
+    class(ssids_fkeep), intent(inout) :: fkeep
+    type(ssids_akeep), intent(in) :: akeep
+    integer, intent(in) :: team
+    real(wp), dimension(*), target, intent(in) :: val
+    type(ssids_options), intent(in) :: options
+    type(ssids_inform), dimension(*), intent(inout) :: inform
+    type(contrib_type), dimension(*), intent(inout) :: child_contrib
+    integer, dimension(*), intent(inout) :: pending
+    integer, dimension(*), intent(in) :: consumer
+    integer, dimension(*), intent(inout) :: active
+    integer, intent(in) :: max_cpus_per_numa
+    logical, intent(inout) :: abort
+
+    integer :: i, j, nchild, nready, team_threads, offset
+    integer, dimension(:), allocatable :: child, ready
+    logical :: my_abort
+
+    offset = (akeep%team_first(team)-1)*max_cpus_per_numa + 1
+    nchild = count(akeep%team_parent(:) .eq. team)
+    allocate(child(nchild), ready(akeep%nparts), stat=inform(offset)%stat)
+    if (inform(offset)%stat .ne. 0) then
+       inform(offset)%flag = SSIDS_ERROR_ALLOCATION
 !$omp atomic write
-          all_region = .true.
+       abort = .true.
 !$omp end atomic
-          cycle
-       end if
-       if ((mod((exec_loc-1), size(akeep%topology))+1) .ne. numa_region) cycle
-       my_abort = .false.
-       my_loc = 0
-!$omp task untied                                    &
-!$omp    default(shared)                             &
-!$omp    firstprivate(i, exec_loc, my_abort, my_loc)
+       return
+    end if
+
+    if (nchild .eq. 0) then
+       call inner_factor_numa(fkeep, akeep, val, options, inform(offset), &
+            child_contrib, pending, consumer, active, team, abort)
+    else
+       j = 0
+       do i = team+1, size(akeep%team_parent)
+          if (akeep%team_parent(i) .ne. team) cycle
+          j = j + 1
+          child(j) = i
+       end do
+       active(team) = nchild
+!$omp parallel proc_bind(spread) num_threads(nchild) default(shared) private(i)
+       i = 1
+!$     i = omp_get_thread_num() + 1
+       call factor_team(fkeep, akeep, child(i), val, options, inform, &
+            child_contrib, pending, consumer, active, max_cpus_per_numa, abort)
+!$omp end parallel
+    end if
+
+    ! Remaining parts use all regions of this team (rescanning, as for a
+    ! single region, for parts whose last input is published elsewhere, and
+    ! for parts of enclosing teams that may start early)
+    team_threads = &
+         sum(akeep%topology(akeep%team_first(team):akeep%team_last(team))%nproc)
+    do
 !$omp atomic read
        my_abort = abort
 !$omp end atomic
-       if (my_abort) goto 10
-!$     my_loc = omp_get_thread_num()
-       my_loc = my_loc + 1
-       if (allocated(fkeep%scaling)) then
-          fkeep%subtree(i)%ptr => akeep%subtree(i)%ptr%factor(               &
-               fkeep%pos_def, val,                                           &
-               child_contrib(akeep%contrib_ptr(i):akeep%contrib_ptr(i+1)-1), &
-               options, inform(my_loc), scaling=fkeep%scaling                &
-               )
-       else
-          fkeep%subtree(i)%ptr => akeep%subtree(i)%ptr%factor(               &
-               fkeep%pos_def, val,                                           &
-               child_contrib(akeep%contrib_ptr(i):akeep%contrib_ptr(i+1)-1), &
-               options, inform(my_loc)                                       &
-               )
-       end if
-       if (inform(my_loc)%flag .lt. 0) then
-!$omp atomic write
-          abort = .true.
-!$omp end atomic
-          goto 10
-!$omp     cancel taskgroup
-       end if
-       if (akeep%contrib_idx(i) .le. akeep%nparts) then
-          ! There is a parent subtree to contribute to
-          child_contrib(akeep%contrib_idx(i)) = &
-               fkeep%subtree(i)%ptr%get_contrib()
-          child_contrib(akeep%contrib_idx(i))%ready = .true.
-       end if
-10     continue ! jump target for abort
+       if (my_abort) exit
+       call claim_ready_parts(akeep, team, pending, active, ready, nready)
+       if (nready .eq. 0) exit
+!$omp parallel num_threads(team_threads) default(shared) private(i)
+!$omp single
+!$omp taskgroup
+       do i = 1, nready
+!$omp task default(shared) firstprivate(i)
+          call factor_chain(fkeep, akeep, ready(i), val, options, &
+               inform(offset), child_contrib, pending, consumer, active, team, &
+               abort)
 !$omp end task
-    end do
+       end do
 !$omp end taskgroup
 !$omp end single
 !$omp end parallel
-  end subroutine inner_factor_numa
+    end do
+
+    ! This team is now idle
+    if (akeep%team_parent(team) .lt. 1) return
+!$omp atomic update
+    active(akeep%team_parent(team)) = active(akeep%team_parent(team)) - 1
+!$omp end atomic
+  end subroutine factor_team
 
   subroutine inner_factor_cpu(fkeep, akeep, val, options, inform)
     implicit none
@@ -145,41 +460,30 @@ contains
     type(ssids_options), intent(in) :: options
     type(ssids_inform), intent(inout) :: inform
 
-    integer :: i, numa_region, exec_loc, my_loc
-    integer :: numa_regions, region_threads !, device
-    integer :: max_cpus, max_cpus_per_numa, total_threads
-    logical :: all_region, my_all_region
+    integer :: i, j, numa_region
+    integer :: numa_regions, region_threads
+    integer :: max_cpus, max_cpus_per_numa
+    logical :: abort
     type(contrib_type), dimension(:), allocatable :: child_contrib
     type(ssids_inform), dimension(:), allocatable :: thread_inform
+    integer, dimension(:), allocatable :: pending, consumer, slot_part, active
 
     ! Begin profile trace (noop if not enabled)
     call profile_begin()
 
-    ! Allocate space for subtrees
-    allocate(fkeep%subtree(akeep%nparts), stat=inform%stat)
-    if (inform%stat .ne. 0) goto 200
+    ! Allocate space for subtrees (unless refactorizing existing ones)
+    if (.not. allocated(fkeep%subtree)) then
+       allocate(fkeep%subtree(akeep%nparts), stat=inform%stat)
+       if (inform%stat .ne. 0) goto 200
+    end if
 
     numa_regions = size(akeep%topology)
     if (numa_regions .eq. 0) numa_regions = 1
 
-    ! do i = 1, akeep%nparts
-    !    exec_loc = akeep%subtree(i)%exec_loc
-    !    if (exec_loc .eq. -1) then
-    !       numa_region = 0
-    !       device = 0
-    !       all_region = .true.
-    !    else
-    !       numa_region = mod((exec_loc-1), numa_regions) + 1
-    !       device = ((exec_loc-1) / numa_regions) + 1
-    !    end if
-    ! end do
-
     max_cpus_per_numa = 0
-    total_threads = 0
     do numa_region = 1, numa_regions
        region_threads = akeep%topology(numa_region)%nproc
        max_cpus_per_numa = max(max_cpus_per_numa, region_threads)
-       total_threads = total_threads + region_threads
     end do
     max_cpus = max_cpus_per_numa * numa_regions
 
@@ -188,62 +492,44 @@ contains
     allocate(thread_inform(max_cpus), stat=inform%stat)
     if (inform%stat .ne. 0) goto 200
 
-    ! Call subtree factor routines
-    ! Split into numa regions; parallelism within a region is responsibility
-    ! of subtrees.
+    ! Record number of inputs to each part and which part consumes its output
+    ! (nparts+1 if none). Slots contrib_ptr(j):contrib_ptr(j+1)-1 of
+    ! child_contrib hold the inputs to part j. A part is claimed for execution
+    ! by decrementing its count below zero (see claim_part()).
+    allocate(pending(akeep%nparts), consumer(akeep%nparts), &
+         slot_part(akeep%contrib_ptr(akeep%nparts+1)), stat=inform%stat)
+    if (inform%stat .ne. 0) goto 200
+    do j = 1, akeep%nparts
+       pending(j) = akeep%contrib_ptr(j+1) - akeep%contrib_ptr(j)
+       slot_part(akeep%contrib_ptr(j):akeep%contrib_ptr(j+1)-1) = j
+    end do
+    do i = 1, akeep%nparts
+       consumer(i) = akeep%nparts + 1
+       if (akeep%contrib_idx(i) .gt. akeep%nparts) cycle ! part is a root
+       consumer(i) = slot_part(akeep%contrib_idx(i))
+    end do
+    allocate(active(size(akeep%team_first)), stat=inform%stat)
+    if (inform%stat .ne. 0) goto 200
+    active(:) = 0
+    abort = .false.
 
-!$omp atomic write
-    all_region = .false.
-!$omp end atomic 
-
-!$omp parallel proc_bind(spread) num_threads(numa_regions) &
-!$omp    default(none)                                     &
-!$omp    shared(akeep, fkeep, val, options, thread_inform, &
-!$omp       child_contrib, all_region, max_cpus_per_numa)  &
-!$omp    private(i,numa_region)
-    numa_region = 0
-!$  numa_region = omp_get_thread_num()
-    numa_region = numa_region + 1
-    i = (numa_region-1)*max_cpus_per_numa + 1
-    call inner_factor_numa(fkeep, akeep, val, options, &
-         thread_inform(i), child_contrib, all_region)
+    ! Call subtree factor routines
+    ! Split into teams of numa regions, starting with the team of all regions;
+    ! parallelism within a region is responsibility of subtrees. Parts start
+    ! as soon as their inputs are published, and continue with their consumers
+    ! where these execute in the same team, or in an enclosing team that is
+    ! still waiting for other child teams. NB: the enclosing parallel region
+    ! ensures thread settings made by a team are local to it.
+
+!$omp parallel proc_bind(spread) num_threads(1) default(shared)
+    call factor_team(fkeep, akeep, 1, val, options, thread_inform, &
+         child_contrib, pending, consumer, active, max_cpus_per_numa, abort)
 !$omp end parallel
+
     do i = 1, max_cpus
        call inform%reduce(thread_inform(i))
     end do
-    if (inform%flag .lt. 0) goto 100 ! cleanup and exit
-
-!$omp atomic read
-    my_all_region = all_region
-!$omp end atomic
-    if (my_all_region) then
-       ! At least some all region subtrees exist
-!$omp parallel num_threads(total_threads) default(shared) private(i,exec_loc)
-!$omp single
-       do i = 1, akeep%nparts
-          exec_loc = akeep%subtree(i)%exec_loc
-          if (exec_loc .ne. -1) cycle
-          if (allocated(fkeep%scaling)) then
-             fkeep%subtree(i)%ptr => akeep%subtree(i)%ptr%factor( &
-                  fkeep%pos_def, val, &
-                  child_contrib(akeep%contrib_ptr(i):akeep%contrib_ptr(i+1)-1), &
-                  options, inform, scaling=fkeep%scaling &
-                  )
-          else
-             fkeep%subtree(i)%ptr => akeep%subtree(i)%ptr%factor( &
-                  fkeep%pos_def, val, &
-                  child_contrib(akeep%contrib_ptr(i):akeep%contrib_ptr(i+1)-1), &
-                  options, inform &
-                  )
-          end if
-          if (akeep%contrib_idx(i) .gt. akeep%nparts) cycle ! part is a root
-          child_contrib(akeep%contrib_idx(i)) = &
-               fkeep%subtree(i)%ptr%get_contrib()
-          child_contrib(akeep%contrib_idx(i))%ready = .true.
-       end do
-!$omp end single
-!$omp end parallel
-    end if
+    call fit_part_costs(inform)
 
 100 continue ! cleanup and exit
 
@@ -257,6 +543,70 @@ contains
     goto 100 ! cleanup and exit
   end subroutine inner_factor_cpu
 
+  !> @brief Fit the subtree splitting cost model to the times of the tasks
+  !>        of a factorization.
+  !>
+  !> The time of a task is modelled as
+  !>    t = x f + y e + z k,
+  !> with f its flops, e the entries of its contribution blocks and k its
+  !> number of nodes. Each CPU task (a node, or a small subtree) with time t
+  !> adds the row (f, e, k)/t to a least squares fit against 1, so that the
+  !> relative error is minimised. The normal equations are accumulated in
+  !> inform%cost_fit as the upper triangle of the 3x3 matrix (by rows)
+  !> followed by the right hand side. The node and entry costs are z and y
+  !> expressed in flops at rate 1/x, and are returned in
+  !> inform%part_node_cost and inform%part_entry_cost. These are left
+  !> negative if the tasks timed do not determine the fit.
+  !>
+  !> @param inform Holds normal equations on entry; costs set on exit.
+  subroutine fit_part_costs(inform)
+    implicit none
+    type(ssids_inform), intent(inout) :: inform
+
+    real(wp), dimension(3,3) :: ata
+    real(wp), dimension(3) :: atb, scale, c
+    real(wp) :: d
+
+    ata(1,1:3) = inform%cost_fit(1:3)
+    ata(2,2:3) = inform%cost_fit(4:5)
+    ata(3,3) = inform%cost_fit(6)
+    ata(2,1) = ata(1,2)
+    ata(3,1:2) = ata(1:2,3)
+    atb(:) = inform%cost_fit(7:9)
+
+    ! Scale to unit diagonal, as the unknowns differ in size by many orders
+    ! of magnitude, then solve by Cramer's rule
+    if ((ata(1,1) .le. 0) .or. (ata(2,2) .le. 0) .or. (ata(3,3) .le. 0)) &
+         return
+    scale(1) = 1 / sqrt(ata(1,1))
+    scale(2) = 1 / sqrt(ata(2,2))
+    scale(3) = 1 / sqrt(ata(3,3))
+    ata(:,1) = ata(:,1) * scale(:) * scale(1)
+    ata(:,2) = ata(:,2) * scale(:) * scale(2)
+    ata(:,3) = ata(:,3) * scale(:) * scale(3)
+    atb(:) = atb(:) * scale(:)
+    d = det3(ata)
+    if (d .lt. 1e-12_wp) return ! Too few distinct tasks
+    c(1) = det3(reshape((/ atb, ata(:,2), ata(:,3) /), (/ 3, 3 /))) / d
+    c(2) = det3(reshape((/ ata(:,1), atb, ata(:,3) /), (/ 3, 3 /))) / d
+    c(3) = det3(reshape((/ ata(:,1), ata(:,2), atb /), (/ 3, 3 /))) / d
+    c(:) = c(:) * scale(:)
+    if (c(1) .le. 0) return ! Time not increasing with flops
+    ! A negative coefficient means the term is lost in the noise
+    inform%part_entry_cost = max(0.0_wp, c(2) / c(1))
+    inform%part_node_cost = max(0.0_wp, c(3) / c(1))
+  end subroutine fit_part_costs
+
+  !> @brief Determinant of a 3x3 matrix.
+  real(wp) function det3(a)
+    implicit none
+    real(wp), dimension(3,3), intent(in) :: a
+
+    det3 = a(1,1) * (a(2,2)*a(3,3) - a(2,3)*a(3,2)) &
+         - a(1,2) * (a(2,1)*a(3,3) - a(2,3)*a(3,1)) &
+         + a(1,3) * (a(2,1)*a(3,2) - a(2,2)*a(3,1))
+  end function det3
+
   subroutine inner_solve_cpu(local_job, nrhs, x, ldx, akeep, fkeep, inform)
     implicit none
     type(ssids_akeep), intent(in) :: akeep
@@ -25,13 +25,29 @@ module spral_ssids_inform
      integer :: matrix_rank = 0 ! Rank of matrix (anal=structral, fact=actual)
      integer :: maxdepth = 0 ! Maximum depth of tree
      integer :: maxfront = 0 ! Maximum front size
+     integer(long) :: maxcontrib = 0_long ! Predicted peak number of entries
+         ! in contribution blocks (serial, no pivoting)
      integer :: num_delay = 0 ! Number of delayed variables
      integer(long) :: num_factor = 0_long ! Number of entries in factors
      integer(long) :: num_flops = 0_long ! Number of floating point operations
      integer :: num_neg = 0 ! Number of negative pivots
      integer :: num_sup = 0 ! Number of supernodes
      integer :: num_two = 0 ! Number of 2x2 pivots used by factorization
+     real(wp) :: part_node_cost = -1 ! Values of options%part_node_cost and
+     real(wp) :: part_entry_cost = -1 ! options%part_entry_cost fitted to the
+         ! task times of factorization (negative if too few tasks were timed)
      integer :: stat = 0 ! stat parameter
+     real(wp) :: cpu_busy_time = 0 ! Total time (seconds) over all threads
+     real(wp) :: cpu_idle_time = 0 ! spent executing, and not executing, the
+         ! tasks of CPU subtrees during factorization
+     ! Wall clock times (seconds) of phases of analyse
+     real(wp) :: time_order = 0 ! Finding pivot order
+     real(wp) :: time_etree = 0 ! Elimination tree and postorder
+     real(wp) :: time_col_counts = 0 ! Column counts
+     real(wp) :: time_supernodes = 0 ! Supernode amalgamation
+     real(wp) :: time_row_lists = 0 ! Row lists, including sort
+     real(wp) :: time_map = 0 ! Map from A to L
+     real(wp) :: time_subtrees = 0 ! Partitioning and symbolic subtrees
      type(auction_inform) :: auction
      integer :: cuda_error = 0
      integer :: cublas_error = 0
@@ -42,6 +58,21 @@ module spral_ssids_inform
      integer :: nparts = 0
      integer(long) :: cpu_flops = 0
      integer(long) :: gpu_flops = 0
+     integer(long) :: numa_local_bytes = 0
+     integer(long) :: numa_remote_bytes = 0
+     integer(long) :: numa_interleaved_bytes = 0
+     integer(long) :: cpu_alloc_bytes = 0 ! Factor and workspace memory of
+         ! CPU subtrees
+     integer(long) :: cpu_contrib_bytes = 0 ! Contribution blocks passed
+         ! between CPU subtrees
+     integer(long) :: cpu_pool_bytes = 0 ! Predicted (initial) size of the
+         ! pools for contribution blocks of CPU subtrees
+     integer :: cpu_pool_pages_added = 0 ! Pages added to these pools as
+         ! the prediction was exceeded (e.g. by delayed pivots)
+     logical :: analyse_cache_hit = .false. ! True if analyse results were
+         ! loaded from options%analyse_cache
+     real(wp), dimension(9) :: cost_fit = 0 ! Normal equations for fit of
+         ! part_node_cost and part_entry_cost, see fit_part_costs()
    contains
      procedure :: flag_to_character
      procedure :: print_flag
@@ -101,6 +132,8 @@ contains
     case(SSIDS_ERROR_NO_SAVED_SCALING)
        msg = 'Requested use of scaling from matching-based &
             &ordering but matching-based ordering not used'
+    case(SSIDS_ERROR_AMALGAMATION)
+       msg = 'control%amalgamation out of range'
     case(SSIDS_ERROR_UNIMPLEMENTED)
        msg = 'Functionality not yet implemented'
     case(SSIDS_ERROR_CUDA_UNKNOWN)
@@ -193,6 +226,7 @@ contains
     this%matrix_rank = this%matrix_rank + other%matrix_rank
     this%maxdepth = max(this%maxdepth, other%maxdepth)
     this%maxfront = max(this%maxfront, other%maxfront)
+    this%maxcontrib = max(this%maxcontrib, other%maxcontrib)
     this%num_delay = this%num_delay + other%num_delay
     this%num_factor = this%num_factor + other%num_factor
     this%num_flops = this%num_flops + other%num_flops
@@ -208,5 +242,17 @@ contains
     this%nparts = this%nparts + other%nparts
     this%cpu_flops = this%cpu_flops + other%cpu_flops
     this%gpu_flops = this%gpu_flops + other%gpu_flops
+    this%numa_local_bytes = this%numa_local_bytes + other%numa_local_bytes
+    this%numa_remote_bytes = this%numa_remote_bytes + other%numa_remote_bytes
+    this%numa_interleaved_bytes = this%numa_interleaved_bytes + &
+         other%numa_interleaved_bytes
+    this%cpu_alloc_bytes = this%cpu_alloc_bytes + other%cpu_alloc_bytes
+    this%cpu_contrib_bytes = this%cpu_contrib_bytes + other%cpu_contrib_bytes
+    this%cpu_pool_bytes = this%cpu_pool_bytes + other%cpu_pool_bytes
+    this%cpu_pool_pages_added = this%cpu_pool_pages_added + &
+         other%cpu_pool_pages_added
+    this%cost_fit(:) = this%cost_fit(:) + other%cost_fit(:)
+    this%cpu_busy_time = this%cpu_busy_time + other%cpu_busy_time
+    this%cpu_idle_time = this%cpu_idle_time + other%cpu_idle_time
   end subroutine reduce
 end module spral_ssids_inform
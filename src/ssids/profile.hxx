@@ -184,6 +184,7 @@ public:
       addEntityValue("TA_LDLT_TPP", "ST_TASK", "LDLT TPP", GTG_BLUE);
       addEntityValue("TA_ASM_PRE", "ST_TASK", "Assembly Pre", GTG_TEAL);
       addEntityValue("TA_ASM_POST", "ST_TASK", "Assembly Post", GTG_MAUVE);
+      addEntityValue("TA_ASM_TILE", "ST_TASK", "Assembly Tile", GTG_LIGHTPINK);
       addEntityValue("TA_MISC1", "ST_TASK", "Misc 1", GTG_KAKI);
       addEntityValue("TA_MISC2", "ST_TASK", "Misc 2", GTG_REDBLOOD);
       // GPU tasks
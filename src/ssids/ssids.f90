@@ -12,13 +12,16 @@ module spral_ssids
                                 SPRAL_MATRIX_REAL_SYM_PSDEF, &
                                 convert_coord_to_cscl, clean_cscl_oop, &
                                 apply_conversion_map
+  use spral_amd_order, only : amd_order
   use spral_metis_wrapper, only : metis_order
+  use spral_nd_order, only : nd_order
   use spral_scaling, only : auction_scale_sym, equilib_scale_sym, &
                             hungarian_scale_sym, &
                             equilib_options, equilib_inform, &
                             hungarian_options, hungarian_inform
   use spral_ssids_anal, only : analyse_phase, check_order, expand_matrix, &
-                               expand_pattern
+                               expand_pattern, analyse_cache_file, &
+                               load_analyse_cache, is_clean_lower
   use spral_ssids_datatypes
   use spral_ssids_akeep, only : ssids_akeep
   use spral_ssids_fkeep, only : ssids_fkeep
@@ -33,6 +36,7 @@ module spral_ssids
   public :: ssids_analyse,         & ! Analyse phase, CSC-lower input
             ssids_analyse_coord,   & ! Analyse phase, Coordinate input
             ssids_factor,          & ! Factorize phase
+            ssids_refactor,        & ! Factorize phase, values changed only
             ssids_solve,           & ! Solve phase
             ssids_free,            & ! Free akeep and/or fkeep
             ssids_enquire_posdef,  & ! Pivot information in posdef case
@@ -41,6 +45,11 @@ module spral_ssids
 
    !!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!
 
+  ! Automatic choice of ordering (options%ordering=5)
+  integer, parameter :: auto_amd_max_n = 50000 ! METIS used for larger n
+  real(wp), parameter :: auto_amd_max_fill = 20.0 ! METIS used if AMD predicts
+    ! more than this many entries in L per entry in lower triangle of A
+
   !> \brief Caches user OpenMP ICV values for later restoration
   type :: omp_settings
      logical :: nested, dynamic
@@ -60,6 +69,10 @@ module spral_ssids
      module procedure ssids_factor_ptr32_double, ssids_factor_ptr64_double
   end interface ssids_factor
 
+  interface ssids_refactor
+     module procedure ssids_refactor_double
+  end interface ssids_refactor
+
   interface ssids_solve
      module procedure ssids_solve_one_double
      module procedure ssids_solve_mult_double
@@ -164,10 +177,15 @@ contains
     integer(long) :: nz     ! entries in expanded matrix
     integer :: st           ! stat parameter
     integer :: flag         ! error flag for metis
+    integer(long) :: t_start, t_stop, t_rate ! system_clock values
+    character(len=:), allocatable :: cache_file ! file caching results of
+      ! analyse for this pattern, blank if not used
+    logical :: hit ! true if results were loaded from cache_file
 
     integer, dimension(:), allocatable :: order2
     integer(long), dimension(:), allocatable :: ptr2 ! col ptrs for expanded mat
     integer, dimension(:), allocatable :: row2 ! row indices for expanded matrix
+    integer, dimension(:), allocatable :: node ! region of unsquashed topology
 
     ! The following are only used for matching-based orderings
     real(wp), dimension(:), allocatable :: val_clean ! cleaned values if
@@ -177,6 +195,8 @@ contains
 
     integer :: mo_flag
     integer :: free_flag
+    logical :: clean ! true if user's data is already clean
+    integer :: ndiag ! number of diagonal entries in clean data
     type(ssids_inform) :: inform_default
 
     ! Initialise
@@ -218,13 +238,22 @@ contains
     end if
 
     ! check options%ordering has a valid value
-    if ((options%ordering .lt. 0) .or. (options%ordering .gt. 2)) then
+    if ((options%ordering .lt. 0) .or. (options%ordering .gt. 5)) then
        inform%flag = SSIDS_ERROR_ORDER
        akeep%inform = inform
        call inform%print_flag(options, context)
        return
     end if
 
+    ! check options%amalgamation has a valid value
+    if ((options%amalgamation .ne. AMALGAMATION_NEMIN) .and. &
+         (options%amalgamation .ne. AMALGAMATION_COST)) then
+       inform%flag = SSIDS_ERROR_AMALGAMATION
+       akeep%inform = inform
+       call inform%print_flag(options, context)
+       return
+    end if
+
     ! check val present when expected
     if (options%ordering .eq. 2) then
        if (.not. present(val)) then
@@ -240,7 +269,31 @@ contains
        allocate (akeep%ptr(n+1),stat=st)
        if (st .ne. 0) go to 490
 
-       if (present(val)) then
+       ! If the data is already clean, it is copied as is, avoiding the cost
+       ! of cleaning it and of a map to apply to the values on factorization
+       clean = .false.
+       if (size(ptr) .gt. n) then
+          if ((ptr(n+1) .gt. 1) .and. (ptr(n+1)-1 .le. size(row))) &
+               clean = is_clean_lower(n, ptr, row, ndiag)
+       end if
+
+       if (clean) then
+          nz = ptr(n+1) - 1
+          allocate(akeep%row(nz), stat=st)
+          if (st .ne. 0) go to 490
+          akeep%ptr(1:n+1) = ptr(1:n+1)
+          akeep%row(1:nz) = row(1:nz)
+          if (present(val)) then
+             allocate(val_clean(nz), stat=st)
+             if (st .ne. 0) go to 490
+             val_clean(1:nz) = val(1:nz)
+          end if
+          akeep%lmap = 0
+          inform%matrix_outrange = 0
+          inform%matrix_dup = 0
+          mu_flag = 0
+          if (ndiag .lt. n) mu_flag = SSIDS_WARNING_MISSING_DIAGONAL
+       else if (present(val)) then
           call clean_cscl_oop(SPRAL_MATRIX_REAL_SYM_INDEF, n, n, ptr, row, &
                akeep%ptr, akeep%row, mu_flag, val_in=val, val_out=val_clean, &
                lmap=akeep%lmap, map=akeep%map, &
@@ -284,6 +337,41 @@ contains
        if (st .ne. 0) go to 490
     end if
 
+    ! Figure out topology
+    if (present(topology)) then
+       ! User supplied
+       allocate(akeep%topology(size(topology)), stat=st)
+       if (st .ne. 0) goto 490
+       akeep%topology(:) = topology(:)
+    else
+       ! Guess it
+       call guess_topology(akeep%topology, st)
+       if (st .ne. 0) goto 490
+    end if
+    call squash_topology(akeep%topology, options, node, st)
+    if (st .ne. 0) goto 490
+    call find_teams(akeep%topology, node, akeep%team_first, &
+         akeep%team_last, akeep%team_parent, st)
+    if (st .ne. 0) goto 490
+
+    ! Reuse results of a previous analyse of the same pattern if available
+    if (check) then
+       cache_file = analyse_cache_file(check, n, akeep%ptr, akeep%row, &
+            options, akeep%topology, akeep%team_first, akeep%team_last, &
+            akeep%team_parent, order=order)
+       call load_analyse_cache(cache_file, n, akeep%ptr, akeep%row, order2, &
+            akeep, options, inform, hit, st, user_order=order)
+    else
+       cache_file = analyse_cache_file(check, n, ptr, row, options, &
+            akeep%topology, akeep%team_first, akeep%team_last, &
+            akeep%team_parent, order=order)
+       call load_analyse_cache(cache_file, n, ptr, row, order2, akeep, &
+            options, inform, hit, st, user_order=order)
+    end if
+    if (st .ne. 0) go to 490
+    if (hit) go to 480
+
+    call system_clock(t_start, t_rate)
     select case(options%ordering)
     case(0)
        if (.not. present(order)) then
@@ -297,7 +385,8 @@ contains
        if (inform%flag .lt. 0) go to 490
        order2(1:n) = order(1:n)
        if (check) then
-          call expand_pattern(n, nz, akeep%ptr, akeep%row, ptr2, row2)
+          call expand_pattern(n, nz, akeep%ptr, akeep%row, ptr2, row2, &
+               clean=.true.)
        else
           call expand_pattern(n, nz, ptr, row, ptr2, row2)
        end if
@@ -306,13 +395,47 @@ contains
        if (check) then
           call metis_order(n, akeep%ptr, akeep%row, order2, akeep%invp, &
                flag, inform%stat)
-          call expand_pattern(n, nz, akeep%ptr, akeep%row, ptr2, row2)
+          call expand_pattern(n, nz, akeep%ptr, akeep%row, ptr2, row2, &
+               clean=.true.)
        else
           call metis_order(n, ptr, row, order2, akeep%invp, &
                flag, inform%stat)
           call expand_pattern(n, nz, ptr, row, ptr2, row2)
        end if
        if (flag .lt. 0) go to 490
+    case(3)
+       ! Native nested dissection ordering (works on expanded pattern)
+       if (check) then
+          call expand_pattern(n, nz, akeep%ptr, akeep%row, ptr2, row2, &
+               clean=.true.)
+       else
+          call expand_pattern(n, nz, ptr, row, ptr2, row2)
+       end if
+       call nd_order(n, ptr2, row2, order2, akeep%invp, flag, st)
+       if (flag .lt. 0) go to 490
+    case(4)
+       ! Approximate minimum degree ordering (works on expanded pattern)
+       if (check) then
+          call expand_pattern(n, nz, akeep%ptr, akeep%row, ptr2, row2, &
+               clean=.true.)
+       else
+          call expand_pattern(n, nz, ptr, row, ptr2, row2)
+       end if
+       call amd_order(n, ptr2, row2, order2, akeep%invp, flag, st)
+       if (flag .lt. 0) go to 490
+    case(5)
+       ! Automatic choice between AMD and METIS orderings
+       if (check) then
+          call expand_pattern(n, nz, akeep%ptr, akeep%row, ptr2, row2, &
+               clean=.true.)
+          call auto_order(n, akeep%ptr, akeep%row, ptr2, row2, order2, &
+               akeep%invp, flag, st)
+       else
+          call expand_pattern(n, nz, ptr, row, ptr2, row2)
+          call auto_order(n, ptr, row, ptr2, row2, order2, akeep%invp, flag, &
+               st)
+       end if
+       if (flag .lt. 0) go to 490
     case(2)
        ! matching-based ordering required
        ! Expand the matrix as more efficient to do it and then
@@ -320,7 +443,7 @@ contains
 
        if (check) then
           call expand_matrix(n, nz, akeep%ptr, akeep%row, val_clean, ptr2, &
-               row2, val2)
+               row2, val2, clean=.true.)
           deallocate (val_clean,stat=st)
        else
           call expand_matrix(n, nz, ptr, row, val, ptr2, row2, val2)
@@ -349,30 +472,20 @@ contains
 
        deallocate(val2,stat=st)
     end select
-
-    ! Figure out topology
-    if (present(topology)) then
-       ! User supplied
-       allocate(akeep%topology(size(topology)), stat=st)
-       if (st .ne. 0) goto 490
-       akeep%topology(:) = topology(:)
-    else
-       ! Guess it
-       call guess_topology(akeep%topology, st)
-       if (st .ne. 0) goto 490
-    end if
-    call squash_topology(akeep%topology, options, st)
-    if (st .ne. 0) goto 490
+    call system_clock(t_stop)
+    inform%time_order = real(t_stop-t_start, wp) / t_rate
 
     ! perform rest of analyse
     if (check) then
        call analyse_phase(n, akeep%ptr, akeep%row, ptr2, row2, order2,  &
-            akeep%invp, akeep, options, inform)
+            akeep%invp, akeep, options, inform, cache_file=cache_file, &
+            cache_order=order)
     else
        call analyse_phase(n, ptr, row, ptr2, row2, order2, akeep%invp, &
-            akeep, options, inform)
+            akeep, options, inform, cache_file=cache_file, cache_order=order)
     end if
 
+480 continue
     if (present(order)) order(1:n) = abs(order2(1:n))
     if (options%print_level .gt. DEBUG_PRINT_LEVEL) &
          print *, "order = ", order2(1:n)
@@ -386,21 +499,69 @@ contains
     call inform%print_flag(options, context)
   end subroutine analyse_double
 
+!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!
+!> @brief Choose between AMD and METIS orderings (options%ordering=5).
+!>
+!> AMD is cheap for small and medium n, and the number of entries in L it
+!> predicts is a by-product that serves as a quick estimate of fill. If this
+!> is large relative to the number of entries in A, nested dissection is
+!> expected to do better and METIS is called instead.
+!>
+!> @param n Order of matrix.
+!> @param ptr Column pointers for lower triangle of A.
+!> @param row Row indices for lower triangle of A.
+!> @param ptr2 Column pointers for expanded pattern of A.
+!> @param row2 Row indices for expanded pattern of A.
+!> @param order On exit, elimination order: order(i) is position of i.
+!> @param invp On exit, inverse of order.
+!> @param flag Error flag from ordering routine called.
+!> @param st Stat parameter on allocation failure.
+  subroutine auto_order(n, ptr, row, ptr2, row2, order, invp, flag, st)
+    implicit none
+    integer, intent(in) :: n
+    integer(long), dimension(n+1), intent(in) :: ptr
+    integer, dimension(ptr(n+1)-1), intent(in) :: row
+    integer(long), dimension(n+1), intent(in) :: ptr2
+    integer, dimension(ptr2(n+1)-1), intent(in) :: row2
+    integer, dimension(n), intent(out) :: order
+    integer, dimension(n), intent(out) :: invp
+    integer, intent(out) :: flag
+    integer, intent(out) :: st
+
+    integer(long) :: lnz
+
+    st = 0
+    if (n .le. auto_amd_max_n) then
+       call amd_order(n, ptr2, row2, order, invp, flag, st, lnz=lnz)
+       if (flag .lt. 0) return
+       if (lnz .le. auto_amd_max_fill*(ptr(n+1)-1)) return
+    end if
+    call metis_order(n, ptr, row, order, invp, flag, st)
+  end subroutine auto_order
+
 !!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!
 !> @brief Given an initial topology, modify it to squash any resources options
-!>        parameters tell us to ignore.
+!>        parameters tell us to ignore, or to split NUMA regions into L3 cache
+!>        groups if options%ignore_cache is false.
 !> @param topology
-  subroutine squash_topology(topology, options, st)
+!> @param node On exit, node(i) is the region of the initial topology from
+!>        which region i derives, or 1 if it derives from several.
+  subroutine squash_topology(topology, options, node, st)
     implicit none
     type(numa_region), dimension(:), allocatable, intent(inout) :: topology
     type(ssids_options), intent(in) :: options
+    integer, dimension(:), allocatable, intent(out) :: node
     integer, intent(out) :: st
 
     logical :: no_omp
-    integer :: i, j, ngpu
+    integer :: i, j, ngpu, ngroup
     type(numa_region), dimension(:), allocatable :: new_topology
 
-    st = 0
+    allocate(node(size(topology)), stat=st)
+    if (st .ne. 0) return
+    do i = 1, size(topology)
+       node(i) = i
+    end do
 
     no_omp = .true.
 !$  no_omp = .false.
@@ -455,6 +616,7 @@ contains
        ! Move new_topology into place, deallocating old one
        deallocate(topology)
        call move_alloc(new_topology, topology)
+       node = (/ 1 /)
     ! Squash everything to single NUMA region if we're ignoring numa
     else if ((size(topology) .gt. 1) .and. options%ignore_numa) then
        allocate(new_topology(1), stat=st)
@@ -481,9 +643,149 @@ contains
        ! Move new_topology into place, deallocating old one
        deallocate(topology)
        call move_alloc(new_topology, topology)
+       node = (/ 1 /)
+    ! Split regions into groups of cores sharing an L3 cache if requested
+    else if ((.not. options%ignore_numa) .and. &
+         (.not. options%ignore_cache)) then
+       ngroup = 0
+       do i = 1, size(topology)
+          if (splits_by_cache(topology(i))) then
+             ngroup = ngroup + size(topology(i)%cache_groups)
+          else
+             ngroup = ngroup + 1
+          end if
+       end do
+       if (ngroup .eq. size(topology)) return ! Nothing to split
+       deallocate(node)
+       allocate(new_topology(ngroup), node(ngroup), stat=st)
+       if (st .ne. 0) return
+       ngroup = 0
+       do i = 1, size(topology)
+          if (splits_by_cache(topology(i))) then
+             do j = 1, size(topology(i)%cache_groups)
+                new_topology(ngroup + j)%nproc = topology(i)%cache_groups(j)
+                new_topology(ngroup + j)%socket = topology(i)%socket
+                allocate(new_topology(ngroup + j)%gpus(0), stat=st)
+                if (st .ne. 0) return
+                node(ngroup + j) = i
+             end do
+             ngroup = ngroup + size(topology(i)%cache_groups)
+          else
+             ngroup = ngroup + 1
+             new_topology(ngroup) = topology(i)
+             node(ngroup) = i
+          end if
+       end do
+       ! Move new_topology into place, deallocating old one
+       deallocate(topology)
+       call move_alloc(new_topology, topology)
     end if
   end subroutine squash_topology
 
+!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!
+!> @brief Group the regions of a (squashed) topology into a hierarchy of
+!>        teams: all regions, then sockets, then NUMA nodes, then regions.
+!>
+!> Each team is split into the maximal runs of consecutive regions that share
+!> the same socket or, if that does not split it, the same NUMA node or, if
+!> that does not either, into single regions. Hence a level of the hierarchy
+!> is omitted wherever it would not split a team, and a flat topology gives
+!> team 1 with one child team per region, as executed before teams existed.
+!> See akeep%team_first for the meaning of the output arrays.
+!> @param topology Squashed topology.
+!> @param node Region of initial topology from which each region derives.
+  subroutine find_teams(topology, node, team_first, team_last, team_parent, st)
+    implicit none
+    type(numa_region), dimension(:), intent(in) :: topology
+    integer, dimension(:), intent(in) :: node
+    integer, dimension(:), allocatable, intent(out) :: team_first
+    integer, dimension(:), allocatable, intent(out) :: team_last
+    integer, dimension(:), allocatable, intent(out) :: team_parent
+    integer, intent(out) :: st
+
+    integer :: first, last, level, nregion, nteam, r, t
+    integer, dimension(:), allocatable :: first2, last2, parent2
+    logical :: split
+
+    nregion = max(1, size(topology))
+    ! Every team but team 1 has at least one sibling, so there are fewer than
+    ! 2*nregion teams
+    allocate(first2(2*nregion), last2(2*nregion), parent2(2*nregion), &
+         stat=st)
+    if (st .ne. 0) return
+    nteam = 1
+    first2(1) = 1
+    last2(1) = nregion
+    parent2(1) = 0
+    t = 1
+    do while (t .le. nteam)
+       first = first2(t)
+       last = last2(t)
+       ! Find first level of hierarchy that splits team t
+       do level = 1, 3
+          split = .false.
+          do r = first+1, last
+             split = split .or. (team_key(level, r) .ne. team_key(level, r-1))
+          end do
+          if (split) exit
+       end do
+       ! Add a child team for each run of regions with the same key
+       if (first .lt. last) then
+          do r = first, last
+             if (r .gt. first) then
+                if (team_key(level, r) .eq. team_key(level, r-1)) cycle
+             end if
+             nteam = nteam + 1
+             first2(nteam) = r
+             parent2(nteam) = t
+             if (r .gt. first) last2(nteam-1) = r-1
+          end do
+          last2(nteam) = last
+       end if
+       t = t + 1
+    end do
+
+    allocate(team_first(nteam), team_last(nteam), team_parent(nteam), &
+         stat=st)
+    if (st .ne. 0) return
+    team_first(:) = first2(1:nteam)
+    team_last(:) = last2(1:nteam)
+    team_parent(:) = parent2(1:nteam)
+
+  contains
+    integer function team_key(level, r)
+      integer, intent(in) :: level
+      integer, intent(in) :: r
+
+      select case(level)
+      case(1)
+         team_key = topology(r)%socket
+      case(2)
+         team_key = node(r)
+      case default
+         team_key = r
+      end select
+    end function team_key
+  end subroutine find_teams
+
+!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!
+!> @brief Return true if region is to be split into its L3 cache groups.
+!>
+!> Regions with GPUs are kept intact, as are those whose cache groups are
+!> unknown or do not account for all of their processors.
+!> @param region NUMA region to consider.
+  logical function splits_by_cache(region)
+    implicit none
+    type(numa_region), intent(in) :: region
+
+    splits_by_cache = .false.
+    if (.not. allocated(region%cache_groups)) return
+    if (size(region%cache_groups) .le. 1) return
+    if (size(region%gpus) .gt. 0) return
+    if (any(region%cache_groups .le. 0)) return
+    splits_by_cache = (sum(region%cache_groups) .eq. region%nproc)
+  end function splits_by_cache
+
 !****************************************************************************
 !
 ! Analyse phase.
@@ -533,8 +835,10 @@ contains
     integer :: mu_flag      ! error flag for matrix_util routines
     integer(long) :: nz     ! entries in expanded matrix
     integer :: flag         ! error flag for metis
+    integer(long) :: t_start, t_stop, t_rate ! system_clock values
     integer :: st           ! stat parameter
     integer :: free_flag
+    integer, dimension(:), allocatable :: node ! region of unsquashed topology
 
     type(ssids_inform) :: inform_default
 
@@ -581,13 +885,22 @@ contains
     end if
 
     ! check options%ordering has a valid value
-    if ((options%ordering .lt. 0) .or. (options%ordering .gt. 2)) then
+    if ((options%ordering .lt. 0) .or. (options%ordering .gt. 5)) then
        inform%flag = SSIDS_ERROR_ORDER
        akeep%inform = inform
        call inform%print_flag(options, context)
        return
     end if
 
+    ! check options%amalgamation has a valid value
+    if ((options%amalgamation .ne. AMALGAMATION_NEMIN) .and. &
+         (options%amalgamation .ne. AMALGAMATION_COST)) then
+       inform%flag = SSIDS_ERROR_AMALGAMATION
+       akeep%inform = inform
+       call inform%print_flag(options, context)
+       return
+    end if
+
     ! check val present when expected
     if (options%ordering .eq. 2) then
        if (.not. present(val)) then
@@ -639,6 +952,7 @@ contains
        if (st .ne. 0) go to 490
     end if
 
+    call system_clock(t_start, t_rate)
     select case(options%ordering)
     case(0)
        if (.not. present(order)) then
@@ -651,20 +965,44 @@ contains
        call check_order(n,order,akeep%invp,options,inform)
        if (inform%flag .lt. 0) go to 490
        order2(1:n) = order(1:n)
-       call expand_pattern(n, nz, akeep%ptr, akeep%row, ptr2, row2)
+       call expand_pattern(n, nz, akeep%ptr, akeep%row, ptr2, row2, &
+            clean=.true.)
 
     case(1)
        ! METIS ordering
        call metis_order(n, akeep%ptr, akeep%row, order2, akeep%invp, &
             flag, inform%stat)
        if (flag .lt. 0) go to 490
-       call expand_pattern(n, nz, akeep%ptr, akeep%row, ptr2, row2)
+       call expand_pattern(n, nz, akeep%ptr, akeep%row, ptr2, row2, &
+            clean=.true.)
+
+    case(3)
+       ! Native nested dissection ordering
+       call expand_pattern(n, nz, akeep%ptr, akeep%row, ptr2, row2, &
+            clean=.true.)
+       call nd_order(n, ptr2, row2, order2, akeep%invp, flag, st)
+       if (flag .lt. 0) go to 490
+
+    case(4)
+       ! Approximate minimum degree ordering
+       call expand_pattern(n, nz, akeep%ptr, akeep%row, ptr2, row2, &
+            clean=.true.)
+       call amd_order(n, ptr2, row2, order2, akeep%invp, flag, st)
+       if (flag .lt. 0) go to 490
+
+    case(5)
+       ! Automatic choice between AMD and METIS orderings
+       call expand_pattern(n, nz, akeep%ptr, akeep%row, ptr2, row2, &
+            clean=.true.)
+       call auto_order(n, akeep%ptr, akeep%row, ptr2, row2, order2, &
+            akeep%invp, flag, st)
+       if (flag .lt. 0) go to 490
 
     case(2)
        ! matching-based ordering required
 
        call expand_matrix(n, nz, akeep%ptr, akeep%row, val_clean, ptr2, row2, &
-            val2)
+            val2, clean=.true.)
        deallocate (val_clean,stat=st)
 
        call match_order_metis(n,ptr2,row2,val2,order2,akeep%scaling,mo_flag, &
@@ -690,6 +1028,8 @@ contains
 
        deallocate(val2,stat=st)
     end select
+    call system_clock(t_stop)
+    inform%time_order = real(t_stop-t_start, wp) / t_rate
 
     ! Figure out topology
     if (present(topology)) then
@@ -702,6 +1042,11 @@ contains
        call guess_topology(akeep%topology, st)
        if (st .ne. 0) goto 490
     end if
+    call squash_topology(akeep%topology, options, node, st)
+    if (st .ne. 0) goto 490
+    call find_teams(akeep%topology, node, akeep%team_first, &
+         akeep%team_last, akeep%team_parent, st)
+    if (st .ne. 0) goto 490
 
     ! we now have the expanded structure held using ptr2, row2
     ! and we are ready to get on with the analyse phase.
@@ -825,8 +1170,9 @@ contains
     st = 0
     n = akeep%n
 
-    ! Ensure OpenMP setup is as required
-    call push_omp_settings(user_omp_settings, inform%flag)
+    ! Ensure OpenMP setup is as required (each level of teams of regions
+    ! nests a parallel region, see factor_team())
+    call push_omp_settings(user_omp_settings, inform%flag, team_depth(akeep))
     if (inform%flag .lt. 0) then
        fkeep%inform = inform
        call inform%print_flag(options, context)
@@ -858,8 +1204,13 @@ contains
        nz = akeep%ptr(n+1) - 1
        allocate(val2(nz),stat=st)
        if (st .ne. 0) go to 10
-       call apply_conversion_map(matrix_type, akeep%lmap, akeep%map, val, &
-            nz, val2)
+       if (allocated(akeep%map)) then
+          call apply_conversion_map(matrix_type, akeep%lmap, akeep%map, val, &
+               nz, val2)
+       else
+          ! Data was clean on analyse, so no map is needed
+          val2(1:nz) = val(1:nz)
+       end if
     else
        ! analyse run with no checking so must have ptr and row present
        if (.not. present(ptr)) inform%flag = SSIDS_ERROR_PTR_ROW
@@ -1063,7 +1414,7 @@ contains
        write (options%unit_diagnostics,'(/a)') &
             ' Completed factorisation with:'
        write (options%unit_diagnostics, &
-            '(a,2(/a,i12),2(/a,es12.4),5(/a,i12))') &
+            '(a,2(/a,i12),2(/a,es12.4),4(/a,i12),/a,es12.4,/a,i12)') &
             ' information parameters (inform%) :', &
             ' flag                   Error flag                               = ',&
             inform%flag, &
@@ -1080,7 +1431,11 @@ contains
             ' rank                   Computed rank                            = ',&
             inform%matrix_rank, &
             ' num_neg                Computed number of negative eigenvalues  = ',&
-            inform%num_neg
+            inform%num_neg, &
+            ' cpu_pool_bytes         Predicted bytes in contribution pools    = ',&
+            real(inform%cpu_pool_bytes), &
+            ' cpu_pool_pages_added   Pages added to contribution pools        = ',&
+            inform%cpu_pool_pages_added
     end if
 
     ! Normal return just drops through
@@ -1101,6 +1456,117 @@ contains
     goto 100
   end subroutine ssids_factor_ptr64_double
 
+!****************************************************************************
+!
+!> @brief Refactorize a matrix whose values have changed since the last call
+!>        to ssids_factor(), but whose sparsity pattern has not.
+!>
+!> The factorization held in fkeep is updated in place. Whether the matrix is
+!> positive definite, and any scaling, are taken from the previous call to
+!> ssids_factor(), so the expense of recomputing the scaling is avoided.
+!> Only the values of A are read, through the map from A to L computed by the
+!> analyse phase, so ptr and row are not required.
+!>
+!> @param val Values of A, in the same order as for ssids_factor().
+!> @param akeep Symbolic factorization returned by ssids_analyse().
+!> @param fkeep Factorization returned by a successful call to ssids_factor().
+!> @param options User-supplied options.
+!> @param inform Information on execution.
+  subroutine ssids_refactor_double(val, akeep, fkeep, options, inform)
+    implicit none
+    real(wp), dimension(*), target, intent(in) :: val
+    type(ssids_akeep), intent(in) :: akeep
+    type(ssids_fkeep), intent(inout) :: fkeep
+    type(ssids_options), intent(in) :: options
+    type(ssids_inform), intent(out) :: inform
+
+    real(wp), dimension(:), allocatable, target :: val2
+    character(len=50) :: context
+    integer :: matrix_type
+    integer(long) :: nz
+    integer :: st
+    type(omp_settings) :: user_omp_settings
+
+    context = 'ssids_refactor'
+
+    ! Check for error in call sequence
+    if ((.not. allocated(akeep%sptr)) .or. (akeep%inform%flag .lt. 0) .or. &
+         (fkeep%inform%flag .lt. 0)) then
+       ! Analyse or factorize failed or have not been run
+       inform%flag = SSIDS_ERROR_CALL_SEQUENCE
+       call inform%print_flag(options, context)
+       fkeep%inform = inform
+       return
+    end if
+
+    ! Immediate return for trivial matrix
+    inform = akeep%inform
+    if (akeep%nnodes .eq. 0) then
+       inform%flag = SSIDS_SUCCESS
+       inform%matrix_rank = 0
+       fkeep%inform = inform
+       call inform%print_flag(options, context)
+       return
+    end if
+
+    if (.not. allocated(fkeep%subtree)) then
+       ! Factorize phase has not been performed
+       inform%flag = SSIDS_ERROR_CALL_SEQUENCE
+       call inform%print_flag(options, context)
+       fkeep%inform = inform
+       return
+    end if
+
+    ! Ensure OpenMP setup is as required
+    call push_omp_settings(user_omp_settings, inform%flag)
+    if (inform%flag .lt. 0) then
+       fkeep%inform = inform
+       call inform%print_flag(options, context)
+       return
+    end if
+
+    ! If matrix has been checked, produce a clean version of val in val2
+    if (akeep%check) then
+       if (fkeep%pos_def) then
+          matrix_type = SPRAL_MATRIX_REAL_SYM_PSDEF
+       else
+          matrix_type = SPRAL_MATRIX_REAL_SYM_INDEF
+       end if
+       nz = akeep%ptr(akeep%n+1) - 1
+       allocate(val2(nz),stat=st)
+       if (st .ne. 0) then
+          inform%flag = SSIDS_ERROR_ALLOCATION
+          inform%stat = st
+          goto 100
+       end if
+       if (allocated(akeep%map)) then
+          call apply_conversion_map(matrix_type, akeep%lmap, akeep%map, val, &
+               nz, val2)
+       else
+          ! Data was clean on analyse, so no map is needed
+          val2(1:nz) = val(1:nz)
+       end if
+       call fkeep%inner_factor(akeep, val2, options, inform)
+    else
+       call fkeep%inner_factor(akeep, val, options, inform)
+    end if
+    if (inform%flag .lt. 0) goto 100
+
+    if (akeep%n .ne. inform%matrix_rank) then
+       ! Rank deficient
+       if (options%action) then
+          inform%flag = SSIDS_WARNING_FACT_SINGULAR
+       else
+          inform%flag = SSIDS_ERROR_SINGULAR
+       end if
+    end if
+
+100 continue
+    fkeep%inform = inform
+    call inform%print_flag(options, context)
+    call pop_omp_settings(user_omp_settings)
+  end subroutine ssids_refactor_double
+
 !*************************************************************************
 !
 ! Solve phase single x. 
@@ -1415,11 +1881,19 @@ contains
 !!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!
 !> \brief Ensure OpenMP ICVs are as required, and store user versions for
 !>        later restoration.
+!> \param levels Number of active levels of parallelism required, if more
+!>        than the default of 2.
 !> \sa pop_omp_settings()
-  subroutine push_omp_settings(user_settings, flag)
+  subroutine push_omp_settings(user_settings, flag, levels)
     implicit none
     type(omp_settings), intent(out) :: user_settings
     integer, intent(inout) :: flag
+    integer, optional, intent(in) :: levels
+
+    integer :: min_levels
+
+    min_levels = 2
+    if (present(levels)) min_levels = max(min_levels, levels)
 
     ! Dummy, for now.
     user_settings%nested = .true.
@@ -1443,11 +1917,34 @@ contains
 !$  user_settings%dynamic = omp_get_dynamic()
 !$  if (user_settings%dynamic) call omp_set_dynamic(.false.)
 
-!$  ! we will need at least 2 active levels
+!$  ! we will need at least 2 active levels (more for a hierarchy of teams)
 !$  user_settings%max_active_levels = omp_get_max_active_levels()
-!$  if (user_settings%max_active_levels .lt. 2) call omp_set_max_active_levels(2)
+!$  if (user_settings%max_active_levels .lt. min_levels) &
+!$       call omp_set_max_active_levels(min_levels)
   end subroutine push_omp_settings
 
+!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!
+!> \brief Return number of levels in hierarchy of teams of regions of akeep
+!>        (see akeep%team_first).
+  integer function team_depth(akeep)
+    implicit none
+    type(ssids_akeep), intent(in) :: akeep
+
+    integer :: depth, t, p
+
+    team_depth = 1
+    if (.not. allocated(akeep%team_parent)) return
+    do t = 1, size(akeep%team_parent)
+       depth = 1
+       p = akeep%team_parent(t)
+       do while (p .gt. 0)
+          depth = depth + 1
+          p = akeep%team_parent(p)
+       end do
+       team_depth = max(team_depth, depth)
+    end do
+  end function team_depth
+
 !!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!
 !> \brief Restore user OpenMP ICV values.
 !> \sa push_omp_settings()
@@ -1457,7 +1954,7 @@ contains
 
 !$  if (.not. user_settings%nested) call omp_set_nested(user_settings%nested)
 !$  if (user_settings%dynamic) call omp_set_dynamic(user_settings%dynamic)    
-!$  if (user_settings%max_active_levels .lt. 2) &
+!$  if (omp_get_max_active_levels() .ne. user_settings%max_active_levels) &
 !$       call omp_set_max_active_levels(user_settings%max_active_levels)
   end subroutine pop_omp_settings
 
@@ -19,7 +19,8 @@
 
 using namespace spral::ssids::cpu;
 
-int test_cholesky(int m, int n, int blksz, bool debug=false) {
+int test_cholesky(int m, int n, int blksz,
+      CholeskySchedule schedule=CholeskySchedule::column, bool debug=false) {
    /* Generate random dense posdef matrix of size m */
    int lda = m;
    double *a = new double[m*lda];
@@ -35,7 +36,8 @@ int test_cholesky(int m, int n, int blksz, bool debug=false) {
    {
       #pragma omp single
       {
-         cholesky_factor(m, n, l, lda, 1.0, &l[n*lda+n], lda, blksz, &info);
+         cholesky_factor(m, n, l, lda, 1.0, &l[n*lda+n], lda, blksz, &info,
+               schedule);
       }
    } /* implicit task wait on exit from parallel region */
    if(debug) { printf("POST:\n"); print_mat(" %e", m, l, lda); }
@@ -105,5 +107,16 @@ int run_cholesky_tests() {
    TEST(test_cholesky(733, 231, 19));
    TEST(test_cholesky(1668, 204, 256));
 
+   /* Alternative task schedules (m, n, blksz, schedule) */
+   TEST(test_cholesky(5, 3, 2, CholeskySchedule::row));
+   TEST(test_cholesky(6, 4, 2, CholeskySchedule::row));
+   TEST(test_cholesky(500, 234, 32, CholeskySchedule::row));
+   TEST(test_cholesky(733, 231, 19, CholeskySchedule::row));
+   TEST(test_cholesky(5, 3, 2, CholeskySchedule::lookahead));
+   TEST(test_cholesky(6, 4, 2, CholeskySchedule::lookahead));
+   TEST(test_cholesky(500, 234, 32, CholeskySchedule::lookahead));
+   TEST(test_cholesky(733, 231, 19, CholeskySchedule::lookahead));
+   TEST(test_cholesky(1668, 204, 256, CholeskySchedule::lookahead));
+
    return nerr;
 }
@@ -15,6 +15,7 @@
 #include <iomanip>
 #include <iostream>
 #include <limits>
+#include <vector>
 
 #include "framework.hxx"
 #include "ssids/cpu/kernels/wrappers.hxx"
@@ -287,16 +288,23 @@ int ldlt_tpp_test(double u, double small, bool delays, bool singular, int m, int
    for(int i=0; i<m; i++) perm[i] = i;
    double *d = new double[2*m];
    double *work = new double[2*m];
-   // First m x n matrix
-   int q1 = ldlt_tpp_factor(m, n, perm, l, lda, d, work, m, action, u, small);
-   if(debug) std::cout << "FIRST FACTOR CALL ELIMINATED " << q1 << " of " << n << " pivots" << std::endl;
-   int q2 = 0;
-   if(m > n) {
-      // Apply outer product update
-      do_update<double>(m-n, q1, &l[n*(lda+1)], &l[n], lda, d);
-      // Second (m-n) x (m-n) matrix [but add delays if any]
-      q2 = ldlt_tpp_factor(m-q1, m-q1, &perm[q1], &l[q1*(lda+1)], lda, &d[2*q1], work, m, action, u, small, q1, &l[q1], lda);
-   }
+   int q1, q2 = 0;
+   // Factor in a parallel region so large updates are split into tasks
+   #pragma omp parallel default(shared)
+   {
+      #pragma omp single
+      {
+         // First m x n matrix
+         q1 = ldlt_tpp_factor(m, n, perm, l, lda, d, work, m, action, u, small);
+         if(debug) std::cout << "FIRST FACTOR CALL ELIMINATED " << q1 << " of " << n << " pivots" << std::endl;
+         if(m > n) {
+            // Apply outer product update
+            do_update<double>(m-n, q1, &l[n*(lda+1)], &l[n], lda, d);
+            // Second (m-n) x (m-n) matrix [but add delays if any]
+            q2 = ldlt_tpp_factor(m-q1, m-q1, &perm[q1], &l[q1*(lda+1)], lda, &d[2*q1], work, m, action, u, small, q1, &l[q1], lda);
+         }
+      }
+   } /* implicit task wait on exit from parallel region */
    EXPECT_EQ(m, q1+q2) << "(test " << test << " seed " << seed << ")" << std::endl;
    EXPECT_LE(find_l_abs_max(m, l, lda), 1.0/u) << "(test " << test << " seed " << seed << ")" << std::endl;
 
@@ -373,6 +381,56 @@ int ldlt_tpp_torture_test(double u, double small, int ntest, int m, int n, bool
 
 } /* anon namespace */
 
+/// Checks that factorizing a tall m x n matrix using nthread threads, so that
+/// updates and column searches are split into tasks, gives the same result
+/// as a serial factorization.
+int ldlt_tpp_split_test(double u, double small, int m, int n, int nthread) {
+   bool failed = false;
+   bool action = true; // Don't abort on singular matrices
+
+   // Generate random lower trapezoidal matrix, with a heavier diagonal on
+   // alternate columns so there is a mix of 1x1, 2x2 and failed pivots
+   int lda = m;
+   std::vector<double> a(n*(size_t)lda, 0.0);
+   for(int c=0; c<n; ++c) {
+      for(int r=c; r<m; ++r)
+         a[c*(size_t)lda+r] = 2.0*rand()/RAND_MAX - 1.0;
+      if(c%2 == 0) a[c*(size_t)lda+c] *= 1000;
+   }
+
+   // Factorize serially, then with nthread threads
+   std::vector<double> l1(a), l2(a);
+   std::vector<int> perm1(m), perm2(m);
+   for(int i=0; i<m; i++) perm1[i] = perm2[i] = i;
+   std::vector<double> d1(2*n), d2(2*n), work(2*(size_t)m);
+   int q1 = ldlt_tpp_factor(m, n, perm1.data(), l1.data(), lda, d1.data(),
+         work.data(), m, action, u, small);
+   int q2;
+   #pragma omp parallel default(shared) num_threads(nthread)
+   {
+      #pragma omp single
+      q2 = ldlt_tpp_factor(m, n, perm2.data(), l2.data(), lda, d2.data(),
+            work.data(), m, action, u, small);
+   }
+
+   // Compare
+   ASSERT_EQ(q1, q2);
+   ASSERT_TRUE(q1 > 0);
+   for(int i=0; i<m; ++i)
+      ASSERT_EQ(perm1[i], perm2[i]);
+   double maxdiff = 0.0;
+   for(int i=0; i<2*q1; ++i)
+      if(std::isfinite(d1[i]))
+         maxdiff = std::max(maxdiff, fabs(d1[i]-d2[i]) / (1+fabs(d1[i])));
+   for(int c=0; c<q1; ++c)
+   for(int r=c; r<m; ++r)
+      maxdiff = std::max(maxdiff, fabs(l1[c*(size_t)lda+r]-l2[c*(size_t)lda+r]));
+   EXPECT_LE(maxdiff, 1e-12);
+   EXPECT_LE(find_l_abs_max(q1, l2.data(), lda), 1.0/u);
+
+   return failed ? -1 : 0;
+}
+
 int run_ldlt_tpp_tests() {
    int nerr = 0;
 
@@ -407,6 +465,14 @@ int run_ldlt_tpp_tests() {
    TEST(( ldlt_tpp_test(0.01, 1e-20, true, true, 233, 122) ));
    TEST(( ldlt_tpp_test(0.01, 1e-20, true, true, 500, 500) ));
 
+   /* Large enough for several panels, with delays */
+   TEST(( ldlt_tpp_test(0.01, 1e-20, true, false, 1200, 400) ));
+   TEST(( ldlt_tpp_test(0.01, 1e-20, true, true, 1200, 400) ));
+
+   /* Tall enough that updates and column searches are split into tasks */
+   TEST(( ldlt_tpp_split_test(0.01, 1e-20, 20000, 64, 4) ));
+   TEST(( ldlt_tpp_split_test(0.01, 1e-20, 1200, 400, 4) ));
+
    /* Torture tests */
    TEST(( ldlt_tpp_torture_test(0.01, 1e-20, 1000, 100, 100) ));
    TEST(( ldlt_tpp_torture_test(0.01, 1e-20, 1000, 100, 50) ));
@@ -11,12 +11,14 @@ program main
    use spral_hw_topology, only : numa_region
    use spral_matrix_util, only : SPRAL_MATRIX_REAL_SYM_PSDEF, &
       SPRAL_MATRIX_REAL_SYM_INDEF, print_matrix
+   use spral_amd_order, only : amd_order
    use spral_metis_wrapper, only : metis_order
    use spral_random
    use spral_random_matrix, only : random_matrix_generate
    use spral_scaling, only : hungarian_scale_sym, hungarian_options, &
       hungarian_inform
    use spral_ssids
+   use spral_ssids_fkeep, only : fit_part_costs
    implicit none
    
    integer, parameter :: long = selected_int_kind(18)
@@ -62,6 +64,7 @@ program main
    integer, parameter :: SSIDS_ERROR_NOT_LLT             = -13
    integer, parameter :: SSIDS_ERROR_NOT_LDLT            = -14
    integer, parameter :: SSIDS_ERROR_NO_SAVED_SCALING    = -15
+   integer, parameter :: SSIDS_ERROR_AMALGAMATION        = -16
    integer, parameter :: SSIDS_ERROR_ALLOCATION          = -50
    integer, parameter :: SSIDS_ERROR_CUDA_UNKNOWN        = -51
    integer, parameter :: SSIDS_ERROR_CUBLAS_UNKNOWN      = -52
@@ -91,6 +94,7 @@ program main
    call test_random
    call test_random_scale
    call test_big
+   call test_refactor
 
    write(*, "(/a)") "=========================="
    write(*, "(a,i4)") "Total number of errors = ", errors
@@ -231,7 +235,7 @@ subroutine test_errors
    write(*,"(a)",advance="no") " * Testing options%ordering oor.............."
    if (allocated(order)) deallocate(order)
    allocate(order(a%n))
-   options%ordering = 3
+   options%ordering = 6
    call ssids_analyse(check, a%n, a%ptr, a%row, akeep, options, info, order)
    call print_result(info%flag, SSIDS_ERROR_ORDER)
    deallocate(order)
@@ -247,6 +251,18 @@ subroutine test_errors
    deallocate(order)
    options%ordering = 0
 
+   call simple_mat(a)
+   write(*,"(a)",advance="no") " * Testing options%amalgamation oor.........."
+   allocate(order(a%n))
+   do i = 1,a%n
+     order(i) = i
+   end do
+   options%amalgamation = 3
+   call ssids_analyse(check, a%n, a%ptr, a%row, akeep, options, info, order)
+   call print_result(info%flag, SSIDS_ERROR_AMALGAMATION)
+   deallocate(order)
+   options%amalgamation = 1
+
    !!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!
 
    ! tests on call to ssids_analyse (entry using coordinate form)
@@ -305,6 +321,19 @@ subroutine test_errors
    call print_result(info%flag, SSIDS_ERROR_ORDER)
    call ssids_free(akeep, cuda_error)
 
+   call simple_mat_lower(a)
+   write(*,"(a)",advance="no") " * Testing options%amalgamation oor.........."
+   allocate(order(a%n))
+   do i = 1,a%n
+     order(i) = i
+   end do
+   options%amalgamation = 0
+   call ssids_analyse_coord(a%n, a%ne, a%row, a%col, akeep, options, info, &
+       order=order)
+   call print_result(info%flag, SSIDS_ERROR_AMALGAMATION)
+   deallocate(order)
+   options%amalgamation = 1
+
    call simple_mat_lower(a)
    if (allocated(order)) deallocate(order)
    allocate(order(a%n))
@@ -1149,13 +1178,30 @@ subroutine test_special
    logical :: posdef
    integer :: st, cuda_error
    integer :: test
-   integer, dimension(:), allocatable :: order
+   integer :: nnodes
+   integer :: iunit
+   type(ssids_inform) :: fit_info
+   real(wp), dimension(3) :: task
+   real(wp) :: t
+   integer :: j, k, l
+   integer, dimension(:), allocatable :: order, invp, row2
+   integer(long), dimension(:), allocatable :: ptr2
+   integer(long) :: lnz, num_factor
+   integer :: flag
    real(wp), dimension(:), allocatable :: scale
    real(wp), dimension(:), allocatable :: x1
    real(wp), dimension(:,:), allocatable :: rhs, x, res
    type(random_state) :: state
 
    integer :: big_test_n = int(1e5 + 5)
+   integer(long) :: num_flops
+   integer(long) :: blkm, contrib_cur, contrib_peak
+   integer(long), dimension(:), allocatable :: child_contrib
+   type(numa_region), dimension(:), allocatable :: topology
+   integer :: nteam
+   integer :: node
+   integer(long) :: numa_bytes
+   integer :: nthread
 
    options%unit_error = we_unit; default_options%unit_error = we_unit
    options%unit_warning = we_unit; default_options%unit_warning = we_unit
@@ -1400,6 +1446,425 @@ subroutine test_special
    call chk_answer(.true., a, akeep, options, rhs, x, res, SSIDS_SUCCESS)
    call ssids_free(akeep, cuda_error)
 
+   ! Test native nested dissection ordering (BBD is disconnected without the
+   ! border, random matrix is large enough to be dissected by several tasks)
+   write(*,"(a)",advance="no") &
+      " * Testing nested dissection, BBD........"
+   options = default_options
+   options%ordering = 3
+   call gen_bordered_block_diag(.true., (/ 150, 455, 100, 300 /), 20, a%n, &
+      a%ptr, a%row, a%val, state)
+   call ssids_analyse(check, a%n, a%ptr, a%row, akeep, options, info)
+   call print_result(info%flag,SSIDS_SUCCESS)
+   call gen_rhs(a, rhs, x1, x, res, 1)
+   call chk_answer(.true., a, akeep, options, rhs, x, res, SSIDS_SUCCESS)
+   call ssids_free(akeep, cuda_error)
+
+   write(*,"(a)",advance="no") &
+      " * Testing nested dissection, random....."
+   a%n = 10000
+   deallocate(a%ptr, a%row, a%val)
+   allocate(a%ptr(a%n+1), a%row(3*a%n), a%val(3*a%n))
+   call gen_random_posdef(a, 3_long*a%n, state)
+   call ssids_analyse(check, a%n, a%ptr, a%row, akeep, options, info)
+   call print_result(info%flag,SSIDS_SUCCESS)
+   call gen_rhs(a, rhs, x1, x, res, 1)
+   call chk_answer(.true., a, akeep, options, rhs, x, res, SSIDS_SUCCESS)
+   call ssids_free(akeep, cuda_error)
+
+   ! Test AMD ordering quality: with no amalgamation, the number of entries in
+   ! L that AMD predicts should be that found by the analyse phase for its
+   ! order, and well below that of the natural (banded) order of a grid
+   write(*,"(a)",advance="no") &
+      " * Testing AMD fill on grid.............."
+   options = default_options
+   options%ordering = 0
+   options%nemin = 1
+   call gen_grid(30, a%n, a%ptr, a%row, a%val, ptr2, row2)
+   deallocate(order, invp, stat=st)
+   allocate(order(a%n), invp(a%n))
+   do i = 1, a%n
+      order(i) = i
+   end do
+   call ssids_analyse(check, a%n, a%ptr, a%row, akeep, options, info, &
+      order=order)
+   num_factor = info%num_factor
+   call ssids_free(akeep, cuda_error)
+   call amd_order(a%n, ptr2, row2, order, invp, flag, st, lnz=lnz)
+   call ssids_analyse(check, a%n, a%ptr, a%row, akeep, options, info, &
+      order=order)
+   if (flag .ne. 0 .or. info%num_factor .ne. lnz + a%n .or. &
+         2*info%num_factor .gt. num_factor) then
+      write(*, "(a,3i10)") "AMD fill incorrect or poor ", lnz + a%n, &
+         info%num_factor, num_factor
+      errors = errors + 1
+   endif
+   call print_result(info%flag,SSIDS_SUCCESS)
+   call gen_rhs(a, rhs, x1, x, res, 1)
+   call chk_answer(.true., a, akeep, options, rhs, x, res, SSIDS_SUCCESS)
+   call ssids_free(akeep, cuda_error)
+
+   ! Test the predicted pool for contribution blocks is large enough that
+   ! no page is added to it when there are no delays
+   write(*,"(a)",advance="no") &
+      " * Testing pool size prediction.........."
+   options = default_options
+   options%ordering = 4
+   call gen_grid(100, a%n, a%ptr, a%row, a%val, ptr2, row2)
+   call ssids_analyse(check, a%n, a%ptr, a%row, akeep, options, info)
+   st = info%flag
+   do test = 1, 2
+      posdef = (test .eq. 1)
+      call ssids_factor(posdef, a%val, akeep, fkeep, options, info)
+      if (st .eq. SSIDS_SUCCESS) st = info%flag
+      if (info%num_delay .eq. 0 .and. (info%cpu_pool_bytes .le. 0 .or. &
+            info%cpu_pool_pages_added .ne. 0)) then
+         write(*, "(a,l2,i12,i4)") "Pool prediction exceeded ", posdef, &
+            info%cpu_pool_bytes, info%cpu_pool_pages_added
+         st = -1
+      endif
+   end do
+   call print_result(st, SSIDS_SUCCESS)
+   call ssids_free(akeep, fkeep, cuda_error)
+
+   ! Test approximate minimum degree ordering, and automatic choice of ordering
+   write(*,"(a)",advance="no") &
+      " * Testing AMD ordering, BBD............."
+   options = default_options
+   options%ordering = 4
+   call gen_bordered_block_diag(.true., (/ 150, 455, 100, 300 /), 20, a%n, &
+      a%ptr, a%row, a%val, state)
+   call ssids_analyse(check, a%n, a%ptr, a%row, akeep, options, info)
+   call print_result(info%flag,SSIDS_SUCCESS)
+   call gen_rhs(a, rhs, x1, x, res, 1)
+   call chk_answer(.true., a, akeep, options, rhs, x, res, SSIDS_SUCCESS)
+   call ssids_free(akeep, cuda_error)
+
+   write(*,"(a)",advance="no") &
+      " * Testing AMD ordering, random.........."
+   a%n = 10000
+   deallocate(a%ptr, a%row, a%val)
+   allocate(a%ptr(a%n+1), a%row(3*a%n), a%val(3*a%n))
+   call gen_random_posdef(a, 3_long*a%n, state)
+   call ssids_analyse(check, a%n, a%ptr, a%row, akeep, options, info)
+   call print_result(info%flag,SSIDS_SUCCESS)
+   call gen_rhs(a, rhs, x1, x, res, 1)
+   call chk_answer(.true., a, akeep, options, rhs, x, res, SSIDS_SUCCESS)
+   call ssids_free(akeep, cuda_error)
+
+   write(*,"(a)",advance="no") &
+      " * Testing automatic ordering............"
+   options%ordering = 5
+   call ssids_analyse(check, a%n, a%ptr, a%row, akeep, options, info)
+   call print_result(info%flag,SSIDS_SUCCESS)
+   call gen_rhs(a, rhs, x1, x, res, 1)
+   call chk_answer(.true., a, akeep, options, rhs, x, res, SSIDS_SUCCESS)
+   call ssids_free(akeep, cuda_error)
+
+   ! Test cost model amalgamation (a large node cost should give fewer nodes
+   ! than nemin alone)
+   write(*,"(a)",advance="no") &
+      " * Testing cost model amalgamation......."
+   options = default_options
+   options%ordering = 4
+   options%nemin = 8
+   call ssids_analyse(check, a%n, a%ptr, a%row, akeep, options, info)
+   nnodes = akeep%nnodes
+   call ssids_free(akeep, cuda_error)
+   options%amalgamation = 2
+   options%amalg_node_cost = 1e6
+   call ssids_analyse(check, a%n, a%ptr, a%row, akeep, options, info)
+   if (akeep%nnodes .ge. nnodes) then
+      write(*, "(a)") "Cost model amalgamation did not reduce number of nodes"
+      errors = errors + 1
+   endif
+   call print_result(info%flag,SSIDS_SUCCESS)
+   call gen_rhs(a, rhs, x1, x, res, 1)
+   call chk_answer(.true., a, akeep, options, rhs, x, res, SSIDS_SUCCESS)
+   call ssids_free(akeep, cuda_error)
+
+   ! Test order of children (predicted peak contribution block memory should
+   ! match that of processing the tree as numbered)
+   write(*,"(a)",advance="no") &
+      " * Testing order of children............."
+   options = default_options
+   options%ordering = 4
+   call ssids_analyse(check, a%n, a%ptr, a%row, akeep, options, info)
+   allocate(child_contrib(akeep%nnodes+1))
+   child_contrib(:) = 0
+   contrib_cur = 0
+   contrib_peak = 0
+   do i = 1, akeep%nnodes
+      blkm = (akeep%rptr(i+1) - akeep%rptr(i)) - &
+         (akeep%sptr(i+1) - akeep%sptr(i))
+      contrib_cur = contrib_cur + blkm**2
+      contrib_peak = max(contrib_peak, contrib_cur)
+      contrib_cur = contrib_cur - child_contrib(i)
+      child_contrib(akeep%sparent(i)) = child_contrib(akeep%sparent(i)) + &
+         blkm**2
+   end do
+   deallocate(child_contrib)
+   if (info%maxcontrib .ne. contrib_peak .or. contrib_peak .le. 0) then
+      write(*, "(a,2i12)") "Predicted peak contribution memory incorrect ", &
+         info%maxcontrib, contrib_peak
+      errors = errors + 1
+   endif
+   call print_result(info%flag,SSIDS_SUCCESS)
+   call gen_rhs(a, rhs, x1, x, res, 1)
+   call chk_answer(.true., a, akeep, options, rhs, x, res, SSIDS_SUCCESS)
+   call ssids_free(akeep, cuda_error)
+
+   ! Test fit of subtree splitting cost model to task times (fitted values
+   ! should be usable for a further analyse)
+   write(*,"(a)",advance="no") &
+      " * Testing subtree cost model fit........"
+   options = default_options
+   options%ordering = 4
+   call ssids_analyse(check, a%n, a%ptr, a%row, akeep, options, info)
+   call ssids_factor(.true., a%val, akeep, fkeep, options, info)
+   if ((info%part_node_cost .lt. 0) .neqv. (info%part_entry_cost .lt. 0) .or. &
+         info%part_node_cost .ne. info%part_node_cost .or. &
+         info%part_entry_cost .ne. info%part_entry_cost) then
+      write(*, "(a,2es12.4)") "Inconsistent fitted costs ", &
+         info%part_node_cost, info%part_entry_cost
+      errors = errors + 1
+   endif
+   call ssids_free(akeep, fkeep, cuda_error)
+   if (info%part_node_cost .ge. 0) then
+      options%part_node_cost = real(info%part_node_cost)
+      options%part_entry_cost = real(info%part_entry_cost)
+   endif
+   call ssids_analyse(check, a%n, a%ptr, a%row, akeep, options, info)
+   call print_result(info%flag,SSIDS_SUCCESS)
+   call gen_rhs(a, rhs, x1, x, res, 1)
+   call chk_answer(.true., a, akeep, options, rhs, x, res, SSIDS_SUCCESS)
+   call ssids_free(akeep, cuda_error)
+
+   ! Test fit of subtree cost model to synthetic task times following it
+   ! exactly, t = x f + y e + z k, which should recover y/x and z/x. Then
+   ! check tasks with proportional (f, e, k) do not determine a fit.
+   write(*,"(a)",advance="no") &
+      " * Testing fit of task times............."
+   st = 0
+   do test = 1, 2
+      fit_info%cost_fit(:) = 0
+      fit_info%part_node_cost = -1
+      fit_info%part_entry_cost = -1
+      do i = 1, 4
+         do j = 1, 3
+            task(1) = 1e6_wp * i * i
+            task(2) = 1e4_wp * j
+            task(3) = mod(i+j, 3) + 1
+            if (test .eq. 2) task(:) = i * (/ 1e6_wp, 1e4_wp, 1.0_wp /)
+            t = 1e-9_wp * task(1) + 5e-9_wp * task(2) + 2e-5_wp * task(3)
+            task(:) = task(:) / t
+            k = 0
+            do l = 1, 3
+               fit_info%cost_fit(k+1:k+4-l) = fit_info%cost_fit(k+1:k+4-l) + &
+                  task(l) * task(l:3)
+               k = k + 4 - l
+            end do
+            fit_info%cost_fit(7:9) = fit_info%cost_fit(7:9) + task(:)
+         end do
+      end do
+      call fit_part_costs(fit_info)
+      if (test .eq. 1) then
+         if (abs(fit_info%part_entry_cost - 5) .gt. 1e-6_wp * 5 .or. &
+               abs(fit_info%part_node_cost - 2e4_wp) .gt. 1e-6_wp * 2e4_wp) &
+            st = -1
+      else
+         if (fit_info%part_entry_cost .ge. 0 .or. &
+               fit_info%part_node_cost .ge. 0) st = -1
+      endif
+      if (st .ne. 0) then
+         write(*, "(a,i2,2es12.4)") "Bad fit for case", test, &
+            fit_info%part_node_cost, fit_info%part_entry_cost
+         exit
+      endif
+   end do
+   call print_result(st, 0)
+
+   ! Test hierarchical partition over four regions in two sockets, which
+   ! should be grouped into a team per socket within the team of all regions
+   write(*,"(a)",advance="no") &
+      " * Testing teams of regions.............."
+   options = default_options
+   options%ordering = 4
+   options%max_load_inbalance = 1.01
+   allocate(topology(4))
+   do i = 1, 4
+      topology(i)%nproc = 1
+      allocate(topology(i)%gpus(0))
+      topology(i)%socket = (i-1)/2
+   end do
+   call ssids_analyse(check, a%n, a%ptr, a%row, akeep, options, info, &
+      topology=topology)
+   st = info%flag
+   nteam = 1 ! Topology is squashed to a single region without OpenMP
+!$ nteam = 7
+   if (st .eq. SSIDS_SUCCESS) then
+      if (size(akeep%team_first) .ne. nteam) then
+         st = -1
+      else if (nteam .gt. 1) then
+         if (akeep%team_parent(2) .ne. 1 .or. akeep%team_first(3) .ne. 3 .or. &
+               akeep%team_last(3) .ne. 4) st = -1
+      endif
+      if (st .ne. SSIDS_SUCCESS) write(*, "(a)") "Incorrect teams of regions"
+   endif
+   call print_result(st,SSIDS_SUCCESS)
+   call gen_rhs(a, rhs, x1, x, res, 1)
+   call chk_answer(.true., a, akeep, options, rhs, x, res, SSIDS_SUCCESS)
+   call ssids_free(akeep, cuda_error)
+   deallocate(topology)
+
+   ! Test NUMA memory accounting over two regions: if threads are bound, each
+   ! byte of factor and workspace memory, and of the contribution blocks
+   ! passed between subtrees, should be counted once as local, remote or
+   ! interleaved
+   write(*,"(a)",advance="no") &
+      " * Testing NUMA memory accounting........"
+   options = default_options
+   options%ordering = 4
+   allocate(topology(2))
+   do i = 1, 2
+      topology(i)%nproc = 1
+      allocate(topology(i)%gpus(0))
+   end do
+   call ssids_analyse(check, a%n, a%ptr, a%row, akeep, options, info, &
+      topology=topology)
+   st = info%flag
+   if (st .eq. SSIDS_SUCCESS) then
+      call ssids_factor(.true., a%val, akeep, fkeep, options, info)
+      st = info%flag
+   endif
+   if (st .eq. SSIDS_SUCCESS) then
+      ! Contribution block of the root of each part with a parent
+      contrib_cur = 0
+      do i = 1, akeep%nparts
+         node = akeep%part(i+1) - 1
+         if (akeep%sparent(node) .gt. akeep%nnodes) cycle
+         blkm = (akeep%rptr(node+1) - akeep%rptr(node)) - &
+            (akeep%sptr(node+1) - akeep%sptr(node))
+         contrib_cur = contrib_cur + blkm**2 * (storage_size(1.0_wp)/8)
+      end do
+      numa_bytes = info%numa_local_bytes + info%numa_remote_bytes + &
+         info%numa_interleaved_bytes
+      if (info%cpu_contrib_bytes .ne. contrib_cur .or. &
+            info%cpu_alloc_bytes .le. 0 .or. (numa_bytes .ne. 0 .and. &
+            numa_bytes .ne. info%cpu_alloc_bytes + contrib_cur)) then
+         write(*, "(a,5i14)") "Incorrect NUMA accounting ", &
+            info%numa_local_bytes, info%numa_remote_bytes, &
+            info%numa_interleaved_bytes, info%cpu_alloc_bytes, contrib_cur
+         st = -1
+      endif
+   endif
+   call print_result(st,SSIDS_SUCCESS)
+   call ssids_free(akeep, fkeep, cuda_error)
+   deallocate(topology)
+
+   ! Test round trip of options profile
+   write(*,"(a)",advance="no") &
+      " * Testing options profile..............."
+   options = default_options
+   options%nemin = 17
+   options%small_subtree_threshold = 123456789_long
+   options%cpu_block_size = 96
+   options%cpu_inner_block_size = 64
+   options%amalgamation = 2
+   options%amalg_half_width = 40.0
+   options%part_entry_cost = 3.5
+   call options%write_profile("ssids_test.profile", st)
+   options = default_options
+   if (st .eq. 0) call options%read_profile("ssids_test.profile", st)
+   if (st .eq. 0) then
+      if (options%nemin .ne. 17 .or. &
+            options%small_subtree_threshold .ne. 123456789_long .or. &
+            options%cpu_block_size .ne. 96 .or. &
+            options%cpu_inner_block_size .ne. 64 .or. &
+            options%amalgamation .ne. 2 .or. &
+            abs(options%amalg_half_width - 40.0) .gt. 1e-3 .or. &
+            abs(options%part_entry_cost - 3.5) .gt. 1e-3) st = -1
+   endif
+   call print_result(st, 0)
+   open(newunit=iunit, file="ssids_test.profile", status='old', iostat=st)
+   if (st .eq. 0) close(iunit, status='delete')
+   options = default_options
+   call options%read_profile("ssids_test_missing.profile", st)
+   if (st .eq. 0 .or. options%nemin .ne. default_options%nemin) then
+      write(*,"(a)") "Missing profile not reported correctly"
+      errors = errors + 1
+   endif
+
+   ! Test clean data skips the conversion map and that expansion with
+   ! multiple threads gives the same analysis as with one
+   write(*,"(a)",advance="no") &
+      " * Testing clean data, parallel expand..."
+   options = default_options
+   options%ordering = 4
+   call gen_bordered_block_diag(.true., (/ (20, i = 1, 2000) /), 5, a%n, &
+      a%ptr, a%row, a%val, state)
+   deallocate(order)
+   allocate(order(a%n))
+   nthread = 1
+!$ nthread = omp_get_max_threads()
+!$ call omp_set_num_threads(1)
+   call ssids_analyse(check, a%n, a%ptr, a%row, akeep, options, info, &
+      order=order)
+!$ call omp_set_num_threads(nthread)
+   st = info%flag
+   num_flops = info%num_flops
+   call ssids_free(akeep, cuda_error)
+   if (st .eq. SSIDS_SUCCESS) then
+      call ssids_analyse(check, a%n, a%ptr, a%row, akeep, options, info, &
+         order=order)
+      st = info%flag
+   endif
+   if (st .eq. SSIDS_SUCCESS) then
+      if (allocated(akeep%map) .or. info%num_flops .ne. num_flops) st = -1
+      if (st .ne. SSIDS_SUCCESS) write(*, "(a)") "Clean data not detected"
+   endif
+   call print_result(st, SSIDS_SUCCESS)
+   call gen_rhs(a, rhs, x1, x, res, 1)
+   call chk_answer(.true., a, akeep, options, rhs, x, res, SSIDS_SUCCESS)
+   call ssids_free(akeep, cuda_error)
+
+   ! Test reuse of cached analyse results (second call should load file
+   ! written by first)
+   write(*,"(a)",advance="no") &
+      " * Testing analyse cache................."
+   options = default_options
+   options%analyse_cache = "ssids_test_cache"
+   call execute_command_line("rm -rf ssids_test_cache && " // &
+      "mkdir ssids_test_cache")
+   call gen_bordered_block_diag(.false., (/ 15, 45, 10 /), 20, a%n, a%ptr, &
+      a%row, a%val, state)
+   deallocate(order)
+   allocate(order(a%n))
+   call ssids_analyse(check, a%n, a%ptr, a%row, akeep, options, info, &
+      order=order)
+   if (info%flag .ne. SSIDS_SUCCESS) then
+      call print_result(info%flag, SSIDS_SUCCESS)
+   else
+      st = SSIDS_SUCCESS
+      if (info%analyse_cache_hit) st = -1
+      num_flops = info%num_flops
+      call ssids_free(akeep, cuda_error)
+      order(:) = 0
+      call ssids_analyse(check, a%n, a%ptr, a%row, akeep, options, info, &
+         order=order)
+      if (st .eq. SSIDS_SUCCESS) st = info%flag
+      if (st .eq. SSIDS_SUCCESS) then
+         if (.not. info%analyse_cache_hit) st = -1
+         if (info%num_flops .ne. num_flops) st = -1
+         if (any(order(:) .lt. 1 .or. order(:) .gt. a%n)) st = -1
+      endif
+      call print_result(st, SSIDS_SUCCESS)
+      call gen_rhs(a, rhs, x1, x, res, 1)
+      call chk_answer(.false., a, akeep, options, rhs, x, res, SSIDS_SUCCESS)
+   endif
+   call ssids_free(akeep, cuda_error)
+   call execute_command_line("rm -rf ssids_test_cache")
+
 end subroutine test_special
 
 !!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!
@@ -1473,6 +1938,68 @@ end subroutine gen_bordered_block_diag
 
 !!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!
 
+! Generates the 5-point Laplacian on an nx by nx grid, returning its lower
+! triangle and the pattern of both triangles without the diagonal
+subroutine gen_grid(nx, n, ptr, row, val, ptr2, row2)
+   integer, intent(in) :: nx
+   integer, intent(out) :: n
+   integer, dimension(:), allocatable :: ptr
+   integer, dimension(:), allocatable :: row
+   real(wp), dimension(:), allocatable :: val
+   integer(long), dimension(:), allocatable :: ptr2
+   integer, dimension(:), allocatable :: row2
+
+   integer :: i, j, k
+   integer(long) :: k2
+   integer :: st
+
+   ! Clear any previous allocs
+   deallocate(ptr, stat=st)
+   deallocate(row, stat=st)
+   deallocate(val, stat=st)
+   deallocate(ptr2, stat=st)
+   deallocate(row2, stat=st)
+
+   n = nx*nx
+   allocate(ptr(n+1), row(3*n), val(3*n), ptr2(n+1), row2(4*n))
+   j = 1
+   k2 = 1
+   do k = 1, n
+      i = mod(k-1, nx) + 1 ! Position within grid line
+      ptr(k) = j
+      ptr2(k) = k2
+      row(j) = k
+      val(j) = 4.0
+      j = j + 1
+      if (k .gt. nx) then
+         row2(k2) = k - nx
+         k2 = k2 + 1
+      end if
+      if (i .gt. 1) then
+         row2(k2) = k - 1
+         k2 = k2 + 1
+      end if
+      if (i .lt. nx) then
+         row(j) = k + 1
+         val(j) = -1.0
+         j = j + 1
+         row2(k2) = k + 1
+         k2 = k2 + 1
+      end if
+      if (k+nx .le. n) then
+         row(j) = k + nx
+         val(j) = -1.0
+         j = j + 1
+         row2(k2) = k + nx
+         k2 = k2 + 1
+      end if
+   end do
+   ptr(n+1) = j
+   ptr2(n+1) = k2
+end subroutine gen_grid
+
+!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!
+
 subroutine simple_mat_lower(a,extra)
    ! simple pos def test matrix (lower triangular part only)
    type(matrix_type), intent(inout) :: a
@@ -1885,6 +2412,8 @@ subroutine test_random
       do i = 1, 2
          fake_topology(i)%nproc = 2
          allocate(fake_topology(i)%gpus(0))
+         allocate(fake_topology(i)%cache_groups(2))
+         fake_topology(i)%cache_groups(:) = 1
       end do
    else
       allocate(fake_topology(1))
@@ -1956,6 +2485,8 @@ subroutine test_random
       if(debug) call print_matrix(6, -1, mt, a%n, a%n, a%ptr, a%row, a%val)
 
       options%ordering = random_integer(state, 2) - 1 ! user or metis
+      options%tree_schedule = random_integer(state, 3)
+      options%ignore_cache = random_logical(state)
 
       if(random_logical(state)) then
          options%nstream = random_integer(state, 4)
@@ -2405,6 +2936,127 @@ end subroutine test_big
 
 !!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!
 
+subroutine test_refactor
+   type(ssids_akeep) :: akeep
+   type(ssids_fkeep) :: fkeep
+   type(ssids_options) :: options
+   type(ssids_inform) :: info
+
+   integer :: maxn = 500
+   integer, parameter :: nprob = 20
+   integer, parameter :: nrhs = 2
+   type(random_state) :: state
+
+   type(matrix_type) :: a
+   real(wp), allocatable, dimension(:, :) :: rhs,x
+   real(wp), allocatable, dimension(:) :: x1
+   real(wp), allocatable, dimension(:, :) :: res
+
+   logical :: posdef, check
+   integer :: prblm, i, k, cuda_error
+   integer(long) :: nza
+
+   write(*, "(a)")
+   write(*, "(a)") "==================="
+   write(*, "(a)") "Testing refactorize"
+   write(*, "(a)") "==================="
+
+   allocate(a%ptr(maxn+1))
+   allocate(a%row(2*maxn**2), a%val(2*maxn**2))
+
+   ! Refactorize before factorize
+   write(*,"(a)",advance="no") " * Testing refactor before factor.........."
+   a%n = 10
+   call gen_random_posdef(a, 20_long, state)
+   call ssids_analyse(.false., a%n, a%ptr, a%row, akeep, options, info)
+   call ssids_refactor(a%val, akeep, fkeep, options, info)
+   call print_result(info%flag, SSIDS_ERROR_CALL_SEQUENCE)
+   call ssids_free(akeep, fkeep, cuda_error)
+
+   do prblm = 1, nprob
+      ! Generate parameters
+      posdef = random_logical(state)
+      check = random_logical(state)
+      a%n = random_integer(state, maxn)
+      nza = a%n + random_integer(state, max(1, a%n**2/2 - a%n))
+      options%scaling = random_integer(state, 3) - 1 ! none, MC64 or auction
+      options%action = .true.
+
+      write(*, "(a, i3, a, i5, a, i7, a, l1, a, i2, a)",advance="no") &
+         " * no. ", prblm,  " n = ", a%n, " nza = ", nza, " posdef = ", &
+         posdef, " scal = ", options%scaling, "..."
+
+      if(posdef) then
+         call gen_random_posdef(a, nza, state)
+      else
+         call gen_random_indef(a, nza, state)
+      endif
+
+      call ssids_analyse(check, a%n, a%ptr, a%row, akeep, options, info)
+      if(info%flag .lt. SSIDS_SUCCESS) then
+         write(*, "(a,i3)") "fail on analyse", info%flag
+         errors = errors + 1
+         call ssids_free(akeep, cuda_error)
+         cycle
+      endif
+
+      call ssids_factor(posdef, a%val, akeep, fkeep, options, info, &
+         ptr=a%ptr, row=a%row)
+      if(info%flag .lt. SSIDS_SUCCESS) then
+         write(*, "(a,i3)") "fail on factor", info%flag
+         errors = errors + 1
+         call ssids_free(akeep, fkeep, cuda_error)
+         cycle
+      endif
+
+      ! Change values, preserving definiteness (and nonsingularity)
+      if(posdef) then
+         a%val(1:a%ptr(a%n+1)-1) = 2*a%val(1:a%ptr(a%n+1)-1)
+         do k = 1, a%n
+            a%val(a%ptr(k)) = a%val(a%ptr(k)) + k ! Diagonal is first entry
+         end do
+      else
+         a%val(1:a%ptr(a%n+1)-1) = -3*a%val(1:a%ptr(a%n+1)-1)
+      endif
+
+      ! Refactorize twice to check factors are reset between calls
+      do i = 1, 2
+         call ssids_refactor(a%val, akeep, fkeep, options, info)
+         if(info%flag .lt. SSIDS_SUCCESS) exit
+      end do
+      if(info%flag .lt. SSIDS_SUCCESS) then
+         write(*, "(a,i3)") "fail on refactor", info%flag
+         errors = errors + 1
+         call ssids_free(akeep, fkeep, cuda_error)
+         cycle
+      endif
+
+      ! Solve with changed values
+      call gen_rhs(a, rhs, x1, x, res, nrhs)
+      call ssids_solve(nrhs, x, a%n, akeep, fkeep, options, info)
+      if(info%flag .lt. SSIDS_SUCCESS) then
+         write(*, "(a,i4)") " fail on solve", info%flag
+         errors = errors + 1
+         call ssids_free(akeep, fkeep, cuda_error)
+         cycle
+      endif
+
+      call compute_resid(nrhs,a,x,a%n,rhs,a%n,res,a%n)
+      if(maxval(abs(res(1:a%n,1:nrhs))) < err_tol_scale) then
+         write(*, "(a)") "ok"
+      else
+         write(*, "(a,es12.4)") "fail residual = ", &
+            maxval(abs(res(1:a%n,1:nrhs)))
+         errors = errors + 1
+      endif
+
+      call ssids_free(akeep, fkeep, cuda_error)
+   end do
+
+end subroutine test_refactor
+
+!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!
+
 subroutine test_random_scale
    type(ssids_akeep) :: akeep
    type(ssids_fkeep) :: fkeep